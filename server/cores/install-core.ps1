@@ -63,6 +63,13 @@ Copy-Item -Path "$REPO_CORE\nf_time.cpp" -Destination $NF_CORE_DIR -Force
 Copy-Item -Path "$REPO_CORE\nf_arduino_time.cpp" -Destination $NF_CORE_DIR -Force
 Copy-Item -Path "$REPO_CORE\nf_gpio.h" -Destination $NF_CORE_DIR -Force
 Copy-Item -Path "$REPO_CORE\nf_gpio.cpp" -Destination $NF_CORE_DIR -Force
+Copy-Item -Path "$REPO_CORE\nf_proto.h" -Destination $NF_CORE_DIR -Force
+Copy-Item -Path "$REPO_CORE\nf_uart.h" -Destination $NF_CORE_DIR -Force
+Copy-Item -Path "$REPO_CORE\nf_uart.cpp" -Destination $NF_CORE_DIR -Force
+Copy-Item -Path "$REPO_CORE\nf_input.h" -Destination $NF_CORE_DIR -Force
+Copy-Item -Path "$REPO_CORE\nf_input.cpp" -Destination $NF_CORE_DIR -Force
+Copy-Item -Path "$REPO_CORE\nf_adc.h" -Destination $NF_CORE_DIR -Force
+Copy-Item -Path "$REPO_CORE\nf_adc.cpp" -Destination $NF_CORE_DIR -Force
 
 Write-Host "[OK] NeuroForge Time e GPIO adicionados" -ForegroundColor Green
 
@@ -98,7 +105,7 @@ if ($LASTEXITCODE -ne 0) {
 Write-Host ""
 Write-Host "[...] Verificando instalacao..." -ForegroundColor Cyan
 
-$files = @("nf_time.h", "nf_time.cpp", "nf_arduino_time.cpp", "nf_gpio.h", "nf_gpio.cpp")
+$files = @("nf_time.h", "nf_time.cpp", "nf_arduino_time.cpp", "nf_gpio.h", "nf_gpio.cpp", "nf_proto.h", "nf_uart.h", "nf_uart.cpp", "nf_input.h", "nf_input.cpp", "nf_adc.h", "nf_adc.cpp")
 foreach ($file in $files) {
     if (Test-Path "$NF_CORE_DIR\$file") {
         Write-Host "  [OK] $file" -ForegroundColor Green
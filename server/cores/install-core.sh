@@ -12,7 +12,7 @@ echo "========================================"
 echo ""
 
 # 1. Detectar diretório do arduino-cli
-ARDUINO_DATA="$HOME/.arduino15"
+ARDUINO_DATA="${ARDUINO_DIRECTORIES_DATA:-$HOME/.arduino15}"
 
 if [ ! -d "$ARDUINO_DATA" ]; then
     echo "❌ Arduino15 não encontrado em: $ARDUINO_DATA"
@@ -64,8 +64,17 @@ REPO_CORE="$(dirname "$0")/neuroforge_qemu"
 cp "$REPO_CORE/nf_time.h" "$NF_CORE_DIR/"
 cp "$REPO_CORE/nf_time.cpp" "$NF_CORE_DIR/"
 cp "$REPO_CORE/nf_arduino_time.cpp" "$NF_CORE_DIR/"
-
-echo "✅ NeuroForge Time adicionado"
+cp "$REPO_CORE/nf_gpio.h" "$NF_CORE_DIR/"
+cp "$REPO_CORE/nf_gpio.cpp" "$NF_CORE_DIR/"
+cp "$REPO_CORE/nf_proto.h" "$NF_CORE_DIR/"
+cp "$REPO_CORE/nf_uart.h" "$NF_CORE_DIR/"
+cp "$REPO_CORE/nf_uart.cpp" "$NF_CORE_DIR/"
+cp "$REPO_CORE/nf_input.h" "$NF_CORE_DIR/"
+cp "$REPO_CORE/nf_input.cpp" "$NF_CORE_DIR/"
+cp "$REPO_CORE/nf_adc.h" "$NF_CORE_DIR/"
+cp "$REPO_CORE/nf_adc.cpp" "$NF_CORE_DIR/"
+
+echo "✅ NeuroForge Time e GPIO adicionados"
 
 # 6. Registrar board no boards.txt
 echo "📦 Registrando board unoqemu..."
@@ -81,11 +90,20 @@ else
     echo "✅ Board unoqemu registrado"
 fi
 
-# 7. Verificar instalação
+# 7. Aplicar patches no core (timing, GPIO, UART; ver patch-wiring.sh)
+echo ""
+echo "🩹 Aplicando patches no core..."
+
+if ! bash "$(dirname "$0")/patch-wiring.sh" "$NF_CORE_DIR"; then
+    echo "❌ Falha ao aplicar patch!"
+    exit 1
+fi
+
+# 8. Verificar instalação
 echo ""
 echo "🔍 Verificando instalação..."
 
-for file in nf_time.h nf_time.cpp nf_arduino_time.cpp; do
+for file in nf_time.h nf_time.cpp nf_arduino_time.cpp nf_gpio.h nf_gpio.cpp nf_proto.h nf_uart.h nf_uart.cpp nf_input.h nf_input.cpp nf_adc.h nf_adc.cpp; do
     if [ -f "$NF_CORE_DIR/$file" ]; then
         echo "  ✅ $file"
     else
@@ -93,7 +111,7 @@ for file in nf_time.h nf_time.cpp nf_arduino_time.cpp; do
     fi
 done
 
-# 8. Testar arduino-cli
+# 9. Testar arduino-cli
 echo ""
 echo "🧪 Testando arduino-cli..."
 
@@ -105,7 +123,7 @@ else
     echo "💡 Tente: arduino-cli core update-index"
 fi
 
-# 9. Sucesso!
+# 10. Sucesso!
 echo ""
 echo "========================================"
 echo "✅ Instalação concluída com sucesso!"
@@ -0,0 +1,99 @@
+#include "nf_adc.h"
+#include "nf_proto.h"
+#include "nf_time.h"
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+/**
+ * Analog inputs fed by the host in bulk.
+ *
+ * A waveform is uploaded once into a small sample pool (NF_OP_ADC_DATA)
+ * and played back on a channel (NF_OP_ADC_PLAY): analogRead() picks the
+ * sample for the current virtual time, so a sketch sampling at kHz rates
+ * costs no UART traffic at all. The host allocates the pool regions.
+ */
+
+// Pool shared by all channels (2 bytes per sample), e.g. -DNF_ADC_POOL_LEN=128
+#ifndef NF_ADC_POOL_LEN
+#define NF_ADC_POOL_LEN 64
+#endif
+
+#define NF_ADC_CHANNELS 8 // ADC0-ADC7 (A0-A5 on the Uno)
+#define NF_ADC_FIRST_PIN 14 // A0
+
+#define NF_ADC_OFF 0
+#define NF_ADC_CONST 1
+#define NF_ADC_TABLE 2
+
+struct nf_adc_channel {
+  uint8_t mode;
+  uint16_t value; // NF_ADC_CONST
+  uint16_t start; // NF_ADC_TABLE
+  uint16_t len;
+  uint32_t period_us;
+  uint32_t t0_us;
+};
+
+// Written by the RX interrupt: read under cli() (a compiler barrier too)
+static uint16_t nf_adc_pool[NF_ADC_POOL_LEN];
+static nf_adc_channel nf_adc_channels[NF_ADC_CHANNELS];
+
+static int8_t nf_adc_channel_of(uint8_t pin) {
+  if (pin >= NF_ADC_FIRST_PIN)
+    pin -= NF_ADC_FIRST_PIN;
+  return pin < NF_ADC_CHANNELS ? (int8_t)pin : -1;
+}
+
+void nf_adc_const(uint8_t pin, uint16_t value) {
+  int8_t ch = nf_adc_channel_of(pin);
+  if (ch < 0)
+    return;
+
+  nf_adc_channels[ch].value = value;
+  nf_adc_channels[ch].mode = value == NF_ADC_RELEASE ? NF_ADC_OFF : NF_ADC_CONST;
+}
+
+void nf_adc_data(uint16_t index, const uint8_t *samples) {
+  for (uint8_t i = 0; i < NF_ADC_DATA_SAMPLES; i++, index++) {
+    if (index < NF_ADC_POOL_LEN)
+      nf_adc_pool[index] = samples[2 * i] | ((uint16_t)samples[2 * i + 1] << 8);
+  }
+}
+
+void nf_adc_play(uint8_t pin, uint16_t start, uint16_t len, uint32_t period_us) {
+  int8_t ch = nf_adc_channel_of(pin);
+  if (ch < 0 || len == 0 || start >= NF_ADC_POOL_LEN || len > NF_ADC_POOL_LEN - start)
+    return;
+
+  nf_adc_channel &c = nf_adc_channels[ch];
+  c.start = start;
+  c.len = len;
+  c.period_us = period_us ? period_us : 1;
+  c.t0_us = nf_now_us();
+  c.mode = NF_ADC_TABLE;
+}
+
+int16_t nf_adc_read(uint8_t pin) {
+  int8_t ch = nf_adc_channel_of(pin);
+  if (ch < 0)
+    return -1;
+
+  uint8_t sreg = SREG;
+  cli();
+  nf_adc_channel c = nf_adc_channels[ch];
+  SREG = sreg;
+
+  if (c.mode == NF_ADC_CONST)
+    return (int16_t)c.value;
+  if (c.mode != NF_ADC_TABLE)
+    return -1;
+
+  // 32-bit virtual time: wraps every ~71 min, the waveform just restarts
+  uint32_t step = (nf_now_us() - c.t0_us) / c.period_us;
+  uint16_t index = c.start + (uint16_t)(step % c.len);
+
+  cli();
+  uint16_t sample = nf_adc_pool[index];
+  SREG = sreg;
+  return (int16_t)sample;
+}
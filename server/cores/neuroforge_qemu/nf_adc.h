@@ -0,0 +1,28 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Host-fed analog inputs (NF_OP_ADC_*), called from the RX interrupt.
+ *
+ * nf_adc_const():  fixed value; NF_ADC_RELEASE hands the channel back to the ADC
+ * nf_adc_data():   write NF_ADC_DATA_SAMPLES samples into the shared pool
+ * nf_adc_play():   loop pool[start .. start+len) on a channel, one sample
+ *                  every period_us of virtual time
+ */
+void nf_adc_const(uint8_t pin, uint16_t value);
+void nf_adc_data(uint16_t index, const uint8_t *samples);
+void nf_adc_play(uint8_t pin, uint16_t start, uint16_t len, uint32_t period_us);
+
+/**
+ * Host-fed value for analogRead(pin), or -1 if the host does not feed it.
+ * Accepts both channel numbers and A0.. pin numbers.
+ */
+int16_t nf_adc_read(uint8_t pin);
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,6 +8,7 @@
  * - delay(ms)  → usa nf_sleep_ms() em vez de Timer0
  * - millis()   → usa nf_now_ms() em vez de Timer0 overflow
  * - micros()   → usa nf_now_us() em vez de Timer0
+ * - delayMicroseconds(us) → usa nf_sleep_us() (avança o clock virtual)
  * 
  * Isso permite que sketches Arduino padrão funcionem
  * no QEMU sem modificações.
@@ -49,10 +50,11 @@ unsigned long micros(void) {
 }
 
 /**
- * delayMicroseconds() continua usando _delay_us().
+ * Substitui delayMicroseconds() do Arduino.
  * 
- * Como é uma função de busy-wait puro baseado em F_CPU,
- * já funciona corretamente no QEMU sem modificações.
- * 
- * Não precisamos sobrescrever.
+ * O original é só um loop de ciclos: não avança o clock virtual,
+ * então micros() medido em volta dele dava 0.
  */
+void delayMicroseconds(unsigned int us) {
+  nf_sleep_us((uint32_t)us);
+}
@@ -1,58 +1,636 @@
 #include "nf_gpio.h"
+#include "nf_proto.h"
+#include "nf_time.h"
+#include "nf_uart.h"
+#include <Arduino.h>
+#include <avr/interrupt.h>
 #include <avr/io.h>
+#include <string.h>
 
 /**
- * Low-level UART0 write to send GPIO frames to QEMU.
- * This works even if Serial.begin() was not called.
+ * GPIO reports are queued on the nf_uart TX ring buffer.
+ *
+ * Overflow policy: when the ring is full, the report is not lost but
+ * coalesced - the pin is marked pending and only its latest state is
+ * sent once the ring drains. Every superseded report bumps a drop
+ * counter that is sent to the host right after the pending pins.
  */
-static void uart_send(char c) {
-  // Wait for empty transmit buffer
-  while (!(UCSR0A & (1 << UDRE0)))
-    ;
-  // Put data into buffer, sends the data
-  UDR0 = c;
-}
 
-static void uart_print(const char *s) {
-  while (*s)
-    uart_send(*s++);
+// Pins 0-31 whose latest state is waiting for room on the ring
+static uint32_t nf_pending_gpio = 0;
+static uint32_t nf_pending_mode = 0;
+
+static uint16_t nf_dropped = 0;
+static uint16_t nf_dropped_reported = 0;
+
+/**
+ * Port-snapshot batching (see nf_gpio_set_batch).
+ * Default can be chosen at build time, e.g. -DNF_GPIO_BATCH=1
+ * (boards.txt "NeuroForge GPIO" menu).
+ */
+#ifndef NF_GPIO_BATCH
+#define NF_GPIO_BATCH NF_GPIO_BATCH_OFF
+#endif
+
+#ifndef NF_GPIO_BATCH_INTERVAL_MS
+#define NF_GPIO_BATCH_INTERVAL_MS 10
+#endif
+
+static uint8_t nf_batch_mode = NF_GPIO_BATCH;
+static uint16_t nf_batch_interval = NF_GPIO_BATCH_INTERVAL_MS;
+static uint32_t nf_batch_last_ms = 0;
+static uint32_t nf_batch_dirty = 0;  // Pins written since the last flush
+static uint8_t nf_batch_pending = 0; // Last flush did not fit in the ring
+static uint8_t nf_last_port[3] = {0, 0, 0}; // PORTB, PORTC, PORTD
+
+// analogWrite() value of each pin, and pins whose PWM report did not fit in the ring
+static uint8_t nf_pwm_duty[32];
+static uint32_t nf_pending_pwm = 0;
+
+/**
+ * PWM frequency of a timer output pin, from the live timer registers
+ * (Arduino defaults: 976 Hz on Timer0, 490 Hz on Timer1/2). 0 if stopped.
+ */
+static uint32_t nf_pwm_frequency(uint8_t pin) {
+  static const uint16_t prescale01[8] = {0, 1, 8, 64, 256, 1024, 0, 0}; // 6-7: external clock
+  static const uint16_t prescale2[8] = {0, 1, 8, 32, 64, 128, 256, 1024};
+  uint16_t prescale;
+  uint16_t top;
+  uint8_t dual_slope; // Phase correct: counts up and down
+
+  switch (digitalPinToTimer(pin)) {
+  case TIMER0A:
+  case TIMER0B:
+    prescale = prescale01[TCCR0B & 7];
+    top = 0xFF;
+    dual_slope = !(TCCR0A & (1 << WGM01));
+    break;
+  case TIMER2A:
+  case TIMER2B:
+    prescale = prescale2[TCCR2B & 7];
+    top = 0xFF;
+    dual_slope = !(TCCR2A & (1 << WGM21));
+    break;
+  case TIMER1A:
+  case TIMER1B: {
+    prescale = prescale01[TCCR1B & 7];
+    uint8_t wgm = (TCCR1A & 3) | ((TCCR1B >> 1) & 0x0C);
+    switch (wgm) {
+    case 1: case 5: top = 0xFF; break;
+    case 2: case 6: top = 0x1FF; break;
+    case 3: case 7: top = 0x3FF; break;
+    case 8: case 10: case 14: top = ICR1; break;
+    case 9: case 11: case 15: top = OCR1A; break;
+    default: return 0;
+    }
+    dual_slope = wgm < 12 && wgm != 5 && wgm != 6 && wgm != 7;
+    break;
+  }
+  default:
+    return 0;
+  }
+
+  if (!prescale || !top)
+    return 0;
+  uint32_t divisor = (uint32_t)prescale * (dual_slope ? 2UL * top : top + 1UL);
+  return (F_CPU + divisor / 2) / divisor;
 }
 
-static void uart_print_num(uint8_t n) {
+#ifdef NF_GPIO_ASCII
+
+static uint8_t nf_put_num(uint8_t *buf, uint8_t n) {
+  uint8_t len = 0;
   if (n >= 100)
-    uart_send('0' + (n / 100) % 10);
+    buf[len++] = '0' + (n / 100) % 10;
   if (n >= 10)
-    uart_send('0' + (n / 10) % 10);
-  uart_send('0' + (n % 10));
+    buf[len++] = '0' + (n / 10) % 10;
+  buf[len++] = '0' + (n % 10);
+  return len;
+}
+
+static uint8_t nf_put_u32(uint8_t *buf, uint32_t n) {
+  uint8_t digits[10];
+  uint8_t count = 0;
+  do {
+    digits[count++] = '0' + n % 10;
+    n /= 10;
+  } while (n);
+
+  for (uint8_t i = 0; i < count; i++)
+    buf[i] = digits[count - 1 - i];
+  return count;
+}
+
+/**
+ * Queue "P:pin=<n>,d=<duty 0-65535>,f=<Hz>\n"
+ */
+static uint8_t nf_emit_pwm(uint8_t pin, uint8_t duty) {
+  uint8_t buf[32];
+  uint8_t len = 0;
+  const char *tag = "P:pin=";
+  while (*tag)
+    buf[len++] = *tag++;
+  len += nf_put_num(buf + len, pin);
+  buf[len++] = ',';
+  buf[len++] = 'd';
+  buf[len++] = '=';
+  len += nf_put_u32(buf + len, (uint16_t)duty * 257);
+  buf[len++] = ',';
+  buf[len++] = 'f';
+  buf[len++] = '=';
+  len += nf_put_u32(buf + len, nf_pwm_frequency(pin));
+  buf[len++] = '\n';
+  return nf_uart_write(buf, len);
+}
+
+/**
+ * Queue "<tag>:pin=<n>,<key>=<v>\n" (protocol v1.0)
+ */
+static uint8_t nf_emit(uint8_t op, uint8_t pin, uint8_t value) {
+  uint8_t buf[16];
+  uint8_t len = 0;
+
+  if (op == NF_OP_PWM)
+    return nf_emit_pwm(pin, value);
+
+  if (op == NF_OP_DROPS) {
+    // D:n=<count low byte>, good enough to notice coalescing in ASCII mode
+    buf[len++] = 'D';
+    buf[len++] = ':';
+    buf[len++] = 'n';
+    buf[len++] = '=';
+    len += nf_put_num(buf + len, pin);
+    buf[len++] = '\n';
+    return nf_uart_write(buf, len);
+  }
+
+  buf[len++] = (op == NF_OP_GPIO) ? 'G' : 'M';
+  buf[len++] = ':';
+  buf[len++] = 'p';
+  buf[len++] = 'i';
+  buf[len++] = 'n';
+  buf[len++] = '=';
+  len += nf_put_num(buf + len, pin);
+  buf[len++] = ',';
+  buf[len++] = (op == NF_OP_GPIO) ? 'v' : 'm';
+  buf[len++] = '=';
+  // Mapping: 0=INPUT, 1=OUTPUT, 2=INPUT_PULLUP
+  buf[len++] = '0' + value;
+  buf[len++] = '\n';
+  return nf_uart_write(buf, len);
 }
 
-// Cache to avoid redundant reporting
-static uint8_t nf_pin_states[32] = {0xFF}; // 0xFF means unknown
-static uint8_t nf_mode_states[32] = {0xFF};
+/**
+ * Protocol v1.0 has no aggregate line: only the window's final level
+ */
+static uint8_t nf_emit_agg(uint8_t pin, uint16_t edges, uint16_t high, uint8_t level) {
+  (void)edges;
+  (void)high;
+  return nf_emit(NF_OP_GPIO, pin, level);
+}
+
+#else
+
+/**
+ * Queue one binary frame. The protocol is announced once, before the
+ * first report, so the host parser can switch out of ASCII mode.
+ */
+static uint8_t nf_emit_frame(uint8_t op, const uint8_t *payload, uint8_t len) {
+  if (!nf_uart_hello())
+    return 0;
+  return nf_uart_send_frame(op, payload, len);
+}
+
+static uint8_t nf_emit_pwm(uint8_t pin, uint8_t duty) {
+  uint16_t duty16 = (uint16_t)duty * 257; // 255 -> 65535
+  uint32_t freq = nf_pwm_frequency(pin);
+  uint8_t payload[NF_OP_PWM_LEN] = {pin,
+                                    (uint8_t)duty16,
+                                    (uint8_t)(duty16 >> 8),
+                                    (uint8_t)freq,
+                                    (uint8_t)(freq >> 8),
+                                    (uint8_t)(freq >> 16),
+                                    (uint8_t)(freq >> 24)};
+  return nf_emit_frame(NF_OP_PWM, payload, sizeof(payload));
+}
+
+static uint8_t nf_emit_agg(uint8_t pin, uint16_t edges, uint16_t high, uint8_t level) {
+  uint8_t payload[NF_OP_AGG_LEN] = {pin,
+                                    (uint8_t)edges,
+                                    (uint8_t)(edges >> 8),
+                                    (uint8_t)high,
+                                    (uint8_t)(high >> 8),
+                                    level};
+  return nf_emit_frame(NF_OP_AGG, payload, sizeof(payload));
+}
+
+static uint8_t nf_emit(uint8_t op, uint8_t a, uint8_t b) {
+  if (op == NF_OP_PWM)
+    return nf_emit_pwm(a, b);
+
+  uint8_t payload[2] = {a, b};
+  return nf_emit_frame(op, payload, sizeof(payload));
+}
+
+#endif
+
+/**
+ * Queue a report, or mark it pending if the ring is full.
+ * Must run with interrupts disabled (pending masks are shared with the ISR).
+ */
+static void nf_queue(uint32_t *pending, uint8_t op, uint8_t pin,
+                     uint8_t value) {
+  if (pin >= 32) {
+    // No coalescing slot: best effort
+    nf_emit(op, pin, value);
+    return;
+  }
+
+  uint32_t bit = (uint32_t)1 << pin;
+  if (*pending & bit) {
+    // Older state still waiting: superseded by this one
+    nf_dropped++;
+    return;
+  }
+
+  if (nf_emit(op, pin, value))
+    return;
+
+  // Nobody drains the ring while interrupts are off: do it by hand
+  if (!(SREG & (1 << SREG_I))) {
+    nf_uart_poll();
+    if (nf_emit(op, pin, value))
+      return;
+  }
+
+  *pending |= bit;
+  nf_dropped++;
+}
+
+// Cache to avoid redundant reporting (0xFF means unknown)
+static uint8_t nf_pin_states[32];
+static uint8_t nf_mode_states[32];
+
+// An initializer would only set element 0: start every pin as unknown,
+// so the first write of each pin is reported even if it is LOW/INPUT
+__attribute__((constructor)) static void nf_gpio_init(void) {
+  memset(nf_pin_states, 0xFF, sizeof(nf_pin_states));
+  memset(nf_mode_states, 0xFF, sizeof(nf_mode_states));
+}
+
+/**
+ * Per-pin reporting policy (nf_gpio_set_policy).
+ *
+ * Aggregated pins count edges and the time spent HIGH in the current
+ * window. The HIGH time is a running sum of edge timestamps (-t when the
+ * pin rises, +t when it falls, +t_end if it ends HIGH), so no per-pin
+ * timestamp of the last edge is needed. Only Arduino digital pins can be
+ * aggregated (-DNF_GPIO_AGG_PINS to change).
+ */
+#ifndef NF_GPIO_AGG_PINS
+#define NF_GPIO_AGG_PINS NUM_DIGITAL_PINS
+#endif
+
+static uint32_t nf_policy_off = 0;
+static uint32_t nf_policy_agg = 0;
+static uint16_t nf_agg_window_ms = 50;
+static uint32_t nf_agg_start_us = 0;
+static uint16_t nf_agg_edges[NF_GPIO_AGG_PINS];
+static uint32_t nf_agg_high[NF_GPIO_AGG_PINS];
+
+/**
+ * Send one NF_OP_AGG frame per aggregated pin that changed and start the
+ * next window at t_end. Must run with interrupts disabled.
+ */
+static void nf_agg_close(uint32_t t_end) {
+  for (uint8_t pin = 0; pin < NF_GPIO_AGG_PINS; pin++) {
+    uint32_t bit = (uint32_t)1 << pin;
+    if (!(nf_policy_agg & bit))
+      continue;
+
+    uint8_t level = nf_pin_states[pin] == 1;
+    if (nf_agg_edges[pin]) {
+      uint32_t span = t_end - nf_agg_start_us;
+      uint32_t high = nf_agg_high[pin] + (level ? t_end : 0);
+      // Scale down so high * 65535 fits in 32 bits (no 64-bit division on AVR)
+      while (span > 0xFFFF) {
+        span >>= 1;
+        high >>= 1;
+      }
+      uint16_t ratio = span ? (uint16_t)((high >= span ? span : high) * 65535UL / span) : (level ? 0xFFFF : 0);
+
+      if (!nf_emit_agg(pin, nf_agg_edges[pin], ratio, level)) {
+        // Window lost: the final level still goes out once the ring drains
+        nf_pending_gpio |= bit;
+        nf_dropped++;
+      }
+    }
+
+    nf_agg_edges[pin] = 0;
+    nf_agg_high[pin] = level ? 0 - t_end : 0;
+  }
+  nf_agg_start_us = t_end;
+}
+
+/**
+ * Close the window if it is over, or if it ends within horizon_us
+ * (the caller is about to sleep that long). Interrupts disabled.
+ */
+static void nf_agg_poll(uint32_t horizon_us) {
+  if (!nf_policy_agg)
+    return;
+
+  uint32_t now = nf_now_us();
+  uint32_t window_us = (uint32_t)nf_agg_window_ms * 1000UL;
+  uint32_t elapsed = now - nf_agg_start_us;
+  if (elapsed >= window_us)
+    nf_agg_close(now);
+  else if (horizon_us >= window_us - elapsed)
+    nf_agg_close(nf_agg_start_us + window_us);
+}
+
+/**
+ * Account one level change of an aggregated pin. Interrupts disabled.
+ */
+static void nf_agg_edge(uint8_t pin, uint8_t value) {
+  uint32_t now = nf_now_us();
+  uint8_t was_high = nf_pin_states[pin] == 1;
+
+  if (value && !was_high)
+    nf_agg_high[pin] -= now;
+  else if (!value && was_high)
+    nf_agg_high[pin] += now;
+  nf_pin_states[pin] = value;
+
+  if (nf_agg_edges[pin] != 0xFFFF)
+    nf_agg_edges[pin]++;
+  nf_agg_poll(0);
+}
+
+void nf_gpio_set_policy(uint32_t off_mask, uint32_t agg_mask, uint16_t window_ms) {
+  uint8_t sreg = SREG;
+  cli();
+  uint32_t now = nf_now_us();
+
+  // Report what the old windows collected before their pins change policy
+  if (nf_policy_agg)
+    nf_agg_close(now);
+
+  agg_mask &= ~off_mask;
+#if NF_GPIO_AGG_PINS < 32
+  agg_mask &= ((uint32_t)1 << NF_GPIO_AGG_PINS) - 1;
+#endif
+
+  for (uint8_t pin = 0; pin < 32; pin++) {
+    uint32_t bit = (uint32_t)1 << pin;
+    // Pins coming back from "off": the next write/pinMode is reported even
+    // if the cache (stale since they went quiet) already holds that value
+    if ((nf_policy_off & bit) && !(off_mask & bit)) {
+      nf_pin_states[pin] = 0xFF;
+      nf_mode_states[pin] = 0xFF;
+    }
+    if (pin < NF_GPIO_AGG_PINS && (agg_mask & bit)) {
+      nf_agg_edges[pin] = 0;
+      nf_agg_high[pin] = nf_pin_states[pin] == 1 ? 0 - now : 0;
+    }
+  }
+
+  // Quiet pins drop whatever they still had queued
+  nf_pending_gpio &= ~(off_mask | agg_mask);
+  nf_pending_mode &= ~off_mask;
+  nf_pending_pwm &= ~off_mask;
+  nf_batch_dirty &= ~(off_mask | agg_mask);
+
+  nf_policy_off = off_mask;
+  nf_policy_agg = agg_mask;
+  nf_agg_window_ms = window_ms ? window_ms : 1;
+  nf_agg_start_us = now;
+  SREG = sreg;
+}
+
+/**
+ * Index of the pin's port in the PORTS frame (B=0, C=1, D=2), or 0xFF
+ * (also for pins past the PROGMEM pin tables)
+ */
+static uint8_t nf_port_index(uint8_t pin) {
+  if (pin >= NUM_DIGITAL_PINS)
+    return 0xFF;
+  uint8_t port = digitalPinToPort(pin);
+  if (port < PB || port > PD)
+    return 0xFF;
+  return port - PB;
+}
+
+/**
+ * Send every dirty pin as one PORTS frame.
+ * Also picks up direct PORTx writes on output pins.
+ * Must run with interrupts disabled.
+ */
+static uint8_t nf_batch_emit(void) {
+#ifdef NF_GPIO_ASCII
+  // No port frame in protocol v1.0: one line per dirty pin
+  for (uint8_t pin = 0; nf_batch_dirty && pin < 32; pin++) {
+    uint32_t bit = (uint32_t)1 << pin;
+    if (!(nf_batch_dirty & bit))
+      continue;
+    if (!nf_emit(NF_OP_GPIO, pin, nf_pin_states[pin]))
+      return 0;
+    nf_batch_dirty &= ~bit;
+  }
+  return 1;
+#else
+  uint8_t dirty[3] = {0, 0, 0};
+  uint8_t quiet[3] = {0, 0, 0}; // Off/aggregated pins: direct PORTx writes stay unreported
+  uint8_t ports[3] = {PORTB, PORTC, PORTD};
+  uint8_t ddrs[3] = {DDRB, DDRC, DDRD};
+
+  for (uint8_t pin = 0; pin < 32; pin++) {
+    uint8_t index = nf_port_index(pin);
+    if (index == 0xFF)
+      continue;
+    uint32_t bit = (uint32_t)1 << pin;
+    if (nf_batch_dirty & bit)
+      dirty[index] |= digitalPinToBitMask(pin);
+    if ((nf_policy_off | nf_policy_agg) & bit)
+      quiet[index] |= digitalPinToBitMask(pin);
+  }
+
+  for (uint8_t i = 0; i < 3; i++)
+    dirty[i] = (dirty[i] | ((ports[i] ^ nf_last_port[i]) & ddrs[i])) & ~quiet[i];
+
+  if (!(dirty[0] | dirty[1] | dirty[2])) {
+    nf_batch_dirty = 0;
+    return 1;
+  }
+
+  uint8_t payload[NF_OP_PORTS_LEN] = {dirty[0], ports[0], dirty[1],
+                                      ports[1], dirty[2], ports[2]};
+  if (!nf_emit_frame(NF_OP_PORTS, payload, sizeof(payload)))
+    return 0;
+
+  for (uint8_t i = 0; i < 3; i++)
+    nf_last_port[i] = ports[i];
+  nf_batch_dirty = 0;
+  return 1;
+#endif
+}
+
+void nf_gpio_sync(void) {
+  if (nf_batch_mode == NF_GPIO_BATCH_OFF)
+    return;
+
+  uint8_t sreg = SREG;
+  cli();
+  nf_batch_last_ms = nf_now_ms();
+  if (!nf_batch_emit()) {
+    // Retried by nf_gpio_flush_pending() when the ring drains;
+    // dirty bits keep accumulating meanwhile
+    nf_batch_pending = 1;
+    if (!(sreg & (1 << SREG_I)))
+      nf_uart_poll();
+  }
+  SREG = sreg;
+}
+
+void nf_gpio_loop_hook(void) {
+  nf_gpio_sync();
+
+  uint8_t sreg = SREG;
+  cli();
+  nf_agg_poll(0);
+  SREG = sreg;
+}
+
+void nf_gpio_idle(uint32_t us) {
+  nf_gpio_sync();
+
+  uint8_t sreg = SREG;
+  cli();
+  nf_agg_poll(us);
+  SREG = sreg;
+}
+
+void nf_gpio_set_batch(uint8_t mode, uint16_t interval_ms) {
+  nf_gpio_sync();
+  nf_batch_mode = mode;
+  nf_batch_interval = interval_ms;
+}
 
 void nf_report_gpio(uint8_t pin, uint8_t value) {
+#ifdef NF_GPIO_NONE
+  // Host captures GPIO through gdbstub watchpoints
+  (void)pin;
+  (void)value;
+  return;
+#endif
+  value = value ? 1 : 0;
   if (pin < 32 && nf_pin_states[pin] == value)
     return;
-  if (pin < 32)
+  if (pin < 32 && (nf_policy_off & ((uint32_t)1 << pin)))
+    return;
+
+  uint8_t sreg = SREG;
+  cli();
+  if (pin < NF_GPIO_AGG_PINS && (nf_policy_agg & ((uint32_t)1 << pin))) {
+    // Counted now, reported once per window
+    nf_agg_edge(pin, value);
+    SREG = sreg;
+    return;
+  }
+
+  if (pin < 32) {
     nf_pin_states[pin] = value;
+    nf_pending_pwm &= ~((uint32_t)1 << pin); // A digital level ends the PWM
+  }
+
+  if (nf_batch_mode != NF_GPIO_BATCH_OFF && pin < 32 &&
+      nf_port_index(pin) != 0xFF) {
+    nf_batch_dirty |= (uint32_t)1 << pin;
+    SREG = sreg;
 
-  uart_print("G:pin=");
-  uart_print_num(pin);
-  uart_print(",v=");
-  uart_send(value ? '1' : '0');
-  uart_send('\n');
+    if (nf_batch_mode == NF_GPIO_BATCH_INTERVAL &&
+        nf_now_ms() - nf_batch_last_ms >= nf_batch_interval)
+      nf_gpio_sync();
+    return;
+  }
+
+  nf_queue(&nf_pending_gpio, NF_OP_GPIO, pin, value);
+  SREG = sreg;
 }
 
 void nf_report_mode(uint8_t pin, uint8_t mode) {
+#ifdef NF_GPIO_NONE
+  (void)pin;
+  (void)mode;
+  return;
+#endif
   if (pin < 32 && nf_mode_states[pin] == mode)
     return;
+  if (pin < 32 && (nf_policy_off & ((uint32_t)1 << pin)))
+    return;
+
+  uint8_t sreg = SREG;
+  cli();
   if (pin < 32)
     nf_mode_states[pin] = mode;
+  nf_queue(&nf_pending_mode, NF_OP_MODE, pin, mode);
+  SREG = sreg;
+}
 
-  uart_print("M:pin=");
-  uart_print_num(pin);
-  uart_print(",m=");
-  // Mapping: 0=INPUT, 1=OUTPUT, 2=INPUT_PULLUP
-  uart_send('0' + mode);
-  uart_send('\n');
+void nf_report_pwm(uint8_t pin, uint8_t duty) {
+  // Also with NF_GPIO_NONE: one frame per change, and gdb capture cannot see
+  // timer outputs (PORTx does not change)
+
+  // 0/255 (and pins without a timer) went through digitalWrite()
+  if (duty == 0 || duty == 255 || pin >= NUM_DIGITAL_PINS || digitalPinToTimer(pin) == NOT_ON_TIMER)
+    return;
+  if (nf_policy_off & ((uint32_t)1 << pin))
+    return;
+
+  uint8_t sreg = SREG;
+  cli();
+  nf_pwm_duty[pin] = duty;
+  // The next digitalWrite() must be reported even if it repeats the old level,
+  // and a stale batched level must not override the PWM state on the host
+  nf_pin_states[pin] = 0xFF;
+  nf_batch_dirty &= ~((uint32_t)1 << pin);
+  nf_pending_gpio &= ~((uint32_t)1 << pin);
+  nf_queue(&nf_pending_pwm, NF_OP_PWM, pin, duty);
+  SREG = sreg;
+}
+
+/**
+ * Send the latest state of every pending pin, then the drop counter.
+ * Stops as soon as the ring is full again; the next drain resumes.
+ */
+static uint8_t nf_flush_mask(uint32_t *pending, uint8_t op,
+                             const uint8_t *states) {
+  for (uint8_t pin = 0; *pending && pin < 32; pin++) {
+    uint32_t bit = (uint32_t)1 << pin;
+    if (!(*pending & bit))
+      continue;
+    if (!nf_emit(op, pin, states[pin]))
+      return 0;
+    *pending &= ~bit;
+  }
+  return 1;
+}
+
+void nf_gpio_flush_pending(void) {
+  if (!nf_flush_mask(&nf_pending_mode, NF_OP_MODE, nf_mode_states))
+    return;
+  if (!nf_flush_mask(&nf_pending_gpio, NF_OP_GPIO, nf_pin_states))
+    return;
+  if (!nf_flush_mask(&nf_pending_pwm, NF_OP_PWM, nf_pwm_duty))
+    return;
+
+  if (nf_batch_pending) {
+    if (!nf_batch_emit())
+      return;
+    nf_batch_pending = 0;
+  }
+
+  if (nf_dropped != nf_dropped_reported &&
+      nf_emit(NF_OP_DROPS, nf_dropped & 0xFF, nf_dropped >> 8))
+    nf_dropped_reported = nf_dropped;
 }
@@ -15,6 +15,57 @@ void nf_report_gpio(uint8_t pin, uint8_t value);
  */
 void nf_report_mode(uint8_t pin, uint8_t mode);
 
+/**
+ * Report analogWrite() as one PWM configuration frame (duty + timer frequency)
+ * instead of edges. 0 and 255 are plain digital writes and already reported.
+ */
+void nf_report_pwm(uint8_t pin, uint8_t duty);
+
+/**
+ * Batching modes for nf_report_gpio():
+ * - NF_GPIO_BATCH_OFF:      one frame per pin change (default)
+ * - NF_GPIO_BATCH_LOOP:     dirty pins of PORTB/C/D sent as one frame
+ *                           at the end of each loop() and before delay()
+ * - NF_GPIO_BATCH_INTERVAL: same, but also flushed every interval_ms
+ *                           (for sketches that never return from loop())
+ */
+#define NF_GPIO_BATCH_OFF 0
+#define NF_GPIO_BATCH_LOOP 1
+#define NF_GPIO_BATCH_INTERVAL 2
+
+void nf_gpio_set_batch(uint8_t mode, uint16_t interval_ms);
+
+/**
+ * Flush batched pin changes now (no-op when batching is off).
+ */
+void nf_gpio_sync(void);
+
+/**
+ * Per-pin reporting policy, pushed by the host (NF_OP_POLICY):
+ * - pins in off_mask are never reported (GPIO, mode or PWM)
+ * - pins in agg_mask only send one NF_OP_AGG frame per window_ms
+ *   (edge count, fraction of time HIGH, final level) if they changed
+ * - every other pin reports each edge (default)
+ */
+void nf_gpio_set_policy(uint32_t off_mask, uint32_t agg_mask, uint16_t window_ms);
+
+/**
+ * Called by nf_time before sleeping `us`: flushes batches and closes
+ * aggregation windows that end during the sleep (levels cannot change).
+ */
+void nf_gpio_idle(uint32_t us);
+
+/**
+ * Called by main() after every loop() iteration.
+ */
+void nf_gpio_loop_hook(void);
+
+/**
+ * Re-send reports that did not fit in the TX ring buffer.
+ * Internal: called by nf_uart when the ring runs empty.
+ */
+void nf_gpio_flush_pending(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,60 @@
+#include "nf_input.h"
+#include "nf_proto.h"
+#include "nf_uart.h"
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+/**
+ * Shadow input registers for pins driven by the host.
+ *
+ * QEMU has no way to change what PINx reads from outside, so the host
+ * sends NF_OP_INPUT frames instead: the RX interrupt decodes them into
+ * these masks and the patched digitalRead() returns the shadow level for
+ * overridden pins. The sketch sees the new value on its next digitalRead(),
+ * without ever polling Serial.
+ */
+
+// Pins 0-31 driven by the host, and their levels
+static volatile uint32_t nf_input_mask = 0;
+static volatile uint32_t nf_input_value = 0;
+
+void nf_input_set(uint8_t pin, uint8_t value) {
+  if (pin >= 32)
+    return;
+
+  uint32_t bit = (uint32_t)1 << pin;
+  if (value == NF_INPUT_RELEASE) {
+    nf_input_mask &= ~bit;
+    return;
+  }
+
+  if (value)
+    nf_input_value |= bit;
+  else
+    nf_input_value &= ~bit;
+  nf_input_mask |= bit;
+}
+
+int8_t nf_input_read(uint8_t pin) {
+  if (pin >= 32)
+    return -1;
+
+  // 32-bit masks written by the RX interrupt: read them atomically
+  uint8_t sreg = SREG;
+  cli();
+  uint32_t mask = nf_input_mask;
+  uint32_t value = nf_input_value;
+  SREG = sreg;
+
+  uint32_t bit = (uint32_t)1 << pin;
+  if (!(mask & bit))
+    return -1;
+  return (value & bit) ? 1 : 0;
+}
+
+/**
+ * Listen for host commands from reset on, not only after the first
+ * report: a button pressed before the sketch writes any pin must still
+ * reach digitalRead(). Serial.begin() keeps RXEN0/RXCIE0 set.
+ */
+__attribute__((constructor)) static void nf_input_init(void) { nf_uart_rx_enable(); }
@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Drive an input pin from the host (NF_OP_INPUT).
+ * value 0/1 overrides the pin, NF_INPUT_RELEASE hands it back to PINx.
+ * Called from the RX interrupt.
+ */
+void nf_input_set(uint8_t pin, uint8_t value);
+
+/**
+ * Host-driven level of a pin, or -1 if the host does not drive it.
+ * The patched digitalRead() checks it before reading PINx.
+ */
+int8_t nf_input_read(uint8_t pin);
+
+#ifdef __cplusplus
+}
+#endif
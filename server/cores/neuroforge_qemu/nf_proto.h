@@ -0,0 +1,79 @@
+/**
+ * NeuroForge Wire Protocol - Binary Frames
+ *
+ * Formato compacto usado entre o firmware e o backend via UART0:
+ *
+ *   [NF_SYNC] [op] [payload ...] [crc8]
+ *
+ * - NF_SYNC: 0xA5 (nunca e byte inicial de texto ASCII/UTF-8)
+ * - op:      opcode do frame (ver NF_OP_*)
+ * - payload: tamanho fixo por opcode (ver NF_OP_*_LEN)
+ * - crc8:    CRC-8/CCITT (poly 0x07, init 0x00) sobre op + payload
+ *
+ * Um frame GPIO ocupa 5 bytes, contra ~13 do formato texto
+ * "G:pin=13,v=1\n", que continua disponivel como fallback
+ * (compilar com -DNF_GPIO_ASCII).
+ *
+ * O backend (SerialGPIOParser) ativa o modo binario ao receber
+ * o frame NF_OP_HELLO enviado no primeiro reporte.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define NF_SYNC 0xA5
+#define NF_PROTO_VERSION 2
+
+// Firmware -> host
+#define NF_OP_HELLO 0x00 // payload: version, flags
+#define NF_OP_GPIO 0x01  // payload: pin, value
+#define NF_OP_MODE 0x02  // payload: pin, mode (0=INPUT, 1=OUTPUT, 2=INPUT_PULLUP)
+#define NF_OP_DROPS 0x03 // payload: total coalesced reports (uint16 LE)
+#define NF_OP_PORTS 0x04 // payload: dirtyB, PORTB, dirtyC, PORTC, dirtyD, PORTD
+#define NF_OP_SLEEP 0x05 // payload: deadline em us (48 bits LE) - espera NF_OP_WAKE
+#define NF_OP_PWM 0x06   // payload: pin, duty (uint16 LE, 65535 = 100%), frequencia em Hz (uint32 LE)
+// 0x07: NF_OP_GPIO_MASK, so no shim ESP32 (captura amostrada)
+#define NF_OP_AGG 0x08   // payload: pin, bordas (uint16 LE), fracao em HIGH (uint16 LE, 65535 = 100%), nivel final
+
+#define NF_OP_HELLO_LEN 2
+#define NF_OP_GPIO_LEN 2
+#define NF_OP_MODE_LEN 2
+#define NF_OP_DROPS_LEN 2
+#define NF_OP_PORTS_LEN 6
+#define NF_OP_SLEEP_LEN 6
+#define NF_OP_PWM_LEN 7
+#define NF_OP_AGG_LEN 6
+
+// Host -> firmware (decodificados pela interrupcao RX, ver nf_uart.cpp)
+#define NF_OP_HOST_HELLO 0x80 // payload: version, flags (NF_HOST_*)
+#define NF_OP_WAKE 0x81       // payload: tempo virtual em us (48 bits LE)
+#define NF_OP_INPUT 0x82      // payload: pin, value (0/1, NF_INPUT_RELEASE devolve o pino)
+#define NF_OP_ADC_CONST 0x83  // payload: pin, valor (uint16 LE; NF_ADC_RELEASE devolve o ADC)
+#define NF_OP_ADC_DATA 0x84   // payload: indice no pool (uint16 LE), 4 amostras (uint16 LE)
+#define NF_OP_ADC_PLAY 0x85   // payload: pin, inicio (uint16 LE), tamanho (uint16 LE), periodo us (uint32 LE)
+// 0x86: NF_OP_CAPTURE, so no shim ESP32
+#define NF_OP_POLICY 0x87     // payload: pinos off (uint32 LE), pinos agregados (uint32 LE), janela ms (uint16 LE)
+
+#define NF_OP_HOST_HELLO_LEN 2
+#define NF_OP_WAKE_LEN 6
+#define NF_OP_INPUT_LEN 2
+#define NF_OP_ADC_CONST_LEN 3
+#define NF_OP_ADC_DATA_LEN 10
+#define NF_OP_ADC_PLAY_LEN 9
+#define NF_OP_POLICY_LEN 10
+
+// Valor do NF_OP_INPUT: digitalRead() volta a ler o registrador PINx
+#define NF_INPUT_RELEASE 0xFF
+
+// Valor do NF_OP_ADC_CONST: analogRead() volta a ler o ADC
+#define NF_ADC_RELEASE 0xFFFF
+
+// Amostras por frame NF_OP_ADC_DATA
+#define NF_ADC_DATA_SAMPLES 4
+
+// Flags do NF_OP_HOST_HELLO
+#define NF_HOST_CLOCK 0x01 // host controla o clock virtual (nf_time v1)
+
+#define NF_MAX_PAYLOAD_LEN 10
+#define NF_MAX_FRAME_LEN (NF_MAX_PAYLOAD_LEN + 3)
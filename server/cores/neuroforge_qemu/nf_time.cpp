@@ -1,9 +1,10 @@
 /**
  * NeuroForge Time - Core Implementation
  *
- * Implementacao v0: Clock virtual mantido dentro do firmware
+ * Implementacao v1: Clock virtual controlado pelo host
+ * Implementacao v0: Clock virtual mantido dentro do firmware (fallback)
  *
- * Usa _delay_ms() de <util/delay.h> que funciona no QEMU AVR porque
+ * v0 usa _delay_ms() de <util/delay.h> que funciona no QEMU AVR porque
  * e baseado apenas em F_CPU (ciclos de CPU), nao em timers.
  *
  * Esta implementacao garante que delay() e millis() funcionem
@@ -11,11 +12,35 @@
  */
 
 #include "nf_time.h"
+#include "nf_gpio.h"
+#include "nf_proto.h"
+#include "nf_uart.h"
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/sleep.h>
 #include <util/delay.h>
 
-// Estado do clock virtual da simulacao
-static volatile uint32_t nf_ms = 0;
-static volatile uint32_t nf_us = 0;
+/**
+ * Timebase de 64 bits em microssegundos (nao da a volta na pratica).
+ *
+ * millis() e micros() sao derivados dele: micros() sao os 32 bits baixos
+ * e millis() = tempo / 1000 mantido incrementalmente (sem divisao de 64
+ * bits no AVR), entao os dois dao a volta de forma coerente, como no
+ * core Arduino original.
+ */
+static volatile uint64_t nf_time_us = 0;
+static volatile uint32_t nf_ms = 0;      // (nf_time_us / 1000) mod 2^32
+static volatile uint16_t nf_ms_frac = 0; // nf_time_us % 1000
+
+// 1 enquanto nf_sleep_ms() espera o NF_OP_WAKE do host
+static volatile uint8_t nf_wake_pending = 0;
+
+// Delays menores que isto nao publicam o batch de GPIO antes de dormir
+// (bit-banging com delayMicroseconds() mandaria um frame por bit)
+#define NF_IDLE_FLUSH_MIN_US 1000UL
+
+// Maior sleep v1 em um unico frame (duracao em us cabe em 32 bits)
+#define NF_HOST_SLEEP_CHUNK_MS 4000000UL
 
 // Multiplicador de timing para QEMU
 // Ajuste este valor se o timing estiver muito rapido ou lento:
@@ -26,13 +51,58 @@ static volatile uint32_t nf_us = 0;
 
 /**
  * Retorna o tempo atual em milissegundos.
+ * Leitura atomica: pode ser chamada de ISRs.
  */
-uint32_t nf_now_ms(void) { return nf_ms; }
+uint32_t nf_now_ms(void) {
+  uint8_t sreg = SREG;
+  cli();
+  uint32_t ms = nf_ms;
+  SREG = sreg;
+  return ms;
+}
 
 /**
  * Retorna o tempo atual em microssegundos.
  */
-uint32_t nf_now_us(void) { return nf_us; }
+uint32_t nf_now_us(void) { return (uint32_t)nf_now_us64(); }
+
+/**
+ * Retorna o timebase completo de 64 bits.
+ * Leitura atomica: pode ser chamada de ISRs.
+ */
+uint64_t nf_now_us64(void) {
+  uint8_t sreg = SREG;
+  cli();
+  uint64_t us = nf_time_us;
+  SREG = sreg;
+  return us;
+}
+
+/**
+ * Avanca o timebase. Interrupcoes devem estar desabilitadas.
+ */
+static void nf_advance_us_locked(uint32_t us) {
+  nf_time_us += us;
+
+  uint16_t frac = nf_ms_frac + (uint16_t)(us % 1000UL);
+  uint32_t ms = us / 1000UL;
+  if (frac >= 1000) {
+    frac -= 1000;
+    ms++;
+  }
+  nf_ms += ms;
+  nf_ms_frac = frac;
+}
+
+/**
+ * Avanca o clock virtual em microssegundos.
+ */
+void nf_advance_us(uint32_t us) {
+  uint8_t sreg = SREG;
+  cli();
+  nf_advance_us_locked(us);
+  SREG = sreg;
+}
 
 /**
  * Avanca o clock virtual.
@@ -40,8 +110,93 @@ uint32_t nf_now_us(void) { return nf_us; }
  * Chamado internamente por nf_sleep_ms() e pelo main loop.
  */
 void nf_advance_ms(uint32_t ms) {
+  uint8_t sreg = SREG;
+  cli();
+  nf_time_us += (uint64_t)ms * 1000UL;
   nf_ms += ms;
-  nf_us += ms * 1000UL;
+  SREG = sreg;
+}
+
+/**
+ * Chamado pela interrupcao RX quando chega NF_OP_WAKE.
+ * O host e a fonte da verdade: o clock pula para o tempo dele
+ * (nunca para tras).
+ */
+void nf_time_host_wake(uint64_t now_us) {
+  while (now_us > nf_time_us) {
+    uint64_t delta = now_us - nf_time_us;
+    nf_advance_us_locked(delta > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (uint32_t)delta);
+  }
+  nf_wake_pending = 0;
+}
+
+/**
+ * v1 so funciona se o host anunciou o clock e a interrupcao RX
+ * pode chegar (delay() dentro de ISR cai no v0).
+ */
+static uint8_t nf_host_clock_ready(void) {
+  return (SREG & (1 << SREG_I)) && (nf_uart_host_flags() & NF_HOST_CLOCK);
+}
+
+/**
+ * Implementacao v1: envia NF_OP_SLEEP e dorme ate o NF_OP_WAKE.
+ *
+ * O frame leva o deadline absoluto (us, 48 bits), entao avancos locais
+ * (delayMicroseconds curtos, delays com interrupcoes desabilitadas)
+ * chegam ao host junto com o proximo sleep.
+ *
+ * A CPU fica em SLEEP_MODE_IDLE (instrucao sleep), entao o QEMU
+ * nao gasta CPU do host durante o delay e o backend pode pausar,
+ * acelerar ou segurar o tempo virtual.
+ */
+static void nf_host_sleep(uint32_t us) {
+  uint64_t deadline = nf_now_us64() + us;
+  uint8_t payload[NF_OP_SLEEP_LEN];
+  for (uint8_t i = 0; i < NF_OP_SLEEP_LEN; i++)
+    payload[i] = (uint8_t)(deadline >> (8 * i));
+
+  nf_wake_pending = 1;
+  while (!nf_uart_send_frame(NF_OP_SLEEP, payload, sizeof(payload))) {
+    // Ring cheio: a interrupcao UDRE esvazia; sem interrupcoes, esvaziar na mao
+    if (!(SREG & (1 << SREG_I)))
+      nf_uart_poll();
+  }
+
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  cli();
+  while (nf_wake_pending) {
+    sleep_enable();
+    sei(); // sei + sleep sao atomicos: o WAKE nao se perde entre os dois
+    sleep_cpu();
+    sleep_disable();
+    cli();
+  }
+  sei();
+}
+
+/**
+ * Dorme por N microssegundos (delayMicroseconds).
+ *
+ * Com o clock do host, todo delay bloqueia em sleep_cpu() ate o
+ * NF_OP_WAKE, mesmo os curtos: busy-wait so queimaria CPU do host
+ * (em 'max' o host responde na hora). Sem ele (ISR, antes do
+ * HOST_HELLO) cai no busy-wait calibrado do v0.
+ */
+void nf_sleep_us(uint32_t us) {
+  if (us == 0)
+    return;
+
+  if (nf_host_clock_ready()) {
+    if (us >= NF_IDLE_FLUSH_MIN_US)
+      nf_gpio_idle(us);
+    nf_host_sleep(us);
+    return;
+  }
+
+  for (uint32_t i = 0; i < us; i++) {
+    _delay_us(QEMU_TIMING_MULTIPLIER);
+  }
+  nf_advance_us(us);
 }
 
 /**
@@ -63,9 +218,25 @@ void nf_advance_ms(uint32_t ms) {
  * - Nao precisa modificar backend
  * - delay() e millis() ficam corretos
  * - Timing ajustavel via QEMU_TIMING_MULTIPLIER
+ *
+ * O HELLO enviado aqui pede o clock ao host; se o NF_OP_HOST_HELLO
+ * chegar no meio de um delay v0, o restante vira um sleep v1.
  */
 void nf_sleep_ms(uint32_t ms) {
+  // Pinos acumulados em modo batch (e janelas de agregacao) ficam visiveis durante o delay
+  nf_gpio_idle(ms < 4000000UL ? ms * 1000UL : 0xFFFFFFFFUL);
+  nf_uart_hello();
+
   while (ms > 0) {
+    if (nf_host_clock_ready()) {
+      while (ms > NF_HOST_SLEEP_CHUNK_MS) {
+        nf_host_sleep(NF_HOST_SLEEP_CHUNK_MS * 1000UL);
+        ms -= NF_HOST_SLEEP_CHUNK_MS;
+      }
+      nf_host_sleep(ms * 1000UL);
+      return;
+    }
+
     // Loop ajustavel: QEMU_TIMING_MULTIPLIER x _delay_ms(1) por millisegundo
     for (uint32_t i = 0; i < QEMU_TIMING_MULTIPLIER; i++) {
       _delay_ms(1);
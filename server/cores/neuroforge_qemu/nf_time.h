@@ -11,7 +11,10 @@
  * - Bare-metal C
  * 
  * Implementação v0: Clock mantido dentro do firmware
- * Implementação v1: Clock vem do host (futuro)
+ * Implementação v1: Clock vem do host (NF_OP_SLEEP / NF_OP_WAKE, ver nf_proto.h)
+ *
+ * v1 é usada assim que o host responde ao HELLO com NF_HOST_CLOCK;
+ * até lá (ou com interrupções desabilitadas) vale o busy-wait v0.
  */
 
 #pragma once
@@ -40,16 +43,37 @@ uint32_t nf_now_ms(void);
  */
 uint32_t nf_now_us(void);
 
+/**
+ * Obtém o timebase completo da simulação (64 bits, µs).
+ * 
+ * nf_now_ms() e nf_now_us() são derivados dele e dão a volta
+ * (2^32) de forma coerente. Leitura atômica, segura em ISRs.
+ * 
+ * @return Tempo em µs desde o início da simulação
+ */
+uint64_t nf_now_us64(void);
+
 /**
  * Dorme por N milissegundos em tempo de simulação.
  * 
  * Implementação v0: Usa busy-wait com _delay_ms() + avança clock virtual
- * Implementação v1: Espera o host avançar o clock (futuro)
+ * Implementação v1: Pede ao host para avançar o clock e dorme (sleep_cpu)
+ *                   até receber NF_OP_WAKE
  * 
  * @param ms Número de milissegundos para dormir
  */
 void nf_sleep_ms(uint32_t ms);
 
+/**
+ * Dorme por N microssegundos em tempo de simulação.
+ * 
+ * Usado por delayMicroseconds(). Com o clock do host dorme até o
+ * NF_OP_WAKE (sem busy-wait), como nf_sleep_ms().
+ * 
+ * @param us Número de microssegundos para dormir
+ */
+void nf_sleep_us(uint32_t us);
+
 /**
  * Avança o clock virtual em N milissegundos.
  * 
@@ -60,6 +84,26 @@ void nf_sleep_ms(uint32_t ms);
  */
 void nf_advance_ms(uint32_t ms);
 
+/**
+ * Avança o clock virtual em N microssegundos.
+ * 
+ * Função interna usada pelo runtime.
+ * Não chamar diretamente do código do usuário!
+ * 
+ * @param us Número de microssegundos para avançar
+ */
+void nf_advance_us(uint32_t us);
+
+/**
+ * Acorda nf_sleep_ms() com o tempo virtual enviado pelo host.
+ * 
+ * Função interna chamada pela interrupção RX (nf_uart.cpp).
+ * Não chamar diretamente do código do usuário!
+ * 
+ * @param now_us Tempo virtual do host em microssegundos
+ */
+void nf_time_host_wake(uint64_t now_us);
+
 #ifdef __cplusplus
 }
 #endif
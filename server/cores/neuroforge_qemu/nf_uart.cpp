@@ -0,0 +1,258 @@
+#include "nf_uart.h"
+#include "nf_adc.h"
+#include "nf_gpio.h"
+#include "nf_input.h"
+#include "nf_proto.h"
+#include "nf_time.h"
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/crc16.h>
+
+/**
+ * Interrupt-driven UART0 transmit for NeuroForge frames.
+ *
+ * Frames are copied into a small ring buffer and sent one byte per
+ * USART_UDRE interrupt, so reporting a GPIO change costs a few cycles
+ * instead of busy-waiting for every byte on the wire.
+ *
+ * HardwareSerial shares the same UDRE vector: patch-wiring.ps1 turns its
+ * handler into nf_hwserial_udre_irq(), which we call once our ring is empty.
+ *
+ * RX works the other way around: HardwareSerial keeps the vector and its
+ * patched _rx_complete_irq() offers every byte to nf_uart_rx_hook() first.
+ */
+
+#define NF_TX_BUF_SIZE 64 // must be a power of two
+#define NF_TX_BUF_MASK (NF_TX_BUF_SIZE - 1)
+
+static volatile uint8_t nf_tx_buf[NF_TX_BUF_SIZE];
+static volatile uint8_t nf_tx_head = 0;
+static volatile uint8_t nf_tx_tail = 0;
+
+/**
+ * Fallback when Serial is not linked: nothing else to send.
+ * The patched HardwareSerial0.cpp provides the strong definition.
+ */
+extern "C" __attribute__((weak)) void nf_hwserial_udre_irq(void) {
+  UCSR0B &= ~(1 << UDRIE0);
+}
+
+uint8_t nf_uart_write(const uint8_t *data, uint8_t len) {
+  uint8_t sreg = SREG;
+  cli();
+
+  uint8_t head = nf_tx_head;
+  uint8_t room = (uint8_t)(nf_tx_tail - head - 1) & NF_TX_BUF_MASK;
+  if (len > room) {
+    SREG = sreg;
+    return 0;
+  }
+
+  for (uint8_t i = 0; i < len; i++) {
+    nf_tx_buf[head] = data[i];
+    head = (head + 1) & NF_TX_BUF_MASK;
+  }
+  nf_tx_head = head;
+
+  // Works even if Serial.begin() was not called
+  UCSR0B |= (1 << TXEN0) | (1 << UDRIE0);
+
+  SREG = sreg;
+  return 1;
+}
+
+uint8_t nf_uart_send_frame(uint8_t op, const uint8_t *payload, uint8_t len) {
+  uint8_t frame[NF_MAX_FRAME_LEN];
+  uint8_t crc = _crc8_ccitt_update(0, op);
+
+  frame[0] = NF_SYNC;
+  frame[1] = op;
+  for (uint8_t i = 0; i < len; i++) {
+    frame[2 + i] = payload[i];
+    crc = _crc8_ccitt_update(crc, payload[i]);
+  }
+  frame[2 + len] = crc;
+
+  return nf_uart_write(frame, len + 3);
+}
+
+uint8_t nf_uart_tx_busy(void) { return nf_tx_head != nf_tx_tail; }
+
+static uint8_t nf_hello_sent = 0;
+
+uint8_t nf_uart_hello(void) {
+#ifdef NF_GPIO_ASCII
+  return 1;
+#else
+  if (nf_hello_sent)
+    return 1;
+
+  uint8_t hello[NF_OP_HELLO_LEN] = {NF_PROTO_VERSION, 0};
+  if (!nf_uart_send_frame(NF_OP_HELLO, hello, sizeof(hello)))
+    return 0;
+
+  // Host answers with NF_OP_HOST_HELLO over RX
+  nf_uart_rx_enable();
+  nf_hello_sent = 1;
+  return 1;
+#endif
+}
+
+void nf_uart_rx_enable(void) {
+  // UDRIE0 lives in the same register and is cleared by the UDRE interrupt
+  uint8_t sreg = SREG;
+  cli();
+  UCSR0B |= (1 << RXEN0) | (1 << RXCIE0);
+  SREG = sreg;
+}
+
+/**
+ * Send the next queued byte, refilling the ring with coalesced
+ * GPIO state when it runs empty.
+ */
+static uint8_t nf_uart_tx_next(void) {
+  if (nf_tx_head == nf_tx_tail)
+    nf_gpio_flush_pending();
+
+  if (nf_tx_head == nf_tx_tail)
+    return 0;
+
+  UDR0 = nf_tx_buf[nf_tx_tail];
+  nf_tx_tail = (nf_tx_tail + 1) & NF_TX_BUF_MASK;
+  return 1;
+}
+
+void nf_uart_poll(void) {
+  for (;;) {
+    while (!(UCSR0A & (1 << UDRE0)))
+      ;
+    if (!nf_uart_tx_next())
+      return;
+  }
+}
+
+void nf_uart_udre_service(void) {
+  if (!nf_uart_tx_next()) {
+    // Our ring is empty, so we are between two frames:
+    // let HardwareSerial drain its own buffer
+    nf_hwserial_udre_irq();
+  }
+}
+
+ISR(USART_UDRE_vect) { nf_uart_udre_service(); }
+
+/**
+ * Host -> firmware command decoder: [NF_SYNC][op][payload][crc8]
+ */
+#define NF_RX_IDLE 0
+#define NF_RX_OPCODE 1
+#define NF_RX_PAYLOAD 2
+
+static uint8_t nf_rx_state = NF_RX_IDLE;
+static uint8_t nf_rx_op;
+static uint8_t nf_rx_len;
+static uint8_t nf_rx_pos;
+static uint8_t nf_rx_crc;
+static uint8_t nf_rx_payload[NF_MAX_PAYLOAD_LEN];
+
+static volatile uint8_t nf_host_flags = 0;
+
+uint8_t nf_uart_host_flags(void) { return nf_host_flags; }
+
+static uint16_t nf_read_u16(const uint8_t *p) { return p[0] | ((uint16_t)p[1] << 8); }
+
+static uint32_t nf_read_u32(const uint8_t *p) { return nf_read_u16(p) | ((uint32_t)nf_read_u16(p + 2) << 16); }
+
+static uint64_t nf_read_u48(const uint8_t *p) {
+  uint64_t v = 0;
+  for (uint8_t i = 6; i > 0; i--)
+    v = (v << 8) | p[i - 1];
+  return v;
+}
+
+static uint8_t nf_rx_payload_len(uint8_t op) {
+  switch (op) {
+  case NF_OP_HOST_HELLO:
+    return NF_OP_HOST_HELLO_LEN;
+  case NF_OP_WAKE:
+    return NF_OP_WAKE_LEN;
+  case NF_OP_INPUT:
+    return NF_OP_INPUT_LEN;
+  case NF_OP_ADC_CONST:
+    return NF_OP_ADC_CONST_LEN;
+  case NF_OP_ADC_DATA:
+    return NF_OP_ADC_DATA_LEN;
+  case NF_OP_ADC_PLAY:
+    return NF_OP_ADC_PLAY_LEN;
+  case NF_OP_POLICY:
+    return NF_OP_POLICY_LEN;
+  default:
+    return 0xFF;
+  }
+}
+
+static void nf_rx_dispatch(uint8_t op, const uint8_t *payload) {
+  switch (op) {
+  case NF_OP_HOST_HELLO:
+    nf_host_flags = payload[1];
+    break;
+  case NF_OP_WAKE:
+    nf_time_host_wake(nf_read_u48(payload));
+    break;
+  case NF_OP_INPUT:
+    nf_input_set(payload[0], payload[1]);
+    break;
+  case NF_OP_ADC_CONST:
+    nf_adc_const(payload[0], nf_read_u16(payload + 1));
+    break;
+  case NF_OP_ADC_DATA:
+    nf_adc_data(nf_read_u16(payload), payload + 2);
+    break;
+  case NF_OP_ADC_PLAY:
+    nf_adc_play(payload[0], nf_read_u16(payload + 1), nf_read_u16(payload + 3), nf_read_u32(payload + 5));
+    break;
+  case NF_OP_POLICY:
+    nf_gpio_set_policy(nf_read_u32(payload), nf_read_u32(payload + 4), nf_read_u16(payload + 8));
+    break;
+  }
+}
+
+uint8_t nf_uart_rx_hook(uint8_t c) {
+  switch (nf_rx_state) {
+  case NF_RX_IDLE:
+    if (c != NF_SYNC)
+      return 0;
+    nf_rx_state = NF_RX_OPCODE;
+    return 1;
+
+  case NF_RX_OPCODE:
+    nf_rx_len = nf_rx_payload_len(c);
+    if (nf_rx_len == 0xFF) {
+      // Not a command: drop it and resync on the next NF_SYNC
+      nf_rx_state = NF_RX_IDLE;
+      return 1;
+    }
+    nf_rx_op = c;
+    nf_rx_crc = _crc8_ccitt_update(0, c);
+    nf_rx_pos = 0;
+    nf_rx_state = NF_RX_PAYLOAD;
+    return 1;
+
+  default:
+    if (nf_rx_pos < nf_rx_len) {
+      nf_rx_payload[nf_rx_pos++] = c;
+      nf_rx_crc = _crc8_ccitt_update(nf_rx_crc, c);
+      return 1;
+    }
+    nf_rx_state = NF_RX_IDLE;
+    if (c == nf_rx_crc)
+      nf_rx_dispatch(nf_rx_op, nf_rx_payload);
+    return 1;
+  }
+}
+
+/**
+ * Fallback RX vector when Serial is not linked.
+ * HardwareSerial0.cpp provides the strong definition otherwise.
+ */
+ISR(USART_RX_vect, __attribute__((weak))) { nf_uart_rx_hook(UDR0); }
@@ -0,0 +1,67 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Queue bytes on the UART0 TX ring buffer (all or nothing).
+ * The ring is drained by the USART_UDRE interrupt.
+ * Returns 0 if there is not enough room; never blocks.
+ */
+uint8_t nf_uart_write(const uint8_t *data, uint8_t len);
+
+/**
+ * Queue a binary frame [NF_SYNC][op][payload][crc8] (see nf_proto.h).
+ */
+uint8_t nf_uart_send_frame(uint8_t op, const uint8_t *payload, uint8_t len);
+
+/**
+ * Drain the ring by polling UDRE0.
+ * Only needed when interrupts are disabled (inside ISRs, before init()).
+ */
+void nf_uart_poll(void);
+
+/**
+ * One USART_UDRE step: the next byte of our ring, or HardwareSerial's
+ * once the ring is empty. The patched HardwareSerial calls this instead
+ * of _tx_udr_empty_irq() when it drains by hand with interrupts disabled,
+ * so its bytes never land between the bytes of a frame.
+ * Call only when UDRE0 is set.
+ */
+void nf_uart_udre_service(void);
+
+/**
+ * Returns 1 while NeuroForge bytes are waiting on the ring.
+ * The patched HardwareSerial::write() checks it so user output
+ * never lands in the middle of a frame.
+ */
+uint8_t nf_uart_tx_busy(void);
+
+/**
+ * Send the protocol HELLO once (no-op in NF_GPIO_ASCII builds).
+ * Returns 1 once it is on the ring.
+ */
+uint8_t nf_uart_hello(void);
+
+/**
+ * Enable UART0 RX and its interrupt (host commands), even without Serial.begin().
+ */
+void nf_uart_rx_enable(void);
+
+/**
+ * Feed one received byte to the host command decoder.
+ * Returns 1 if the byte belongs to a NeuroForge frame and must not
+ * reach HardwareSerial (patched _rx_complete_irq calls this).
+ */
+uint8_t nf_uart_rx_hook(uint8_t c);
+
+/**
+ * Flags announced by the host in NF_OP_HOST_HELLO (NF_HOST_*), 0 until then.
+ */
+uint8_t nf_uart_host_flags(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,321 @@
+/**
+ * Arduino API for the NeuroForge WASM runtime
+ *
+ * Uno-compatible subset (pins 0-19, 10-bit ADC, Serial) implemented on top
+ * of nf_wasm.h. The sketch is plain C++17 against wasi-libc/libc++, so
+ * <vector>, <string>, templates, lambdas etc. work as usual. Libraries
+ * (Servo, Wire, ...) are not available in this runtime.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "nf_wasm.h"
+
+#ifdef __cplusplus
+#include <string>
+#endif
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT NF_MODE_INPUT
+#define OUTPUT NF_MODE_OUTPUT
+#define INPUT_PULLUP NF_MODE_INPUT_PULLUP
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define PI 3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+#define EULER 2.718281828459045235360287471352
+
+#define LED_BUILTIN 13
+#define NUM_DIGITAL_PINS NF_NUM_PINS
+#define NUM_ANALOG_INPUTS 6
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+
+#define NOT_AN_INTERRUPT -1
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : NOT_AN_INTERRUPT))
+
+#define lowByte(w) ((uint8_t)((w) & 0xff))
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitToggle(value, bit) ((value) ^= (1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+#define bit(b) (1UL << (b))
+
+#define radians(deg) ((deg) * DEG_TO_RAD)
+#define degrees(rad) ((rad) * RAD_TO_DEG)
+#define sq(x) ((x) * (x))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// No flash on wasm: PROGMEM data lives in linear memory like everything else
+#define PROGMEM
+#define F(string_literal) (string_literal)
+#define PSTR(string_literal) (string_literal)
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define pgm_read_float(addr) (*(const float *)(addr))
+#define pgm_read_ptr(addr) (*(const void * const *)(addr))
+
+#define interrupts()
+#define noInterrupts()
+
+typedef bool boolean;
+typedef uint8_t byte;
+typedef uint16_t word;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogReference(uint8_t mode);
+void analogWrite(uint8_t pin, int value);
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield(void);
+
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout);
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val);
+uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder);
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode);
+void detachInterrupt(uint8_t interruptNum);
+
+void setup(void);
+void loop(void);
+
+#ifdef __cplusplus
+}
+
+unsigned long pulseIn(uint8_t pin, uint8_t state);
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration = 0);
+void noTone(uint8_t pin);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+long map(long value, long fromLow, long fromHigh, long toLow, long toHigh);
+
+uint16_t makeWord(uint16_t w);
+uint16_t makeWord(uint8_t h, uint8_t l);
+#define word(...) makeWord(__VA_ARGS__)
+
+// Templates instead of the AVR macros: they do not clash with <algorithm>
+template <class T, class L>
+auto min(const T &a, const L &b) -> decltype((b < a) ? b : a) {
+  return (b < a) ? b : a;
+}
+
+template <class T, class L>
+auto max(const T &a, const L &b) -> decltype((b < a) ? b : a) {
+  return (a < b) ? b : a;
+}
+
+/**
+ * Arduino String, backed by std::string
+ */
+class String {
+public:
+  String(const char *cstr = "");
+  String(const std::string &str);
+  String(char c);
+  String(int value, unsigned char base = 10);
+  String(unsigned int value, unsigned char base = 10);
+  String(long value, unsigned char base = 10);
+  String(unsigned long value, unsigned char base = 10);
+  String(float value, unsigned char decimalPlaces = 2);
+  String(double value, unsigned char decimalPlaces = 2);
+
+  unsigned int length() const { return (unsigned int)str.size(); }
+  bool isEmpty() const { return str.empty(); }
+  const char *c_str() const { return str.c_str(); }
+  bool reserve(unsigned int size);
+
+  String &operator+=(const String &rhs);
+  String &operator+=(const char *cstr);
+  String &operator+=(char c);
+  String &operator+=(int value) { return *this += String(value); }
+  String &operator+=(unsigned int value) { return *this += String(value); }
+  String &operator+=(long value) { return *this += String(value); }
+  String &operator+=(unsigned long value) { return *this += String(value); }
+  String &operator+=(float value) { return *this += String(value); }
+  String &operator+=(double value) { return *this += String(value); }
+
+  template <class T>
+  bool concat(const T &value) {
+    *this += value;
+    return true;
+  }
+
+  bool operator==(const String &rhs) const { return str == rhs.str; }
+  bool operator==(const char *cstr) const { return str == cstr; }
+  bool operator!=(const String &rhs) const { return str != rhs.str; }
+  bool operator!=(const char *cstr) const { return str != cstr; }
+  bool operator<(const String &rhs) const { return str < rhs.str; }
+  bool operator>(const String &rhs) const { return str > rhs.str; }
+  bool operator<=(const String &rhs) const { return str <= rhs.str; }
+  bool operator>=(const String &rhs) const { return str >= rhs.str; }
+
+  bool equals(const String &rhs) const { return str == rhs.str; }
+  bool equalsIgnoreCase(const String &rhs) const;
+  int compareTo(const String &rhs) const { return str.compare(rhs.str); }
+  bool startsWith(const String &prefix) const;
+  bool startsWith(const String &prefix, unsigned int offset) const;
+  bool endsWith(const String &suffix) const;
+
+  char charAt(unsigned int index) const;
+  void setCharAt(unsigned int index, char c);
+  char operator[](unsigned int index) const { return charAt(index); }
+  char &operator[](unsigned int index);
+  void toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const;
+  void getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index = 0) const;
+
+  int indexOf(char c, unsigned int fromIndex = 0) const;
+  int indexOf(const String &s, unsigned int fromIndex = 0) const;
+  int lastIndexOf(char c) const;
+  int lastIndexOf(const String &s) const;
+  String substring(unsigned int beginIndex) const;
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+  void replace(char find, char replace);
+  void replace(const String &find, const String &replace);
+  void remove(unsigned int index);
+  void remove(unsigned int index, unsigned int count);
+  void toLowerCase();
+  void toUpperCase();
+  void trim();
+
+  long toInt() const;
+  float toFloat() const;
+  double toDouble() const;
+
+  friend String operator+(const String &lhs, const String &rhs);
+  friend String operator+(const char *lhs, const String &rhs);
+
+  // Any type += accepts (numbers are formatted, not converted to char)
+  template <class T>
+  friend String operator+(const String &lhs, const T &rhs) {
+    String result(lhs);
+    result += rhs;
+    return result;
+  }
+
+private:
+  std::string str;
+};
+
+/**
+ * Text formatting on top of write(), as in the Arduino core
+ */
+class Print {
+public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+
+  size_t print(const char *str);
+  size_t print(const String &s);
+  size_t print(char c);
+  size_t print(unsigned char value, int base = DEC);
+  size_t print(int value, int base = DEC);
+  size_t print(unsigned int value, int base = DEC);
+  size_t print(long value, int base = DEC);
+  size_t print(unsigned long value, int base = DEC);
+  size_t print(long long value, int base = DEC);
+  size_t print(unsigned long long value, int base = DEC);
+  size_t print(double value, int digits = 2);
+
+  size_t println(void);
+  template <class T>
+  size_t println(const T &value) { return print(value) + println(); }
+  template <class T>
+  size_t println(const T &value, int format) { return print(value, format) + println(); }
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+private:
+  size_t printNumber(unsigned long long value, int base);
+};
+
+/**
+ * Print plus reads and parsing (timeouts in virtual time)
+ */
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { timeoutMs = timeout; }
+  size_t readBytes(char *buffer, size_t length);
+  size_t readBytesUntil(char terminator, char *buffer, size_t length);
+  String readString();
+  String readStringUntil(char terminator);
+  long parseInt();
+  float parseFloat();
+  bool find(const char *target);
+
+protected:
+  int timedRead();
+  int timedPeek();
+
+  unsigned long timeoutMs = 1000;
+};
+
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  void begin(unsigned long baud, uint8_t config) { (void)baud; (void)config; }
+  void end() {}
+  int available() override;
+  int read() override;
+  int peek() override;
+  int availableForWrite() { return 64; }
+  void flush() {}
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,449 @@
+#include <Arduino.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+/**
+ * Print / Stream / Serial / String for the WASM runtime.
+ * Serial TX goes to the worker through nf.serial_write, RX comes from
+ * the ring filled by nf_serial_rx.
+ */
+
+HardwareSerial Serial;
+
+/* ---- Print ---- */
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::print(const char *str) {
+  return write(str);
+}
+
+size_t Print::print(const String &s) {
+  return write(s.c_str(), s.length());
+}
+
+size_t Print::print(char c) {
+  return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char value, int base) {
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(int value, int base) {
+  return print((long)value, base);
+}
+
+size_t Print::print(unsigned int value, int base) {
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(long value, int base) {
+  return print((long long)value, base);
+}
+
+size_t Print::print(unsigned long value, int base) {
+  return printNumber(value, base);
+}
+
+size_t Print::print(long long value, int base) {
+  if (base == 0) return write((uint8_t)value);
+  if (base == DEC && value < 0) {
+    return print('-') + printNumber(-(unsigned long long)value, DEC);
+  }
+  // Other bases print the two's complement, as the Arduino core does
+  return printNumber(base == DEC ? (unsigned long long)value : (unsigned long)value, base);
+}
+
+size_t Print::print(unsigned long long value, int base) {
+  if (base == 0) return write((uint8_t)value);
+  return printNumber(value, base);
+}
+
+size_t Print::print(double value, int digits) {
+  if (isnan(value)) return print("nan");
+  if (isinf(value)) return print("inf");
+
+  char buffer[64];
+  int length = snprintf(buffer, sizeof(buffer), "%.*f", digits < 0 ? 0 : digits, value);
+  if (length < 0 || length >= (int)sizeof(buffer)) return print("ovf");
+  return write((const uint8_t *)buffer, (size_t)length);
+}
+
+size_t Print::println(void) {
+  return write("\r\n");
+}
+
+size_t Print::printf(const char *format, ...) {
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+
+  if (length < 0) return 0;
+  if (length < (int)sizeof(buffer)) return write((const uint8_t *)buffer, (size_t)length);
+
+  // Longer than the stack buffer: format again into the heap
+  std::string text((size_t)length + 1, '\0');
+  va_start(args, format);
+  vsnprintf(&text[0], text.size(), format, args);
+  va_end(args);
+  return write((const uint8_t *)text.data(), (size_t)length);
+}
+
+size_t Print::printNumber(unsigned long long value, int base) {
+  if (base < 2) base = DEC;
+
+  char buffer[65];
+  char *p = &buffer[sizeof(buffer) - 1];
+  *p = '\0';
+  do {
+    unsigned digit = (unsigned)(value % base);
+    *--p = (char)(digit < 10 ? '0' + digit : 'A' + digit - 10);
+    value /= base;
+  } while (value);
+
+  return write(p);
+}
+
+/* ---- Stream ---- */
+
+int Stream::timedRead() {
+  uint64_t limit = nf_now_us64() + (uint64_t)timeoutMs * 1000;
+  do {
+    int c = read();
+    if (c >= 0) return c;
+    nf_poll();
+  } while (nf_now_us64() < limit);
+  return -1;
+}
+
+int Stream::timedPeek() {
+  uint64_t limit = nf_now_us64() + (uint64_t)timeoutMs * 1000;
+  do {
+    int c = peek();
+    if (c >= 0) return c;
+    nf_poll();
+  } while (nf_now_us64() < limit);
+  return -1;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    int c = timedRead();
+    if (c < 0) break;
+    buffer[count++] = (char)c;
+  }
+  return count;
+}
+
+size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    int c = timedRead();
+    if (c < 0 || c == terminator) break;
+    buffer[count++] = (char)c;
+  }
+  return count;
+}
+
+String Stream::readString() {
+  String result;
+  int c;
+  while ((c = timedRead()) >= 0) {
+    result += (char)c;
+  }
+  return result;
+}
+
+String Stream::readStringUntil(char terminator) {
+  String result;
+  int c;
+  while ((c = timedRead()) >= 0 && c != terminator) {
+    result += (char)c;
+  }
+  return result;
+}
+
+long Stream::parseInt() {
+  int c;
+  // Skip anything that cannot start a number
+  while ((c = timedPeek()) >= 0 && c != '-' && !isdigit(c)) read();
+  if (c < 0) return 0;
+
+  bool negative = false;
+  long value = 0;
+  if (c == '-') {
+    negative = true;
+    read();
+  }
+  while ((c = timedPeek()) >= 0 && isdigit(c)) {
+    value = value * 10 + (c - '0');
+    read();
+  }
+  return negative ? -value : value;
+}
+
+float Stream::parseFloat() {
+  int c;
+  while ((c = timedPeek()) >= 0 && c != '-' && c != '.' && !isdigit(c)) read();
+  if (c < 0) return 0;
+
+  String text;
+  while ((c = timedPeek()) >= 0 && (isdigit(c) || c == '.' || (c == '-' && text.isEmpty()))) {
+    text += (char)c;
+    read();
+  }
+  return text.toFloat();
+}
+
+bool Stream::find(const char *target) {
+  size_t length = strlen(target);
+  size_t matched = 0;
+  if (length == 0) return true;
+
+  int c;
+  while ((c = timedRead()) >= 0) {
+    matched = c == target[matched] ? matched + 1 : (c == target[0] ? 1 : 0);
+    if (matched == length) return true;
+  }
+  return false;
+}
+
+/* ---- HardwareSerial ---- */
+
+int HardwareSerial::available() {
+  nf_poll();
+  return nf_uart_available();
+}
+
+int HardwareSerial::read() {
+  return nf_uart_read();
+}
+
+int HardwareSerial::peek() {
+  return nf_uart_peek();
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  nf_host_serial_write(&c, 1);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  if (size > 0) nf_host_serial_write(buffer, (uint32_t)size);
+  return size;
+}
+
+/* ---- String ---- */
+
+static std::string nf_format_unsigned(unsigned long long value, unsigned char base) {
+  if (base < 2 || base > 36) base = 10;
+  std::string digits;
+  do {
+    unsigned digit = (unsigned)(value % base);
+    digits.insert(digits.begin(), (char)(digit < 10 ? '0' + digit : 'a' + digit - 10));
+    value /= base;
+  } while (value);
+  return digits;
+}
+
+static std::string nf_format_signed(long long value, unsigned char base) {
+  if (base != 10) return nf_format_unsigned((unsigned long)value, base);
+  if (value < 0) return "-" + nf_format_unsigned(-(unsigned long long)value, 10);
+  return nf_format_unsigned((unsigned long long)value, 10);
+}
+
+static std::string nf_format_double(double value, unsigned char decimalPlaces) {
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*f", decimalPlaces, value);
+  return buffer;
+}
+
+String::String(const char *cstr) : str(cstr ? cstr : "") {}
+String::String(const std::string &s) : str(s) {}
+String::String(char c) : str(1, c) {}
+String::String(int value, unsigned char base) : str(nf_format_signed(value, base)) {}
+String::String(unsigned int value, unsigned char base) : str(nf_format_unsigned(value, base)) {}
+String::String(long value, unsigned char base) : str(nf_format_signed(value, base)) {}
+String::String(unsigned long value, unsigned char base) : str(nf_format_unsigned(value, base)) {}
+String::String(float value, unsigned char decimalPlaces) : str(nf_format_double(value, decimalPlaces)) {}
+String::String(double value, unsigned char decimalPlaces) : str(nf_format_double(value, decimalPlaces)) {}
+
+bool String::reserve(unsigned int size) {
+  str.reserve(size);
+  return true;
+}
+
+String &String::operator+=(const String &rhs) {
+  str += rhs.str;
+  return *this;
+}
+
+String &String::operator+=(const char *cstr) {
+  if (cstr) str += cstr;
+  return *this;
+}
+
+String &String::operator+=(char c) {
+  str += c;
+  return *this;
+}
+
+bool String::equalsIgnoreCase(const String &rhs) const {
+  if (str.size() != rhs.str.size()) return false;
+  for (size_t i = 0; i < str.size(); i++) {
+    if (tolower((unsigned char)str[i]) != tolower((unsigned char)rhs.str[i])) return false;
+  }
+  return true;
+}
+
+bool String::startsWith(const String &prefix) const {
+  return startsWith(prefix, 0);
+}
+
+bool String::startsWith(const String &prefix, unsigned int offset) const {
+  return offset <= str.size() && str.compare(offset, prefix.str.size(), prefix.str) == 0;
+}
+
+bool String::endsWith(const String &suffix) const {
+  return suffix.str.size() <= str.size() &&
+         str.compare(str.size() - suffix.str.size(), suffix.str.size(), suffix.str) == 0;
+}
+
+char String::charAt(unsigned int index) const {
+  return index < str.size() ? str[index] : 0;
+}
+
+void String::setCharAt(unsigned int index, char c) {
+  if (index < str.size()) str[index] = c;
+}
+
+char &String::operator[](unsigned int index) {
+  static char dummy;
+  if (index >= str.size()) {
+    dummy = 0;
+    return dummy;
+  }
+  return str[index];
+}
+
+void String::toCharArray(char *buf, unsigned int bufsize, unsigned int index) const {
+  getBytes((unsigned char *)buf, bufsize, index);
+}
+
+void String::getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index) const {
+  if (!bufsize || !buf) return;
+  if (index >= str.size()) {
+    buf[0] = 0;
+    return;
+  }
+  size_t n = str.copy((char *)buf, bufsize - 1, index);
+  buf[n] = 0;
+}
+
+int String::indexOf(char c, unsigned int fromIndex) const {
+  size_t found = str.find(c, fromIndex);
+  return found == std::string::npos ? -1 : (int)found;
+}
+
+int String::indexOf(const String &s, unsigned int fromIndex) const {
+  size_t found = str.find(s.str, fromIndex);
+  return found == std::string::npos ? -1 : (int)found;
+}
+
+int String::lastIndexOf(char c) const {
+  size_t found = str.rfind(c);
+  return found == std::string::npos ? -1 : (int)found;
+}
+
+int String::lastIndexOf(const String &s) const {
+  size_t found = str.rfind(s.str);
+  return found == std::string::npos ? -1 : (int)found;
+}
+
+String String::substring(unsigned int beginIndex) const {
+  return substring(beginIndex, length());
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+  if (beginIndex > endIndex) {
+    unsigned int swap = beginIndex;
+    beginIndex = endIndex;
+    endIndex = swap;
+  }
+  if (beginIndex >= str.size()) return String();
+  return String(str.substr(beginIndex, endIndex - beginIndex));
+}
+
+void String::replace(char find, char replace) {
+  for (char &c : str) {
+    if (c == find) c = replace;
+  }
+}
+
+void String::replace(const String &find, const String &replace) {
+  if (find.str.empty()) return;
+  size_t position = 0;
+  while ((position = str.find(find.str, position)) != std::string::npos) {
+    str.replace(position, find.str.size(), replace.str);
+    position += replace.str.size();
+  }
+}
+
+void String::remove(unsigned int index) {
+  if (index < str.size()) str.erase(index);
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+  if (index < str.size()) str.erase(index, count);
+}
+
+void String::toLowerCase() {
+  for (char &c : str) c = (char)tolower((unsigned char)c);
+}
+
+void String::toUpperCase() {
+  for (char &c : str) c = (char)toupper((unsigned char)c);
+}
+
+void String::trim() {
+  size_t begin = 0;
+  while (begin < str.size() && isspace((unsigned char)str[begin])) begin++;
+  size_t end = str.size();
+  while (end > begin && isspace((unsigned char)str[end - 1])) end--;
+  str = str.substr(begin, end - begin);
+}
+
+long String::toInt() const {
+  return atol(str.c_str());
+}
+
+float String::toFloat() const {
+  return (float)atof(str.c_str());
+}
+
+double String::toDouble() const {
+  return atof(str.c_str());
+}
+
+String operator+(const String &lhs, const String &rhs) {
+  String result(lhs);
+  result += rhs;
+  return result;
+}
+
+String operator+(const char *lhs, const String &rhs) {
+  String result(lhs);
+  result += rhs;
+  return result;
+}
@@ -0,0 +1,421 @@
+#include "nf_wasm.h"
+#include <Arduino.h>
+
+/**
+ * Virtual clock
+ *
+ * nf_now advances only with delay()/delayMicroseconds() and the
+ * NF_POLL_US cost of polling calls. The worker sets nf_slice_end to the
+ * virtual time its wall clock allows; while deadlines fall inside the slice
+ * time just jumps, past it the sketch suspends in nf.yield_until.
+ */
+
+#ifndef NF_POLL_US
+#define NF_POLL_US 1
+#endif
+
+static uint64_t nf_now = 0;
+static uint64_t nf_slice_end = 0;
+
+/**
+ * Asyncify unwind/rewind buffer: { current, end } followed by the saved
+ * call stack. Deep recursion across delay() needs more than the default.
+ */
+#ifndef NF_ASYNCIFY_STACK
+#define NF_ASYNCIFY_STACK (32 * 1024)
+#endif
+
+static uint8_t nf_async_stack[NF_ASYNCIFY_STACK];
+static struct {
+  uint8_t *current;
+  uint8_t *end;
+} nf_async_data = { nf_async_stack, nf_async_stack + NF_ASYNCIFY_STACK };
+
+/* ---- Pins ---- */
+
+static uint8_t nf_mode[NF_NUM_PINS];
+static uint8_t nf_level[NF_NUM_PINS];     // Output latch (PORTx)
+static uint8_t nf_pwm_duty[NF_NUM_PINS];  // Last analogWrite(), 0 = none
+static uint32_t nf_input_driven = 0;      // Pins whose level comes from the host
+static uint32_t nf_input_level = 0;
+static uint16_t nf_adc[NUM_ANALOG_INPUTS];
+
+/* ---- External interrupts (INT0 = pin 2, INT1 = pin 3) ---- */
+
+static void (*nf_isr[2])(void) = { nullptr, nullptr };
+static int nf_isr_mode[2];
+static uint8_t nf_isr_pending = 0;
+
+static const uint8_t NF_ISR_PIN[2] = { 2, 3 };
+
+/* ---- Serial RX ring ---- */
+
+#define NF_RX_SIZE 256
+static uint8_t nf_rx[NF_RX_SIZE];
+static uint16_t nf_rx_head = 0;
+static uint16_t nf_rx_tail = 0;
+
+static uint32_t nf_random_state = 1;
+
+static inline bool nf_valid_pin(uint8_t pin) {
+  return pin < NF_NUM_PINS;
+}
+
+/**
+ * digitalRead() without the poll: safe to call from the exports, which
+ * run while the sketch is suspended and must never yield
+ */
+static int nf_pin_level(uint8_t pin) {
+  if (!nf_valid_pin(pin)) return LOW;
+  if (nf_mode[pin] == OUTPUT) return nf_level[pin];
+
+  int8_t driven = nf_input_read(pin);
+  if (driven >= 0) return driven;
+  return nf_level[pin]; // Floating input: pull-up or LOW
+}
+
+/**
+ * Run ISRs whose edge arrived since the last check. Interrupts are only
+ * taken at the points where the sketch touches the HAL (polls, sleeps),
+ * which is where an input change can first be observed anyway.
+ */
+static void nf_dispatch_interrupts(void) {
+  while (nf_isr_pending) {
+    for (uint8_t i = 0; i < 2; i++) {
+      if (nf_isr_pending & (1 << i)) {
+        nf_isr_pending &= ~(1 << i);
+        if (nf_isr[i]) nf_isr[i]();
+      }
+    }
+  }
+}
+
+static void nf_sleep_until(uint64_t deadline) {
+  nf_dispatch_interrupts();
+  while (nf_now < deadline) {
+    if (deadline <= nf_slice_end) {
+      nf_now = deadline;
+      break;
+    }
+    uint64_t resumed = (uint64_t)nf_host_yield_until((double)deadline);
+    if (resumed > nf_now) nf_now = resumed;
+    nf_dispatch_interrupts();
+  }
+}
+
+/* ---- nf_gpio.h ---- */
+
+void nf_report_gpio(uint8_t pin, uint8_t value) {
+  nf_host_gpio(pin, value);
+}
+
+void nf_report_mode(uint8_t pin, uint8_t mode) {
+  nf_host_mode(pin, mode);
+}
+
+void nf_report_pwm(uint8_t pin, uint8_t duty) {
+  nf_host_pwm(pin, duty);
+}
+
+/* ---- nf_time.h ---- */
+
+uint64_t nf_now_us64(void) {
+  return nf_now;
+}
+
+uint32_t nf_now_ms(void) {
+  return (uint32_t)(nf_now / 1000);
+}
+
+uint32_t nf_now_us(void) {
+  return (uint32_t)nf_now;
+}
+
+void nf_sleep_ms(uint32_t ms) {
+  nf_sleep_until(nf_now + (uint64_t)ms * 1000);
+}
+
+void nf_sleep_us(uint32_t us) {
+  nf_sleep_until(nf_now + us);
+}
+
+void nf_poll(void) {
+  nf_sleep_until(nf_now + NF_POLL_US);
+}
+
+/* ---- Inputs ---- */
+
+int8_t nf_input_read(uint8_t pin) {
+  if (!nf_valid_pin(pin) || !(nf_input_driven & (1UL << pin))) return -1;
+  return (nf_input_level >> pin) & 1;
+}
+
+uint16_t nf_adc_read(uint8_t channel) {
+  return channel < NUM_ANALOG_INPUTS ? nf_adc[channel] : 0;
+}
+
+int nf_uart_available(void) {
+  return (NF_RX_SIZE + nf_rx_head - nf_rx_tail) % NF_RX_SIZE;
+}
+
+int nf_uart_read(void) {
+  if (nf_rx_head == nf_rx_tail) return -1;
+  uint8_t c = nf_rx[nf_rx_tail];
+  nf_rx_tail = (nf_rx_tail + 1) % NF_RX_SIZE;
+  return c;
+}
+
+int nf_uart_peek(void) {
+  return nf_rx_head == nf_rx_tail ? -1 : nf_rx[nf_rx_tail];
+}
+
+/* ---- Worker exports ---- */
+
+extern "C" {
+
+NF_EXPORT("nf_asyncify_data") void *nf_asyncify_data(void) {
+  return &nf_async_data;
+}
+
+NF_EXPORT("nf_set_slice_end") void nf_set_slice_end(double us) {
+  nf_slice_end = (uint64_t)us;
+}
+
+NF_EXPORT("nf_now") double nf_now_export(void) {
+  return (double)nf_now;
+}
+
+/**
+ * Drive an input pin: value 0/1, or 2 to release it (reads fall back to
+ * the pull-up / output latch)
+ */
+NF_EXPORT("nf_set_input") void nf_set_input(uint32_t pin, uint32_t value) {
+  if (!nf_valid_pin(pin)) return;
+
+  int previous = nf_pin_level(pin);
+  if (value > 1) {
+    nf_input_driven &= ~(1UL << pin);
+  } else {
+    nf_input_driven |= 1UL << pin;
+    nf_input_level = value ? (nf_input_level | (1UL << pin)) : (nf_input_level & ~(1UL << pin));
+  }
+  int current = nf_pin_level(pin);
+  if (current == previous) return;
+
+  for (uint8_t i = 0; i < 2; i++) {
+    if (!nf_isr[i] || NF_ISR_PIN[i] != pin) continue;
+    int mode = nf_isr_mode[i];
+    if (mode == CHANGE || (mode == RISING && current) || (mode == FALLING && !current)) {
+      nf_isr_pending |= 1 << i;
+    }
+  }
+}
+
+NF_EXPORT("nf_set_analog") void nf_set_analog(uint32_t channel, uint32_t value) {
+  if (channel < NUM_ANALOG_INPUTS) {
+    nf_adc[channel] = value > 1023 ? 1023 : value;
+  }
+}
+
+/**
+ * Queue one received byte; 0 if the ring is full (host retries later)
+ */
+NF_EXPORT("nf_serial_rx") uint32_t nf_serial_rx(uint32_t byte) {
+  uint16_t next = (nf_rx_head + 1) % NF_RX_SIZE;
+  if (next == nf_rx_tail) return 0;
+  nf_rx[nf_rx_head] = (uint8_t)byte;
+  nf_rx_head = next;
+  return 1;
+}
+
+/**
+ * Entry point: never returns, the worker regains control every time the
+ * sketch suspends (asyncify unwind) and re-enters it to resume (rewind).
+ * Static constructors already ran in the reactor's _initialize.
+ */
+NF_EXPORT("nf_main") void nf_main(void) {
+  setup();
+  for (;;) {
+    loop();
+    nf_poll();
+  }
+}
+
+/* ---- Arduino wiring ---- */
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (!nf_valid_pin(pin)) return;
+  nf_mode[pin] = mode;
+  nf_pwm_duty[pin] = 0;
+  // AVR: INPUT_PULLUP sets the latch, INPUT clears it
+  if (mode != OUTPUT) nf_level[pin] = mode == INPUT_PULLUP;
+  nf_report_mode(pin, mode);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (!nf_valid_pin(pin)) return;
+  value = value ? HIGH : LOW;
+
+  if (nf_mode[pin] != OUTPUT) {
+    // Writing an input pin toggles its pull-up, as on the AVR
+    if (nf_level[pin] != value) {
+      nf_level[pin] = value;
+      nf_mode[pin] = value ? INPUT_PULLUP : INPUT;
+      nf_report_mode(pin, nf_mode[pin]);
+    }
+    return;
+  }
+
+  if (nf_pwm_duty[pin] == 0 && nf_level[pin] == value) return;
+  nf_pwm_duty[pin] = 0;
+  nf_level[pin] = value;
+  nf_report_gpio(pin, value);
+}
+
+int digitalRead(uint8_t pin) {
+  nf_poll();
+  return nf_pin_level(pin);
+}
+
+int analogRead(uint8_t pin) {
+  nf_poll();
+  if (pin >= A0) pin -= A0;
+  return nf_adc_read(pin);
+}
+
+void analogReference(uint8_t mode) {
+  (void)mode;
+}
+
+void analogWrite(uint8_t pin, int value) {
+  if (!nf_valid_pin(pin)) return;
+  if (nf_mode[pin] != OUTPUT) pinMode(pin, OUTPUT);
+
+  if (value <= 0) {
+    digitalWrite(pin, LOW);
+  } else if (value >= 255) {
+    digitalWrite(pin, HIGH);
+  } else if (nf_pwm_duty[pin] != value) {
+    nf_pwm_duty[pin] = (uint8_t)value;
+    nf_report_pwm(pin, (uint8_t)value);
+  }
+}
+
+unsigned long millis(void) {
+  nf_poll();
+  return nf_now_ms();
+}
+
+unsigned long micros(void) {
+  nf_poll();
+  return nf_now_us();
+}
+
+void delay(unsigned long ms) {
+  nf_sleep_ms(ms);
+}
+
+void delayMicroseconds(unsigned int us) {
+  nf_sleep_us(us);
+}
+
+void yield(void) {
+  nf_poll();
+}
+
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout) {
+  uint64_t start = nf_now;
+  uint64_t limit = start + timeout;
+
+  // Wait for any previous pulse to end, then for the pulse to start
+  while (digitalRead(pin) == state) {
+    if (nf_now >= limit) return 0;
+  }
+  while (digitalRead(pin) != state) {
+    if (nf_now >= limit) return 0;
+  }
+  uint64_t pulseStart = nf_now;
+  while (digitalRead(pin) == state) {
+    if (nf_now >= limit) return 0;
+  }
+  return (unsigned long)(nf_now - pulseStart);
+}
+
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val) {
+  for (uint8_t i = 0; i < 8; i++) {
+    digitalWrite(dataPin, bitOrder == LSBFIRST ? (val >> i) & 1 : (val >> (7 - i)) & 1);
+    digitalWrite(clockPin, HIGH);
+    digitalWrite(clockPin, LOW);
+  }
+}
+
+uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder) {
+  uint8_t value = 0;
+  for (uint8_t i = 0; i < 8; i++) {
+    digitalWrite(clockPin, HIGH);
+    if (bitOrder == LSBFIRST) {
+      value |= digitalRead(dataPin) << i;
+    } else {
+      value |= digitalRead(dataPin) << (7 - i);
+    }
+    digitalWrite(clockPin, LOW);
+  }
+  return value;
+}
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode) {
+  if (interruptNum >= 2) return;
+  nf_isr_mode[interruptNum] = mode;
+  nf_isr[interruptNum] = userFunc;
+}
+
+void detachInterrupt(uint8_t interruptNum) {
+  if (interruptNum >= 2) return;
+  nf_isr[interruptNum] = nullptr;
+  nf_isr_pending &= ~(1 << interruptNum);
+}
+
+} // extern "C"
+
+unsigned long pulseIn(uint8_t pin, uint8_t state) {
+  return pulseIn(pin, state, 1000000UL);
+}
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration) {
+  nf_host_tone(pin, frequency, (uint32_t)duration);
+}
+
+void noTone(uint8_t pin) {
+  nf_host_tone(pin, 0, 0);
+}
+
+void randomSeed(unsigned long seed) {
+  if (seed != 0) nf_random_state = (uint32_t)seed;
+}
+
+long random(long howbig) {
+  if (howbig <= 0) return 0;
+  // xorshift32: deterministic between runs unless randomSeed() is called
+  nf_random_state ^= nf_random_state << 13;
+  nf_random_state ^= nf_random_state >> 17;
+  nf_random_state ^= nf_random_state << 5;
+  return (long)(nf_random_state % (uint32_t)howbig);
+}
+
+long random(long howsmall, long howbig) {
+  if (howsmall >= howbig) return howsmall;
+  return random(howbig - howsmall) + howsmall;
+}
+
+long map(long value, long fromLow, long fromHigh, long toLow, long toHigh) {
+  if (fromHigh == fromLow) return toLow;
+  return (value - fromLow) * (toHigh - toLow) / (fromHigh - fromLow) + toLow;
+}
+
+uint16_t makeWord(uint16_t w) {
+  return w;
+}
+
+uint16_t makeWord(uint8_t h, uint8_t l) {
+  return (uint16_t)((h << 8) | l);
+}
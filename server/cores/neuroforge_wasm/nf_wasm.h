@@ -0,0 +1,88 @@
+/**
+ * NeuroForge WASM - HAL do runtime JS (sketch compilado para wasm32)
+ *
+ * Mesma API de nf_gpio.h / nf_time.h do core neuroforge_qemu, mas o
+ * "hardware" é o Web Worker que instancia o módulo
+ * (src/engine/wasm/sketch.worker.ts):
+ *
+ * - Saídas (GPIO, modo, PWM, tone, Serial TX) são imports do módulo "nf"
+ * - Entradas (botões, potenciômetros, Serial RX) são escritas pelo worker
+ *   em shadows através dos exports nf_set_input / nf_set_analog / nf_serial_rx
+ * - O clock virtual fica dentro do módulo; o worker só diz até onde o
+ *   sketch pode avançar (nf_set_slice_end). Passar do fim da fatia chama
+ *   nf.yield_until, que o Asyncify (wasm-opt --asyncify) transforma em
+ *   suspensão: delay() bloqueia sem SharedArrayBuffer nem Atomics.wait.
+ */
+
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NF_IMPORT(name) __attribute__((import_module("nf"), import_name(name)))
+#define NF_EXPORT(name) __attribute__((export_name(name), used))
+
+/** Digital pins 0-19 (A0-A5 = 14-19), same numbering as the Uno */
+#define NF_NUM_PINS 20
+
+/** Pin modes as sent to nf.mode (same values as the AVR core) */
+#define NF_MODE_INPUT 0
+#define NF_MODE_OUTPUT 1
+#define NF_MODE_INPUT_PULLUP 2
+
+/* ---- Host imports (worker) ---- */
+
+NF_IMPORT("gpio") void nf_host_gpio(uint32_t pin, uint32_t value);
+NF_IMPORT("mode") void nf_host_mode(uint32_t pin, uint32_t mode);
+NF_IMPORT("pwm") void nf_host_pwm(uint32_t pin, uint32_t duty);
+NF_IMPORT("tone") void nf_host_tone(uint32_t pin, uint32_t frequency, uint32_t duration_ms);
+NF_IMPORT("serial_write") void nf_host_serial_write(const uint8_t *data, uint32_t length);
+
+/**
+ * Suspend the sketch until the host's slice reaches deadline_us.
+ * Returns the virtual time it resumed at: the deadline, or earlier when
+ * an input changed meanwhile (attached interrupts must run on time).
+ * The only import listed in asyncify-imports.
+ */
+NF_IMPORT("yield_until") double nf_host_yield_until(double deadline_us);
+
+/* ---- nf_gpio.h ---- */
+
+void nf_report_gpio(uint8_t pin, uint8_t value);
+void nf_report_mode(uint8_t pin, uint8_t mode);
+void nf_report_pwm(uint8_t pin, uint8_t duty);
+
+/* ---- nf_time.h ---- */
+
+uint64_t nf_now_us64(void);
+uint32_t nf_now_ms(void);
+uint32_t nf_now_us(void);
+void nf_sleep_ms(uint32_t ms);
+void nf_sleep_us(uint32_t us);
+
+/**
+ * Busy-wait step: digitalRead(), analogRead(), millis(), micros() and
+ * Serial reads cost NF_POLL_US of virtual time, so polling loops
+ * (while (millis() - t < 1000)) advance the clock and yield to the host
+ * at the end of the slice instead of spinning forever.
+ */
+void nf_poll(void);
+
+/* ---- Inputs (shadows written by the worker) ---- */
+
+/** Host-driven level of a pin, or -1 if the host does not drive it */
+int8_t nf_input_read(uint8_t pin);
+
+/** Last value set by the host for analog channel 0-5 (0-1023) */
+uint16_t nf_adc_read(uint8_t channel);
+
+/** Serial RX ring (filled by nf_serial_rx) */
+int nf_uart_available(void);
+int nf_uart_read(void);
+int nf_uart_peek(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -37,32 +37,41 @@ if (-not (Test-Path $BACKUP_FILE)) {
 $content = Get-Content $WIRING_FILE -Raw
 
 # 4. Check if already patched
+$patchedContent = $content
 if ($content -match "#define NEUROFORGE_TIME_PATCHED") {
-    Write-Host "[!] wiring.c ja foi patchado anteriormente!" -ForegroundColor Yellow
-    Write-Host "[OK] Nada a fazer." -ForegroundColor Green
-    exit 0
+    Write-Host "[!] wiring.c ja foi patchado anteriormente, verificando funcoes novas..." -ForegroundColor Yellow
 }
+else {
+    Write-Host "[...] Aplicando patch..." -ForegroundColor Cyan
 
-Write-Host "[...] Aplicando patch..." -ForegroundColor Cyan
+    # 5. Add patch marker at the beginning
+    $patchedContent = "// NEUROFORGE_TIME_PATCHED - timing functions disabled`n"
+    $patchedContent += "#define NEUROFORGE_TIME_PATCHED`n`n"
+    $patchedContent += $content
 
-# 5. Add patch marker at the beginning
-$patchedContent = "// NEUROFORGE_TIME_PATCHED - timing functions disabled`n"
-$patchedContent += "#define NEUROFORGE_TIME_PATCHED`n`n"
-$patchedContent += $content
+    # 6. Disable millis() function
+    $patchedContent = $patchedContent -replace '(?s)(unsigned long millis\(\)\s*\{.*?\n\})', '/* NEUROFORGE_TIME: Original millis() disabled`n$1`n*/'
 
-# 6. Disable millis() function
-$patchedContent = $patchedContent -replace '(?s)(unsigned long millis\(\)\s*\{.*?\n\})', '/* NEUROFORGE_TIME: Original millis() disabled`n$1`n*/'
+    # 7. Disable micros() function
+    $patchedContent = $patchedContent -replace '(?s)(unsigned long micros\(\)\s*\{.*?\n\})', '/* NEUROFORGE_TIME: Original micros() disabled`n$1`n*/'
 
-# 7. Disable micros() function
-$patchedContent = $patchedContent -replace '(?s)(unsigned long micros\(\)\s*\{.*?\n\})', '/* NEUROFORGE_TIME: Original micros() disabled`n$1`n*/'
+    # 8. Disable delay() function
+    $patchedContent = $patchedContent -replace '(?s)(void delay\(unsigned long ms\)\s*\{.*?\n\})', '/* NEUROFORGE_TIME: Original delay() disabled`n$1`n*/'
+}
 
-# 8. Disable delay() function
-$patchedContent = $patchedContent -replace '(?s)(void delay\(unsigned long ms\)\s*\{.*?\n\})', '/* NEUROFORGE_TIME: Original delay() disabled`n$1`n*/'
+# 8b. Disable delayMicroseconds() (avanca o clock virtual em nf_arduino_time.cpp)
+if ($patchedContent -notmatch "Original delayMicroseconds\(\) disabled") {
+    $patchedContent = $patchedContent -replace '(?s)(void delayMicroseconds\(unsigned int us\)\s*\{.*?\n\})', '/* NEUROFORGE_TIME: Original delayMicroseconds() disabled`n$1`n*/'
+}
 
 # 9. Save patched file
-Set-Content -Path $WIRING_FILE -Value $patchedContent -NoNewline
-
-Write-Host "[OK] wiring.c patch aplicado!" -ForegroundColor Green
+if ($patchedContent -ne $content) {
+    Set-Content -Path $WIRING_FILE -Value $patchedContent -NoNewline
+    Write-Host "[OK] wiring.c patch aplicado!" -ForegroundColor Green
+}
+else {
+    Write-Host "[OK] wiring.c ja esta atualizado." -ForegroundColor Green
+}
 
 # 10. Patch wiring_digital.c
 $WIRING_DIGITAL_FILE = "$ARDUINO_DATA\packages\arduino\hardware\avr\$AVR_VERSION\cores\neuroforge_qemu\wiring_digital.c"
@@ -101,6 +110,139 @@ else {
     Write-Host "[OK] wiring_digital.c patch aplicado!" -ForegroundColor Green
 }
 
+# digitalRead() consulta primeiro os pinos dirigidos pelo host (NF_OP_INPUT, ver nf_input.cpp)
+$digitalContent = Get-Content $WIRING_DIGITAL_FILE -Raw
+
+if ($digitalContent -match "nf_input_read") {
+    Write-Host "[!] wiring_digital.c ja possui o override de digitalRead." -ForegroundColor Yellow
+}
+else {
+    $digitalContent = $digitalContent -replace '#include "wiring_private.h"', "#include `"wiring_private.h`"`n#include `"nf_input.h`""
+    $digitalContent = $digitalContent -replace '(int digitalRead\(uint8_t pin\)\s*\{)', "`$1`n	// NeuroForge: pino dirigido pelo host`n	int8_t nf_level = nf_input_read(pin);`n	if (nf_level >= 0) return nf_level;`n"
+
+    Set-Content -Path $WIRING_DIGITAL_FILE -Value $digitalContent -NoNewline
+    Write-Host "[OK] digitalRead() patch aplicado!" -ForegroundColor Green
+}
+
+# analogRead() le primeiro os canais alimentados pelo host (NF_OP_ADC_*, ver nf_adc.cpp)
+$WIRING_ANALOG_FILE = "$ARDUINO_DATA\packages\arduino\hardware\avr\$AVR_VERSION\cores\neuroforge_qemu\wiring_analog.c"
+$analogContent = Get-Content $WIRING_ANALOG_FILE -Raw
+
+if ($analogContent -match "nf_adc_read") {
+    Write-Host "[!] wiring_analog.c ja possui o override de analogRead." -ForegroundColor Yellow
+}
+else {
+    Copy-Item -Path $WIRING_ANALOG_FILE -Destination "$WIRING_ANALOG_FILE.backup" -Force
+
+    $analogContent = $analogContent -replace '#include "wiring_private.h"', "#include `"wiring_private.h`"`n#include `"nf_adc.h`""
+    $analogContent = $analogContent -replace '(int analogRead\(uint8_t pin\)\s*\{)', "`$1`n	// NeuroForge: canal alimentado pelo host`n	int16_t nf_sample = nf_adc_read(pin);`n	if (nf_sample >= 0) return nf_sample;`n"
+
+    Set-Content -Path $WIRING_ANALOG_FILE -Value $analogContent -NoNewline
+    Write-Host "[OK] analogRead() patch aplicado!" -ForegroundColor Green
+}
+
+# analogWrite() reporta o PWM como um frame de configuracao (duty + frequencia), nao como bordas
+$analogContent = Get-Content $WIRING_ANALOG_FILE -Raw
+
+if ($analogContent -match "nf_report_pwm") {
+    Write-Host "[!] wiring_analog.c ja possui o reporte PWM." -ForegroundColor Yellow
+}
+else {
+    $analogContent = $analogContent -replace '#include "wiring_private.h"', "#include `"wiring_private.h`"`n#include `"nf_gpio.h`""
+    $analogContent = $analogContent -replace '(?s)(void analogWrite\(uint8_t pin, int val\)\s*\{.*?\n)(\})', "`$1`n	// NeuroForge: Report PWM configuration`n	nf_report_pwm(pin, val);`n`$2"
+
+    Set-Content -Path $WIRING_ANALOG_FILE -Value $analogContent -NoNewline
+    Write-Host "[OK] analogWrite() patch aplicado!" -ForegroundColor Green
+}
+
+# 11. Patch HardwareSerial (UART TX compartilhado com nf_uart)
+$CORE_DIR = "$ARDUINO_DATA\packages\arduino\hardware\avr\$AVR_VERSION\cores\neuroforge_qemu"
+$HWSERIAL_FILE = "$CORE_DIR\HardwareSerial.cpp"
+$HWSERIAL0_FILE = "$CORE_DIR\HardwareSerial0.cpp"
+
+Write-Host ""
+Write-Host "[...] Aplicando patch no HardwareSerial..." -ForegroundColor Cyan
+
+if (-not (Test-Path $HWSERIAL_FILE) -or -not (Test-Path $HWSERIAL0_FILE)) {
+    Write-Host "[X] HardwareSerial.cpp/HardwareSerial0.cpp nao encontrados!" -ForegroundColor Red
+    exit 1
+}
+
+$hwContent = Get-Content $HWSERIAL_FILE -Raw
+
+if ($hwContent -match "nf_uart_tx_busy") {
+    Write-Host "[!] HardwareSerial.cpp ja possui o patch nf_uart." -ForegroundColor Yellow
+}
+else {
+    Copy-Item -Path $HWSERIAL_FILE -Destination "$HWSERIAL_FILE.backup" -Force
+
+    $hwContent = $hwContent -replace '#include "HardwareSerial_private.h"', "#include `"HardwareSerial_private.h`"`n#include `"nf_uart.h`""
+
+    # Fast path de write() so escreve direto em UDR0 se nao houver frame NeuroForge em andamento
+    $hwContent = $hwContent.Replace("bit_is_set(*_ucsra, UDRE0)) {", "bit_is_set(*_ucsra, UDRE0) && !nf_uart_tx_busy()) {")
+
+    # Com interrupcoes desabilitadas, write()/flush() esvaziam o buffer na mao: passar pelo nf_uart,
+    # que termina o frame NeuroForge em andamento antes de liberar um byte do Serial
+    $hwContent = $hwContent.Replace("_tx_udr_empty_irq();", "nf_uart_udre_service();")
+
+    Set-Content -Path $HWSERIAL_FILE -Value $hwContent -NoNewline
+    Write-Host "[OK] HardwareSerial.cpp patch aplicado!" -ForegroundColor Green
+}
+
+$hw0Content = Get-Content $HWSERIAL0_FILE -Raw
+
+if ($hw0Content -match "nf_hwserial_udre_irq") {
+    Write-Host "[!] HardwareSerial0.cpp ja possui o patch nf_uart." -ForegroundColor Yellow
+}
+else {
+    Copy-Item -Path $HWSERIAL0_FILE -Destination "$HWSERIAL0_FILE.backup" -Force
+
+    # O vetor USART_UDRE passa a ser do nf_uart.cpp, que chama este handler quando o ring dele esvazia
+    $hw0Content = $hw0Content.Replace("ISR(USART_UDRE_vect)", "extern `"C`" void nf_hwserial_udre_irq(void)")
+    $hw0Content = $hw0Content.Replace("Serial._tx_udr_empty_irq();", "if (Serial.availableForWrite() < SERIAL_TX_BUFFER_SIZE - 1)`n    Serial._tx_udr_empty_irq();`n  else`n    cbi(UCSR0B, UDRIE0);")
+
+    Set-Content -Path $HWSERIAL0_FILE -Value $hw0Content -NoNewline
+    Write-Host "[OK] HardwareSerial0.cpp patch aplicado!" -ForegroundColor Green
+}
+
+# RX: frames do host (NF_OP_WAKE etc.) sao consumidos antes do buffer do Serial
+$HWSERIAL_PRIVATE_FILE = "$CORE_DIR\HardwareSerial_private.h"
+$hwpContent = Get-Content $HWSERIAL_PRIVATE_FILE -Raw
+
+if ($hwpContent -match "nf_uart_rx_hook") {
+    Write-Host "[!] HardwareSerial_private.h ja possui o hook RX." -ForegroundColor Yellow
+}
+else {
+    Copy-Item -Path $HWSERIAL_PRIVATE_FILE -Destination "$HWSERIAL_PRIVATE_FILE.backup" -Force
+
+    $hwpContent = $hwpContent -replace '#include "wiring_private.h"', "#include `"wiring_private.h`"`n#include `"nf_uart.h`""
+    $hwpContent = $hwpContent -replace '(\s+)unsigned char c = \*_udr;', '$1unsigned char c = *_udr;$1if (nf_uart_rx_hook(c)) return;'
+
+    Set-Content -Path $HWSERIAL_PRIVATE_FILE -Value $hwpContent -NoNewline
+    Write-Host "[OK] HardwareSerial_private.h patch aplicado!" -ForegroundColor Green
+}
+
+# 12. Patch main.cpp (flush do batching GPIO ao fim de cada loop())
+$MAIN_FILE = "$CORE_DIR\main.cpp"
+
+Write-Host ""
+Write-Host "[...] Aplicando patch no main.cpp..." -ForegroundColor Cyan
+
+$mainContent = Get-Content $MAIN_FILE -Raw
+
+if ($mainContent -match "nf_gpio_loop_hook") {
+    Write-Host "[!] main.cpp ja possui o hook de loop." -ForegroundColor Yellow
+}
+else {
+    Copy-Item -Path $MAIN_FILE -Destination "$MAIN_FILE.backup" -Force
+
+    $mainContent = $mainContent -replace '#include <Arduino.h>', "#include <Arduino.h>`n#include `"nf_gpio.h`""
+    $mainContent = $mainContent -replace '(\s+)loop\(\);', '$1loop();$1nf_gpio_loop_hook();'
+
+    Set-Content -Path $MAIN_FILE -Value $mainContent -NoNewline
+    Write-Host "[OK] main.cpp patch aplicado!" -ForegroundColor Green
+}
+
 Write-Host ""
 Write-Host "========================================" -ForegroundColor Green
 Write-Host "[OK] Pronto! Tente compilar novamente." -ForegroundColor Green
@@ -0,0 +1,135 @@
+#!/bin/bash
+# NeuroForge QEMU Core - Patch do core Arduino copiado (Linux/macOS)
+#
+# Mesmos patches do patch-wiring.ps1: desliga o timing original do wiring.c
+# (nf_arduino_time.cpp assume), injeta os reportes GPIO e entrega o UART
+# ao nf_uart. Uso: patch-wiring.sh [diretorio do core neuroforge_qemu]
+
+set -e
+
+echo "========================================"
+echo "NeuroForge - Patch do core"
+echo "========================================"
+echo ""
+
+# 1. Encontrar o core neuroforge_qemu
+if [ -n "$1" ]; then
+    CORE_DIR="$1"
+else
+    ARDUINO_DATA="${ARDUINO_DIRECTORIES_DATA:-$HOME/.arduino15}"
+    AVR_BASE="$ARDUINO_DATA/packages/arduino/hardware/avr"
+    AVR_VERSION=$(ls -1 "$AVR_BASE" 2>/dev/null | sort -V | tail -1)
+    CORE_DIR="$AVR_BASE/$AVR_VERSION/cores/neuroforge_qemu"
+fi
+
+if [ ! -f "$CORE_DIR/wiring.c" ]; then
+    echo "❌ wiring.c não encontrado em: $CORE_DIR"
+    echo "💡 Execute install-core.sh primeiro!"
+    exit 1
+fi
+
+echo "✅ Core: $CORE_DIR"
+
+# patch_file <arquivo> <marcador> <descrição> <expressão perl>
+# Aplica a expressão (arquivo inteiro de uma vez) se o marcador ainda não
+# estiver lá; falha se depois dela o marcador continuar ausente, ou seja,
+# se o core Arduino instalado não tiver o trecho esperado.
+patch_file() {
+    local file="$CORE_DIR/$1" marker="$2" description="$3" expression="$4"
+
+    if [ ! -f "$file" ]; then
+        echo "❌ $1 não encontrado!"
+        exit 1
+    fi
+    if grep -qF -- "$marker" "$file"; then
+        echo "⚠️  $1 já possui: $description"
+        return
+    fi
+
+    [ -f "$file.backup" ] || cp "$file" "$file.backup"
+    perl -0777 -pi -e "$expression" "$file"
+
+    if ! grep -qF -- "$marker" "$file"; then
+        echo "❌ Patch não aplicado em $1: $description (trecho esperado não encontrado)"
+        exit 1
+    fi
+    echo "✅ $1: $description"
+}
+
+# 2. wiring.c: millis/micros/delay/delayMicroseconds passam para nf_arduino_time.cpp
+echo ""
+echo "⏱️  Patch no wiring.c..."
+
+patch_file wiring.c "NEUROFORGE_TIME_PATCHED" "marcador do patch" \
+    '$_ = "// NEUROFORGE_TIME_PATCHED - timing functions disabled\n#define NEUROFORGE_TIME_PATCHED\n\n" . $_'
+
+patch_file wiring.c "Original millis() disabled" "millis() original desligada" \
+    's/(unsigned long millis\(\)\s*\{.*?\n\})/#if 0 \/\/ NEUROFORGE_TIME: Original millis() disabled\n$1\n#endif/s'
+patch_file wiring.c "Original micros() disabled" "micros() original desligada" \
+    's/(unsigned long micros\(\)\s*\{.*?\n\})/#if 0 \/\/ NEUROFORGE_TIME: Original micros() disabled\n$1\n#endif/s'
+patch_file wiring.c "Original delay() disabled" "delay() original desligada" \
+    's/(void delay\(unsigned long ms\)\s*\{.*?\n\})/#if 0 \/\/ NEUROFORGE_TIME: Original delay() disabled\n$1\n#endif/s'
+patch_file wiring.c "Original delayMicroseconds() disabled" "delayMicroseconds() original desligada" \
+    's/(void delayMicroseconds\(unsigned int us\)\s*\{.*?\n\})/#if 0 \/\/ NEUROFORGE_TIME: Original delayMicroseconds() disabled\n$1\n#endif/s'
+
+# 3. wiring_digital.c: reporte de modo e nível, entradas do host
+echo ""
+echo "📍 Patch no wiring_digital.c..."
+
+patch_file wiring_digital.c "nf_report_mode" "reporte de pinMode()" \
+    's/#include "wiring_private.h"/#include "wiring_private.h"\n#include "nf_gpio.h"/;
+     s/(void pinMode\(uint8_t pin, uint8_t mode\)\s*\{.*?\n)(\})/$1\n\t\/\/ NeuroForge: Report mode change\n\tnf_report_mode(pin, mode);\n$2/s'
+
+patch_file wiring_digital.c "nf_report_gpio" "reporte de digitalWrite()" \
+    's/(void digitalWrite\(uint8_t pin, uint8_t val\)\s*\{.*?\n)(\})/$1\n\t\/\/ NeuroForge: Report GPIO change\n\tnf_report_gpio(pin, val);\n$2/s'
+
+# digitalRead() consulta primeiro os pinos dirigidos pelo host (NF_OP_INPUT, ver nf_input.cpp)
+patch_file wiring_digital.c "nf_input_read" "override de digitalRead()" \
+    's/#include "wiring_private.h"/#include "wiring_private.h"\n#include "nf_input.h"/;
+     s/(int digitalRead\(uint8_t pin\)\s*\{)/$1\n\t\/\/ NeuroForge: pino dirigido pelo host\n\tint8_t nf_level = nf_input_read(pin);\n\tif (nf_level >= 0) return nf_level;\n/'
+
+echo ""
+echo "📈 Patch no wiring_analog.c..."
+
+# wiring_analog.c: analogRead() lê primeiro os canais alimentados pelo host (NF_OP_ADC_*, ver nf_adc.cpp);
+# analogWrite() reporta o PWM como um frame de configuração (duty + frequência), não como bordas
+patch_file wiring_analog.c "nf_adc_read" "override de analogRead()" \
+    's/#include "wiring_private.h"/#include "wiring_private.h"\n#include "nf_adc.h"/;
+     s/(int analogRead\(uint8_t pin\)\s*\{)/$1\n\t\/\/ NeuroForge: canal alimentado pelo host\n\tint16_t nf_sample = nf_adc_read(pin);\n\tif (nf_sample >= 0) return nf_sample;\n/'
+
+patch_file wiring_analog.c "nf_report_pwm" "reporte PWM de analogWrite()" \
+    's/#include "wiring_private.h"/#include "wiring_private.h"\n#include "nf_gpio.h"/;
+     s/(void analogWrite\(uint8_t pin, int val\)\s*\{.*?\n)(\})/$1\n\t\/\/ NeuroForge: Report PWM configuration\n\tnf_report_pwm(pin, val);\n$2/s'
+
+# 4. HardwareSerial: o UART TX é compartilhado com o nf_uart, que é dono do vetor USART_UDRE
+echo ""
+echo "🔌 Patch no HardwareSerial..."
+
+# Fast path de write() só escreve direto em UDR0 sem frame NeuroForge em andamento;
+# com interrupções desabilitadas, write()/flush() esvaziam o buffer pelo nf_uart,
+# que termina o frame em andamento antes de liberar um byte do Serial
+patch_file HardwareSerial.cpp "nf_uart_tx_busy" "TX compartilhado com nf_uart" \
+    's/#include "HardwareSerial_private.h"/#include "HardwareSerial_private.h"\n#include "nf_uart.h"/;
+     s/bit_is_set\(\*_ucsra, UDRE0\)\) \{/bit_is_set(*_ucsra, UDRE0) && !nf_uart_tx_busy()) {/g;
+     s/_tx_udr_empty_irq\(\);/nf_uart_udre_service();/g'
+
+# O vetor passa a ser do nf_uart.cpp, que chama este handler quando o ring dele esvazia
+patch_file HardwareSerial0.cpp "nf_hwserial_udre_irq" "vetor UDRE entregue ao nf_uart" \
+    's/ISR\(USART_UDRE_vect\)/extern "C" void nf_hwserial_udre_irq(void)/;
+     s/Serial\._tx_udr_empty_irq\(\);/if (Serial.availableForWrite() < SERIAL_TX_BUFFER_SIZE - 1)\n    Serial._tx_udr_empty_irq();\n  else\n    cbi(UCSR0B, UDRIE0);/'
+
+# RX: frames do host (NF_OP_WAKE etc.) são consumidos antes do buffer do Serial
+patch_file HardwareSerial_private.h "nf_uart_rx_hook" "hook RX" \
+    's/#include "wiring_private.h"/#include "wiring_private.h"\n#include "nf_uart.h"/;
+     s/(\s+)unsigned char c = \*_udr;/$1unsigned char c = *_udr;$1if (nf_uart_rx_hook(c)) return;/'
+
+# 5. main.cpp: flush do batching GPIO ao fim de cada loop()
+echo ""
+echo "🔁 Patch no main.cpp..."
+
+patch_file main.cpp "nf_gpio_loop_hook" "hook de loop" \
+    's/#include <Arduino.h>/#include <Arduino.h>\n#include "nf_gpio.h"/;
+     s/(\s+)loop\(\);/$1loop();$1nf_gpio_loop_hook();/'
+
+echo ""
+echo "✅ Core patchado"
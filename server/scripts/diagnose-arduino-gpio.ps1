@@ -29,7 +29,7 @@ if (Test-Path $NF_CORE) {
     Write-Host "  [OK] Core instalado: $NF_CORE" -ForegroundColor Green
     
     # Verificar arquivos criticos
-    $files = @("nf_gpio.cpp", "nf_gpio.h", "nf_time.cpp", "nf_time.h", "nf_arduino_time.cpp")
+    $files = @("nf_gpio.cpp", "nf_gpio.h", "nf_proto.h", "nf_uart.h", "nf_uart.cpp", "nf_time.cpp", "nf_time.h", "nf_arduino_time.cpp")
     foreach ($file in $files) {
         if (Test-Path "$NF_CORE\$file") {
             Write-Host "  [OK] $file" -ForegroundColor Green
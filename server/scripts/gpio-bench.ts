@@ -0,0 +1,362 @@
+/**
+ * GPIO pipeline benchmark
+ *
+ * Compiles the sketches in test-firmware/bench/, runs each one headless and
+ * measures the path digitalWrite -> UART frame -> QEMURunner -> SerialGPIOParser
+ * -> QEMUSimulationEngine -> PinChangeBatcher (the 'pinBatch' socket message).
+ *
+ * Latency is measured with a probe every sketch runs: the driver flips an
+ * input pin (NF_OP_INPUT), the sketch mirrors it on an output pin, and the
+ * time until that level leaves the batcher is one sample. It includes the
+ * host->firmware input frame, so it is an upper bound of digitalWrite->socket.
+ *
+ * Usage (from server/):
+ *   npm run bench:gpio -- [--boards arduino-uno,esp32-devkit] [--sketches toggle_storm,...]
+ *                         [--duration 10] [--run-mode realtime|max] [--reporting edge|loop]
+ *                         [--out results.json] [--baseline old.json] [--threshold 20]
+ */
+
+import * as fs from 'fs';
+import * as path from 'path';
+import * as os from 'os';
+import { execSync } from 'child_process';
+import { CompilerService } from '../src/services/CompilerService';
+import type { BoardType, GPIOReporting } from '../src/services/CompilerService';
+import { QEMUSimulationEngine } from '../src/services/QEMUSimulationEngine';
+import { PinChangeBatcher } from '../src/services/PinChangeBatcher';
+import type { PinBatchMessage } from '../src/services/PinChangeBatcher';
+import type { Esp32BackendConfig } from '../src/types/esp32.types';
+import type { RunMode } from '../src/types/simulation.types';
+
+const SKETCH_DIR = path.join(__dirname, '..', 'test-firmware', 'bench');
+const SKETCHES = ['toggle_storm', 'serial_flood', 'mixed_traffic', 'mode_churn'];
+
+/** Probe pins, must match the sketches */
+const PROBE_PINS: Record<'avr' | 'esp32', { in: number; out: number }> = {
+  avr: { in: 2, out: 12 },
+  esp32: { in: 4, out: 5 }
+};
+
+const WARMUP_MS = 1000;
+const PROBE_TIMEOUT_MS = 1000;
+const PROBE_GAP_MS = 10;
+
+/** Metrics compared against a baseline, and whether higher is better */
+const COMPARED_METRICS: Record<string, boolean> = {
+  eventsPerSec: true,
+  batchesPerSec: true,
+  serialLinesPerSec: true,
+  latencyP50Ms: false,
+  latencyP99Ms: false,
+  timeToFirstEventMs: false
+};
+
+interface BenchOptions {
+  boards: BoardType[];
+  sketches: string[];
+  durationMs: number;
+  runMode: RunMode;
+  reporting: GPIOReporting;
+  out: string;
+  baseline?: string;
+  threshold: number;
+}
+
+interface BenchResult {
+  sketch: string;
+  board: BoardType;
+  compileMs: number;
+  compileCached: boolean;
+  timeToFirstEventMs: number | null;
+  durationMs: number;
+  events: number;
+  eventsPerSec: number;
+  batches: number;
+  batchesPerSec: number;
+  batchEntries: number;
+  coalesced: number; // pin-change events folded by the batcher
+  firmwareDropped: number; // reports coalesced by the firmware TX ring (DROPS)
+  serialLines: number;
+  serialLinesPerSec: number;
+  probes: number;
+  probesLost: number;
+  latencyP50Ms: number | null;
+  latencyP99Ms: number | null;
+  latencyMaxMs: number | null;
+  virtualTimeMs: number;
+  error?: string;
+}
+
+function parseArgs(argv: string[]): BenchOptions {
+  const args = new Map<string, string>();
+  for (let i = 0; i < argv.length; i++) {
+    if (argv[i].startsWith('--')) {
+      args.set(argv[i].slice(2), argv[i + 1] ?? '');
+      i++;
+    }
+  }
+
+  const runMode = args.get('run-mode') ?? 'realtime';
+  if (runMode !== 'realtime' && runMode !== 'max') {
+    throw new Error(`--run-mode must be realtime or max (got '${runMode}')`);
+  }
+
+  const sketches = (args.get('sketches') ?? SKETCHES.join(',')).split(',');
+  for (const sketch of sketches) {
+    if (!SKETCHES.includes(sketch)) {
+      throw new Error(`Unknown sketch '${sketch}' (expected ${SKETCHES.join(', ')})`);
+    }
+  }
+
+  return {
+    boards: (args.get('boards') ?? 'arduino-uno').split(',') as BoardType[],
+    sketches,
+    durationMs: Number(args.get('duration') ?? 10) * 1000,
+    runMode: { mode: runMode },
+    reporting: (args.get('reporting') ?? 'edge') as GPIOReporting,
+    out: args.get('out') ?? path.join(__dirname, '..', 'bench-results', `gpio-${new Date().toISOString().replace(/[:.]/g, '-')}.json`),
+    baseline: args.get('baseline'),
+    threshold: Number(args.get('threshold') ?? 20)
+  };
+}
+
+function percentile(sorted: number[], p: number): number | null {
+  if (sorted.length === 0) return null;
+  const index = Math.min(sorted.length - 1, Math.ceil((p / 100) * sorted.length) - 1);
+  return Math.round(sorted[Math.max(0, index)] * 1000) / 1000;
+}
+
+function sleep(ms: number): Promise<void> {
+  return new Promise(resolve => setTimeout(resolve, ms));
+}
+
+function isEsp32(board: BoardType): boolean {
+  return board === 'esp32' || board.includes('esp32');
+}
+
+function gitCommit(): string | null {
+  try {
+    return execSync('git rev-parse --short HEAD', { stdio: ['ignore', 'pipe', 'ignore'] }).toString().trim();
+  } catch {
+    return null;
+  }
+}
+
+async function runOne(
+  compiler: CompilerService,
+  sketch: string,
+  board: BoardType,
+  options: BenchOptions
+): Promise<BenchResult> {
+  const result: BenchResult = {
+    sketch, board, compileMs: 0, compileCached: false, timeToFirstEventMs: null,
+    durationMs: options.durationMs, events: 0, eventsPerSec: 0, batches: 0, batchesPerSec: 0,
+    batchEntries: 0, coalesced: 0, firmwareDropped: 0, serialLines: 0, serialLinesPerSec: 0,
+    probes: 0, probesLost: 0, latencyP50Ms: null, latencyP99Ms: null, latencyMaxMs: null,
+    virtualTimeMs: 0
+  };
+
+  // 1. Compile
+  const code = fs.readFileSync(path.join(SKETCH_DIR, sketch, `${sketch}.ino`), 'utf-8');
+  const compileStart = performance.now();
+  const compiled = await compiler.compile(code, board, 'qemu', { gpioReporting: options.reporting });
+  result.compileMs = Math.round(performance.now() - compileStart);
+  result.compileCached = compiled.cached ?? false;
+  if (!compiled.success) {
+    result.error = `Compile failed: ${compiled.error}`;
+    return result;
+  }
+
+  // 2. Engine + the same delivery stage as the websocket (acked at once: a fast client)
+  const engine = new QEMUSimulationEngine();
+  const probe = PROBE_PINS[isEsp32(board) ? 'esp32' : 'avr'];
+  let measuring = false;
+  let events = 0;
+  let pinChanges = 0;
+  let serialLines = 0;
+  let batches = 0;
+  let batchEntries = 0;
+  let firstEventAt: number | null = null;
+  let probeWaiter: { level: number; resolve: () => void } | null = null;
+
+  const batcher = new PinChangeBatcher((message: PinBatchMessage, onAck) => {
+    onAck();
+    if (measuring) {
+      batches++;
+      batchEntries += message.pins.length + (message.modes?.length ?? 0) + (message.pwm?.length ?? 0);
+    }
+    if (probeWaiter && message.pins.some(([pin, value]) => pin === probe.out && value === probeWaiter!.level)) {
+      probeWaiter.resolve();
+    }
+  });
+
+  engine.on('pin-change', (pin: number, state) => {
+    if (firstEventAt === null) firstEventAt = performance.now();
+    if (measuring) {
+      events++;
+      if (pin !== probe.in) pinChanges++; // Host-side input echo is not a firmware event
+    }
+    batcher.push(pin, state);
+  });
+  engine.on('serial', () => {
+    if (measuring) serialLines++;
+  });
+
+  try {
+    await engine.loadFirmware(compiled.firmwarePath!, board);
+    batcher.start();
+
+    const startAt = performance.now();
+    if (isEsp32(board)) {
+      const esp32Config: Esp32BackendConfig = {
+        flash: {
+          flashImagePath: compiled.firmwarePath!,
+          efuseImagePath: compiled.efusePath ?? path.join(path.dirname(compiled.firmwarePath!), 'qemu_efuse.bin')
+        },
+        qemuOptions: {
+          memory: process.env.ESP32_DEFAULT_MEMORY || '4M',
+          networkMode: 'none',
+          wdtDisable: true
+        }
+      };
+      await engine.start(esp32Config, { mode: 'realtime' });
+    } else {
+      await engine.start(undefined, options.runMode);
+    }
+
+    await sleep(WARMUP_MS);
+    if (firstEventAt !== null) {
+      result.timeToFirstEventMs = Math.round(firstEventAt - startAt);
+    }
+
+    // 3. Measure: throughput counters run while the probe loop samples latency
+    const droppedBefore = engine.getGPIOStats().dropped;
+    const latencies: number[] = [];
+    let level = 0;
+    measuring = true;
+    const measureStart = performance.now();
+
+    while (performance.now() - measureStart < options.durationMs) {
+      level ^= 1;
+      const sentAt = performance.now();
+      const echoed = new Promise<boolean>(resolve => {
+        probeWaiter = { level, resolve: () => resolve(true) };
+        setTimeout(() => resolve(false), PROBE_TIMEOUT_MS);
+      });
+      await engine.setPinState(probe.in, level);
+
+      result.probes++;
+      if (await echoed) {
+        latencies.push(performance.now() - sentAt);
+      } else {
+        result.probesLost++;
+      }
+      probeWaiter = null;
+      await sleep(PROBE_GAP_MS);
+    }
+
+    measuring = false;
+    const elapsedSec = (performance.now() - measureStart) / 1000;
+    latencies.sort((a, b) => a - b);
+
+    result.durationMs = Math.round(elapsedSec * 1000);
+    result.events = events;
+    result.eventsPerSec = Math.round(events / elapsedSec);
+    result.batches = batches;
+    result.batchesPerSec = Math.round(batches / elapsedSec);
+    result.batchEntries = batchEntries;
+    result.coalesced = Math.max(0, pinChanges - batchEntries);
+    result.firmwareDropped = engine.getGPIOStats().dropped - droppedBefore;
+    result.serialLines = serialLines;
+    result.serialLinesPerSec = Math.round(serialLines / elapsedSec);
+    result.latencyP50Ms = percentile(latencies, 50);
+    result.latencyP99Ms = percentile(latencies, 99);
+    result.latencyMaxMs = percentile(latencies, 100);
+    result.virtualTimeMs = engine.getVirtualTime();
+  } catch (error) {
+    result.error = error instanceof Error ? error.message : String(error);
+  } finally {
+    batcher.stop();
+    engine.stop();
+    engine.removeAllListeners();
+  }
+
+  return result;
+}
+
+/**
+ * Print metric deltas against a previous results file; true if any
+ * metric regressed more than threshold %
+ */
+function compareWithBaseline(results: BenchResult[], baselineFile: string, threshold: number): boolean {
+  const baseline: { commit: string | null; results: BenchResult[] } = JSON.parse(fs.readFileSync(baselineFile, 'utf-8'));
+  let regressed = false;
+
+  console.log(`\n📊 Compared with ${path.basename(baselineFile)} (${baseline.commit ?? 'unknown commit'}):`);
+  for (const result of results) {
+    const before = baseline.results.find(r => r.sketch === result.sketch && r.board === result.board);
+    if (!before || result.error || before.error) continue;
+
+    for (const [metric, higherIsBetter] of Object.entries(COMPARED_METRICS)) {
+      const a = (before as any)[metric] as number | null;
+      const b = (result as any)[metric] as number | null;
+      if (a === null || b === null || a === 0) continue;
+
+      const change = ((b - a) / a) * 100;
+      const worse = higherIsBetter ? -change : change;
+      const flag = worse > threshold ? '❌' : worse < -threshold ? '✅' : '  ';
+      if (worse > threshold) regressed = true;
+      console.log(`${flag} ${result.board}/${result.sketch} ${metric}: ${a} -> ${b} (${change >= 0 ? '+' : ''}${change.toFixed(1)}%)`);
+    }
+  }
+
+  return regressed;
+}
+
+async function main() {
+  const options = parseArgs(process.argv.slice(2));
+  const compiler = new CompilerService();
+  const results: BenchResult[] = [];
+
+  console.log(`🏁 GPIO benchmark: ${options.sketches.join(', ')} on ${options.boards.join(', ')} (${options.durationMs / 1000}s each)`);
+
+  for (const board of options.boards) {
+    for (const sketch of options.sketches) {
+      console.log(`\n▶️  ${board}/${sketch}`);
+      const result = await runOne(compiler, sketch, board, options);
+      results.push(result);
+
+      if (result.error) {
+        console.error(`❌ ${result.error}`);
+      } else {
+        console.log(
+          `   ${result.eventsPerSec} events/s, ${result.batchesPerSec} batches/s, ${result.serialLinesPerSec} lines/s, ` +
+          `p50 ${result.latencyP50Ms} ms, p99 ${result.latencyP99Ms} ms, ` +
+          `dropped ${result.firmwareDropped}, coalesced ${result.coalesced}, ` +
+          `first event ${result.timeToFirstEventMs} ms, compile ${result.compileMs} ms${result.compileCached ? ' (cached)' : ''}`
+        );
+      }
+    }
+  }
+
+  const report = {
+    commit: gitCommit(),
+    date: new Date().toISOString(),
+    host: { platform: process.platform, arch: process.arch, cpus: os.cpus().length, node: process.version },
+    options: { ...options, out: undefined, baseline: undefined },
+    results
+  };
+
+  fs.mkdirSync(path.dirname(options.out), { recursive: true });
+  fs.writeFileSync(options.out, JSON.stringify(report, null, 2));
+  console.log(`\n💾 Results written to ${options.out}`);
+
+  const regressed = options.baseline ? compareWithBaseline(results, options.baseline, options.threshold) : false;
+  const failed = results.some(result => result.error);
+  process.exit(failed || regressed ? 1 : 0);
+}
+
+main().catch(error => {
+  console.error('❌ Benchmark failed:', error);
+  process.exit(1);
+});
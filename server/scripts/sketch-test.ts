@@ -0,0 +1,175 @@
+/**
+ * Headless sketch test runner
+ *
+ * Compiles every sketch of a suite, runs them in parallel (one QEMU instance
+ * each, see SketchTestRunner) and checks serial output and pin waveforms.
+ * Exits with code 1 if any case fails or errors.
+ *
+ * Suite file (JSON); top-level fields other than cases/sketches are defaults
+ * for every case, paths are relative to the suite file:
+ *   {
+ *     "board": "arduino-uno", "durationMs": 3000,
+ *     "expectations": [{ "type": "period", "pin": 13, "periodMs": 1000 }],
+ *     "sketches": "submissions/",            // every .ino below it is a case
+ *     "cases": [{ "name": "blink", "sketch": "blink.ino", "inputs": [...] }]
+ *   }
+ *
+ * Usage (from server/):
+ *   npm run test:sketches -- suite.json [--concurrency 8] [--only name,...] [--out report.json]
+ */
+
+import * as fs from 'fs';
+import * as path from 'path';
+import * as os from 'os';
+import { execSync } from 'child_process';
+import { CompilerService } from '../src/services/CompilerService';
+import { SketchTestRunner, parseSketchTestCases } from '../src/services/SketchTestRunner';
+import type { SketchTestResult } from '../src/services/SketchTestRunner';
+
+interface CliOptions {
+  suite: string;
+  concurrency?: number;
+  only?: string[];
+  out?: string;
+}
+
+function parseArgs(argv: string[]): CliOptions {
+  const args = new Map<string, string>();
+  const positional: string[] = [];
+  for (let i = 0; i < argv.length; i++) {
+    if (argv[i].startsWith('--')) {
+      args.set(argv[i].slice(2), argv[i + 1] ?? '');
+      i++;
+    } else {
+      positional.push(argv[i]);
+    }
+  }
+
+  if (positional.length !== 1) {
+    throw new Error('Usage: sketch-test <suite.json> [--concurrency N] [--only name,...] [--out report.json]');
+  }
+
+  const concurrency = args.has('concurrency') ? parseInt(args.get('concurrency')!, 10) : undefined;
+  if (concurrency !== undefined && !(concurrency > 0)) {
+    throw new Error('--concurrency must be a positive integer');
+  }
+
+  return {
+    suite: path.resolve(positional[0]),
+    concurrency,
+    only: args.get('only')?.split(','),
+    out: args.get('out')
+  };
+}
+
+/**
+ * .ino files below dir (sketch folders or loose files), sorted
+ */
+function findSketches(dir: string): string[] {
+  const found: string[] = [];
+  for (const entry of fs.readdirSync(dir, { withFileTypes: true })) {
+    const full = path.join(dir, entry.name);
+    if (entry.isDirectory()) {
+      found.push(...findSketches(full));
+    } else if (entry.name.endsWith('.ino')) {
+      found.push(full);
+    }
+  }
+  return found.sort();
+}
+
+/**
+ * Suite file -> API-shaped body ({ ...defaults, cases }) with the code inlined
+ */
+function loadSuite(file: string): any {
+  const { sketches, cases = [], ...defaults } = JSON.parse(fs.readFileSync(file, 'utf-8'));
+  const baseDir = path.dirname(file);
+  const all: any[] = [];
+
+  if (sketches) {
+    const dir = path.resolve(baseDir, sketches);
+    for (const sketch of findSketches(dir)) {
+      const relative = path.relative(dir, sketch).replace(/\.ino$/, '');
+      // Arduino layout (name/name.ino): the folder is the name
+      const name = path.basename(path.dirname(relative)) === path.basename(relative) ? path.dirname(relative) : relative;
+      all.push({ name, code: fs.readFileSync(sketch, 'utf-8') });
+    }
+  }
+
+  for (const testCase of cases) {
+    const { sketch, ...rest } = testCase;
+    all.push(sketch
+      ? { name: path.basename(sketch, '.ino'), ...rest, code: fs.readFileSync(path.resolve(baseDir, sketch), 'utf-8') }
+      : rest);
+  }
+
+  return { ...defaults, cases: all };
+}
+
+function gitCommit(): string | null {
+  try {
+    return execSync('git rev-parse --short HEAD', { stdio: ['ignore', 'pipe', 'ignore'] }).toString().trim();
+  } catch {
+    return null;
+  }
+}
+
+function printResult(result: SketchTestResult, completed: number, total: number): void {
+  const icon = result.status === 'passed' ? '✅' : result.status === 'failed' ? '❌' : '💥';
+  const compile = `compile ${(result.compileMs / 1000).toFixed(1)}s${result.compileCached ? ' (cached)' : ''}`;
+  console.log(`${icon} [${completed}/${total}] ${result.name} (${compile}, run ${(result.runMs / 1000).toFixed(1)}s, ${result.simulatedMs} ms simulated)`);
+  if (result.error) {
+    console.log(`     ${result.error.split('\n')[0]}`);
+  }
+  for (const check of result.expectations) {
+    if (!check.passed) console.log(`     ✗ ${check.message}`);
+  }
+}
+
+async function main() {
+  const options = parseArgs(process.argv.slice(2));
+  const body = loadSuite(options.suite);
+  if (options.only) {
+    body.cases = body.cases.filter((testCase: any) => options.only!.includes(testCase.name));
+  }
+  const cases = parseSketchTestCases(body);
+
+  const runner = new SketchTestRunner(new CompilerService(), { concurrency: options.concurrency });
+  const { concurrency } = runner.getStats();
+  console.log(`🧪 ${cases.length} sketch(es) from ${path.basename(options.suite)}, ${concurrency} at a time`);
+
+  const startedAt = performance.now();
+  let completed = 0;
+  const results = await runner.run(cases, result => printResult(result, ++completed, cases.length));
+  const durationMs = Math.round(performance.now() - startedAt);
+
+  const passed = results.filter(result => result.status === 'passed').length;
+  const failed = results.filter(result => result.status === 'failed').length;
+  const errors = results.length - passed - failed;
+  console.log(`\n📊 ${passed} passed, ${failed} failed, ${errors} errors in ${(durationMs / 1000).toFixed(1)}s`);
+
+  if (options.out) {
+    const report = {
+      commit: gitCommit(),
+      date: new Date().toISOString(),
+      suite: options.suite,
+      host: { platform: process.platform, arch: process.arch, cpus: os.cpus().length, node: process.version },
+      concurrency,
+      durationMs,
+      passed,
+      failed,
+      errors,
+      results
+    };
+    fs.mkdirSync(path.dirname(path.resolve(options.out)), { recursive: true });
+    fs.writeFileSync(options.out, JSON.stringify(report, null, 2));
+    console.log(`💾 Report written to ${options.out}`);
+  }
+
+  process.exit(passed === results.length ? 0 : 1);
+}
+
+main().catch(error => {
+  console.error('❌ Sketch tests failed:', error instanceof Error ? error.message : error);
+  process.exit(1);
+});
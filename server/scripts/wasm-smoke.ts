@@ -0,0 +1,227 @@
+/**
+ * WebAssembly toolchain smoke test
+ *
+ * Builds a Blink and a delay()/Serial sketch through CompilerService in 'wasm'
+ * mode (wasi-sdk clang + wasm-opt --asyncify), checks the module against the
+ * imports/exports src/engine/wasm/sketch.worker.ts relies on, then runs it
+ * headless with the worker's Asyncify protocol (unwind in nf.yield_until,
+ * rewind to resume) for a few virtual seconds and checks pins and Serial.
+ *
+ * Usage (from server/, with WASI_SDK_PATH / WASM_OPT set as for the server):
+ *   npm run test:wasm -- [--duration 3000]
+ */
+
+import * as fs from 'fs';
+import { CompilerService } from '../src/services/CompilerService';
+
+/** What the worker instantiates and calls */
+const NF_IMPORTS = ['gpio', 'mode', 'pwm', 'tone', 'serial_write', 'yield_until'];
+const REQUIRED_EXPORTS = [
+  'memory', 'nf_main', 'nf_now', 'nf_set_slice_end', 'nf_asyncify_data', 'nf_set_input', 'nf_set_analog',
+  'nf_serial_rx', 'asyncify_start_unwind', 'asyncify_stop_unwind', 'asyncify_start_rewind',
+  'asyncify_stop_rewind', 'asyncify_get_state'
+];
+
+const ASYNCIFY_UNWINDING = 1;
+const SLICE_US = 100_000;
+
+interface SmokeCase {
+  name: string;
+  code: string;
+  check: (run: SmokeRun) => string | null; // Error, or null if it passed
+}
+
+interface SmokeRun {
+  gpio: { pin: number; value: number; timeUs: number }[];
+  serial: string;
+  steps: number;
+}
+
+const CASES: SmokeCase[] = [
+  {
+    name: 'blink',
+    code: `void setup() {
+  pinMode(LED_BUILTIN, OUTPUT);
+}
+
+void loop() {
+  digitalWrite(LED_BUILTIN, HIGH);
+  delay(1000);
+  digitalWrite(LED_BUILTIN, LOW);
+  delay(1000);
+}
+`,
+    check: run => {
+      const edges = run.gpio.filter(event => event.pin === 13);
+      if (edges.length < 3) return `expected 3+ writes on pin 13, got ${edges.length}`;
+      const gaps = edges.slice(1).map((event, i) => event.timeUs - edges[i].timeUs);
+      // delay() jumps straight to its deadline; only polling calls add µs
+      return gaps.every(gap => Math.abs(gap - 1_000_000) <= 1000) ? null : `pin 13 gaps ${gaps.join(', ')} µs, expected 1000000`;
+    }
+  },
+  {
+    name: 'delay-serial',
+    // Unindented member function: must not get a top-level prototype
+    code: `class Counter {
+public:
+int next() { return ++count; }
+private:
+int count = 0;
+};
+
+Counter counter;
+
+void setup() {
+  Serial.begin(9600);
+  report(0);
+}
+
+void loop() {
+  delay(500);
+  report(counter.next());
+}
+
+void report(int n) {
+  Serial.print("tick ");
+  Serial.println(n);
+}
+`,
+    check: run => {
+      const lines = run.serial.split(/\r?\n/).filter(Boolean);
+      const expected = ['tick 0', 'tick 1', 'tick 2', 'tick 3', 'tick 4'];
+      return expected.every((line, i) => lines[i] === line) ? null : `serial was ${JSON.stringify(lines.slice(0, 6))}`;
+    }
+  }
+];
+
+function parseDuration(argv: string[]): number {
+  const index = argv.indexOf('--duration');
+  return index >= 0 ? Number(argv[index + 1]) : 3000;
+}
+
+function checkInterface(module: WebAssembly.Module): string[] {
+  const problems: string[] = [];
+  for (const entry of WebAssembly.Module.imports(module)) {
+    if (entry.module === 'nf' && !NF_IMPORTS.includes(entry.name)) problems.push(`unknown import nf.${entry.name}`);
+    if (entry.module !== 'nf' && entry.module !== 'wasi_snapshot_preview1') {
+      problems.push(`import from unexpected module ${entry.module}.${entry.name}`);
+    }
+  }
+  const exported = new Set(WebAssembly.Module.exports(module).map(entry => entry.name));
+  for (const name of REQUIRED_EXPORTS) {
+    if (!exported.has(name)) problems.push(`missing export ${name}`);
+  }
+  return problems;
+}
+
+/**
+ * The worker's step loop without wall-clock pacing: slices of SLICE_US
+ */
+async function runHeadless(module: WebAssembly.Module, durationUs: number): Promise<SmokeRun> {
+  const run: SmokeRun = { gpio: [], serial: '', steps: 0 };
+  const decoder = new TextDecoder();
+  let exports: any;
+  let asyncData = 0;
+  let stackStart = 0;
+  let rewinding = false;
+  let resumeAt = 0;
+  let wakeAt = 0;
+
+  const view32 = () => new Int32Array(exports.memory.buffer);
+  const bytes = (ptr: number, length: number) => new Uint8Array(exports.memory.buffer, ptr, length);
+
+  const instance = await WebAssembly.instantiate(module, {
+    nf: {
+      gpio: (pin: number, value: number) => run.gpio.push({ pin, value, timeUs: exports.nf_now() }),
+      mode: () => undefined,
+      pwm: () => undefined,
+      tone: () => undefined,
+      serial_write: (ptr: number, length: number) => {
+        run.serial += decoder.decode(bytes(ptr, length), { stream: true });
+      },
+      yield_until: (deadline: number) => {
+        if (rewinding) {
+          exports.asyncify_stop_rewind();
+          rewinding = false;
+          return resumeAt;
+        }
+        wakeAt = deadline;
+        view32()[asyncData >> 2] = stackStart;
+        exports.asyncify_start_unwind(asyncData);
+        return 0;
+      }
+    },
+    wasi_snapshot_preview1: new Proxy({}, { get: () => () => 52 }) // ENOSYS
+  });
+
+  exports = instance.exports;
+  exports._initialize?.();
+  asyncData = exports.nf_asyncify_data();
+  stackStart = view32()[asyncData >> 2];
+
+  let suspended = false;
+  let target = 0;
+  while (target < durationUs) {
+    target += SLICE_US;
+    exports.nf_set_slice_end(target);
+    resumeAt = Math.min(target, wakeAt);
+    if (suspended && wakeAt > target) continue; // Still asleep in this slice
+
+    if (suspended) {
+      exports.asyncify_start_rewind(asyncData);
+      rewinding = true;
+    }
+    exports.nf_main();
+    if (exports.asyncify_get_state() !== ASYNCIFY_UNWINDING) throw new Error('Sketch returned from nf_main');
+    exports.asyncify_stop_unwind();
+    suspended = true;
+    run.steps++;
+  }
+
+  return run;
+}
+
+async function main(): Promise<void> {
+  const durationUs = parseDuration(process.argv.slice(2)) * 1000;
+  const compiler = new CompilerService();
+  let failed = 0;
+
+  for (const smoke of CASES) {
+    const compiled = await compiler.compile(smoke.code, 'arduino-uno', 'wasm');
+    if (!compiled.success || !compiled.firmwarePath) {
+      console.error(`❌ ${smoke.name}: build failed\n${compiled.error ?? ''}\n${compiled.stderr ?? ''}`);
+      failed++;
+      continue;
+    }
+
+    const wasm = fs.readFileSync(compiled.firmwarePath);
+    const module = await WebAssembly.compile(wasm);
+    const problems = checkInterface(module);
+    if (problems.length > 0) {
+      console.error(`❌ ${smoke.name}: ${problems.join('; ')}`);
+      failed++;
+      continue;
+    }
+
+    try {
+      const run = await runHeadless(module, durationUs);
+      const error = smoke.check(run);
+      if (error) {
+        console.error(`❌ ${smoke.name}: ${error}`);
+        failed++;
+      } else {
+        console.log(`✅ ${smoke.name}: ${wasm.length} bytes, ${run.steps} resumes, ${run.gpio.length} pin writes`);
+      }
+    } catch (error) {
+      console.error(`❌ ${smoke.name}: ${error instanceof Error ? error.message : String(error)}`);
+      failed++;
+    }
+  }
+
+  process.exit(failed > 0 ? 1 : 0);
+}
+
+main().catch(error => {
+  console.error(error);
+  process.exit(1);
+});
@@ -1,21 +1,92 @@
-import { Router, Request, Response } from 'express';
-import { CompilerService, SimulationMode } from '../services/CompilerService';
+import { Router, Request, Response, NextFunction } from 'express';
+import * as fs from 'fs';
+import { CompilerService, SimulationMode, GPIOReporting } from '../services/CompilerService';
 import { QEMUSimulationEngine } from '../services/QEMUSimulationEngine';
+import { SessionManager, SessionCapacityError, Session } from '../services/SessionManager';
+import { QEMUInstancePool } from '../services/QEMUInstancePool';
 import { BoardType } from '../services/CompilerService';
 import type { Esp32BackendConfig } from '../types/esp32.types';
+import type { RunMode, GpioCaptureMode } from '../types/simulation.types';
+import { parseAnalogSource } from '../services/AnalogInput';
+import type { AnalogSource } from '../services/AnalogInput';
+import { parseGpioPolicy } from '../services/GpioPolicy';
+import type { GpioPolicy } from '../services/GpioPolicy';
+import type { PinTraceRecorder } from '../services/PinTraceRecorder';
+import { metrics } from '../services/Metrics';
+import { SketchTestRunner, parseSketchTestCases } from '../services/SketchTestRunner';
 
 const router = Router();
 const compiler = new CompilerService();
-const engine = new QEMUSimulationEngine();
+const qemuPool = new QEMUInstancePool();
+const sessions = new SessionManager({ pool: qemuPool });
+compiler.trackFirmwareUsers(() => sessions.firmwarePaths()); // Loaded firmware survives cache cleanup
+const testRunner = new SketchTestRunner(compiler, { pool: qemuPool });
+
+/** Session behind the legacy unscoped /api/simulate routes and websockets without a sessionId */
+const DEFAULT_SESSION_ID = 'default';
+
+/**
+ * Session-scoped simulation routes, mounted at:
+ * - /api/sessions/:sessionId/simulate
+ * - /api/simulate (default session, single-user clients)
+ */
+const simulateRouter = Router({ mergeParams: true });
+
+/**
+ * Resolve the session of the request into res.locals.session
+ */
+function resolveSession(req: Request, res: Response, next: NextFunction) {
+  try {
+    const id = req.params.sessionId;
+    const session = id ? sessions.get(id) : sessions.getOrCreate(DEFAULT_SESSION_ID);
+
+    if (!session) {
+      return res.status(404).json({
+        success: false,
+        error: `Session not found: ${id}`
+      });
+    }
+
+    res.locals.session = session;
+    next();
+  } catch (error) {
+    sendCapacityError(res, error);
+  }
+}
+
+function sessionEngine(res: Response): QEMUSimulationEngine {
+  return (res.locals.session as Session).engine;
+}
+
+/**
+ * 503 + Retry-After for capacity errors, 500 otherwise
+ */
+function sendCapacityError(res: Response, error: unknown) {
+  if (error instanceof SessionCapacityError) {
+    res.set('Retry-After', '30');
+    return res.status(503).json({
+      success: false,
+      error: error.message
+    });
+  }
+
+  console.error('Session error:', error);
+  res.status(500).json({
+    success: false,
+    error: error instanceof Error ? error.message : 'Session error'
+  });
+}
 
 /**
  * POST /api/compile
  * Compile Arduino code to firmware
- * Body: { code: string, board?: BoardType, mode?: SimulationMode }
+ * Body: { code: string, board?: BoardType, mode?: SimulationMode, gpioReporting?: GPIOReporting, clientId?: string }
+ * clientId: socket id that receives 'compileQueue' events while the compile waits for a worker
+ * mode 'wasm': the response also carries the module itself (wasm, base64) for the browser runtime
  */
 router.post('/compile', async (req: Request, res: Response) => {
   try {
-    const { code, board, mode } = req.body;
+    const { code, board, mode, gpioReporting, clientId } = req.body;
 
     if (!code) {
       return res.status(400).json({
@@ -28,14 +99,19 @@ router.post('/compile', async (req: Request, res: Response) => {
     const simulationMode = (mode as SimulationMode) || 'interpreter';
     
     console.log(`📝 Compiling for board: ${boardType}, mode: ${simulationMode}`);
-    const result = await compiler.compile(code, boardType, simulationMode);
+    const result = await compiler.compile(code, boardType, simulationMode, {
+      gpioReporting: gpioReporting as GPIOReporting | undefined,
+      clientId: typeof clientId === 'string' ? clientId : undefined
+    });
 
     if (result.success) {
       res.json({
         success: true,
         firmwarePath: result.firmwarePath,
         efusePath: result.efusePath,
-        stdout: result.stdout
+        stdout: result.stdout,
+        cached: result.cached,
+        ...(simulationMode === 'wasm' && { wasm: fs.readFileSync(result.firmwarePath!).toString('base64') })
       });
     } else {
       res.status(400).json({
@@ -54,12 +130,24 @@ router.post('/compile', async (req: Request, res: Response) => {
 });
 
 /**
- * POST /api/simulate/start
+ * GET /api/compile/queue
+ * Compile worker pool occupancy
+ */
+router.get('/compile/queue', (req: Request, res: Response) => {
+  res.json({
+    success: true,
+    ...compiler.getQueueStats()
+  });
+});
+
+/**
+ * POST /api/sessions/:sessionId/simulate/start
  * Start QEMU simulation with firmware
  */
-router.post('/simulate/start', async (req: Request, res: Response) => {
+simulateRouter.post('/start', async (req: Request, res: Response) => {
   try {
-    const { firmwarePath, efusePath, board } = req.body;
+    const engine = sessionEngine(res);
+    const { firmwarePath, efusePath, board, runMode = 'realtime', speed, gpioCapture, gpioSampleUs, gpioPolicy, trace } = req.body;
 
     if (!firmwarePath) {
       return res.status(400).json({
@@ -68,7 +156,70 @@ router.post('/simulate/start', async (req: Request, res: Response) => {
       });
     }
 
+    if (!['realtime', 'scaled', 'max'].includes(runMode)) {
+      return res.status(400).json({
+        success: false,
+        error: `Invalid runMode '${runMode}' (expected realtime, scaled or max)`
+      });
+    }
+
+    if (runMode === 'scaled' && !(typeof speed === 'number' && speed > 0)) {
+      return res.status(400).json({
+        success: false,
+        error: 'speed must be a positive number for runMode scaled'
+      });
+    }
+
     const boardType = (board as BoardType) || 'arduino-uno';
+    const isEsp32 = boardType === 'esp32' || boardType.includes('esp32');
+
+    const captureModes = isEsp32 ? ['serial', 'sampled'] : ['serial', 'gdb'];
+    if (gpioCapture !== undefined && !captureModes.includes(gpioCapture)) {
+      return res.status(400).json({
+        success: false,
+        error: `Invalid gpioCapture '${gpioCapture}' for ${boardType} (expected ${captureModes.join(' or ')})`
+      });
+    }
+
+    if (gpioSampleUs !== undefined && !(typeof gpioSampleUs === 'number' && gpioSampleUs >= 50)) {
+      return res.status(400).json({
+        success: false,
+        error: 'gpioSampleUs must be a number >= 50 (µs)'
+      });
+    }
+
+    let policy: GpioPolicy | undefined;
+    if (gpioPolicy !== undefined) {
+      if (isEsp32) {
+        return res.status(400).json({
+          success: false,
+          error: 'gpioPolicy is only supported on AVR boards'
+        });
+      }
+      try {
+        policy = parseGpioPolicy(gpioPolicy);
+      } catch (error: any) {
+        return res.status(400).json({
+          success: false,
+          error: `Invalid gpioPolicy: ${error.message}`
+        });
+      }
+    }
+
+    const mode: RunMode = runMode === 'scaled' ? { mode: runMode, speed } : { mode: runMode };
+    if (trace !== undefined && typeof trace !== 'boolean') {
+      return res.status(400).json({
+        success: false,
+        error: 'trace must be a boolean'
+      });
+    }
+
+    const captureOptions = { gpioCapture: gpioCapture as GpioCaptureMode | undefined, gpioSampleUs, gpioPolicy: policy, trace };
+
+    // One more QEMU process must not starve the other sessions
+    if (!engine.isRunning()) {
+      sessions.assertCanStart();
+    }
     
     // Stop existing simulation if running
     if (engine.isRunning()) {
@@ -81,7 +232,7 @@ router.post('/simulate/start', async (req: Request, res: Response) => {
     await engine.loadFirmware(firmwarePath, boardType);
 
     // ✅ NOVA LÓGICA: Detectar ESP32 e passar config apropriado
-    if (boardType === 'esp32' || boardType.includes('esp32')) {
+    if (isEsp32) {
       console.log('🔧 Starting ESP32 backend with QEMU config...');
       
       // ⭐ CORREÇÃO: Usar efusePath do parâmetro ou fallback inteligente
@@ -103,8 +254,8 @@ router.post('/simulate/start', async (req: Request, res: Response) => {
       const esp32Config: Esp32BackendConfig = {
         flash: {
           flashImagePath: firmwarePath,
-          efuseImagePath: efuseImagePath,
-          serialPort: parseInt(process.env.ESP32_SERIAL_PORT || '5555')
+          efuseImagePath: efuseImagePath
+          // serialPort: alocada pelo Esp32Backend (uma por sessao)
         },
         qemuOptions: {
           memory: process.env.ESP32_DEFAULT_MEMORY || '4M',
@@ -113,10 +264,10 @@ router.post('/simulate/start', async (req: Request, res: Response) => {
         }
       };
 
-      await engine.start(esp32Config);
+      await engine.start(esp32Config, mode, captureOptions);
     } else {
       // AVR (Arduino Uno, etc)
-      await engine.start();
+      await engine.start(undefined, mode, captureOptions);
     }
 
     res.json({
@@ -124,6 +275,9 @@ router.post('/simulate/start', async (req: Request, res: Response) => {
       message: 'Simulation started'
     });
   } catch (error) {
+    if (error instanceof SessionCapacityError) {
+      return sendCapacityError(res, error);
+    }
     console.error('Start simulation error:', error);
     res.status(500).json({
       success: false,
@@ -133,11 +287,12 @@ router.post('/simulate/start', async (req: Request, res: Response) => {
 });
 
 /**
- * POST /api/simulate/stop
+ * POST /api/sessions/:sessionId/simulate/stop
  * Stop QEMU simulation
  */
-router.post('/simulate/stop', (req: Request, res: Response) => {
+simulateRouter.post('/stop', (req: Request, res: Response) => {
   try {
+    const engine = sessionEngine(res);
     engine.stop();
     res.json({
       success: true,
@@ -153,11 +308,12 @@ router.post('/simulate/stop', (req: Request, res: Response) => {
 });
 
 /**
- * GET /api/simulate/status
+ * GET /api/sessions/:sessionId/simulate/status
  * Get simulation status
  */
-router.get('/simulate/status', (req: Request, res: Response) => {
+simulateRouter.get('/status', (req: Request, res: Response) => {
   try {
+    const engine = sessionEngine(res);
     const isRunning = engine.isRunning();
     const isPaused = engine.isPaused();
     const backendType = engine.getBackendType();
@@ -166,7 +322,10 @@ router.get('/simulate/status', (req: Request, res: Response) => {
       success: true,
       running: isRunning,
       paused: isPaused,
-      backend: backendType
+      backend: backendType,
+      runMode: engine.getRunMode(),
+      virtualTimeMs: engine.getVirtualTime(),
+      gpio: engine.getGPIOStats()
     });
   } catch (error) {
     console.error('Get status error:', error);
@@ -178,11 +337,12 @@ router.get('/simulate/status', (req: Request, res: Response) => {
 });
 
 /**
- * GET /api/simulate/pins/:pin
+ * GET /api/sessions/:sessionId/simulate/pins/:pin
  * Read pin state from QEMU
  */
-router.get('/simulate/pins/:pin', (req: Request, res: Response) => {
+simulateRouter.get('/pins/:pin', (req: Request, res: Response) => {
   try {
+    const engine = sessionEngine(res);
     const pin = parseInt(req.params.pin, 10);
 
     if (isNaN(pin)) {
@@ -209,11 +369,12 @@ router.get('/simulate/pins/:pin', (req: Request, res: Response) => {
 });
 
 /**
- * POST /api/simulate/pins/:pin
+ * POST /api/sessions/:sessionId/simulate/pins/:pin
  * Write pin state to QEMU (simulate button press, etc)
  */
-router.post('/simulate/pins/:pin', async (req: Request, res: Response) => {
+simulateRouter.post('/pins/:pin', async (req: Request, res: Response) => {
   try {
+    const engine = sessionEngine(res);
     const pin = parseInt(req.params.pin, 10);
     const { value } = req.body;
 
@@ -248,11 +409,213 @@ router.post('/simulate/pins/:pin', async (req: Request, res: Response) => {
 });
 
 /**
- * GET /api/simulate/serial
+ * POST /api/sessions/:sessionId/simulate/analog/:pin
+ * Feed analogRead(pin): { value } | { samples, sampleRateHz } |
+ * { waveform, min, max, frequencyHz, points? } | { release: true }
+ */
+simulateRouter.post('/analog/:pin', async (req: Request, res: Response) => {
+  const engine = sessionEngine(res);
+  const pin = parseInt(req.params.pin, 10);
+
+  let source: AnalogSource;
+  try {
+    if (isNaN(pin) || pin < 0 || pin > 255) {
+      throw new Error('Invalid pin number');
+    }
+    source = parseAnalogSource(req.body);
+  } catch (error: any) {
+    return res.status(400).json({
+      success: false,
+      error: error.message
+    });
+  }
+
+  try {
+    await engine.setAnalogInput(pin, source);
+
+    res.json({
+      success: true,
+      pin,
+      source: source.type
+    });
+  } catch (error: any) {
+    console.error('Write analog error:', error);
+    res.status(409).json({
+      success: false,
+      error: error.message
+    });
+  }
+});
+
+/**
+ * POST /api/sessions/:sessionId/simulate/gpio-policy
+ * Which pins the firmware reports: { default?, pins?: { "13": "aggregate" }, windowMs? }
+ * with policies off | edge | aggregate (AVR only)
+ */
+simulateRouter.post('/gpio-policy', (req: Request, res: Response) => {
+  const engine = sessionEngine(res);
+
+  let policy: GpioPolicy;
+  try {
+    policy = parseGpioPolicy(req.body);
+  } catch (error: any) {
+    return res.status(400).json({
+      success: false,
+      error: error.message
+    });
+  }
+
+  try {
+    engine.setGpioPolicy(policy);
+
+    res.json({
+      success: true,
+      policy
+    });
+  } catch (error: any) {
+    console.error('GPIO policy error:', error);
+    res.status(409).json({
+      success: false,
+      error: error.message
+    });
+  }
+});
+
+/**
+ * Trace of the session's run, or a 404 when it was started without trace
+ */
+function sessionTrace(res: Response): PinTraceRecorder | null {
+  const trace = sessionEngine(res).getTrace();
+  if (!trace) {
+    res.status(404).json({
+      success: false,
+      error: 'No pin trace (start the simulation with "trace": true or PIN_TRACE=1)'
+    });
+  }
+  return trace;
+}
+
+/**
+ * Range query parameters: from/to (µs of virtual time), pins=13,9, limit, skip
+ */
+function parseTraceRange(query: Request['query']): { fromUs: number; toUs: number; pins?: number[]; limit?: number; skip?: number } {
+  const number = (name: string, fallback?: number): number | undefined => {
+    const raw = query[name];
+    if (raw === undefined) return fallback;
+    const value = Number(raw);
+    if (!Number.isInteger(value) || value < 0) {
+      throw new Error(`${name} must be a non-negative integer`);
+    }
+    return value;
+  };
+
+  const fromUs = number('from', 0)!;
+  const toUs = number('to', Number.MAX_SAFE_INTEGER)!;
+  if (toUs < fromUs) {
+    throw new Error('to must be >= from');
+  }
+
+  let pins: number[] | undefined;
+  if (query.pins !== undefined) {
+    pins = String(query.pins).split(',').map(Number);
+    if (pins.some(pin => !Number.isInteger(pin) || pin < 0 || pin > 255)) {
+      throw new Error('pins must be a comma-separated list of pin numbers');
+    }
+  }
+
+  return { fromUs, toUs, pins, limit: number('limit'), skip: number('skip') };
+}
+
+/**
+ * GET /api/sessions/:sessionId/simulate/trace
+ * Recorded span (µs), event count and size of the pin trace
+ */
+simulateRouter.get('/trace', (req: Request, res: Response) => {
+  const trace = sessionTrace(res);
+  if (!trace) return;
+
+  res.json({
+    success: true,
+    ...trace.getInfo()
+  });
+});
+
+/**
+ * GET /api/sessions/:sessionId/simulate/trace/events?from=0&to=1000000&pins=13&limit=5000
+ * Pin events in [from, to] µs plus the state of each pin at `from` (for scrubbing).
+ * Truncated pages continue at ?from=nextFromUs&skip=nextSkip.
+ */
+simulateRouter.get('/trace/events', (req: Request, res: Response) => {
+  const trace = sessionTrace(res);
+  if (!trace) return;
+
+  let range: ReturnType<typeof parseTraceRange>;
+  try {
+    range = parseTraceRange(req.query);
+  } catch (error: any) {
+    return res.status(400).json({
+      success: false,
+      error: error.message
+    });
+  }
+
+  try {
+    res.json({
+      success: true,
+      ...trace.query(range.fromUs, range.toUs, range)
+    });
+  } catch (error) {
+    console.error('Trace query error:', error);
+    res.status(500).json({
+      success: false,
+      error: 'Failed to read pin trace'
+    });
+  }
+});
+
+/**
+ * GET /api/sessions/:sessionId/simulate/trace/vcd?from=&to=&pins=
+ * Value Change Dump for GTKWave/PulseView (timescale 1 µs)
+ */
+simulateRouter.get('/trace/vcd', (req: Request, res: Response) => {
+  const trace = sessionTrace(res);
+  if (!trace) return;
+
+  let range: ReturnType<typeof parseTraceRange>;
+  try {
+    range = parseTraceRange(req.query);
+  } catch (error: any) {
+    return res.status(400).json({
+      success: false,
+      error: error.message
+    });
+  }
+
+  try {
+    res.setHeader('Content-Type', 'text/x-vcd; charset=utf-8');
+    res.setHeader('Content-Disposition', 'attachment; filename="neuroforge-trace.vcd"');
+    trace.exportVcd(text => res.write(text), range.fromUs, range.toUs, range.pins);
+    res.end();
+  } catch (error) {
+    console.error('Trace VCD export error:', error);
+    if (!res.headersSent) {
+      res.status(500).json({
+        success: false,
+        error: 'Failed to export pin trace'
+      });
+    } else {
+      res.end();
+    }
+  }
+});
+
+/**
+ * GET /api/sessions/:sessionId/simulate/serial
  * Get serial buffer
  */
-router.get('/simulate/serial', (req: Request, res: Response) => {
+simulateRouter.get('/serial', (req: Request, res: Response) => {
   try {
+    const engine = sessionEngine(res);
     const buffer = engine.getSerialBuffer();
 
     res.json({
@@ -269,11 +632,12 @@ router.get('/simulate/serial', (req: Request, res: Response) => {
 });
 
 /**
- * DELETE /api/simulate/serial
+ * DELETE /api/sessions/:sessionId/simulate/serial
  * Clear serial buffer
  */
-router.delete('/simulate/serial', (req: Request, res: Response) => {
+simulateRouter.delete('/serial', (req: Request, res: Response) => {
   try {
+    const engine = sessionEngine(res);
     engine.clearSerial();
 
     res.json({
@@ -289,4 +653,120 @@ router.delete('/simulate/serial', (req: Request, res: Response) => {
   }
 });
 
-export { router, engine };
+/**
+ * POST /api/sessions
+ * Create a simulation session (503 when the host is at capacity)
+ */
+router.post('/sessions', (req: Request, res: Response) => {
+  try {
+    const session = sessions.create();
+    res.status(201).json({
+      success: true,
+      sessionId: session.id
+    });
+  } catch (error) {
+    sendCapacityError(res, error);
+  }
+});
+
+/**
+ * GET /api/sessions
+ * Sessions and host capacity
+ */
+router.get('/sessions', (req: Request, res: Response) => {
+  res.json({
+    success: true,
+    ...sessions.getStats(),
+    qemuPool: qemuPool.getStats(),
+    list: sessions.list()
+  });
+});
+
+/**
+ * GET /api/sessions/:sessionId
+ * Check that a session still exists (idle sessions are reaped)
+ */
+router.get('/sessions/:sessionId', (req: Request, res: Response) => {
+  const session = sessions.get(req.params.sessionId);
+  if (!session) {
+    return res.status(404).json({
+      success: false,
+      error: `Session not found: ${req.params.sessionId}`
+    });
+  }
+
+  res.json({
+    success: true,
+    sessionId: session.id,
+    running: session.engine.isRunning()
+  });
+});
+
+/**
+ * DELETE /api/sessions/:sessionId
+ * Stop the session's simulation and release it
+ */
+router.delete('/sessions/:sessionId', (req: Request, res: Response) => {
+  const destroyed = sessions.destroy(req.params.sessionId);
+  res.status(destroyed ? 200 : 404).json({
+    success: destroyed
+  });
+});
+
+/**
+ * POST /api/test-runs
+ * Compile and run a batch of sketches headless, checking their expectations
+ * (see SketchTestRunner); poll GET /api/test-runs/:runId for the results
+ */
+router.post('/test-runs', (req: Request, res: Response) => {
+  let cases;
+  try {
+    cases = parseSketchTestCases(req.body);
+  } catch (error) {
+    return res.status(400).json({
+      success: false,
+      error: error instanceof Error ? error.message : 'Invalid test cases'
+    });
+  }
+
+  const run = testRunner.start(cases);
+  res.status(202).json({
+    success: true,
+    runId: run.id,
+    total: run.total,
+    ...testRunner.getStats()
+  });
+});
+
+/**
+ * GET /api/test-runs/:runId
+ * Progress and results of a test run (kept for an hour after it finishes)
+ */
+router.get('/test-runs/:runId', (req: Request, res: Response) => {
+  const run = testRunner.getRun(req.params.runId);
+  if (!run) {
+    return res.status(404).json({
+      success: false,
+      error: `Test run not found: ${req.params.runId}`
+    });
+  }
+
+  res.json({
+    success: true,
+    ...run,
+    results: [...run.results].sort((a, b) => a.index - b.index)
+  });
+});
+
+/**
+ * GET /api/metrics
+ * Pipeline counters and histograms (Prometheus text format)
+ */
+router.get('/metrics', (req: Request, res: Response) => {
+  res.type('text/plain; version=0.0.4; charset=utf-8').send(metrics.render());
+});
+
+router.use('/sessions/:sessionId/simulate', resolveSession, simulateRouter);
+router.use('/simulate', resolveSession, simulateRouter);
+
+export { router, sessions, compiler, qemuPool, DEFAULT_SESSION_ID };
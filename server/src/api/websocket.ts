@@ -1,6 +1,13 @@
 import { Server as SocketIOServer } from 'socket.io';
 import { Server as HTTPServer } from 'http';
-import { engine } from './routes';
+import { sessions, compiler, DEFAULT_SESSION_ID } from './routes';
+import type { Session } from '../services/SessionManager';
+import { PinChangeBatcher } from '../services/PinChangeBatcher';
+import { wsClients, wsEmitsTotal, Tracer } from '../services/Metrics';
+
+const serialEmits = wsEmitsTotal.labels('serial');
+const pinBatchEmits = wsEmitsTotal.labels('pinBatch');
+const wsTrace = new Tracer('ws');
 
 /**
  * Setup WebSocket server for real-time communication
@@ -13,18 +20,61 @@ export function setupWebSocket(httpServer: HTTPServer): SocketIOServer {
     }
   });
 
+  // Compile queue position, sent only to the socket that asked for the compile
+  compiler.on('queue-position', (clientId: string, position: number) => {
+    io.to(clientId).emit('compileQueue', { position });
+  });
+
+  // Clients of a destroyed session (DELETE or idle reaper) must create a new one
+  sessions.on('destroyed', (sessionId: string) => {
+    io.to(`session:${sessionId}`).emit('sessionClosed', { sessionId });
+  });
+
   io.on('connection', (socket) => {
-    console.log('Client connected:', socket.id);
+    // Session chosen at handshake: io(url, { auth: { sessionId } })
+    const requested = socket.handshake.auth?.sessionId ?? socket.handshake.query.sessionId;
+    let resolved: Session | undefined;
+    try {
+      resolved = typeof requested === 'string' && requested
+        ? sessions.get(requested)
+        : sessions.getOrCreate(DEFAULT_SESSION_ID);
+    } catch (error) {
+      socket.emit('sessionError', { error: error instanceof Error ? error.message : 'Session error' });
+      socket.disconnect(true);
+      return;
+    }
+
+    if (!resolved) {
+      socket.emit('sessionError', { error: `Session not found: ${requested}` });
+      socket.disconnect(true);
+      return;
+    }
+
+    const session = resolved;
+    const engine = session.engine;
+    sessions.attachClient(session);
+    socket.join(`session:${session.id}`);
+    wsClients.inc();
+    console.log('Client connected:', socket.id, `(session ${session.id})`);
 
     // Forward serial output to client
     const serialHandler = (line: string) => {
+      serialEmits.inc();
       socket.emit('serial', line);
     };
 
-    // Forward pin changes to client
+    // Forward pin changes to client, coalesced per frame (see PinChangeBatcher)
+    const pinBatcher = new PinChangeBatcher((message, onAck) => {
+      pinBatchEmits.inc();
+      if (wsTrace.enabled) {
+        wsTrace.sample(() => `pinBatch seq=${message.seq} to ${socket.id}: ${message.pins.length} pins`);
+      }
+      socket.emit('pinBatch', message, onAck);
+    }, { clock: () => engine.getTimeUs() });
+    pinBatcher.start();
+
     const pinChangeHandler = (pin: number, state: any) => {
-      console.log(`📡 [WebSocket] Forwarding pin-change: pin=${pin}, state=`, state);
-      socket.emit('pinChange', { pin, ...state });
+      pinBatcher.push(pin, state);
     };
 
     // Forward simulation events
@@ -55,6 +105,9 @@ export function setupWebSocket(httpServer: HTTPServer): SocketIOServer {
     // Handle client disconnect
     socket.on('disconnect', () => {
       console.log('Client disconnected:', socket.id);
+      wsClients.dec();
+      pinBatcher.stop();
+      sessions.detachClient(session);
 
       // Unsubscribe from engine events
       engine.off('serial', serialHandler);
@@ -67,6 +120,7 @@ export function setupWebSocket(httpServer: HTTPServer): SocketIOServer {
 
     // Send initial status
     socket.emit('status', {
+      sessionId: session.id,
       running: engine.isRunning(),
       paused: engine.isPaused()
     });
@@ -1,7 +1,8 @@
 import express from 'express';
 import cors from 'cors';
 import { createServer } from 'http';
-import { router } from './api/routes';
+import { router, compiler, sessions, qemuPool } from './api/routes';
+import type { BoardType, SimulationMode } from './services/CompilerService';
 import { setupWebSocket } from './api/websocket';
 
 const app = express();
@@ -13,7 +14,7 @@ app.use(cors({
   origin: process.env.FRONTEND_URL || 'http://localhost:5173',
   credentials: true
 }));
-app.use(express.json());
+app.use(express.json({ limit: '5mb' })); // POST /api/test-runs carries a whole class of sketches
 
 // Routes
 app.use('/api', router);
@@ -31,11 +32,27 @@ httpServer.listen(PORT, () => {
   console.log(`✅ NeuroForge Backend running on http://localhost:${PORT}`);
   console.log(`📡 WebSocket server ready`);
   console.log(`🔧 API available at http://localhost:${PORT}/api`);
+
+  // Pre-build the core of the usual boards in every compile worker (board:mode, comma separated)
+  const warmBoards = (process.env.COMPILE_WARM_BOARDS ?? 'arduino-uno:qemu')
+    .split(',')
+    .map(entry => entry.trim())
+    .filter(Boolean)
+    .map(entry => {
+      const [board, mode] = entry.split(':');
+      return { board: board as BoardType, mode: mode as SimulationMode | undefined };
+    });
+  compiler.warmUp(warmBoards);
+
+  // Paused QEMU instances waiting for firmware (QEMU_POOL_SIZE per profile, 0 = off)
+  qemuPool.warmUp([{ board: 'arduino-uno', runMode: { mode: 'realtime' } }]);
 });
 
 // Graceful shutdown
 process.on('SIGTERM', () => {
   console.log('SIGTERM signal received: closing HTTP server');
+  sessions.destroyAll();
+  qemuPool.shutdown();
   httpServer.close(() => {
     console.log('HTTP server closed');
   });
@@ -0,0 +1,193 @@
+import { NF_HOST_OP, NF_ADC_DATA_SAMPLES, NF_ADC_RELEASE, encodeFrame } from './NFWireProtocol';
+
+export type AnalogWaveform = 'sine' | 'triangle' | 'square' | 'sawtooth';
+
+/**
+ * What analogRead() returns on a host-fed channel:
+ * - constant: one value
+ * - samples:  a table looped at sampleRateHz of virtual time
+ * - waveform: a table generated here (points samples per period)
+ * - release:  back to the emulated ADC
+ */
+export type AnalogSource =
+  | { type: 'constant'; value: number }
+  | { type: 'samples'; samples: number[]; sampleRateHz: number }
+  | { type: 'waveform'; waveform: AnalogWaveform; min: number; max: number; frequencyHz: number; points?: number }
+  | { type: 'release' };
+
+/**
+ * Firmware-side sample pool and ADC range per backend
+ * (NF_ADC_POOL_LEN in nf_adc.cpp / esp32-shim.cpp)
+ */
+export const ANALOG_TARGETS = {
+  avr: { poolSize: 64, maxValue: 1023 },
+  esp32: { poolSize: 1024, maxValue: 4095 }
+} as const;
+
+const WAVEFORMS: AnalogWaveform[] = ['sine', 'triangle', 'square', 'sawtooth'];
+
+/**
+ * Validate a request body ({ value } | { samples, sampleRateHz } |
+ * { waveform, min, max, frequencyHz, points? } | { release: true })
+ */
+export function parseAnalogSource(body: any): AnalogSource {
+  const finite = (value: any, name: string): number => {
+    if (typeof value !== 'number' || !Number.isFinite(value)) {
+      throw new Error(`${name} must be a number`);
+    }
+    return value;
+  };
+
+  if (body?.release === true) {
+    return { type: 'release' };
+  }
+  if (body?.value !== undefined) {
+    return { type: 'constant', value: finite(body.value, 'value') };
+  }
+  if (Array.isArray(body?.samples)) {
+    if (body.samples.length === 0) throw new Error('samples must not be empty');
+    const sampleRateHz = finite(body.sampleRateHz, 'sampleRateHz');
+    if (sampleRateHz <= 0) throw new Error('sampleRateHz must be > 0');
+    return { type: 'samples', samples: body.samples.map((v: any) => finite(v, 'samples[]')), sampleRateHz };
+  }
+  if (body?.waveform !== undefined) {
+    if (!WAVEFORMS.includes(body.waveform)) {
+      throw new Error(`waveform must be one of: ${WAVEFORMS.join(', ')}`);
+    }
+    const frequencyHz = finite(body.frequencyHz, 'frequencyHz');
+    if (frequencyHz <= 0) throw new Error('frequencyHz must be > 0');
+    return {
+      type: 'waveform',
+      waveform: body.waveform,
+      min: finite(body.min ?? 0, 'min'),
+      max: finite(body.max, 'max'),
+      frequencyHz,
+      points: body.points !== undefined ? finite(body.points, 'points') : undefined
+    };
+  }
+  throw new Error('Expected value, samples, waveform or release');
+}
+
+/**
+ * One period of a waveform, `points` samples long
+ */
+export function generateWaveform(waveform: AnalogWaveform, min: number, max: number, points: number): number[] {
+  const samples: number[] = [];
+  for (let i = 0; i < points; i++) {
+    const phase = i / points;
+    let unit: number; // 0..1
+    switch (waveform) {
+      case 'sine':
+        unit = (1 - Math.cos(2 * Math.PI * phase)) / 2; // Starts at min, like the others
+        break;
+      case 'triangle':
+        unit = phase < 0.5 ? phase * 2 : 2 - phase * 2;
+        break;
+      case 'square':
+        unit = phase < 0.5 ? 1 : 0;
+        break;
+      case 'sawtooth':
+        unit = phase;
+        break;
+    }
+    samples.push(min + (max - min) * unit);
+  }
+  return samples;
+}
+
+/**
+ * Host-side allocator for the firmware's sample pool: each pin owns one
+ * region, replaced (first fit) when its waveform changes
+ */
+export class AnalogSamplePool {
+  private size: number;
+  private regions = new Map<number, { start: number; length: number }>();
+
+  constructor(size: number) {
+    this.size = size;
+  }
+
+  allocate(pin: number, length: number): number {
+    this.regions.delete(pin);
+    if (length > this.size) {
+      throw new Error(`Waveform has ${length} samples, the firmware pool holds ${this.size}`);
+    }
+
+    const taken = [...this.regions.values()].sort((a, b) => a.start - b.start);
+    let start = 0;
+    for (const region of taken) {
+      if (region.start - start >= length) break;
+      start = Math.max(start, region.start + region.length);
+    }
+    if (start + length > this.size) {
+      throw new Error(`Analog sample pool full (${this.size} samples shared by all pins)`);
+    }
+
+    this.regions.set(pin, { start, length });
+    return start;
+  }
+
+  free(pin: number): void {
+    this.regions.delete(pin);
+  }
+
+  clear(): void {
+    this.regions.clear();
+  }
+}
+
+/**
+ * NF_OP_ADC_* frames that make analogRead(pin) follow `source`.
+ * Table sources are uploaded once; playback runs on the firmware's virtual clock.
+ */
+export function encodeAnalogSource(
+  pin: number,
+  source: AnalogSource,
+  pool: AnalogSamplePool,
+  target: { poolSize: number; maxValue: number }
+): Buffer {
+  const clamp = (value: number) => Math.max(0, Math.min(target.maxValue, Math.round(value)));
+
+  if (source.type === 'release' || source.type === 'constant') {
+    pool.free(pin);
+    const value = source.type === 'release' ? NF_ADC_RELEASE : clamp(source.value);
+    return encodeFrame(NF_HOST_OP.ADC_CONST, [pin, value & 0xff, value >> 8]);
+  }
+
+  let samples: number[];
+  let periodUs: number;
+  if (source.type === 'samples') {
+    samples = source.samples;
+    periodUs = 1e6 / source.sampleRateHz;
+  } else {
+    // As many points per period as the pool and a 1 us step allow
+    const points = Math.max(2, Math.min(source.points ?? 32, target.poolSize, Math.floor(1e6 / source.frequencyHz)));
+    samples = generateWaveform(source.waveform, source.min, source.max, points);
+    periodUs = 1e6 / (source.frequencyHz * points);
+  }
+
+  // Whole DATA frames, so the padding of the last one stays inside this pin's region
+  const start = pool.allocate(pin, Math.ceil(samples.length / NF_ADC_DATA_SAMPLES) * NF_ADC_DATA_SAMPLES);
+  const frames: Buffer[] = [];
+
+  for (let i = 0; i < samples.length; i += NF_ADC_DATA_SAMPLES) {
+    const index = start + i;
+    const payload = [index & 0xff, index >> 8];
+    for (let j = 0; j < NF_ADC_DATA_SAMPLES; j++) {
+      // Padding after the last sample is never played
+      const value = clamp(samples[Math.min(i + j, samples.length - 1)]);
+      payload.push(value & 0xff, value >> 8);
+    }
+    frames.push(encodeFrame(NF_HOST_OP.ADC_DATA, payload));
+  }
+
+  const period = Math.max(1, Math.min(0xffffffff, Math.round(periodUs)));
+  frames.push(encodeFrame(NF_HOST_OP.ADC_PLAY, [
+    pin,
+    start & 0xff, start >> 8,
+    samples.length & 0xff, samples.length >> 8,
+    period & 0xff, (period >> 8) & 0xff, (period >> 16) & 0xff, (period >>> 24) & 0xff
+  ]));
+
+  return Buffer.concat(frames);
+}
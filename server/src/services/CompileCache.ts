@@ -0,0 +1,196 @@
+import { createHash } from 'crypto';
+import * as fs from 'fs';
+import * as path from 'path';
+
+/**
+ * Cached artifacts of one successful compile
+ */
+export interface CompileCacheEntry {
+  key: string;
+  firmwarePath: string;
+  efusePath?: string;
+  stdout: string;
+  createdAt: number;
+}
+
+/**
+ * Inputs that fully determine a firmware image
+ */
+export interface CompileCacheInputs {
+  code: string;             // Sketch after preprocessing (Serial.begin injection)
+  fqbn: string;
+  coreVersion: string;      // arduino-cli core list output
+  extraFiles: string[];     // Injected sources (esp32-shim.cpp, nf_* core files)
+  buildProperties?: string[]; // arduino-cli --build-property values
+}
+
+/**
+ * Bounds applied by cleanup()
+ */
+export interface CompileCacheLimits {
+  maxAgeMs: number;  // Entries unused for longer are removed
+  maxBytes: number;  // Then least-recently-used entries go until the cache fits
+  graceMs: number;   // Entries used this recently are never removed (compile -> start gap)
+}
+
+/**
+ * Content-addressed firmware cache
+ *
+ * Layout: <root>/<sha256>/{entry.json, firmware files}
+ * An entry's mtime is refreshed on every hit, so cleanup() evicts
+ * least-recently-used entries.
+ */
+export class CompileCache {
+  /** Bump when the key derivation or entry layout changes */
+  private static readonly FORMAT = 1;
+
+  private root: string;
+
+  constructor(root: string) {
+    this.root = root;
+    fs.mkdirSync(this.root, { recursive: true });
+  }
+
+  /**
+   * Cache key: sha256 over every input, including the content of the injected files
+   */
+  computeKey(inputs: CompileCacheInputs): string {
+    const hash = createHash('sha256');
+    hash.update(`format:${CompileCache.FORMAT}\0fqbn:${inputs.fqbn}\0core:${inputs.coreVersion}\0`);
+
+    for (const file of [...inputs.extraFiles].sort()) {
+      hash.update(`file:${path.basename(file)}\0`);
+      if (fs.existsSync(file)) {
+        hash.update(fs.readFileSync(file));
+      }
+      hash.update('\0');
+    }
+
+    for (const property of inputs.buildProperties ?? []) {
+      hash.update(`prop:${property}\0`);
+    }
+
+    hash.update('code:');
+    hash.update(inputs.code);
+    return hash.digest('hex');
+  }
+
+  /**
+   * Directory where the artifacts of a key are stored
+   */
+  entryDir(key: string): string {
+    return path.join(this.root, key);
+  }
+
+  get(key: string): CompileCacheEntry | null {
+    const dir = this.entryDir(key);
+    const metaFile = path.join(dir, 'entry.json');
+
+    try {
+      const entry: CompileCacheEntry = JSON.parse(fs.readFileSync(metaFile, 'utf-8'));
+      if (!fs.existsSync(entry.firmwarePath) || (entry.efusePath && !fs.existsSync(entry.efusePath))) {
+        return null;
+      }
+
+      const now = new Date();
+      fs.utimesSync(dir, now, now);
+      return entry;
+    } catch {
+      return null;
+    }
+  }
+
+  /**
+   * Copy the build artifacts into the cache and record the entry.
+   * Returns the entry with paths pointing inside the cache.
+   */
+  put(key: string, artifacts: string[], firmwareFile: string, stdout: string, efusePath?: string): CompileCacheEntry {
+    const dir = this.entryDir(key);
+    const tmpDir = `${dir}.tmp-${process.pid}-${Date.now()}`;
+    fs.mkdirSync(tmpDir, { recursive: true });
+
+    for (const file of artifacts) {
+      if (fs.existsSync(file)) {
+        fs.copyFileSync(file, path.join(tmpDir, path.basename(file)));
+      }
+    }
+
+    const entry: CompileCacheEntry = {
+      key,
+      firmwarePath: path.join(dir, path.basename(firmwareFile)),
+      efusePath,
+      stdout,
+      createdAt: Date.now()
+    };
+    fs.writeFileSync(path.join(tmpDir, 'entry.json'), JSON.stringify(entry, null, 2));
+
+    // Atomic publish: readers never see a half-written entry
+    fs.rmSync(dir, { recursive: true, force: true });
+    fs.renameSync(tmpDir, dir);
+    return entry;
+  }
+
+  /**
+   * Apply the limits; entries holding a firmware path in inUse (loaded by a
+   * session, restartable) are kept whatever their age. Returns bytes freed.
+   */
+  cleanup(limits: CompileCacheLimits, inUse: Iterable<string> = []): number {
+    const now = Date.now();
+    const keep = new Set<string>();
+    for (const file of inUse) {
+      const relative = path.relative(this.root, file);
+      if (relative && !relative.startsWith('..') && !path.isAbsolute(relative)) {
+        keep.add(relative.split(path.sep)[0]);
+      }
+    }
+
+    const entries: { name: string; usedAt: number; bytes: number }[] = [];
+    let total = 0;
+    for (const name of fs.readdirSync(this.root)) {
+      const entryPath = path.join(this.root, name);
+      const stats = this.statOrNull(entryPath); // Gone already: replaced or renamed mid-scan
+      if (!stats) continue;
+
+      if (name.includes('.tmp-')) {
+        // Publish in progress; one this old belongs to a process that died mid-put()
+        if (now - stats.mtimeMs > limits.maxAgeMs) fs.rmSync(entryPath, { recursive: true, force: true });
+        continue;
+      }
+
+      const bytes = this.entrySize(entryPath);
+      total += bytes;
+      if (!keep.has(name) && now - stats.mtimeMs > limits.graceMs) {
+        entries.push({ name, usedAt: stats.mtimeMs, bytes });
+      }
+    }
+
+    let freed = 0;
+    entries.sort((a, b) => a.usedAt - b.usedAt);
+    for (const entry of entries) {
+      if (now - entry.usedAt <= limits.maxAgeMs && total - freed <= limits.maxBytes) break;
+      fs.rmSync(path.join(this.root, entry.name), { recursive: true, force: true });
+      freed += entry.bytes;
+    }
+    return freed;
+  }
+
+  private statOrNull(file: string): fs.Stats | null {
+    try {
+      return fs.statSync(file);
+    } catch {
+      return null;
+    }
+  }
+
+  private entrySize(dir: string): number {
+    let bytes = 0;
+    try {
+      for (const file of fs.readdirSync(dir)) {
+        bytes += this.statOrNull(path.join(dir, file))?.size ?? 0;
+      }
+    } catch {
+      // Evicted or replaced concurrently
+    }
+    return bytes;
+  }
+}
@@ -0,0 +1,149 @@
+import * as os from 'os';
+import { compileQueueWaitSeconds, compileQueueDepth } from './Metrics';
+
+/**
+ * One compile slot. Each worker owns its sketch folders and build paths,
+ * so workers never share arduino-cli state.
+ */
+export interface CompileWorker {
+  id: number;
+  busy: boolean;
+  warm: Set<string>; // Boards (FQBN slugs) whose core is already built in this worker's build path (set by the task on success)
+}
+
+export interface CompilePoolStats {
+  workers: number;
+  busy: number;
+  queued: number;
+}
+
+export interface CompilePoolRunOptions {
+  background?: boolean;                   // Runs only after every user job (warm-up)
+  workerId?: number;                      // Pin the job to one worker
+  onPosition?: (position: number) => void; // Place in the queue (1 = next); 0 = started
+}
+
+interface PendingJob {
+  fqbn: string;
+  background: boolean;
+  workerId?: number;
+  onPosition?: (position: number) => void;
+  lastPosition: number;
+  enqueuedAt: number; // performance.now(), for the queue wait metric
+  start: (worker: CompileWorker) => void;
+}
+
+/**
+ * Bounded pool of arduino-cli slots with a FIFO queue
+ *
+ * A free worker that already built the job's FQBN is preferred, so the
+ * core library is not rebuilt on every board switch.
+ */
+export class CompileWorkerPool {
+  /** Rough peak RSS of one arduino-cli + gcc run (ESP32 builds are the heavy ones) */
+  private static readonly MEMORY_PER_WORKER = 768 * 1024 * 1024;
+
+  private workers: CompileWorker[] = [];
+  private queue: PendingJob[] = [];
+
+  /**
+   * COMPILE_WORKERS, or as many workers as both CPUs and memory allow
+   */
+  static defaultSize(): number {
+    const configured = parseInt(process.env.COMPILE_WORKERS || '', 10);
+    if (configured > 0) return configured;
+
+    const byMemory = Math.floor(os.totalmem() / CompileWorkerPool.MEMORY_PER_WORKER);
+    return Math.max(1, Math.min(os.cpus().length, byMemory));
+  }
+
+  constructor(size: number = CompileWorkerPool.defaultSize()) {
+    for (let id = 0; id < size; id++) {
+      this.workers.push({ id, busy: false, warm: new Set() });
+    }
+  }
+
+  getWorkers(): readonly CompileWorker[] {
+    return this.workers;
+  }
+
+  getStats(): CompilePoolStats {
+    return {
+      workers: this.workers.length,
+      busy: this.workers.filter(w => w.busy).length,
+      queued: this.queue.filter(job => !job.background).length
+    };
+  }
+
+  /**
+   * Run task on a free worker, waiting in the queue if all are busy
+   * @param fqbn - Board key used for warm-worker affinity
+   */
+  run<T>(fqbn: string, task: (worker: CompileWorker) => Promise<T>, options: CompilePoolRunOptions = {}): Promise<T> {
+    return new Promise<T>((resolve, reject) => {
+      const job: PendingJob = {
+        fqbn,
+        background: !!options.background,
+        workerId: options.workerId,
+        onPosition: options.onPosition,
+        lastPosition: -1,
+        enqueuedAt: performance.now(),
+        start: (worker) => {
+          task(worker)
+            .then(resolve, reject)
+            .finally(() => {
+              worker.busy = false;
+              this.dispatch();
+            });
+        }
+      };
+
+      if (job.background) {
+        this.queue.push(job);
+      } else {
+        // User jobs go ahead of pending warm-ups
+        const firstBackground = this.queue.findIndex(pending => pending.background);
+        this.queue.splice(firstBackground === -1 ? this.queue.length : firstBackground, 0, job);
+      }
+
+      this.dispatch();
+    });
+  }
+
+  private dispatch(): void {
+    for (let i = 0; i < this.queue.length; ) {
+      const job = this.queue[i];
+      const worker = this.pickWorker(job);
+      if (!worker) {
+        i++;
+        continue;
+      }
+
+      this.queue.splice(i, 1);
+      worker.busy = true;
+      if (!job.background) {
+        compileQueueWaitSeconds.observeSince(job.enqueuedAt);
+      }
+      this.notify(job, 0);
+      job.start(worker);
+    }
+
+    this.queue.forEach((job, index) => this.notify(job, index + 1));
+    compileQueueDepth.set(this.queue.filter(job => !job.background).length);
+  }
+
+  private pickWorker(job: PendingJob): CompileWorker | undefined {
+    const free = this.workers.filter(w => !w.busy && (job.workerId === undefined || w.id === job.workerId));
+    if (free.length === 0) return undefined;
+
+    // Warm for this board first, then the one with the fewest boards built
+    return free.find(w => w.warm.has(job.fqbn))
+      || free.reduce((best, w) => (w.warm.size < best.warm.size ? w : best));
+  }
+
+  private notify(job: PendingJob, position: number): void {
+    if (!job.onPosition || job.lastPosition === position) return;
+    job.lastPosition = position;
+    job.onPosition(position);
+  }
+}
@@ -2,9 +2,45 @@ import { spawn } from 'child_process';
 import * as fs from 'fs';
 import * as path from 'path';
 import * as os from 'os';
+import { EventEmitter } from 'events';
+import { CompileCache } from './CompileCache';
+import type { CompileCacheLimits } from './CompileCache';
+import { CompileWorkerPool } from './CompileWorkerPool';
+import type { CompileWorker, CompilePoolStats } from './CompileWorkerPool';
+import { compileSeconds, compileRequestsTotal } from './Metrics';
+
+const compileSucceeded = compileSeconds.labels('success');
+const compileFailed = compileSeconds.labels('failure');
+const cacheHits = compileRequestsTotal.labels('cache_hit');
+const joinedBuilds = compileRequestsTotal.labels('joined');
+const newBuilds = compileRequestsTotal.labels('built');
 
 export type BoardType = 'arduino-uno' | 'esp32' | 'esp32-devkit' | 'raspberry-pi-pico';
-export type SimulationMode = 'interpreter' | 'qemu';
+/** wasm: clang-compiled WebAssembly for the browser runtime (cores/neuroforge_wasm) */
+export type SimulationMode = 'interpreter' | 'qemu' | 'wasm';
+
+/**
+ * GPIO reporting strategy of the neuroforge_qemu core (boards.txt "nfgpio" menu)
+ * - edge:     one frame per pin change
+ * - loop:     PORTB/C/D deltas batched into one frame per loop() iteration
+ * - interval: same as loop, also flushed every 10 ms
+ * - none:     no reports (GPIO captured by the host through the gdbstub)
+ */
+export type GPIOReporting = 'edge' | 'loop' | 'interval' | 'none';
+
+export interface CompileOptions {
+  gpioReporting?: GPIOReporting;
+  clientId?: string; // Receives 'queue-position' events while the compile waits
+}
+
+/**
+ * Board to keep pre-built in every worker (see warmUp)
+ */
+export interface WarmTarget {
+  board: BoardType;
+  mode?: SimulationMode;
+  options?: CompileOptions;
+}
 
 export interface CompileResult {
   success: boolean;
@@ -13,16 +49,79 @@ export interface CompileResult {
   error?: string;
   stdout?: string;
   stderr?: string;
+  cached?: boolean;    // Served from the compile cache, arduino-cli not run
+}
+
+/**
+ * Core functions the ESP32 shim intercepts with -Wl,--wrap (see esp32-shim.cpp).
+ * _Z5setupv is the sketch's setup(): the shim starts its tasks before it runs.
+ * uart_write_bytes/uartSetDebug route Serial and log output on UART0 through
+ * the shim's single locked writer, so they cannot split a GPIO frame.
+ */
+const ESP32_SHIM_WRAPS = ['ledcWrite', 'ledcWriteTone', 'analogWrite', '_Z5setupv', 'uart_write_bytes', 'uartSetDebug'];
+
+/**
+ * WebAssembly toolchain: wasi-sdk clang (libc/libc++ for wasm32) and
+ * binaryen's wasm-opt, which adds Asyncify so delay() can suspend the
+ * sketch inside the browser worker
+ */
+const WASI_SDK_PATH = process.env.WASI_SDK_PATH || '/opt/wasi-sdk';
+const WASM_CLANG = process.env.WASM_CLANG || path.join(WASI_SDK_PATH, 'bin', 'clang++');
+const WASM_OPT = process.env.WASM_OPT || 'wasm-opt';
+
+/** Pseudo-FQBN of wasm builds (cache key, work dir) */
+const WASM_FQBN = 'neuroforge:wasm32:uno';
+
+/** Imports that suspend the sketch (see nf_wasm.h) */
+const WASM_ASYNC_IMPORTS = ['nf.yield_until'];
+
+/** Words that start a top-level statement but never a function definition */
+const NOT_A_RETURN_TYPE = /^(if|else|for|while|switch|return|do|case|typedef|struct|class|enum|union|namespace|template|using)\b/;
+
+/**
+ * One arduino-cli build, described independently of the board family
+ */
+interface BuildJob {
+  code: string;
+  fqbn: string;
+  extraFiles: string[];              // Hashed into the cache key
+  injectedFiles: Record<string, string>; // Sketch-relative name -> source file to copy
+  exportBinaries: boolean;
+  buildProperties?: string[];        // arduino-cli --build-property (hashed into the cache key)
+  firmwareNames: string[];           // Candidates in order of preference
+  efusePath?: string;
+  toolchain?: 'arduino-cli' | 'wasm'; // Default arduino-cli
 }
 
 /**
  * Service for compiling Arduino sketches using arduino-cli
+ *
+ * Builds run on a bounded CompileWorkerPool; identical compiles already
+ * in flight share one build.
+ *
+ * Events:
+ * - 'queue-position' (clientId, position): place of the client's compile in the queue (1 = next), 0 = building
  */
-export class CompilerService {
+export class CompilerService extends EventEmitter {
+  /** Stable sketch name: arduino-cli only rebuilds what changed in a reused build path */
+  private static readonly SKETCH_NAME = 'sketch';
+  private static readonly CORE_VERSION_TTL_MS = 5 * 60 * 1000;
+  private static readonly CLEANUP_INTERVAL_MS = 10 * 60 * 1000;
+
   private arduinoCliPath: string;
   private tempDir: string;
+  private workDir: string; // Per-FQBN sketch + build path, reused between compiles
+  private cache: CompileCache;
+  private coreVersion: { value: Promise<string>; at: number } | null = null;
+  private wasmToolchainVersion: { value: Promise<string>; at: number } | null = null;
+  private pool: CompileWorkerPool;
+  private inFlight = new Map<string, { result: Promise<CompileResult>; clients: Set<string>; position: number }>();
+  private cacheLimits: CompileCacheLimits;
+  private firmwareUsers: (() => Iterable<string>)[] = []; // Firmware paths still loaded somewhere
+  private cleanupTimer: NodeJS.Timeout;
 
   constructor() {
+    super();
     // Try to find arduino-cli in PATH
     this.arduinoCliPath = process.platform === 'win32' ? 'arduino-cli.exe' : 'arduino-cli';
     this.tempDir = path.join(os.tmpdir(), 'neuroforge-compile');
@@ -31,6 +130,26 @@ export class CompilerService {
     if (!fs.existsSync(this.tempDir)) {
       fs.mkdirSync(this.tempDir, { recursive: true });
     }
+
+    this.workDir = path.join(this.tempDir, 'work');
+    this.cache = new CompileCache(path.join(this.tempDir, 'cache'));
+    this.cacheLimits = {
+      maxBytes: (parseInt(process.env.COMPILE_CACHE_MAX_MB || '', 10) || 2048) * 1024 * 1024,
+      maxAgeMs: (parseInt(process.env.COMPILE_CACHE_MAX_AGE_H || '', 10) || 7 * 24) * 3600 * 1000,
+      graceMs: CompilerService.CLEANUP_INTERVAL_MS
+    };
+    this.cleanupTimer = setInterval(() => this.cleanup(), CompilerService.CLEANUP_INTERVAL_MS);
+    this.cleanupTimer.unref();
+    this.pool = new CompileWorkerPool();
+
+    // Build paths survive restarts: those workers are already warm
+    for (const worker of this.pool.getWorkers()) {
+      const workerDir = path.join(this.workDir, `w${worker.id}`);
+      if (!fs.existsSync(workerDir)) continue;
+      for (const fqbnDir of fs.readdirSync(workerDir)) {
+        worker.warm.add(fqbnDir);
+      }
+    }
   }
 
   /**
@@ -38,10 +157,13 @@ export class CompilerService {
    * @param board - Board type (arduino-uno, esp32, etc)
    * @param mode - Simulation mode (qemu uses custom core with NeuroForge Time)
    */
-  private getFQBN(board: BoardType, mode: SimulationMode = 'interpreter'): string {
+  private getFQBN(board: BoardType, mode: SimulationMode = 'interpreter', options: CompileOptions = {}): string {
     // NeuroForge Time: Use unoqemu board (registered in arduino:avr platform)
     if (mode === 'qemu' && board === 'arduino-uno') {
-      return 'arduino:avr:unoqemu';  // ✅ Board unoqemu dentro da plataforma arduino:avr
+      // ✅ Board unoqemu dentro da plataforma arduino:avr
+      return options.gpioReporting
+        ? `arduino:avr:unoqemu:nfgpio=${options.gpioReporting}`
+        : 'arduino:avr:unoqemu';
     }
 
     // Default boards for interpreter mode
@@ -92,187 +214,552 @@ export class CompilerService {
    * @param code - Arduino sketch code
    * @param board - Target board type
    * @param mode - Simulation mode (interpreter or qemu)
+   * @param options - Core build options (GPIO reporting strategy)
    */
   async compile(
     code: string,
     board: BoardType = 'arduino-uno',
-    mode: SimulationMode = 'interpreter'
+    mode: SimulationMode = 'interpreter',
+    options: CompileOptions = {}
   ): Promise<CompileResult> {
+    return this.compileCached(this.createJob(code, board, mode, options), options.clientId);
+  }
+
+  /**
+   * Build the core of the given boards in every worker, behind any user compile
+   */
+  warmUp(targets: WarmTarget[]): void {
+    const sketch = 'void setup() {\n}\n\nvoid loop() {\n}\n';
+
+    for (const target of targets) {
+      const job = this.createJob(sketch, target.board, target.mode, target.options);
+
+      for (const worker of this.pool.getWorkers()) {
+        if (worker.warm.has(this.slug(job.fqbn))) continue;
+
+        this.pool.run(this.slug(job.fqbn), w => this.build(job, null, w), { background: true, workerId: worker.id })
+          .then(result => {
+            if (result.success) {
+              console.log(`🔥 Worker ${worker.id} warm: ${job.fqbn}`);
+            } else {
+              console.warn(`⚠️ Worker ${worker.id} warm-up failed: ${job.fqbn}`);
+            }
+          })
+          .catch(() => undefined);
+      }
+    }
+  }
+
+  /**
+   * Worker pool occupancy
+   */
+  getQueueStats(): CompilePoolStats {
+    return this.pool.getStats();
+  }
+
+  /**
+   * Describe the arduino-cli build for a board
+   */
+  private createJob(
+    code: string,
+    board: BoardType,
+    mode: SimulationMode = 'interpreter',
+    options: CompileOptions = {}
+  ): BuildJob {
+    // Browser runtime: same Uno-like HAL for every board
+    if (mode === 'wasm') {
+      return this.createWasmJob(code);
+    }
+
     // ✅ NOVA LÓGICA: ESP32 usa firmware pré-compilado (por enquanto)
     if (board === 'esp32' || board === 'esp32-devkit') {
-      return this.compileESP32(code, board);
+      return this.createESP32Job(code);
     }
 
     // 🔧 NEUROFORGE: Inject Serial.begin() for Arduino AVR
     const processedCode = this.injectSerialBegin(code);
 
-    // Compilação padrão para AVR/Arduino
-    const sketchName = `sketch_${Date.now()}`;
-    const sketchDir = path.join(this.tempDir, sketchName);
-    // IMPORTANT: .ino file MUST have same name as folder (arduino-cli requirement)
-    const sketchFile = path.join(sketchDir, `${sketchName}.ino`);
+    // Get FQBN for the board and mode
+    const fqbn = this.getFQBN(board, mode, options);
+    console.log(`🔧 Compiling with arduino-cli: ${fqbn} (mode: ${mode})`);
+
+    return {
+      code: processedCode,
+      fqbn,
+      // The custom core is part of the firmware: a core update must invalidate the cache
+      extraFiles: fqbn.startsWith('arduino:avr:unoqemu') ? this.getQemuCoreFiles() : [],
+      injectedFiles: {},
+      exportBinaries: false,
+      // Prefer .elf for QEMU, fallback to .hex
+      firmwareNames: [`${CompilerService.SKETCH_NAME}.ino.elf`, `${CompilerService.SKETCH_NAME}.ino.hex`]
+    };
+  }
 
-    try {
-      // Create sketch directory
-      fs.mkdirSync(sketchDir, { recursive: true });
+  /**
+   * ESP32 Compilation Logic
+   */
+  private createESP32Job(code: string): BuildJob {
+    console.log('🔧 ESP32 compilation requested');
 
-      // Write sketch file with processed code
-      fs.writeFileSync(sketchFile, processedCode, 'utf-8');
-      console.log(`✅ Created sketch: ${sketchFile}`);
+    // Inject Shim for GPIO Reporting
+    // Matches the "weak symbol override" strategy
+    const shimSource = path.join(__dirname, '..', 'shims', 'esp32-shim.cpp');
+    if (!fs.existsSync(shimSource)) {
+      console.warn(`⚠️ ESP32 Shim not found at ${shimSource}`);
+    }
 
-      // Get FQBN for the board and mode
-      const fqbn = this.getFQBN(board, mode);
-      console.log(`🔧 Compiling with arduino-cli: ${fqbn} (mode: ${mode})`);
+    // Locate eFuse (reuse static one for now)
+    const serverRoot = path.resolve(__dirname, '..', '..');
+    const efusePath = path.join(serverRoot, 'test-firmware', 'esp32', 'qemu_efuse.bin');
+
+    // TODO: Make this configurable per board variant. For now using generic DevKit V1
+    const fqbn = 'esp32:esp32:esp32doit-devkit-v1';
+    console.log(`🔧 Compiling ESP32 with arduino-cli: ${fqbn}`);
+
+    return {
+      code,
+      fqbn,
+      extraFiles: [shimSource],
+      injectedFiles: fs.existsSync(shimSource) ? { 'neuroforge_shim.cpp': shimSource } : {},
+      // Important for QEMU: generates merged bin
+      exportBinaries: true,
+      // ledcWrite/analogWrite/setup are not weak: the shim hooks them through linker wraps
+      buildProperties: fs.existsSync(shimSource)
+        ? [`compiler.c.elf.extra_flags=${ESP32_SHIM_WRAPS.map(symbol => `-Wl,--wrap=${symbol}`).join(' ')}`]
+        : [],
+      firmwareNames: [`${CompilerService.SKETCH_NAME}.ino.merged.bin`],
+      efusePath: fs.existsSync(efusePath) ? efusePath : undefined
+    };
+  }
 
-      // Compile using arduino-cli
-      const result = await this.runArduinoCli([
-        'compile',
-        '--fqbn', fqbn,
-        '--output-dir', sketchDir,
-        sketchDir
-      ]);
+  /**
+   * WebAssembly build of the sketch against the neuroforge_wasm core
+   */
+  private createWasmJob(code: string): BuildJob {
+    console.log(`🔧 Compiling to WebAssembly: ${WASM_CLANG}`);
+
+    return {
+      code: this.inoToCpp(code),
+      fqbn: WASM_FQBN,
+      extraFiles: this.getWasmCoreFiles(),
+      injectedFiles: {},
+      exportBinaries: false,
+      firmwareNames: [`${CompilerService.SKETCH_NAME}.wasm`],
+      toolchain: 'wasm'
+    };
+  }
 
-      if (result.exitCode !== 0) {
-        console.error('❌ Compilation failed with status:', result.exitCode);
-        console.error('STDOUT:', result.stdout);
-        console.error('STDERR:', result.stderr);
-        return {
-          success: false,
-          error: result.stderr || 'Compilation failed',
-          stdout: result.stdout,
-          stderr: result.stderr
-        };
+  /**
+   * .ino -> C++ the way arduino-cli does it: include Arduino.h and declare
+   * every top-level function before the first definition, so sketches can
+   * call functions defined further down. #line keeps errors on .ino lines.
+   * Only brace depth 0 counts: member functions in class bodies are skipped.
+   */
+  private inoToCpp(code: string): string {
+    const definition = /^([A-Za-z_][\w:<>*&\s]*?[\s*&])([A-Za-z_]\w*)\s*\(([^()]*)\)\s*(?:const\s*)?\{/gm;
+    const prototypes: string[] = [];
+    let firstIndex = -1;
+
+    for (const match of this.topLevelOnly(code).matchAll(definition)) {
+      const returnType = match[1].trim();
+      if (NOT_A_RETURN_TYPE.test(returnType) || /[=;]/.test(returnType)) continue;
+      if (firstIndex < 0) firstIndex = match.index!;
+
+      // Default arguments may only be given once: keep them on the definition
+      const params = match[3].split(',').map(param => param.replace(/=[^,]*$/, '').trim()).join(', ');
+      prototypes.push(`${returnType} ${match[2]}(${params});`);
+    }
+
+    const header = '#include <Arduino.h>\n#line 1 "sketch.ino"\n';
+    if (firstIndex < 0) {
+      return header + code;
+    }
+
+    const firstLine = code.slice(0, firstIndex).split('\n').length;
+    return header +
+      code.slice(0, firstIndex) +
+      prototypes.join('\n') +
+      `\n#line ${firstLine} "sketch.ino"\n` +
+      code.slice(firstIndex);
+  }
+
+  /**
+   * code with comments, literal contents and everything inside braces blanked
+   * (newlines kept), so offsets still match but only top-level text is left
+   */
+  private topLevelOnly(code: string): string {
+    const out = code.split('');
+    let depth = 0;
+    let i = 0;
+
+    const blank = (from: number, to: number) => {
+      for (let j = from; j < to; j++) if (out[j] !== '\n') out[j] = ' ';
+    };
+
+    while (i < code.length) {
+      const c = code[i];
+      const start = i;
+      if (c === '/' && code[i + 1] === '/') {
+        while (i < code.length && code[i] !== '\n') i++;
+        blank(start, i);
+      } else if (c === '/' && code[i + 1] === '*') {
+        const end = code.indexOf('*/', i + 2);
+        i = end < 0 ? code.length : end + 2;
+        blank(start, i);
+      } else if (c === '"' || c === "'") {
+        for (i++; i < code.length && code[i] !== c && code[i] !== '\n'; i++) {
+          if (code[i] === '\\') i++;
+        }
+        i++;
+        blank(depth > 0 ? start : start + 1, depth > 0 ? i : i - 1);
+      } else {
+        if (c === '}' && depth > 0) depth--;
+        if (depth > 0) blank(i, i + 1);
+        if (c === '{') depth++;
+        i++;
       }
+    }
 
-      // Find the hex/elf file (arduino-cli names it after the sketch)
-      const hexFile = path.join(sketchDir, `${sketchName}.ino.hex`);
-      const elfFile = path.join(sketchDir, `${sketchName}.ino.elf`);
+    return out.join('');
+  }
 
-      // Prefer .elf for QEMU, fallback to .hex
-      let firmwarePath: string;
-      if (fs.existsSync(elfFile)) {
-        firmwarePath = elfFile;
-        console.log(`✅ ELF firmware created: ${elfFile}`);
-      } else if (fs.existsSync(hexFile)) {
-        firmwarePath = hexFile;
-        console.log(`✅ HEX firmware created: ${hexFile}`);
+  /**
+   * Return a cached firmware for identical inputs, or build and cache it
+   */
+  private async compileCached(job: BuildJob, clientId?: string): Promise<CompileResult> {
+    try {
+      const key = this.cache.computeKey({
+        code: job.code,
+        fqbn: job.fqbn,
+        coreVersion: job.toolchain === 'wasm' ? await this.getWasmToolchainVersion() : await this.getCoreVersion(),
+        extraFiles: job.extraFiles,
+        buildProperties: job.buildProperties
+      });
+
+      const hit = this.cache.get(key);
+      if (hit) {
+        cacheHits.inc();
+        console.log(`⚡ Compile cache hit: ${key.slice(0, 12)} (${job.fqbn})`);
+        return { success: true, firmwarePath: hit.firmwarePath, efusePath: hit.efusePath, stdout: hit.stdout, cached: true };
+      }
+
+      // Same inputs already building: share that result
+      let pending = this.inFlight.get(key);
+      if (!pending) {
+        newBuilds.inc();
+        const entry = { clients: new Set<string>(), position: 0 };
+        const result = this.pool.run(this.slug(job.fqbn), worker => this.build(job, key, worker), {
+          onPosition: position => {
+            entry.position = position;
+            entry.clients.forEach(id => this.emit('queue-position', id, position));
+          }
+        });
+        pending = Object.assign(entry, { result });
+        this.inFlight.set(key, pending);
+        result.finally(() => this.inFlight.delete(key)).catch(() => undefined);
       } else {
-        return {
-          success: false,
-          error: 'Firmware file not found after compilation',
-          stdout: result.stdout,
-          stderr: result.stderr
-        };
+        joinedBuilds.inc();
+        console.log(`🔗 Joining in-flight compile: ${key.slice(0, 12)} (${job.fqbn})`);
       }
 
+      if (clientId && !pending.clients.has(clientId)) {
+        pending.clients.add(clientId);
+        this.emit('queue-position', clientId, pending.position);
+      }
+      return await pending.result;
+    } catch (error) {
+      return {
+        success: false,
+        error: error instanceof Error ? error.message : 'Unknown compilation error'
+      };
+    }
+  }
+
+  /**
+   * Run arduino-cli in the worker's work dir for the FQBN and store the result
+   * in the cache (key null: warm-up build, nothing is cached)
+   */
+  private async build(job: BuildJob, key: string | null, worker: CompileWorker): Promise<CompileResult> {
+    if (job.toolchain === 'wasm') {
+      return this.buildWasm(job, key, worker);
+    }
+
+    const fqbnDir = path.join(this.workDir, `w${worker.id}`, this.slug(job.fqbn));
+    // IMPORTANT: .ino file MUST have same name as folder (arduino-cli requirement)
+    const sketchDir = path.join(fqbnDir, CompilerService.SKETCH_NAME);
+    const sketchFile = path.join(sketchDir, `${CompilerService.SKETCH_NAME}.ino`);
+    const buildPath = path.join(fqbnDir, 'build');
+    const outputDir = path.join(fqbnDir, 'output');
+
+    fs.mkdirSync(sketchDir, { recursive: true });
+    fs.rmSync(outputDir, { recursive: true, force: true });
+
+    // Unchanged files keep their mtime, so their objects are reused from the build path
+    this.writeIfChanged(sketchFile, job.code);
+    for (const [name, source] of Object.entries(job.injectedFiles)) {
+      this.writeIfChanged(path.join(sketchDir, name), fs.readFileSync(source, 'utf-8'));
+    }
+
+    const args = ['compile', '--fqbn', job.fqbn, '--build-path', buildPath];
+    if (job.exportBinaries) {
+      args.push('--export-binaries');
+    }
+    for (const property of job.buildProperties ?? []) {
+      args.push('--build-property', property);
+    }
+    args.push('--output-dir', outputDir, sketchDir);
+
+    const startedAt = performance.now();
+    const result = await this.runArduinoCli(args);
+    (result.exitCode === 0 ? compileSucceeded : compileFailed).observeSince(startedAt);
+    // A failed build may have stopped before the core (sketch errors come first)
+    if (result.exitCode === 0) {
+      worker.warm.add(this.slug(job.fqbn));
+    }
+
+    if (result.exitCode !== 0) {
+      console.error('❌ Compilation failed with status:', result.exitCode);
+      console.error('STDOUT:', result.stdout);
+      console.error('STDERR:', result.stderr);
       return {
-        success: true,
-        firmwarePath,
+        success: false,
+        error: result.stderr || 'Compilation failed',
         stdout: result.stdout,
         stderr: result.stderr
       };
+    }
 
-    } catch (error) {
+    const firmwareName = job.firmwareNames.find(name => fs.existsSync(path.join(outputDir, name)));
+    if (!firmwareName) {
       return {
         success: false,
-        error: error instanceof Error ? error.message : 'Unknown error'
+        error: 'Firmware file not found after compilation',
+        stdout: result.stdout,
+        stderr: result.stderr
       };
     }
+
+    if (key === null) {
+      return { success: true, stdout: result.stdout, stderr: result.stderr };
+    }
+
+    const artifacts = fs.readdirSync(outputDir).map(file => path.join(outputDir, file));
+    const entry = this.cache.put(key, artifacts, firmwareName, result.stdout, job.efusePath);
+    console.log(`✅ Firmware created: ${entry.firmwarePath}`);
+
+    return {
+      success: true,
+      firmwarePath: entry.firmwarePath,
+      efusePath: entry.efusePath,
+      stdout: result.stdout,
+      stderr: result.stderr,
+      cached: false
+    };
   }
 
   /**
-   * ESP32 Compilation Logic
+   * clang++ (wasm32-wasi reactor) + wasm-opt --asyncify in the worker's work
+   * dir. Core objects are kept there and only rebuilt when the core changes.
    */
-  private async compileESP32(code: string, board: BoardType): Promise<CompileResult> {
-    console.log('🔧 ESP32 compilation requested');
+  private async buildWasm(job: BuildJob, key: string | null, worker: CompileWorker): Promise<CompileResult> {
+    const fqbnDir = path.join(this.workDir, `w${worker.id}`, this.slug(job.fqbn));
+    const buildPath = path.join(fqbnDir, 'build');
+    const outputDir = path.join(fqbnDir, 'output');
+    const coreDir = path.join(this.getCoresDir(), 'neuroforge_wasm');
+    const sketchFile = path.join(buildPath, `${CompilerService.SKETCH_NAME}.cpp`);
+    const rawWasm = path.join(buildPath, `${CompilerService.SKETCH_NAME}.raw.wasm`);
+    const firmware = path.join(outputDir, job.firmwareNames[0]);
+
+    fs.mkdirSync(buildPath, { recursive: true });
+    fs.rmSync(outputDir, { recursive: true, force: true });
+    fs.mkdirSync(outputDir, { recursive: true });
+    this.writeIfChanged(sketchFile, job.code);
+
+    const flags = [
+      '--target=wasm32-wasi',
+      `--sysroot=${path.join(WASI_SDK_PATH, 'share', 'wasi-sysroot')}`,
+      '-std=gnu++17', '-O2', '-fno-exceptions', '-fno-rtti',
+      '-Wall', '-Wno-unused-parameter',
+      `-I${coreDir}`
+    ];
+
+    const startedAt = performance.now();
+    let stdout = '';
+
+    // Core objects: rebuilt only when a core file is newer
+    const coreSources = job.extraFiles.filter(file => file.endsWith('.cpp'));
+    const coreUpdatedAt = Math.max(...job.extraFiles.map(file => fs.statSync(file).mtimeMs));
+    const coreObjects: string[] = [];
+    for (const source of coreSources) {
+      const object = path.join(buildPath, `${path.basename(source, '.cpp')}.o`);
+      coreObjects.push(object);
+      if (fs.existsSync(object) && fs.statSync(object).mtimeMs >= coreUpdatedAt) continue;
+
+      const result = await this.runProcess(WASM_CLANG, [...flags, '-c', source, '-o', object]);
+      stdout += result.stdout;
+      if (result.exitCode !== 0) {
+        compileFailed.observeSince(startedAt);
+        console.error('❌ WASM core build failed:', result.stderr);
+        return { success: false, error: result.stderr || 'WASM core build failed', stdout, stderr: result.stderr };
+      }
+    }
+    worker.warm.add(this.slug(job.fqbn)); // HAL objects are built, whatever the sketch does
+
+    const link = await this.runProcess(WASM_CLANG, [
+      ...flags,
+      '-mexec-model=reactor',
+      '-Wl,-z,stack-size=65536',
+      sketchFile, ...coreObjects,
+      '-o', rawWasm
+    ]);
+    stdout += link.stdout;
+
+    const optimize = link.exitCode === 0
+      ? await this.runProcess(WASM_OPT, [
+        rawWasm, '--asyncify', `--pass-arg=asyncify-imports@${WASM_ASYNC_IMPORTS.join(',')}`, '-O2', '-o', firmware
+      ])
+      : link;
+
+    (optimize.exitCode === 0 ? compileSucceeded : compileFailed).observeSince(startedAt);
+
+    if (optimize.exitCode !== 0) {
+      console.error('❌ WASM compilation failed with status:', optimize.exitCode);
+      console.error('STDERR:', optimize.stderr);
+      return {
+        success: false,
+        error: optimize.stderr || 'WASM compilation failed',
+        stdout,
+        stderr: optimize.stderr
+      };
+    }
 
-    const sketchName = `sketch_${Date.now()}`;
-    const sketchDir = path.join(this.tempDir, sketchName);
-    const sketchFile = path.join(sketchDir, `${sketchName}.ino`);
+    if (key === null) {
+      return { success: true, stdout, stderr: link.stderr };
+    }
 
-    try {
-      // 1. Create sketch directory
-      fs.mkdirSync(sketchDir, { recursive: true });
-
-      // 2. Write User Code
-      fs.writeFileSync(sketchFile, code, 'utf-8');
-
-      // 3. Inject Shim for GPIO Reporting
-      // Matches the "weak symbol override" strategy
-      const shimSource = path.join(__dirname, '..', 'shims', 'esp32-shim.cpp');
-      if (fs.existsSync(shimSource)) {
-        const shimDest = path.join(sketchDir, 'neuroforge_shim.cpp');
-        fs.copyFileSync(shimSource, shimDest);
-        console.log(`✅ Injected ESP32 Shim: ${shimDest}`);
-      } else {
-        console.warn(`⚠️ ESP32 Shim not found at ${shimSource}`);
-      }
+    const entry = this.cache.put(key, [firmware], path.basename(firmware), stdout);
+    console.log(`✅ WebAssembly module created: ${entry.firmwarePath}`);
 
-      // 4. Get FQBN
-      // TODO: Make this configurable per board variant. For now using generic DevKit V1
-      const fqbn = 'esp32:esp32:esp32doit-devkit-v1';
-      console.log(`🔧 Compiling ESP32 with arduino-cli: ${fqbn}`);
+    return {
+      success: true,
+      firmwarePath: entry.firmwarePath,
+      stdout,
+      stderr: link.stderr,
+      cached: false
+    };
+  }
 
-      // 5. Compile with --export-binaries to get the merged bin
-      const result = await this.runArduinoCli([
-        'compile',
-        '--fqbn', fqbn,
-        '--export-binaries', // Important for QEMU: generates merged bin
-        '--output-dir', sketchDir,
-        sketchDir
-      ]);
+  /**
+   * Work dir name of an FQBN
+   */
+  private slug(fqbn: string): string {
+    return fqbn.replace(/[^a-zA-Z0-9_-]+/g, '_');
+  }
 
-      if (result.exitCode !== 0) {
-        console.error('❌ ESP32 Compilation failed:', result.exitCode);
-        return {
-          success: false,
-          error: result.stderr || 'ESP32 Compilation failed',
-          stdout: result.stdout,
-          stderr: result.stderr
-        };
-      }
+  private writeIfChanged(file: string, content: string): void {
+    if (fs.existsSync(file) && fs.readFileSync(file, 'utf-8') === content) {
+      return;
+    }
+    fs.writeFileSync(file, content, 'utf-8');
+  }
 
-      // 6. Locate the merged binary
-      // arduino-cli with --export-binaries usually produces sketchName.ino.merged.bin
-      const mergedBin = path.join(sketchDir, `${sketchName}.ino.merged.bin`);
-
-      if (!fs.existsSync(mergedBin)) {
-        return {
-          success: false,
-          error: 'Merged firmware binary not found. Compilation might have succeeded but binary export failed.',
-          stdout: result.stdout,
-          stderr: result.stderr
-        };
-      }
+  /**
+   * Files of the neuroforge_qemu core that arduino-cli actually builds
+   * unoqemu firmware with: the installed copy under hardware/avr (patched
+   * wiring*.c and HardwareSerial included) plus the platform boards.txt.
+   * The repo's cores/ sources only count once install-core copies them,
+   * so a stale install never hits a cache entry built from newer sources.
+   */
+  private getQemuCoreFiles(): string[] {
+    const avrDir = this.getInstalledAvrDir();
+    const coreDir = avrDir && path.join(avrDir, 'cores', 'neuroforge_qemu');
+    if (!coreDir || !fs.existsSync(coreDir)) {
+      console.warn('⚠️ neuroforge_qemu core not installed (run server/cores/install-core)');
+      return [];
+    }
 
-      console.log(`✅ ESP32 Firmware created: ${mergedBin}`);
+    return fs.readdirSync(coreDir, { withFileTypes: true })
+      .filter(entry => entry.isFile() && !entry.name.endsWith('.backup'))
+      .map(entry => path.join(coreDir, entry.name))
+      .concat(path.join(avrDir, 'boards.txt'));
+  }
 
-      // 7. Locate eFuse (reuse static one for now)
-      const serverRoot = path.resolve(__dirname, '..', '..');
-      const efusePath = path.join(serverRoot, 'test-firmware', 'esp32', 'qemu_efuse.bin');
+  /**
+   * Installed arduino:avr platform, picked like the install scripts do
+   * (latest version under the arduino-cli data directory)
+   */
+  private getInstalledAvrDir(): string | null {
+    const dataDir = process.env.ARDUINO_DIRECTORIES_DATA || (
+      process.platform === 'win32' ? path.join(process.env.LOCALAPPDATA || os.homedir(), 'Arduino15')
+        : process.platform === 'darwin' ? path.join(os.homedir(), 'Library', 'Arduino15')
+          : path.join(os.homedir(), '.arduino15')
+    );
+    const avrBase = path.join(dataDir, 'packages', 'arduino', 'hardware', 'avr');
+    if (!fs.existsSync(avrBase)) return null;
+
+    const versions = fs.readdirSync(avrBase)
+      .sort((a, b) => a.localeCompare(b, undefined, { numeric: true }));
+    return versions.length > 0 ? path.join(avrBase, versions[versions.length - 1]) : null;
+  }
 
-      return {
-        success: true,
-        firmwarePath: mergedBin,
-        efusePath: fs.existsSync(efusePath) ? efusePath : undefined,
-        stdout: result.stdout,
-        stderr: result.stderr
-      };
+  /**
+   * Sources and headers of the neuroforge_wasm core (linked into every module)
+   */
+  private getWasmCoreFiles(): string[] {
+    const coreDir = path.join(this.getCoresDir(), 'neuroforge_wasm');
+    if (!fs.existsSync(coreDir)) return [];
 
-    } catch (error) {
-      return {
-        success: false,
-        error: error instanceof Error ? error.message : 'Unknown compilation error'
-      };
+    return fs.readdirSync(coreDir)
+      .filter(file => /\.(h|cpp)$/.test(file))
+      .map(file => path.join(coreDir, file));
+  }
+
+  private getCoresDir(): string {
+    return path.resolve(__dirname, '..', '..', 'cores');
+  }
+
+  /**
+   * Installed platform versions (arduino-cli core list), cached for a few minutes
+   */
+  private getCoreVersion(): Promise<string> {
+    const now = Date.now();
+    if (this.coreVersion && now - this.coreVersion.at < CompilerService.CORE_VERSION_TTL_MS) {
+      return this.coreVersion.value;
+    }
+
+    const value = this.runArduinoCli(['core', 'list', '--format', 'json'])
+      .then(result => result.exitCode === 0 ? result.stdout.trim() : 'unknown');
+    this.coreVersion = { value, at: now };
+    return value;
+  }
+
+  /**
+   * clang and wasm-opt versions, cached like the core version
+   */
+  private getWasmToolchainVersion(): Promise<string> {
+    const now = Date.now();
+    if (this.wasmToolchainVersion && now - this.wasmToolchainVersion.at < CompilerService.CORE_VERSION_TTL_MS) {
+      return this.wasmToolchainVersion.value;
     }
+
+    const value = Promise.all([
+      this.runProcess(WASM_CLANG, ['--version']),
+      this.runProcess(WASM_OPT, ['--version'])
+    ]).then(results => results.map(result => (result.exitCode === 0 ? result.stdout.trim() : 'unknown')).join('\n'));
+    this.wasmToolchainVersion = { value, at: now };
+    return value;
   }
 
   /**
    * Run arduino-cli command
    */
   private runArduinoCli(args: string[]): Promise<{ exitCode: number; stdout: string; stderr: string }> {
+    return this.runProcess(this.arduinoCliPath, args);
+  }
+
+  private runProcess(command: string, args: string[]): Promise<{ exitCode: number; stdout: string; stderr: string }> {
     return new Promise((resolve) => {
-      const proc = spawn(this.arduinoCliPath, args);
+      const proc = spawn(command, args);
 
       let stdout = '';
       let stderr = '';
@@ -304,20 +791,44 @@ export class CompilerService {
   }
 
   /**
-   * Clean up old compilation directories
+   * Register where firmware paths handed out by compile() are still in use
+   * (sessions, test runs): cleanup() keeps their cache entries
+   */
+  trackFirmwareUsers(users: () => Iterable<string>): void {
+    this.firmwareUsers.push(users);
+  }
+
+  /**
+   * Bound the cache (COMPILE_CACHE_MAX_MB, COMPILE_CACHE_MAX_AGE_H) and remove
+   * old compilation directories; runs every CLEANUP_INTERVAL_MS
    */
   cleanup(olderThanMs: number = 3600000): void {
     if (!fs.existsSync(this.tempDir)) return;
 
+    // Cache entries are evicted by last use; work dirs are kept for incremental builds
+    try {
+      const inUse = this.firmwareUsers.flatMap(users => [...users()]);
+      const freed = this.cache.cleanup(this.cacheLimits, inUse);
+      if (freed > 0) {
+        console.log(`🧹 Compile cache: ${(freed / 1024 / 1024).toFixed(1)} MB evicted`);
+      }
+    } catch (error) {
+      console.warn('⚠️ Compile cache cleanup failed:', error);
+    }
+
     const now = Date.now();
     const entries = fs.readdirSync(this.tempDir);
 
     for (const entry of entries) {
-      const entryPath = path.join(this.tempDir, entry);
-      const stats = fs.statSync(entryPath);
+      if (entry === 'cache' || entry === 'work') continue;
 
-      if (now - stats.mtimeMs > olderThanMs) {
-        fs.rmSync(entryPath, { recursive: true, force: true });
+      const entryPath = path.join(this.tempDir, entry);
+      try {
+        if (now - fs.statSync(entryPath).mtimeMs > olderThanMs) {
+          fs.rmSync(entryPath, { recursive: true, force: true });
+        }
+      } catch {
+        // Removed concurrently
       }
     }
   }
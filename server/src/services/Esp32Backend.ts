@@ -5,6 +5,15 @@ import * as path from 'path';
 import { execSync } from 'child_process';
 import { Esp32BackendConfig, Esp32RunnerHandle } from '../types/esp32.types';
 import { Esp32SerialClient } from './Esp32SerialClient';
+import { allocatePort, releasePort } from './PortAllocator';
+import { NF_HOST_OP, encodeFrame } from './NFWireProtocol';
+import { Esp32BootSnapshot } from './Esp32BootSnapshot';
+import type { Esp32SnapshotRun } from './Esp32BootSnapshot';
+import type { SerialFrameDecoder } from './SerialFramer';
+import { qemuSpawnSeconds, Tracer } from './Metrics';
+
+const spawnSeconds = qemuSpawnSeconds.labels('esp32');
+const stdoutTrace = new Tracer('qemu');
 
 /**
  * Backend para executar QEMU ESP32 (qemu-system-xtensa)
@@ -13,8 +22,17 @@ import { Esp32SerialClient } from './Esp32SerialClient';
 export class Esp32Backend extends EventEmitter {
   private process: ChildProcess | null = null;
   private serialClient: Esp32SerialClient | null = null;
+  private inputClient: Esp32SerialClient | null = null; // UART1: frames NF_OP_INPUT (esp32-shim.cpp)
+  private inputPort: number | null = null;
   private config: Esp32BackendConfig | null = null;
   private qemuPath: string;
+  private serialPort: number | null = null;
+  private allocatedPort = false; // serialPort came from PortAllocator
+  private snapshotRun: Esp32SnapshotRun | null = null;
+  private frameDecoder: SerialFrameDecoder | null = null; // Frames GPIO binários do shim (UART0)
+
+  /** Boot snapshots are shared by every backend using the same emulator */
+  private static bootSnapshots = new Map<string, Esp32BootSnapshot>();
 
   constructor(qemuPath?: string) {
     super();
@@ -183,13 +201,36 @@ export class Esp32Backend extends EventEmitter {
     }
 
     this.config = config;
-    const serialPort = config.flash.serialPort || parseInt(process.env.ESP32_SERIAL_PORT || '5555');
 
-    const args = this.buildQemuArgs(config, serialPort);
+    // Porta dinamica por padrao: varias sessoes ESP32 (e o AVR) no mesmo host
+    const fixedPort = config.flash.serialPort || parseInt(process.env.ESP32_SERIAL_PORT || '', 10);
+    this.allocatedPort = !(fixedPort > 0);
+    const serialPort = this.allocatedPort ? await allocatePort() : fixedPort;
+    this.serialPort = serialPort;
+
+    // UART0 = Serial do sketch; UART1 = canal de entrada do host (digitalRead), so do shim
+    const inputPort = await allocatePort();
+    this.inputPort = inputPort;
+    const serial = [
+      '-serial', `tcp::${serialPort},server,nowait`,
+      '-serial', `tcp::${inputPort},server,nowait`
+    ];
+    const buildArgs = (drives: string[], serialArgs: string[]) => this.buildQemuArgs(config, drives, serialArgs);
+
+    // Resume from the post-bootloader snapshot when enabled (cold boot otherwise)
+    if (Esp32BootSnapshot.enabled()) {
+      this.snapshotRun = await this.getBootSnapshot().prepare(config, buildArgs);
+    }
+
+    const args = buildArgs(this.snapshotRun?.drives ?? [
+      '-drive', `file=${config.flash.flashImagePath},if=mtd,format=raw`,
+      '-drive', `file=${config.flash.efuseImagePath},if=none,format=raw,id=efuse`
+    ], serial);
 
     console.log('🚀 Starting QEMU ESP32:', this.qemuPath);
     console.log('📋 Args:', args.join(' '));
 
+    const spawnedAt = performance.now();
     this.process = spawn(this.qemuPath, args, {
       stdio: ['ignore', 'pipe', 'pipe'],
       env: { ...process.env }
@@ -197,15 +238,20 @@ export class Esp32Backend extends EventEmitter {
 
     this.setupProcessHandlers();
 
-    // Aguardar QEMU inicializar e abrir o socket TCP
-    await this.waitForSerialPort(serialPort);
-
-    // Pequeno delay para garantir que o QEMU liberou o socket após o teste
-    await new Promise(resolve => setTimeout(resolve, 500));
+    // Conectar ao socket serial assim que o QEMU abrir a porta (sem sonda + sleep fixo)
+    this.serialClient = new Esp32SerialClient(serialPort, '127.0.0.1', {
+      reconnectDelay: 10,
+      maxReconnectAttempts: 500
+    });
+    this.serialClient.setFrameDecoder(this.frameDecoder);
+    await this.serialClient.connect(5000);
 
-    // Conectar ao socket serial
-    this.serialClient = new Esp32SerialClient(serialPort);
-    await this.serialClient.connect();
+    this.inputClient = new Esp32SerialClient(inputPort, '127.0.0.1', {
+      reconnectDelay: 10,
+      maxReconnectAttempts: 500
+    });
+    await this.inputClient.connect(5000);
+    spawnSeconds.observeSince(spawnedAt);
 
     // Forward eventos de linha para o backend
     this.serialClient.on('line', (line: string) => {
@@ -242,12 +288,13 @@ export class Esp32Backend extends EventEmitter {
       });
     }
 
-    // Capturar stdout (diagnósticos do QEMU, não serial do firmware)
+    // Capturar stdout (diagnósticos do QEMU, não serial do firmware); amostrado com NF_DEBUG=qemu
     if (this.process.stdout) {
       this.process.stdout.on('data', (chunk: Buffer) => {
+        if (!stdoutTrace.enabled) return;
         const msg = chunk.toString().trim();
         if (msg) {
-          console.log(`[QEMU ESP32 stdout]: ${msg}`);
+          stdoutTrace.sample(() => `QEMU ESP32 stdout: ${msg}`);
         }
       });
     }
@@ -256,7 +303,7 @@ export class Esp32Backend extends EventEmitter {
   /**
    * Constrói argumentos da linha de comando do QEMU ESP32
    */
-  private buildQemuArgs(config: Esp32BackendConfig, serialPort: number): string[] {
+  private buildQemuArgs(config: Esp32BackendConfig, drives: string[], serial: string[]): string[] {
     const memory = config.qemuOptions?.memory || process.env.ESP32_DEFAULT_MEMORY || '4M';
     const wdtDisable = config.qemuOptions?.wdtDisable !== false; // Default true
     const networkMode = config.qemuOptions?.networkMode || 'user';
@@ -266,12 +313,11 @@ export class Esp32Backend extends EventEmitter {
       ...(dataPath ? ['-L', dataPath] : []),
       '-M', 'esp32',
       '-m', memory,
-      '-drive', `file=${config.flash.flashImagePath},if=mtd,format=raw`,
-      '-drive', `file=${config.flash.efuseImagePath},if=none,format=raw,id=efuse`,
+      ...drives,
       '-global', 'driver=nvram.esp32.efuse,property=drive,value=efuse',
       ...(wdtDisable ? ['-global', 'driver=timer.esp32.timg,property=wdt_disable,value=true'] : []),
       '-nographic',
-      '-serial', `tcp::${serialPort},server,nowait`
+      ...serial
     ];
 
     if (networkMode !== 'none') {
@@ -283,34 +329,13 @@ export class Esp32Backend extends EventEmitter {
     return args;
   }
 
-  /**
-   * Aguarda o socket serial TCP estar disponível
-   */
-  private async waitForSerialPort(port: number, timeout: number = 5000): Promise<void> {
-    const net = await import('net');
-    const startTime = Date.now();
-
-    console.log(`⏳ Waiting for ESP32 serial port ${port}...`);
-
-    while (Date.now() - startTime < timeout) {
-      try {
-        await new Promise<void>((resolve, reject) => {
-          const client = net.connect({ port, host: '127.0.0.1' }, () => {
-            client.end();
-            resolve();
-          });
-          client.on('error', reject);
-          client.setTimeout(100);
-        });
-
-        console.log(`✅ ESP32 serial port ${port} is ready`);
-        return;
-      } catch {
-        await new Promise(resolve => setTimeout(resolve, 100));
-      }
+  private getBootSnapshot(): Esp32BootSnapshot {
+    let snapshot = Esp32Backend.bootSnapshots.get(this.qemuPath);
+    if (!snapshot) {
+      snapshot = new Esp32BootSnapshot(this.qemuPath);
+      Esp32Backend.bootSnapshots.set(this.qemuPath, snapshot);
     }
-
-    throw new Error(`Timeout waiting for ESP32 serial port ${port}`);
+    return snapshot;
   }
 
   /**
@@ -323,6 +348,10 @@ export class Esp32Backend extends EventEmitter {
       this.serialClient.disconnect();
       this.serialClient = null;
     }
+    if (this.inputClient) {
+      this.inputClient.disconnect();
+      this.inputClient = null;
+    }
 
     if (this.process) {
       this.process.kill('SIGTERM');
@@ -337,10 +366,24 @@ export class Esp32Backend extends EventEmitter {
    */
   private cleanup(): void {
     this.process = null;
+    if (this.snapshotRun) {
+      Esp32Backend.bootSnapshots.get(this.qemuPath)?.release(this.snapshotRun);
+      this.snapshotRun = null;
+    }
+    if (this.allocatedPort) {
+      releasePort(this.serialPort);
+      this.allocatedPort = false;
+    }
+    releasePort(this.inputPort);
+    this.inputPort = null;
     if (this.serialClient) {
       this.serialClient.disconnect();
       this.serialClient = null;
     }
+    if (this.inputClient) {
+      this.inputClient.disconnect();
+      this.inputClient = null;
+    }
   }
 
   /**
@@ -354,13 +397,21 @@ export class Esp32Backend extends EventEmitter {
    * Retorna informações de conexão serial
    */
   getSerialInfo(): { port: number; host: string } | null {
-    if (!this.config) return null;
+    if (!this.config || !this.serialPort) return null;
     return {
-      port: this.config.flash.serialPort || 5555,
+      port: this.serialPort,
       host: '127.0.0.1'
     };
   }
 
+  /**
+   * Decoder dos frames binários do shim, misturados ao Serial na UART0
+   */
+  setFrameDecoder(decoder: SerialFrameDecoder | null): void {
+    this.frameDecoder = decoder;
+    this.serialClient?.setFrameDecoder(decoder);
+  }
+
   /**
    * Envia dados para o serial (UART RX do ESP32)
    */
@@ -371,4 +422,22 @@ export class Esp32Backend extends EventEmitter {
     }
     return this.serialClient.write(data);
   }
+
+  /**
+   * Dirige um pino de entrada (digitalRead) pelo canal UART1 do shim.
+   * value NF_INPUT_RELEASE devolve o pino ao GPIO.
+   */
+  writeInput(pin: number, value: number): boolean {
+    return this.writeInputFrames(encodeFrame(NF_HOST_OP.INPUT, [pin, value]));
+  }
+
+  /**
+   * Envia frames host -> firmware (NF_OP_INPUT, NF_OP_ADC_*) pela UART1
+   */
+  writeInputFrames(frames: Buffer): boolean {
+    if (!this.inputClient || !this.inputClient.isConnected()) {
+      return false;
+    }
+    return this.inputClient.write(frames);
+  }
 }
@@ -0,0 +1,212 @@
+import { spawn, execFile, ChildProcess } from 'child_process';
+import { createHash } from 'crypto';
+import { promisify } from 'util';
+import * as fs from 'fs';
+import * as os from 'os';
+import * as path from 'path';
+import { GdbRemoteClient } from './GdbRemoteClient';
+import { allocatePort, releasePort } from './PortAllocator';
+import type { Esp32BackendConfig } from '../types/esp32.types';
+
+const execFileAsync = promisify(execFile);
+
+/** Flash layout written by esptool merge_bin (QEMU flash image) */
+const BOOTLOADER_OFFSET = 0x1000;
+const PARTITION_TABLE_END = 0x9000;
+
+const SNAPSHOT_NAME = 'nfboot';
+
+/**
+ * Builds the QEMU command line for a given set of -drive arguments
+ * (same machine, memory and globals as the run that will use the snapshot)
+ */
+export type Esp32ArgsBuilder = (drives: string[], serial: string[]) => string[];
+
+/**
+ * Drives (and -loadvm) for one run started from a boot snapshot
+ */
+export interface Esp32SnapshotRun {
+  drives: string[];
+  dir: string; // Per-run copy, removed by release()
+}
+
+/**
+ * Post-bootloader QEMU snapshots for ESP32 (ESP32_BOOT_SNAPSHOT=1)
+ *
+ * The ROM boot up to the 2nd-stage bootloader entry only depends on the
+ * bootloader, the partition table, the eFuses and the machine options, so
+ * it is executed once and saved with savevm. Flash and eFuse are attached
+ * as qcow2 overlays (savevm needs snapshot-capable drives); each run gets
+ * its own copy rebased onto its flash image and starts with -loadvm.
+ *
+ * The m25p80 flash model reads the whole image at startup and keeps it out
+ * of the migration state, so after -loadvm the bootloader loads the app of
+ * the current image. Any failure just means a cold boot.
+ */
+export class Esp32BootSnapshot {
+  private qemuPath: string;
+  private dir: string;
+  private templates = new Map<string, Promise<string | null>>();
+  private runCount = 0;
+
+  static enabled(): boolean {
+    return ['1', 'true'].includes((process.env.ESP32_BOOT_SNAPSHOT || '').toLowerCase());
+  }
+
+  constructor(qemuPath: string, dir: string = path.join(os.tmpdir(), 'neuroforge-esp32-snapshots')) {
+    this.qemuPath = qemuPath;
+    this.dir = dir;
+  }
+
+  /**
+   * Drives for a run restored from the boot snapshot, or null (cold boot)
+   */
+  async prepare(config: Esp32BackendConfig, buildArgs: Esp32ArgsBuilder): Promise<Esp32SnapshotRun | null> {
+    let runDir: string | null = null;
+
+    try {
+      const key = this.snapshotKey(config, buildArgs);
+      if (!key) return null;
+
+      if (!this.templates.has(key)) {
+        this.templates.set(key, this.createTemplate(key, config, buildArgs).catch((error) => {
+          console.warn('⚠️ ESP32 boot snapshot unavailable, using cold boot:', error.message);
+          return null;
+        }));
+      }
+      const template = await this.templates.get(key)!;
+      if (!template) return null;
+
+      runDir = path.join(this.dir, 'runs', `${process.pid}-${this.runCount++}`);
+      fs.mkdirSync(runDir, { recursive: true });
+      const flash = path.join(runDir, 'flash.qcow2');
+      const efuse = path.join(runDir, 'efuse.qcow2');
+      fs.copyFileSync(path.join(template, 'flash.qcow2'), flash);
+      fs.copyFileSync(path.join(template, 'efuse.qcow2'), efuse);
+
+      // Metadata only: the snapshot's flash clusters are empty, reads fall through to the new image
+      await this.qemuImg(['rebase', '-u', '-f', 'qcow2', '-b', path.resolve(config.flash.flashImagePath), '-F', 'raw', flash]);
+      await this.qemuImg(['rebase', '-u', '-f', 'qcow2', '-b', path.resolve(config.flash.efuseImagePath), '-F', 'raw', efuse]);
+
+      return {
+        drives: [...Esp32BootSnapshot.drives(flash, efuse), '-loadvm', SNAPSHOT_NAME],
+        dir: runDir
+      };
+    } catch (error: any) {
+      console.warn('⚠️ ESP32 boot snapshot restore failed, using cold boot:', error.message);
+      if (runDir) this.release({ drives: [], dir: runDir });
+      return null;
+    }
+  }
+
+  release(run: Esp32SnapshotRun | null): void {
+    if (run) {
+      fs.rmSync(run.dir, { recursive: true, force: true });
+    }
+  }
+
+  private static drives(flash: string, efuse: string): string[] {
+    return [
+      '-drive', `file=${flash},if=mtd,format=qcow2`,
+      '-drive', `file=${efuse},if=none,format=qcow2,id=efuse`
+    ];
+  }
+
+  /**
+   * Everything the boot up to the bootloader entry depends on
+   */
+  private snapshotKey(config: Esp32BackendConfig, buildArgs: Esp32ArgsBuilder): string | null {
+    const flash = fs.readFileSync(config.flash.flashImagePath);
+    if (flash.length < PARTITION_TABLE_END) return null;
+
+    const hash = createHash('sha256');
+    hash.update(flash.subarray(BOOTLOADER_OFFSET, PARTITION_TABLE_END));
+    hash.update(String(flash.length)); // Flash chip size
+    hash.update(fs.readFileSync(config.flash.efuseImagePath));
+    hash.update(buildArgs([], []).join('\0'));
+    hash.update(`${this.qemuPath}:${this.qemuMtime()}`);
+    return hash.digest('hex').slice(0, 16);
+  }
+
+  /**
+   * Boot once to the 2nd-stage bootloader entry and savevm there
+   */
+  private async createTemplate(key: string, config: Esp32BackendConfig, buildArgs: Esp32ArgsBuilder): Promise<string> {
+    const flashImage = fs.readFileSync(config.flash.flashImagePath);
+    // esp_image_header_t: magic, segment count, SPI mode, SPI speed/size, entry_addr
+    if (flashImage[BOOTLOADER_OFFSET] !== 0xe9) {
+      throw new Error('No bootloader image at 0x1000');
+    }
+    const entry = flashImage.readUInt32LE(BOOTLOADER_OFFSET + 4);
+
+    const dir = path.join(this.dir, key);
+    const tmpDir = `${dir}.tmp-${process.pid}`;
+    fs.rmSync(tmpDir, { recursive: true, force: true });
+    fs.mkdirSync(tmpDir, { recursive: true });
+
+    const flash = path.join(tmpDir, 'flash.qcow2');
+    const efuse = path.join(tmpDir, 'efuse.qcow2');
+    const gdbPort = await allocatePort();
+    let child: ChildProcess | null = null;
+    const gdb = new GdbRemoteClient();
+
+    try {
+      await this.qemuImg(['create', '-f', 'qcow2', '-b', path.resolve(config.flash.flashImagePath), '-F', 'raw', flash]);
+      await this.qemuImg(['create', '-f', 'qcow2', '-b', path.resolve(config.flash.efuseImagePath), '-F', 'raw', efuse]);
+
+      const args = [
+        ...buildArgs(Esp32BootSnapshot.drives(flash, efuse), ['-serial', 'null']),
+        '-S', '-gdb', `tcp:127.0.0.1:${gdbPort}`
+      ];
+      child = spawn(this.qemuPath, args, { stdio: 'ignore' });
+      child.on('error', () => undefined); // Surfaces as a gdb connect timeout
+
+      await gdb.connect(gdbPort);
+      await gdb.insertPoint(1, entry, 4);
+      gdb.continue();
+      await gdb.waitForStop(10000);
+      await gdb.removePoint(1, entry, 4);
+
+      const output = await gdb.monitorCommand(`savevm ${SNAPSHOT_NAME}`);
+      if (/error/i.test(output)) {
+        throw new Error(output.trim());
+      }
+    } catch (error) {
+      fs.rmSync(tmpDir, { recursive: true, force: true });
+      throw error;
+    } finally {
+      gdb.disconnect();
+      child?.kill('SIGKILL');
+      releasePort(gdbPort);
+    }
+
+    fs.rmSync(dir, { recursive: true, force: true });
+    fs.renameSync(tmpDir, dir);
+    console.log(`📸 ESP32 boot snapshot ready (${key}, bootloader entry 0x${entry.toString(16)})`);
+    return dir;
+  }
+
+  private async qemuImg(args: string[]): Promise<void> {
+    await execFileAsync(this.qemuImgPath(), args);
+  }
+
+  /**
+   * qemu-img next to the emulator (Espressif release), else from PATH
+   */
+  private qemuImgPath(): string {
+    const exe = process.platform === 'win32' ? 'qemu-img.exe' : 'qemu-img';
+    if (path.isAbsolute(this.qemuPath)) {
+      const sibling = path.join(path.dirname(this.qemuPath), exe);
+      if (fs.existsSync(sibling)) return sibling;
+    }
+    return exe;
+  }
+
+  private qemuMtime(): number {
+    try {
+      return fs.statSync(this.qemuPath).mtimeMs;
+    } catch {
+      return 0;
+    }
+  }
+}
@@ -1,54 +1,95 @@
 import { EventEmitter } from 'events';
 import * as net from 'net';
+import { SerialFramer } from './SerialFramer';
+import type { SerialFrameDecoder } from './SerialFramer';
+import { serialBytesTotal, serialLinesTotal, Tracer } from './Metrics';
+
+const serialBytes = serialBytesTotal.labels('esp32');
+const serialLines = serialLinesTotal.labels('esp32');
+const serialTrace = new Tracer('serial');
 
 /**
  * Cliente TCP para conectar ao socket serial do QEMU ESP32
- * Converte stream TCP em eventos de linha (similar ao stdout do AVR)
+ * Converte stream TCP em eventos de linha (similar ao stdout do AVR);
+ * frames binários do shim vão direto para o decoder, se houver
  */
 export class Esp32SerialClient extends EventEmitter {
   private client: net.Socket | null = null;
-  private buffer: string = '';
+  private framer = new SerialFramer();
   private port: number;
   private host: string;
   private reconnectAttempts: number = 0;
   private maxReconnectAttempts: number = 5;
   private reconnectDelay: number = 1000;
 
-  constructor(port: number = 5555, host: string = '127.0.0.1') {
+  constructor(
+    port: number = 5555,
+    host: string = '127.0.0.1',
+    options: { reconnectDelay?: number; maxReconnectAttempts?: number } = {}
+  ) {
     super();
     this.port = port;
     this.host = host;
+    this.reconnectDelay = options.reconnectDelay ?? this.reconnectDelay;
+    this.maxReconnectAttempts = options.maxReconnectAttempts ?? this.maxReconnectAttempts;
+  }
+
+  /**
+   * Decoder dos frames binários misturados ao texto (esp32-shim.cpp)
+   */
+  setFrameDecoder(decoder: SerialFrameDecoder | null): void {
+    this.framer.setDecoder(decoder);
   }
 
   /**
    * Conecta ao socket TCP do QEMU ESP32
+   *
+   * Tenta de novo (reconnectDelay) enquanto o QEMU ainda não abriu a porta.
    */
   async connect(timeout: number = 5000): Promise<void> {
+    const deadline = Date.now() + timeout;
+    this.reconnectAttempts = 0;
+
+    while (true) {
+      try {
+        await this.connectOnce(Math.max(0, deadline - Date.now()));
+        break;
+      } catch (error) {
+        if (this.reconnectAttempts >= this.maxReconnectAttempts || Date.now() + this.reconnectDelay > deadline) {
+          throw error;
+        }
+        this.reconnectAttempts++;
+        await new Promise(resolve => setTimeout(resolve, this.reconnectDelay));
+      }
+    }
+
+    this.reconnectAttempts = 0;
+    console.log(`✅ Connected to ESP32 serial: ${this.host}:${this.port}`);
+    this.setupClientHandlers();
+    this.emit('connected');
+  }
+
+  private connectOnce(timeout: number): Promise<void> {
     return new Promise((resolve, reject) => {
+      const socket = net.connect({ port: this.port, host: this.host });
+
       const timeoutId = setTimeout(() => {
-        this.disconnect();
+        socket.destroy();
         reject(new Error(`Timeout connecting to ESP32 serial on ${this.host}:${this.port}`));
       }, timeout);
 
-      this.client = net.connect({ port: this.port, host: this.host }, () => {
+      socket.once('connect', () => {
         clearTimeout(timeoutId);
-        this.reconnectAttempts = 0;
-        console.log(`✅ Connected to ESP32 serial: ${this.host}:${this.port}`);
-        this.emit('connected');
+        socket.removeAllListeners('error');
+        socket.setNoDelay(true);
+        this.client = socket;
         resolve();
       });
 
-      this.setupClientHandlers();
-
-      this.client.on('error', (error) => {
+      socket.once('error', (error) => {
         clearTimeout(timeoutId);
-        if (this.reconnectAttempts < this.maxReconnectAttempts) {
-          console.warn(`⚠️ Serial connection error, retrying... (${this.reconnectAttempts + 1}/${this.maxReconnectAttempts})`);
-          this.reconnectAttempts++;
-          setTimeout(() => this.connect(timeout), this.reconnectDelay);
-        } else {
-          reject(error);
-        }
+        socket.destroy();
+        reject(error);
       });
     });
   }
@@ -60,16 +101,15 @@ export class Esp32SerialClient extends EventEmitter {
     if (!this.client) return;
 
     this.client.on('data', (chunk: Buffer) => {
-      this.buffer += chunk.toString();
-
-      // Quebrar por linhas
-      const lines = this.buffer.split('\n');
-      this.buffer = lines.pop() || ''; // Última linha incompleta volta pro buffer
-
+      serialBytes.inc(chunk.length);
+      if (serialTrace.enabled) {
+        serialTrace.sample(() => `ESP32 serial read: ${chunk.length} bytes ${chunk.subarray(0, 16).toString('hex')}`);
+      }
+      // Linhas completas (já sem os frames binários); a incompleta fica no framer
+      const lines = this.framer.push(chunk);
+      serialLines.inc(lines.length);
       for (const line of lines) {
-        if (line.trim()) {
-          this.emit('line', line.trim());
-        }
+        this.emit('line', line);
       }
     });
 
@@ -79,10 +119,6 @@ export class Esp32SerialClient extends EventEmitter {
     });
 
     this.client.on('error', (error) => {
-      // Se ainda não estiver conectado, deixamos o handler do connect() cuidar do erro/retry
-      if (!this.isConnected()) {
-        return;
-      }
       console.error('ESP32 serial error:', error);
       this.emit('error', error);
     });
@@ -91,7 +127,7 @@ export class Esp32SerialClient extends EventEmitter {
   /**
    * Envia dados para o ESP32 (UART RX)
    */
-  write(data: string): boolean {
+  write(data: string | Buffer): boolean {
     if (!this.client || this.client.destroyed) {
       console.error('Cannot write to disconnected serial');
       return false;
@@ -106,7 +142,7 @@ export class Esp32SerialClient extends EventEmitter {
     if (this.client) {
       this.client.destroy();
       this.client = null;
-      this.buffer = '';
+      this.framer.reset();
     }
   }
 
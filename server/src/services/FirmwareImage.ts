@@ -0,0 +1,107 @@
+import * as fs from 'fs';
+
+/**
+ * Bytes to place at one flash address
+ */
+export interface FirmwareSegment {
+  address: number;
+  data: Buffer;
+}
+
+/** AVR ELF addresses at/above this are SRAM/EEPROM/fuses, not flash */
+const AVR_FLASH_END = 0x800000;
+
+const PT_LOAD = 1;
+
+/**
+ * Flash contents of an AVR firmware (.elf or .hex), as QEMU's -bios
+ * loader would place them. Used to program a pre-spawned, paused QEMU.
+ */
+export function loadAvrFlashImage(firmwarePath: string): FirmwareSegment[] {
+  const file = fs.readFileSync(firmwarePath);
+
+  if (file.length >= 4 && file.readUInt32BE(0) === 0x7f454c46) {
+    return parseElf32(file).filter(segment => segment.address < AVR_FLASH_END);
+  }
+
+  return parseIntelHex(file.toString('ascii'));
+}
+
+/**
+ * PT_LOAD segments at their load (physical) address: .data's initial
+ * values live in flash right after .text
+ */
+function parseElf32(file: Buffer): FirmwareSegment[] {
+  if (file[4] !== 1) {
+    throw new Error('Only 32-bit ELF firmware is supported');
+  }
+
+  const le = file[5] === 1;
+  const u16 = (offset: number) => (le ? file.readUInt16LE(offset) : file.readUInt16BE(offset));
+  const u32 = (offset: number) => (le ? file.readUInt32LE(offset) : file.readUInt32BE(offset));
+
+  const phoff = u32(28);
+  const phentsize = u16(42);
+  const phnum = u16(44);
+  const segments: FirmwareSegment[] = [];
+
+  for (let i = 0; i < phnum; i++) {
+    const ph = phoff + i * phentsize;
+    const filesz = u32(ph + 16);
+    if (u32(ph) !== PT_LOAD || filesz === 0) continue;
+
+    const offset = u32(ph + 4);
+    segments.push({
+      address: u32(ph + 12), // p_paddr
+      data: file.subarray(offset, offset + filesz)
+    });
+  }
+
+  return segments;
+}
+
+/**
+ * Intel HEX data records, merged into contiguous runs
+ */
+function parseIntelHex(text: string): FirmwareSegment[] {
+  const segments: FirmwareSegment[] = [];
+  let base = 0;
+  let current: { address: number; parts: Buffer[]; length: number } | null = null;
+
+  const flush = () => {
+    if (current) {
+      segments.push({ address: current.address, data: Buffer.concat(current.parts, current.length) });
+      current = null;
+    }
+  };
+
+  for (const rawLine of text.split('\n')) {
+    const line = rawLine.trim();
+    if (!line.startsWith(':')) continue;
+
+    const record = Buffer.from(line.slice(1), 'hex');
+    const length = record[0];
+    const offset = record.readUInt16BE(1);
+    const type = record[3];
+    const data = record.subarray(4, 4 + length);
+
+    if (type === 0x00) {
+      const address = base + offset;
+      if (!current || current.address + current.length !== address) {
+        flush();
+        current = { address, parts: [], length: 0 };
+      }
+      current.parts.push(data);
+      current.length += data.length;
+    } else if (type === 0x01) {
+      break;
+    } else if (type === 0x02) {
+      base = data.readUInt16BE(0) << 4;
+    } else if (type === 0x04) {
+      base = data.readUInt16BE(0) << 16;
+    }
+  }
+
+  flush();
+  return segments;
+}
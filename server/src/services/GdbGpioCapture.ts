@@ -0,0 +1,160 @@
+import { EventEmitter } from 'events';
+import { GdbRemoteClient } from './GdbRemoteClient';
+import type { PinStateUpdate } from './SerialGPIOParser';
+
+/** AVR data space in the gdbstub's address space */
+const AVR_DATA_OFFSET = 0x800000;
+
+/** PINB..PORTD (0x23-0x2B) inside one aligned 16-byte watch window */
+const WATCH_BASE = AVR_DATA_OFFSET + 0x20;
+const WATCH_SIZE = 16;
+const GPIO_BASE = AVR_DATA_OFFSET + 0x23;
+const GPIO_SIZE = 9;
+
+/** Register reads while the VM runs (QMP) during verify() */
+const VERIFY_INTERVAL_MS = 100;
+
+/** Offsets of [PIN, DDR, PORT] in the 9-byte dump, and the Arduino pins on bits 0.. */
+const PORTS: { offset: number; firstPin: number; bits: number }[] = [
+  { offset: 6, firstPin: 0, bits: 8 },  // PORTD: D0-D7
+  { offset: 0, firstPin: 8, bits: 6 },  // PORTB: D8-D13 (bits 6-7 are the crystal)
+  { offset: 3, firstPin: 14, bits: 6 }  // PORTC: A0-A5
+];
+
+/**
+ * GPIO capture through QEMU's gdbstub (no firmware cooperation)
+ *
+ * A write watchpoint covers the PINx/DDRx/PORTx registers of ports B, C
+ * and D. Every hit stops the VM right after the write; the registers are
+ * read back, diffed against the last snapshot and the VM continues. Works
+ * for digitalWrite() and direct PORTB/DDRB writes alike, with no UART
+ * traffic.
+ *
+ * An accepted Z2 packet does not mean the watchpoint fires: qemu-system-avr
+ * takes it, but OUT/SBI/CBI and data-space stores to I/O registers go
+ * through helper_outb -> address_space_stb, which never checks
+ * watchpoints. verify() compares the registers read over QMP against the
+ * watch hits and tells the engine to fall back to polling.
+ *
+ * Events:
+ * - 'pin-change' (PinStateUpdate)
+ */
+export class GdbGpioCapture extends EventEmitter {
+  private gdb: GdbRemoteClient;
+  private last: Buffer | null = null;
+  private active = false;
+  private hits = 0;
+  private verifyTimer: NodeJS.Timeout | null = null;
+  private onStop = (reply: string) => this.handleStop(reply);
+
+  constructor(gdb: GdbRemoteClient) {
+    super();
+    this.gdb = gdb;
+  }
+
+  /**
+   * Insert the watchpoint and take the initial register snapshot.
+   * The VM must be halted; the caller resumes it afterwards.
+   * Throws if the gdbstub refuses write watchpoints.
+   */
+  async start(): Promise<void> {
+    await this.gdb.insertPoint(2, WATCH_BASE, WATCH_SIZE);
+    this.active = true;
+    this.gdb.on('stop', this.onStop);
+    await this.sample();
+  }
+
+  stop(): void {
+    this.active = false;
+    this.gdb.off('stop', this.onStop);
+    if (this.verifyTimer) {
+      clearTimeout(this.verifyTimer);
+      this.verifyTimer = null;
+    }
+  }
+
+  /**
+   * Check that the watchpoint actually fires, reading the registers with
+   * the VM running (QMP). Resolves true on the first watch hit, false once
+   * DDRx/PORTx differ from the last snapshot on two reads in a row with no
+   * hit at all (PINx is left out: inputs change without a write). Keeps
+   * reading until one of the two happens; a sketch that never touches
+   * its ports has nothing to report either way.
+   */
+  verify(readRegisters: (address: number, length: number) => Promise<Buffer>): Promise<boolean> {
+    return new Promise(resolve => {
+      let mismatches = 0;
+
+      const check = async () => {
+        this.verifyTimer = null;
+        if (!this.active) return;
+        if (this.hits > 0) return resolve(true);
+
+        try {
+          const io = await readRegisters(GPIO_BASE, GPIO_SIZE);
+          if (this.hits > 0) return resolve(true);
+          mismatches = this.last && this.outputsDiffer(this.last, io) ? mismatches + 1 : 0;
+          if (mismatches >= 2) return resolve(false);
+        } catch {
+          // Monitor busy or VM exiting: try again on the next tick
+        }
+        if (this.active) this.verifyTimer = setTimeout(check, VERIFY_INTERVAL_MS);
+      };
+
+      this.verifyTimer = setTimeout(check, VERIFY_INTERVAL_MS);
+    });
+  }
+
+  /** Watchpoint hits so far */
+  getHits(): number {
+    return this.hits;
+  }
+
+  private handleStop(reply: string): void {
+    if (!this.active) return;
+
+    // T05watch:<addr>;... - anything else (QMP stop, exit) is not ours to resume
+    if (!/(^|;)(watch|awatch|rwatch):/.test(reply.slice(3))) return;
+
+    this.hits++;
+    this.sample()
+      .then(() => {
+        if (this.active) this.gdb.continue();
+      })
+      .catch(() => undefined); // VM gone; the runner reports the exit
+  }
+
+  private outputsDiffer(a: Buffer, b: Buffer): boolean {
+    return PORTS.some(({ offset }) => a[offset + 1] !== b[offset + 1] || a[offset + 2] !== b[offset + 2]);
+  }
+
+  private async sample(): Promise<void> {
+    const io = await this.gdb.readMemory(GPIO_BASE, GPIO_SIZE);
+    const last = this.last;
+    this.last = io;
+    if (!last) return; // Reset state: everything is an input, nothing to report
+
+    for (const { offset, firstPin, bits } of PORTS) {
+      const ddr = io[offset + 1];
+      const port = io[offset + 2];
+      const pin = io[offset];
+
+      if (last[offset + 1] === ddr && last[offset + 2] === port && last[offset] === pin) continue;
+
+      for (let bit = 0; bit < bits; bit++) {
+        const mask = 1 << bit;
+        const output = (ddr & mask) !== 0;
+        // Outputs show the driven level, inputs what the pin reads
+        const value = (output ? port : pin) & mask ? 1 : 0;
+        const mode = output ? 'OUTPUT' : (port & mask ? 'INPUT_PULLUP' : 'INPUT');
+
+        const lastOutput = (last[offset + 1] & mask) !== 0;
+        const lastValue = (lastOutput ? last[offset + 2] : last[offset]) & mask ? 1 : 0;
+        const lastMode = lastOutput ? 'OUTPUT' : (last[offset + 2] & mask ? 'INPUT_PULLUP' : 'INPUT');
+        if (lastValue === value && lastMode === mode) continue;
+
+        this.emit('pin-change', { pin: firstPin + bit, value, mode } as PinStateUpdate);
+      }
+    }
+  }
+}
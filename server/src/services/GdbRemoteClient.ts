@@ -0,0 +1,233 @@
+import { EventEmitter } from 'events';
+import * as net from 'net';
+
+/**
+ * Minimal GDB Remote Serial Protocol client for QEMU's gdbstub (-gdb tcp:...)
+ *
+ * Only what the backend needs to drive a paused VM: memory writes,
+ * breakpoints, continue and stop replies. Packets are answered in order,
+ * so requests are queued one at a time.
+ *
+ * Events:
+ * - 'stop' (reply): the VM stopped after continue() (e.g. "T05")
+ * - 'output' (text): console output of a monitor command
+ * - 'close'
+ */
+export class GdbRemoteClient extends EventEmitter {
+  /** Data bytes per memory write packet (QEMU's packet buffer is 4 KB of hex) */
+  private static readonly WRITE_CHUNK = 1024;
+
+  private socket: net.Socket | null = null;
+  private buffer = '';
+  private noAck = false;
+  private running = false; // continue() sent, stop reply pending
+  private pending: { resolve: (reply: string) => void; reject: (error: Error) => void } | null = null;
+  private queue: Promise<unknown> = Promise.resolve();
+
+  /**
+   * Connect to the gdbstub, retrying until QEMU listens
+   */
+  async connect(port: number, host: string = '127.0.0.1', timeout: number = 5000): Promise<void> {
+    const startTime = Date.now();
+
+    while (true) {
+      try {
+        this.socket = await new Promise<net.Socket>((resolve, reject) => {
+          const socket = net.connect({ port, host }, () => resolve(socket));
+          socket.once('error', reject);
+        });
+        break;
+      } catch (error) {
+        if (Date.now() - startTime > timeout) {
+          throw new Error(`Timeout connecting to gdbstub on ${host}:${port}`);
+        }
+        await new Promise(resolve => setTimeout(resolve, 20));
+      }
+    }
+
+    this.socket.setNoDelay(true);
+    this.socket.on('data', (data: Buffer) => this.handleData(data.toString('latin1')));
+    this.socket.on('error', () => undefined);
+    this.socket.on('close', () => {
+      this.socket = null;
+      this.pending?.reject(new Error('gdbstub connection closed'));
+      this.pending = null;
+      this.emit('close');
+    });
+
+    // Acks are useless over TCP and double the round trips
+    if ((await this.request('QStartNoAckMode')) === 'OK') {
+      this.noAck = true;
+    }
+  }
+
+  disconnect(): void {
+    if (this.socket) {
+      this.socket.destroy();
+      this.socket = null;
+    }
+  }
+
+  isConnected(): boolean {
+    return this.socket !== null;
+  }
+
+  /**
+   * Send one packet and wait for its reply
+   */
+  request(payload: string): Promise<string> {
+    const run = this.queue.then(() => new Promise<string>((resolve, reject) => {
+      if (!this.socket) {
+        reject(new Error('Not connected to gdbstub'));
+        return;
+      }
+      this.pending = { resolve, reject };
+      this.socket.write(GdbRemoteClient.frame(payload), 'latin1');
+    }));
+    this.queue = run.catch(() => undefined);
+    return run;
+  }
+
+  /**
+   * Write target memory (AVR: flash at 0x000000, SRAM at 0x800000)
+   */
+  async writeMemory(address: number, data: Buffer): Promise<void> {
+    for (let offset = 0; offset < data.length; offset += GdbRemoteClient.WRITE_CHUNK) {
+      const chunk = data.subarray(offset, offset + GdbRemoteClient.WRITE_CHUNK);
+      const reply = await this.request(`M${(address + offset).toString(16)},${chunk.length.toString(16)}:${chunk.toString('hex')}`);
+      if (reply !== 'OK') {
+        throw new Error(`gdbstub memory write failed at 0x${(address + offset).toString(16)}: ${reply}`);
+      }
+    }
+  }
+
+  async readMemory(address: number, length: number): Promise<Buffer> {
+    const reply = await this.request(`m${address.toString(16)},${length.toString(16)}`);
+    if (reply.startsWith('E')) {
+      throw new Error(`gdbstub memory read failed at 0x${address.toString(16)}: ${reply}`);
+    }
+    return Buffer.from(reply, 'hex');
+  }
+
+  /**
+   * Insert a breakpoint/watchpoint (type 0 sw, 1 hw, 2 write, 3 read, 4 access)
+   */
+  async insertPoint(type: number, address: number, kind: number): Promise<void> {
+    const reply = await this.request(`Z${type},${address.toString(16)},${kind.toString(16)}`);
+    if (reply !== 'OK') {
+      throw new Error(`gdbstub refused Z${type} at 0x${address.toString(16)}: ${reply || 'unsupported'}`);
+    }
+  }
+
+  async removePoint(type: number, address: number, kind: number): Promise<void> {
+    await this.request(`z${type},${address.toString(16)},${kind.toString(16)}`);
+  }
+
+  /**
+   * Run a QEMU monitor (HMP) command through the stub ("monitor <cmd>" in gdb)
+   */
+  async monitorCommand(command: string): Promise<string> {
+    let output = '';
+    const onOutput = (text: string) => {
+      output += text;
+    };
+
+    this.on('output', onOutput);
+    try {
+      const reply = await this.request(`qRcmd,${Buffer.from(command, 'latin1').toString('hex')}`);
+      if (reply !== 'OK' && reply !== '') {
+        throw new Error(`gdbstub monitor command failed (${command}): ${reply}`);
+      }
+      return output;
+    } finally {
+      this.off('output', onOutput);
+    }
+  }
+
+  /**
+   * Resume the VM; the stop reply arrives later as a 'stop' event
+   */
+  continue(): void {
+    if (!this.socket) {
+      throw new Error('Not connected to gdbstub');
+    }
+    this.running = true;
+    this.socket.write(GdbRemoteClient.frame('c'), 'latin1');
+  }
+
+  /**
+   * Resolve with the next stop reply
+   */
+  waitForStop(timeout: number): Promise<string> {
+    return new Promise((resolve, reject) => {
+      const timer = setTimeout(() => {
+        this.off('stop', onStop);
+        reject(new Error('Timeout waiting for the VM to stop'));
+      }, timeout);
+      const onStop = (reply: string) => {
+        clearTimeout(timer);
+        resolve(reply);
+      };
+      this.once('stop', onStop);
+    });
+  }
+
+  private handleData(data: string): void {
+    this.buffer += data;
+
+    while (this.buffer.length > 0) {
+      const ch = this.buffer[0];
+      if (ch === '+' || ch === '-') {
+        this.buffer = this.buffer.slice(1);
+        continue;
+      }
+
+      const start = this.buffer.indexOf('$');
+      if (start === -1) {
+        this.buffer = '';
+        return;
+      }
+
+      const end = this.buffer.indexOf('#', start);
+      if (end === -1 || end + 2 >= this.buffer.length) {
+        this.buffer = this.buffer.slice(start);
+        return; // Incomplete packet
+      }
+
+      const payload = this.buffer.slice(start + 1, end);
+      this.buffer = this.buffer.slice(end + 3);
+      if (!this.noAck) {
+        this.socket?.write('+');
+      }
+      this.dispatch(payload);
+    }
+  }
+
+  private dispatch(payload: string): void {
+    // Stop replies (T/S/W/X) after continue() are not answers to a request;
+    // QEMU also sends one when the VM is stopped or hits a watchpoint after a QMP "cont"
+    if ((this.running || !this.pending) && /^[TSWX]/.test(payload)) {
+      this.running = false;
+      this.emit('stop', payload);
+      return;
+    }
+
+    // "O<hex>": console output ahead of the final reply to qRcmd
+    if (this.pending && payload.length > 1 && payload[0] === 'O' && payload !== 'OK') {
+      this.emit('output', Buffer.from(payload.slice(1), 'hex').toString('latin1'));
+      return;
+    }
+
+    const pending = this.pending;
+    this.pending = null;
+    pending?.resolve(payload);
+  }
+
+  private static frame(payload: string): string {
+    let sum = 0;
+    for (let i = 0; i < payload.length; i++) {
+      sum = (sum + payload.charCodeAt(i)) & 0xff;
+    }
+    return `$${payload}#${sum.toString(16).padStart(2, '0')}`;
+  }
+}
@@ -0,0 +1,79 @@
+import { NF_HOST_OP, encodeFrame } from './NFWireProtocol';
+
+/**
+ * How the firmware reports one pin (nf_gpio_set_policy):
+ * - off:       never (pins the canvas does not show)
+ * - edge:      every change (default)
+ * - aggregate: one summary per window (edge count, fraction of time HIGH)
+ */
+export type GpioPinPolicy = 'off' | 'edge' | 'aggregate';
+
+export interface GpioPolicy {
+  default: GpioPinPolicy;
+  pins: Record<number, GpioPinPolicy>;
+  windowMs: number;
+}
+
+/** Pins covered by the firmware's policy masks (nf_gpio.cpp) */
+export const GPIO_POLICY_PINS = 32;
+
+const POLICIES: GpioPinPolicy[] = ['off', 'edge', 'aggregate'];
+
+/**
+ * Validate a request body ({ default?, pins?: { "13": "aggregate", ... }, windowMs? })
+ */
+export function parseGpioPolicy(body: any): GpioPolicy {
+  const policyOf = (value: any, name: string): GpioPinPolicy => {
+    if (!POLICIES.includes(value)) {
+      throw new Error(`${name} must be one of: ${POLICIES.join(', ')}`);
+    }
+    return value;
+  };
+
+  const policy: GpioPolicy = {
+    default: body?.default !== undefined ? policyOf(body.default, 'default') : 'edge',
+    pins: {},
+    windowMs: 50
+  };
+
+  if (body?.pins !== undefined) {
+    if (typeof body.pins !== 'object' || body.pins === null || Array.isArray(body.pins)) {
+      throw new Error('pins must be an object of pin -> policy');
+    }
+    for (const [key, value] of Object.entries(body.pins)) {
+      const pin = Number(key);
+      if (!Number.isInteger(pin) || pin < 0 || pin >= GPIO_POLICY_PINS) {
+        throw new Error(`Invalid pin '${key}' (0-${GPIO_POLICY_PINS - 1})`);
+      }
+      policy.pins[pin] = policyOf(value, `pins.${key}`);
+    }
+  }
+
+  if (body?.windowMs !== undefined) {
+    if (!Number.isInteger(body.windowMs) || body.windowMs < 1 || body.windowMs > 0xffff) {
+      throw new Error('windowMs must be an integer between 1 and 65535');
+    }
+    policy.windowMs = body.windowMs;
+  }
+
+  return policy;
+}
+
+/**
+ * NF_HOST_OP.POLICY frame: off mask, aggregate mask (uint32 LE), window (uint16 LE)
+ */
+export function encodeGpioPolicy(policy: GpioPolicy): Buffer {
+  let off = 0;
+  let aggregate = 0;
+  for (let pin = 0; pin < GPIO_POLICY_PINS; pin++) {
+    const pinPolicy = policy.pins[pin] ?? policy.default;
+    if (pinPolicy === 'off') off |= 1 << pin;
+    if (pinPolicy === 'aggregate') aggregate |= 1 << pin;
+  }
+
+  const payload = Buffer.alloc(10);
+  payload.writeUInt32LE(off >>> 0, 0);
+  payload.writeUInt32LE(aggregate >>> 0, 4);
+  payload.writeUInt16LE(policy.windowMs, 8);
+  return encodeFrame(NF_HOST_OP.POLICY, payload);
+}
@@ -0,0 +1,304 @@
+/**
+ * In-process counters, gauges and histograms, rendered in the Prometheus
+ * text format by GET /api/metrics
+ *
+ * Hot paths resolve their labeled child once (module constant) and only do
+ * an addition per event; nothing is formatted until the route is scraped.
+ */
+
+type MetricType = 'counter' | 'gauge' | 'histogram';
+
+interface MetricFamily {
+  name: string;
+  help: string;
+  type: MetricType;
+  labelNames: string[];
+  render(): string[];
+}
+
+function labelText(names: string[], values: string[], extra = ''): string {
+  const pairs = names.map((name, i) => `${name}="${values[i].replace(/["\\\n]/g, c => (c === '\n' ? '\\n' : `\\${c}`))}"`);
+  if (extra) pairs.push(extra);
+  return pairs.length > 0 ? `{${pairs.join(',')}}` : '';
+}
+
+export class CounterChild {
+  value = 0;
+
+  inc(amount = 1): void {
+    this.value += amount;
+  }
+}
+
+export class GaugeChild {
+  value = 0;
+
+  set(value: number): void {
+    this.value = value;
+  }
+
+  inc(amount = 1): void {
+    this.value += amount;
+  }
+
+  dec(amount = 1): void {
+    this.value -= amount;
+  }
+}
+
+export class HistogramChild {
+  readonly counts: number[];
+  sum = 0;
+  count = 0;
+  private readonly buckets: number[];
+
+  constructor(buckets: number[]) {
+    this.buckets = buckets;
+    this.counts = new Array(buckets.length).fill(0);
+  }
+
+  observe(value: number): void {
+    this.sum += value;
+    this.count++;
+    for (let i = 0; i < this.buckets.length; i++) {
+      if (value <= this.buckets[i]) {
+        this.counts[i]++;
+        return;
+      }
+    }
+  }
+
+  /**
+   * Observe the seconds elapsed since a performance.now() timestamp
+   */
+  observeSince(startMs: number): void {
+    this.observe((performance.now() - startMs) / 1000);
+  }
+}
+
+abstract class Metric<T> implements MetricFamily {
+  abstract readonly type: MetricType;
+  readonly name: string;
+  readonly help: string;
+  readonly labelNames: string[];
+  protected children = new Map<string, { values: string[]; child: T }>();
+
+  constructor(name: string, help: string, labelNames: string[] = []) {
+    this.name = name;
+    this.help = help;
+    this.labelNames = labelNames;
+  }
+
+  /**
+   * Child for one combination of label values (cached; resolve it once on hot paths)
+   */
+  labels(...values: string[]): T {
+    const key = values.join('\u0000');
+    let entry = this.children.get(key);
+    if (!entry) {
+      entry = { values, child: this.create() };
+      this.children.set(key, entry);
+    }
+    return entry.child;
+  }
+
+  protected abstract create(): T;
+  abstract render(): string[];
+}
+
+export class Counter extends Metric<CounterChild> {
+  readonly type = 'counter';
+
+  inc(amount = 1): void {
+    this.labels().inc(amount);
+  }
+
+  protected create(): CounterChild {
+    return new CounterChild();
+  }
+
+  render(): string[] {
+    return Array.from(this.children.values(), ({ values, child }) =>
+      `${this.name}${labelText(this.labelNames, values)} ${child.value}`);
+  }
+}
+
+export class Gauge extends Metric<GaugeChild> {
+  readonly type = 'gauge';
+  private collector: (() => void) | null = null;
+
+  set(value: number): void {
+    this.labels().set(value);
+  }
+
+  inc(amount = 1): void {
+    this.labels().inc(amount);
+  }
+
+  dec(amount = 1): void {
+    this.labels().dec(amount);
+  }
+
+  /**
+   * Refresh the value at scrape time instead of on every change
+   */
+  collect(collector: () => void): this {
+    this.collector = collector;
+    return this;
+  }
+
+  protected create(): GaugeChild {
+    return new GaugeChild();
+  }
+
+  render(): string[] {
+    this.collector?.();
+    return Array.from(this.children.values(), ({ values, child }) =>
+      `${this.name}${labelText(this.labelNames, values)} ${child.value}`);
+  }
+}
+
+export class Histogram extends Metric<HistogramChild> {
+  readonly type = 'histogram';
+  readonly buckets: number[];
+
+  constructor(name: string, help: string, buckets: number[], labelNames: string[] = []) {
+    super(name, help, labelNames);
+    this.buckets = buckets;
+  }
+
+  observe(value: number): void {
+    this.labels().observe(value);
+  }
+
+  observeSince(startMs: number): void {
+    this.labels().observeSince(startMs);
+  }
+
+  protected create(): HistogramChild {
+    return new HistogramChild(this.buckets);
+  }
+
+  render(): string[] {
+    const lines: string[] = [];
+    for (const { values, child } of this.children.values()) {
+      let cumulative = 0;
+      this.buckets.forEach((bound, i) => {
+        cumulative += child.counts[i];
+        lines.push(`${this.name}_bucket${labelText(this.labelNames, values, `le="${bound}"`)} ${cumulative}`);
+      });
+      lines.push(`${this.name}_bucket${labelText(this.labelNames, values, 'le="+Inf"')} ${child.count}`);
+      lines.push(`${this.name}_sum${labelText(this.labelNames, values)} ${child.sum}`);
+      lines.push(`${this.name}_count${labelText(this.labelNames, values)} ${child.count}`);
+    }
+    return lines;
+  }
+}
+
+export class MetricsRegistry {
+  private families = new Map<string, MetricFamily>();
+
+  counter(name: string, help: string, labelNames: string[] = []): Counter {
+    return this.register(new Counter(name, help, labelNames));
+  }
+
+  gauge(name: string, help: string, labelNames: string[] = []): Gauge {
+    return this.register(new Gauge(name, help, labelNames));
+  }
+
+  histogram(name: string, help: string, buckets: number[], labelNames: string[] = []): Histogram {
+    return this.register(new Histogram(name, help, buckets, labelNames));
+  }
+
+  /**
+   * Prometheus text exposition format (version 0.0.4)
+   */
+  render(): string {
+    const lines: string[] = [];
+    for (const family of this.families.values()) {
+      lines.push(`# HELP ${family.name} ${family.help}`);
+      lines.push(`# TYPE ${family.name} ${family.type}`);
+      lines.push(...family.render());
+    }
+    return lines.join('\n') + '\n';
+  }
+
+  private register<T extends MetricFamily>(metric: T): T {
+    if (this.families.has(metric.name)) {
+      throw new Error(`Metric already registered: ${metric.name}`);
+    }
+    this.families.set(metric.name, metric);
+    return metric;
+  }
+}
+
+export const metrics = new MetricsRegistry();
+
+/** Bucket sets (seconds) */
+export const STARTUP_BUCKETS = [0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10];
+export const COMPILE_BUCKETS = [0.5, 1, 2, 5, 10, 20, 30, 60, 120];
+export const DELIVERY_BUCKETS = [0.001, 0.005, 0.01, 0.02, 0.05, 0.1, 0.25, 0.5, 1];
+
+/**
+ * Sampled debug tracing, replacing per-event console logs
+ *
+ * NF_DEBUG=serial,gpio,ws (or *) enables categories; each one logs 1 of
+ * every NF_DEBUG_SAMPLE events (default 100). Disabled categories cost a
+ * boolean check: guard with `if (trace.enabled)` before building messages.
+ */
+export class Tracer {
+  readonly category: string;
+  readonly enabled: boolean;
+  private readonly every: number;
+  private seen = 0;
+
+  constructor(category: string) {
+    this.category = category;
+    const categories = (process.env.NF_DEBUG ?? '').split(',').map(name => name.trim());
+    this.enabled = categories.includes('*') || categories.includes(category);
+    this.every = Math.max(1, parseInt(process.env.NF_DEBUG_SAMPLE || '', 10) || 100);
+  }
+
+  sample(describe: () => string): void {
+    if (!this.enabled) return;
+    if (this.seen++ % this.every === 0) {
+      console.debug(`🔬 [${this.category}] ${describe()} (1/${this.every}, #${this.seen})`);
+    }
+  }
+}
+
+// Backend metrics, declared here so /metrics lists them before first use
+
+export const qemuSpawnSeconds = metrics.histogram(
+  'nf_qemu_spawn_seconds', 'QEMU process spawn until its monitor/serial is ready', STARTUP_BUCKETS, ['backend']);
+export const qemuMonitorConnectSeconds = metrics.histogram(
+  'nf_qemu_monitor_connect_seconds', 'QMP connect and capabilities negotiation', STARTUP_BUCKETS);
+
+export const serialBytesTotal = metrics.counter(
+  'nf_serial_bytes_total', 'Bytes read from the firmware UART (text and frames)', ['backend']);
+export const serialLinesTotal = metrics.counter(
+  'nf_serial_lines_total', 'Text lines split from the firmware UART', ['backend']);
+
+export const gpioFramesTotal = metrics.counter(
+  'nf_gpio_frames_total', 'GPIO protocol frames decoded, by opcode (ascii = G: lines)', ['op']);
+export const gpioPinEventsTotal = metrics.counter(
+  'nf_gpio_pin_events_total', 'Pin updates applied by the simulation engines');
+
+export const wsClients = metrics.gauge('nf_ws_clients', 'Connected websocket clients');
+export const wsEmitsTotal = metrics.counter('nf_ws_emits_total', 'Websocket messages sent, by event', ['event']);
+export const wsBatchesInFlight = metrics.gauge(
+  'nf_ws_batches_in_flight', 'pinBatch messages sent and not acknowledged yet (all clients)');
+export const wsFramesSkippedTotal = metrics.counter(
+  'nf_ws_frames_skipped_total', 'Batcher frames skipped because a client had too many batches in flight');
+export const wsBatchDelaySeconds = metrics.histogram(
+  'nf_ws_batch_delay_seconds', 'Age of the oldest pin change in a pinBatch when it is sent', DELIVERY_BUCKETS);
+
+export const compileSeconds = metrics.histogram(
+  'nf_compile_seconds', 'arduino-cli build duration', COMPILE_BUCKETS, ['result']);
+export const compileQueueWaitSeconds = metrics.histogram(
+  'nf_compile_queue_wait_seconds', 'Time a user compile waited for a free worker', COMPILE_BUCKETS);
+export const compileQueueDepth = metrics.gauge('nf_compile_queue_depth', 'User compiles waiting for a worker');
+export const compileRequestsTotal = metrics.counter(
+  'nf_compile_requests_total', 'Compile requests by outcome (cache_hit, joined, built)', ['source']);
+
+export const sessionsActive = metrics.gauge('nf_sessions', 'Simulation sessions (running or idle)');
@@ -0,0 +1,146 @@
+/**
+ * NeuroForge Wire Protocol - binary frame definitions
+ * Mirror of server/cores/neuroforge_qemu/nf_proto.h
+ *
+ * Frame: [NF_SYNC][op][payload...][crc8]
+ * crc8 = CRC-8/CCITT (poly 0x07, init 0x00) over op + payload
+ */
+
+export const NF_SYNC = 0xa5;
+export const NF_PROTO_VERSION = 2;
+
+/** Firmware -> host opcodes */
+export const NF_OP = {
+  HELLO: 0x00,
+  GPIO: 0x01,
+  MODE: 0x02,
+  DROPS: 0x03,
+  PORTS: 0x04,
+  SLEEP: 0x05,
+  PWM: 0x06,
+  GPIO_MASK: 0x07, // ESP32 sampled capture: changed u64, levels u64
+  AGG: 0x08, // Aggregated pin: pin, edges u16, high fraction u16, level
+} as const;
+
+/** Host -> firmware opcodes (decoded by the RX interrupt in nf_uart.cpp) */
+export const NF_HOST_OP = {
+  HELLO: 0x80,
+  WAKE: 0x81,
+  INPUT: 0x82,
+  ADC_CONST: 0x83,
+  ADC_DATA: 0x84,
+  ADC_PLAY: 0x85,
+  CAPTURE: 0x86, // ESP32 shim only: mode (NF_CAPTURE), sampling period µs u32
+  POLICY: 0x87, // Per-pin reporting: off mask u32, aggregate mask u32, window ms u16
+} as const;
+
+/** NF_HOST_OP.INPUT value that hands the pin back to the hardware register */
+export const NF_INPUT_RELEASE = 0xff;
+
+/** NF_HOST_OP.ADC_CONST value that hands the channel back to the emulated ADC */
+export const NF_ADC_RELEASE = 0xffff;
+
+/** Samples (uint16 LE) per NF_HOST_OP.ADC_DATA frame */
+export const NF_ADC_DATA_SAMPLES = 4;
+
+/** NF_HOST_OP.CAPTURE modes */
+export const NF_CAPTURE = {
+  HOOKS: 0,   // Report from digitalWrite() itself
+  SAMPLED: 1, // Periodic sample of GPIO.out/out1
+} as const;
+
+/** NF_HOST_OP.HELLO flags */
+export const NF_HOST_FLAG = {
+  CLOCK: 0x01, // Host drives NeuroForge Time (nf_time v1)
+} as const;
+
+/** Payload length per opcode (frames are fixed-size per opcode) */
+export const NF_OP_PAYLOAD_LEN: Record<number, number> = {
+  [NF_OP.HELLO]: 2,
+  [NF_OP.GPIO]: 2,
+  [NF_OP.MODE]: 2,
+  [NF_OP.DROPS]: 2,
+  [NF_OP.PORTS]: 6,
+  [NF_OP.SLEEP]: 6,
+  [NF_OP.PWM]: 7,
+  [NF_OP.GPIO_MASK]: 16,
+  [NF_OP.AGG]: 6,
+};
+
+/**
+ * Arduino Uno pin layout of the PORTS frame, in payload order (B, C, D)
+ */
+export const AVR_PORT_PINS: { port: 'B' | 'C' | 'D'; firstPin: number; bits: number }[] = [
+  { port: 'B', firstPin: 8, bits: 6 },  // D8-D13 (PB6/PB7 = crystal)
+  { port: 'C', firstPin: 14, bits: 6 }, // A0-A5 (PC6 = reset)
+  { port: 'D', firstPin: 0, bits: 8 },  // D0-D7
+];
+
+/** Largest frame on the wire: sync + op + payload + crc */
+export const NF_MAX_FRAME_LEN = 2 + Math.max(...Object.values(NF_OP_PAYLOAD_LEN)) + 1;
+
+const CRC8_TABLE = (() => {
+  const table = new Uint8Array(256);
+  for (let i = 0; i < 256; i++) {
+    let crc = i;
+    for (let bit = 0; bit < 8; bit++) {
+      crc = crc & 0x80 ? ((crc << 1) ^ 0x07) & 0xff : (crc << 1) & 0xff;
+    }
+    table[i] = crc;
+  }
+  return table;
+})();
+
+/**
+ * CRC-8/CCITT, same as avr-libc _crc8_ccitt_update()
+ */
+export function crc8(bytes: ArrayLike<number>, start = 0, end = bytes.length): number {
+  let crc = 0;
+  for (let i = start; i < end; i++) {
+    crc = CRC8_TABLE[(crc ^ bytes[i]) & 0xff];
+  }
+  return crc;
+}
+
+/**
+ * Total frame length for an opcode, or 0 if the opcode is unknown
+ */
+export function frameLength(op: number): number {
+  const len = NF_OP_PAYLOAD_LEN[op];
+  return len === undefined ? 0 : len + 3;
+}
+
+/**
+ * 48-bit little-endian virtual time in µs (NF_OP.SLEEP, NF_HOST_OP.WAKE)
+ * Exact as a JS number (< 2^53)
+ */
+export function readU48(bytes: ArrayLike<number>, offset: number): number {
+  let value = 0;
+  for (let i = 5; i >= 0; i--) {
+    value = value * 256 + bytes[offset + i];
+  }
+  return value;
+}
+
+export function u48(value: number): number[] {
+  const bytes: number[] = [];
+  for (let i = 0; i < 6; i++) {
+    bytes.push(value % 256);
+    value = Math.floor(value / 256);
+  }
+  return bytes;
+}
+
+/**
+ * Encode a frame ready to be written to the serial socket
+ */
+export function encodeFrame(op: number, payload: ArrayLike<number>): Buffer {
+  const frame = Buffer.alloc(payload.length + 3);
+  frame[0] = NF_SYNC;
+  frame[1] = op;
+  for (let i = 0; i < payload.length; i++) {
+    frame[2 + i] = payload[i];
+  }
+  frame[frame.length - 1] = crc8(frame, 1, frame.length - 1);
+  return frame;
+}
@@ -0,0 +1,235 @@
+import type { PinState } from './QEMUSimulationEngine';
+import { wsBatchesInFlight, wsFramesSkippedTotal, wsBatchDelaySeconds } from './Metrics';
+
+/**
+ * One coalesced frame of pin activity, sent as the 'pinBatch' socket event
+ */
+export interface PinBatchMessage {
+  seq: number;
+  /** [pin, value] - latest value of every pin that changed during the frame */
+  pins: [number, number][];
+  /** [pin, mode] - mode changes during the frame */
+  modes?: [number, PinState['mode']][];
+  /** [pin, toggles, highRatio] - pins that toggled more than once (PWM-like), ratio in simulation time */
+  duty?: [number, number, number][];
+  /** [pin, duty (0..1), frequency (Hz)] - hardware PWM configured during the frame */
+  pwm?: [number, number, number][];
+}
+
+export interface PinChangeBatcherOptions {
+  frameMs?: number; // Flush period (default 1000/60)
+  maxInFlight?: number; // Unacknowledged batches before a client counts as slow
+  ackTimeoutMs?: number; // An unanswered batch stops counting after this
+  clock?: () => number; // Simulation time in µs, the timebase of highRatio (default: wall clock)
+}
+
+interface PinActivity {
+  value: number;
+  toggles: number;
+  highUs: number; // Simulation time spent HIGH within the frame
+  lastChangeUs: number;
+  dirty: boolean;
+  highRatio?: number; // Summary computed by the firmware (aggregated pin)
+}
+
+type SendFn = (message: PinBatchMessage, onAck: () => void) => void;
+
+/**
+ * Per-client pin-change delivery stage
+ *
+ * Pin changes are folded into per-pin state and flushed once per frame
+ * (60 Hz by default), so a pin toggling at kHz rates costs one entry per
+ * frame instead of one socket message per edge. Pins that toggle several
+ * times within a frame also get a duty-cycle summary, so PWM-like signals
+ * still render (e.g. LED brightness). Pins aggregated by the firmware
+ * (GPIO policy 'aggregate') arrive with that summary already computed.
+ *
+ * The summary is measured on the simulation clock (options.clock), not on
+ * arrival times: frames read from one TCP chunk arrive together, so host
+ * timestamps describe the socket, not the waveform. A frame in which the
+ * simulation clock did not move gets levels and no summary.
+ *
+ * Backpressure: each batch must be acknowledged by the client. While
+ * maxInFlight batches are pending, frames are skipped and keep coalescing;
+ * the next batch carries the latest state.
+ */
+export class PinChangeBatcher {
+  private readonly send: SendFn;
+  private readonly frameMs: number;
+  private readonly maxInFlight: number;
+  private readonly ackTimeoutMs: number;
+
+  private activity = new Map<number, PinActivity>();
+  private modes = new Map<number, PinState['mode']>(); // Mode changes not sent yet
+  private pwm = new Map<number, [number, number]>(); // Latest PWM config not sent yet
+  private knownModes = new Map<number, PinState['mode']>();
+  private readonly clock: () => number;
+  private frameStartUs: number;
+  private timer: NodeJS.Timeout | null = null;
+  private seq = 0;
+  private inFlight = 0;
+  private skippedFrames = 0;
+  private pendingSince: number | null = null; // First change not sent yet (delivery delay)
+
+  constructor(send: SendFn, options: PinChangeBatcherOptions = {}) {
+    this.send = send;
+    this.frameMs = options.frameMs ?? 1000 / 60;
+    this.maxInFlight = options.maxInFlight ?? 2;
+    this.ackTimeoutMs = options.ackTimeoutMs ?? 1000;
+    this.clock = options.clock ?? (() => performance.now() * 1000);
+    this.frameStartUs = this.clock();
+  }
+
+  start(): void {
+    if (this.timer) return;
+    this.frameStartUs = this.clock();
+    this.timer = setInterval(() => this.flush(), this.frameMs);
+  }
+
+  stop(): void {
+    if (this.timer) {
+      clearInterval(this.timer);
+      this.timer = null;
+    }
+    this.activity.clear();
+    this.modes.clear();
+    this.pwm.clear();
+    this.knownModes.clear();
+    this.pendingSince = null;
+  }
+
+  /**
+   * Frames skipped because the client was not keeping up
+   */
+  getSkippedFrames(): number {
+    return this.skippedFrames;
+  }
+
+  /**
+   * Record a pin change (engine 'pin-change' event)
+   */
+  push(pin: number, state: Partial<PinState>): void {
+    this.pendingSince ??= performance.now();
+
+    if (state.mode && state.mode !== 'UNKNOWN' && this.knownModes.get(pin) !== state.mode) {
+      this.knownModes.set(pin, state.mode);
+      this.modes.set(pin, state.mode);
+    }
+
+    if (state.pwm) {
+      // Hardware PWM replaces the pin's digital activity until the next level
+      this.pwm.set(pin, [state.pwm.duty, state.pwm.frequency]);
+      this.activity.delete(pin);
+      return;
+    }
+
+    if (state.value === undefined) return;
+    this.pwm.delete(pin);
+
+    const nowUs = this.clock();
+    if (state.activity) {
+      // Firmware aggregation window: already a duty summary, the latest wins
+      this.activity.set(pin, {
+        value: state.value,
+        toggles: state.activity.edges,
+        highUs: 0,
+        lastChangeUs: nowUs,
+        dirty: true,
+        highRatio: state.activity.highRatio
+      });
+      return;
+    }
+
+    const entry = this.activity.get(pin);
+    if (!entry) {
+      this.activity.set(pin, { value: state.value, toggles: 0, highUs: 0, lastChangeUs: nowUs, dirty: true });
+      return;
+    }
+
+    if (entry.value === state.value) return;
+
+    entry.highRatio = undefined;
+    if (entry.value) {
+      entry.highUs += nowUs - Math.max(entry.lastChangeUs, this.frameStartUs);
+    }
+    entry.toggles++;
+    entry.value = state.value;
+    entry.lastChangeUs = nowUs;
+    entry.dirty = true;
+  }
+
+  /**
+   * Send everything that changed since the last frame
+   */
+  flush(): void {
+    const now = performance.now();
+    const nowUs = this.clock();
+    const frameUs = nowUs - this.frameStartUs;
+
+    if (this.inFlight >= this.maxInFlight) {
+      // Slow client: keep coalescing, the next frame carries the latest state
+      this.skippedFrames++;
+      wsFramesSkippedTotal.inc();
+      return;
+    }
+
+    const message: PinBatchMessage = { seq: ++this.seq, pins: [] };
+    const duty: [number, number, number][] = [];
+
+    this.activity.forEach((entry, pin) => {
+      if (!entry.dirty) return;
+
+      message.pins.push([pin, entry.value]);
+
+      if (entry.highRatio !== undefined) {
+        duty.push([pin, entry.toggles, Math.round(entry.highRatio * 1000) / 1000]);
+      } else if (entry.toggles > 1 && frameUs > 0) {
+        const highUs = entry.highUs + (entry.value ? nowUs - Math.max(entry.lastChangeUs, this.frameStartUs) : 0);
+        duty.push([pin, entry.toggles, Math.round(Math.min(highUs / frameUs, 1) * 1000) / 1000]);
+      }
+
+      entry.dirty = false;
+      entry.toggles = 0;
+      entry.highUs = 0;
+      entry.highRatio = undefined;
+    });
+
+    if (this.modes.size > 0) {
+      message.modes = Array.from(this.modes.entries());
+      this.modes.clear();
+    }
+    if (duty.length > 0) {
+      message.duty = duty;
+    }
+    if (this.pwm.size > 0) {
+      message.pwm = Array.from(this.pwm, ([pin, [dutyCycle, frequency]]) => [pin, Math.round(dutyCycle * 10000) / 10000, frequency]);
+      this.pwm.clear();
+    }
+
+    this.frameStartUs = nowUs;
+
+    if (message.pins.length === 0 && !message.modes && !message.pwm) {
+      this.seq--;
+      this.pendingSince = null;
+      return;
+    }
+
+    if (this.pendingSince !== null) {
+      wsBatchDelaySeconds.observe((now - this.pendingSince) / 1000);
+      this.pendingSince = null;
+    }
+
+    this.inFlight++;
+    wsBatchesInFlight.inc();
+    let settled = false;
+    const settle = () => {
+      if (settled) return;
+      settled = true;
+      this.inFlight--;
+      wsBatchesInFlight.dec();
+    };
+    // Clients that never ack (old builds, dropped packets) must not stall delivery forever
+    setTimeout(settle, this.ackTimeoutMs).unref?.();
+    this.send(message, settle);
+  }
+}
@@ -0,0 +1,557 @@
+import fs from 'fs';
+import os from 'os';
+import path from 'path';
+import type { PwmConfig, PinActivitySummary } from './SerialGPIOParser';
+
+export type TracePinMode = 'INPUT' | 'OUTPUT' | 'INPUT_PULLUP' | 'UNKNOWN';
+
+/**
+ * One decoded trace event, compact like the pinBatch arrays:
+ * - [tUs, pin, 'level', 0 | 1]
+ * - [tUs, pin, 'mode', mode]
+ * - [tUs, pin, 'pwm', duty (0..1), frequency]
+ * - [tUs, pin, 'activity', edges, highRatio]
+ */
+export type TraceEvent =
+  | [number, number, 'level', number]
+  | [number, number, 'mode', TracePinMode]
+  | [number, number, 'pwm', number, number]
+  | [number, number, 'activity', number, number];
+
+/** Pin state at the start of a queried range */
+export interface TracePinState {
+  pin: number;
+  mode: TracePinMode;
+  value: number;
+  pwm?: PwmConfig;
+}
+
+export interface TraceRange {
+  fromUs: number;
+  toUs: number;
+  initial: TracePinState[];
+  events: TraceEvent[];
+  truncated: boolean;
+  nextFromUs?: number; // Resume point when truncated...
+  nextSkip?: number;   // ...after this many events at nextFromUs
+}
+
+export interface TraceInfo {
+  file: string;
+  recording: boolean;
+  startUs: number;
+  endUs: number;
+  events: number;
+  chunks: number;
+  bytes: number;
+}
+
+interface ChunkIndexEntry {
+  offset: number; // Chunk header position in the file
+  length: number; // Header + body
+  t0: number;
+  t1: number;
+  events: number;
+}
+
+const KIND_LEVEL = 0;
+const KIND_MODE = 1;
+const KIND_PWM = 2;
+const KIND_ACTIVITY = 3;
+
+const MODES: TracePinMode[] = ['INPUT', 'OUTPUT', 'INPUT_PULLUP', 'UNKNOWN'];
+
+/** "NFTR", version, flags, wall-clock start (ms since epoch) */
+const FILE_MAGIC = 0x5254464e;
+const FILE_VERSION = 1;
+const FILE_HEADER_LEN = 16;
+
+/** bodyLen u32, keyframe events u32, events u32, reserved u32, t0 f64, t1 f64 */
+const CHUNK_HEADER_LEN = 32;
+
+/** An open chunk is sealed (written) at this many events or body bytes */
+const CHUNK_MAX_EVENTS = 4096;
+const CHUNK_MAX_BYTES = 64 * 1024;
+
+/** Largest encoded event: varint delta (8) + kind + pin + u16 + varint (5) */
+const EVENT_MAX_LEN = 20;
+
+/** Events per range query unless the caller asks for fewer */
+export const TRACE_MAX_EVENTS = 100000;
+
+/**
+ * Streaming, on-disk recorder of every pin event of a run
+ *
+ * Events are appended to an in-memory chunk stamped with virtual time (µs);
+ * full chunks are written to the trace file and only their time index stays
+ * in memory, so multi-minute runs cost a few bytes of RAM per 4096 events.
+ *
+ * File: 16-byte header, then chunks. Each chunk starts with a keyframe
+ * (state of every pin seen so far, at t0) followed by delta-encoded events:
+ * varint Δt, kind, pin, value. A range query decodes only the chunks that
+ * overlap it and starts from the keyframe, never from the start of the run.
+ */
+export class PinTraceRecorder {
+  readonly file: string;
+
+  private fd: number;
+  private fileBytes = FILE_HEADER_LEN;
+  private index: ChunkIndexEntry[] = [];
+  private state = new Map<number, TracePinState>();
+  private totalEvents = 0;
+  private lastUs = 0;
+  private closed = false;
+
+  // Open chunk
+  private body = Buffer.alloc(CHUNK_MAX_BYTES + EVENT_MAX_LEN);
+  private bodyLen = 0;
+  private keyEvents = 0;
+  private chunkEvents = 0;
+  private chunkT0 = 0;
+  private chunkPrevUs = 0;
+
+  constructor(file?: string) {
+    this.file = file ?? path.join(
+      process.env.PIN_TRACE_DIR || path.join(os.tmpdir(), 'neuroforge-traces'),
+      `trace-${process.pid}-${Date.now()}-${Math.random().toString(36).slice(2, 8)}.nftrace`
+    );
+    fs.mkdirSync(path.dirname(this.file), { recursive: true });
+    this.fd = fs.openSync(this.file, 'w+');
+
+    const header = Buffer.alloc(FILE_HEADER_LEN);
+    header.writeUInt32LE(FILE_MAGIC, 0);
+    header.writeUInt16LE(FILE_VERSION, 4);
+    header.writeDoubleLE(Date.now(), 8);
+    fs.writeSync(this.fd, header, 0, header.length, 0);
+
+    this.openChunk(0);
+  }
+
+  /**
+   * Digital level (0/1) of a pin; ends hardware PWM on it
+   */
+  level(tUs: number, pin: number, value: number): void {
+    const state = this.pinState(pin);
+    state.value = value;
+    delete state.pwm;
+    this.append(tUs, KIND_LEVEL, pin, value, 0);
+  }
+
+  mode(tUs: number, pin: number, mode: TracePinMode): void {
+    this.pinState(pin).mode = mode;
+    this.append(tUs, KIND_MODE, pin, MODES.indexOf(mode), 0);
+  }
+
+  pwm(tUs: number, pin: number, pwm: PwmConfig): void {
+    const state = this.pinState(pin);
+    state.value = Math.round(pwm.duty * 255);
+    state.pwm = { ...pwm };
+    this.append(tUs, KIND_PWM, pin, Math.round(pwm.duty * 0xffff), Math.round(pwm.frequency));
+  }
+
+  /**
+   * Aggregated window of a pin (NF_OP.AGG); transient, not part of the keyframes
+   */
+  activity(tUs: number, pin: number, activity: PinActivitySummary): void {
+    this.append(tUs, KIND_ACTIVITY, pin, Math.round(activity.highRatio * 0xffff), activity.edges);
+  }
+
+  /**
+   * Write the open chunk; the trace stays queryable, nothing more is recorded
+   */
+  finish(): void {
+    if (this.closed) return;
+    this.sealChunk();
+    this.closed = true;
+  }
+
+  /**
+   * Close and delete the trace file
+   */
+  discard(): void {
+    this.closed = true;
+    try {
+      fs.closeSync(this.fd);
+    } catch {
+      // Already closed
+    }
+    fs.rm(this.file, { force: true }, () => {});
+  }
+
+  getInfo(): TraceInfo {
+    return {
+      file: this.file,
+      recording: !this.closed,
+      startUs: this.index.length > 0 ? this.index[0].t0 : this.chunkT0,
+      endUs: this.lastUs,
+      events: this.totalEvents,
+      chunks: this.index.length + (this.chunkEvents > this.keyEvents ? 1 : 0),
+      bytes: this.fileBytes + (this.chunkEvents > this.keyEvents ? CHUNK_HEADER_LEN + this.bodyLen : 0)
+    };
+  }
+
+  /**
+   * Events in [fromUs, toUs] plus the state of every pin at fromUs.
+   * Many events share a timestamp (the firmware is awake at one virtual
+   * instant), so pages resume from nextFromUs skipping nextSkip events.
+   */
+  query(
+    fromUs: number,
+    toUs: number,
+    options: { pins?: number[]; limit?: number; skip?: number } = {}
+  ): TraceRange {
+    const limit = Math.min(options.limit ?? TRACE_MAX_EVENTS, TRACE_MAX_EVENTS);
+    const pins = options.pins ? new Set(options.pins) : null;
+    const range: TraceRange = { fromUs, toUs, initial: [], events: [], truncated: false };
+    let initial: Map<number, TracePinState> | null = null;
+    let skip = options.skip ?? 0;
+    let lastT = -1;
+    let sameT = 0; // Events returned at lastT
+
+    for (const chunk of this.chunksFrom(fromUs)) {
+      const state = initial ?? new Map<number, TracePinState>();
+      let done = false;
+
+      for (const { event, keyframe } of decodeChunk(chunk.data, chunk.t0, chunk.keyEvents)) {
+        const t = event[0];
+        if (keyframe) {
+          if (!initial) applyEvent(state, event);
+          continue;
+        }
+        if (t < fromUs) {
+          applyEvent(state, event);
+          continue;
+        }
+        if (t > toUs) {
+          done = true;
+          break;
+        }
+
+        if (pins && !pins.has(event[1])) continue;
+        if (t === fromUs && skip > 0) {
+          skip--;
+          continue;
+        }
+        if (range.events.length >= limit) {
+          range.truncated = true;
+          range.nextFromUs = t;
+          range.nextSkip = (t === lastT ? sameT : 0) + (t === fromUs ? options.skip ?? 0 : 0);
+          done = true;
+          break;
+        }
+
+        if (t !== lastT) {
+          lastT = t;
+          sameT = 0;
+        }
+        sameT++;
+        range.events.push(event);
+      }
+
+      initial = state;
+      if (done) break;
+    }
+
+    range.initial = Array.from((initial ?? this.state).values())
+      .filter(state => !pins || pins.has(state.pin))
+      .sort((a, b) => a.pin - b.pin)
+      .map(state => ({ ...state, ...(state.pwm && { pwm: { ...state.pwm } }) }));
+    return range;
+  }
+
+  /**
+   * Value Change Dump of [fromUs, toUs], written page by page
+   * (one wire per pin, plus a real for the duty of PWM/aggregated pins)
+   */
+  exportVcd(write: (text: string) => void, fromUs = 0, toUs = Number.MAX_SAFE_INTEGER, pins?: number[]): void {
+    const start = this.query(fromUs, fromUs - 1, { pins });
+    const seen = new Set<number>(start.initial.map(state => state.pin));
+    const dutyPins = new Set<number>(start.initial.filter(state => state.pwm).map(state => state.pin));
+
+    // Variables are declared up front: one pass to collect the pins of the range
+    for (const page of this.pages(fromUs, toUs, pins)) {
+      for (const [, pin, kind] of page.events) {
+        seen.add(pin);
+        if (kind === 'pwm' || kind === 'activity') dutyPins.add(pin);
+      }
+    }
+
+    const wire = (pin: number) => vcdId(pin * 2);
+    const real = (pin: number) => vcdId(pin * 2 + 1);
+
+    write(`$date ${new Date().toISOString()} $end\n`);
+    write('$version NeuroForge pin trace $end\n');
+    write('$timescale 1us $end\n');
+    write('$scope module board $end\n');
+    for (const pin of Array.from(seen).sort((a, b) => a - b)) {
+      write(`$var wire 1 ${wire(pin)} D${pin} $end\n`);
+      if (dutyPins.has(pin)) write(`$var real 64 ${real(pin)} D${pin}_duty $end\n`);
+    }
+    write('$upscope $end\n$enddefinitions $end\n');
+
+    let lastT = Math.max(0, fromUs);
+    write(`#${lastT}\n$dumpvars\n`);
+    for (const state of start.initial) {
+      const duty = state.pwm ? state.pwm.duty : state.value ? 1 : 0;
+      write(`${duty > 0 ? 1 : 0}${wire(state.pin)}\n`);
+      if (dutyPins.has(state.pin)) write(`r${duty} ${real(state.pin)}\n`);
+    }
+    write('$end\n');
+
+    for (const page of this.pages(fromUs, toUs, pins)) {
+      let out = '';
+      for (const event of page.events) {
+        const [t, pin] = event;
+        if (t !== lastT) {
+          out += `#${t}\n`;
+          lastT = t;
+        }
+        switch (event[2]) {
+          case 'level':
+            out += `${event[3]}${wire(pin)}\n`;
+            if (dutyPins.has(pin)) out += `r${event[3]} ${real(pin)}\n`;
+            break;
+          case 'pwm':
+            // Timer output: the wire is high while there is a duty cycle
+            out += `${event[3] > 0 && event[4] > 0 ? 1 : 0}${wire(pin)}\nr${event[3]} ${real(pin)}\n`;
+            break;
+          case 'activity':
+            out += `r${event[4]} ${real(pin)}\n`;
+            break;
+        }
+      }
+      if (out) write(out);
+    }
+  }
+
+  /**
+   * query() pages covering the whole [fromUs, toUs] range
+   */
+  *pages(fromUs: number, toUs: number, pins?: number[]): Generator<TraceRange> {
+    let page = this.query(fromUs, toUs, { pins });
+    yield page;
+    while (page.truncated) {
+      page = this.query(page.nextFromUs!, toUs, { pins, skip: page.nextSkip });
+      yield page;
+    }
+  }
+
+  private pinState(pin: number): TracePinState {
+    let state = this.state.get(pin);
+    if (!state) {
+      state = { pin, mode: 'UNKNOWN', value: 0 };
+      this.state.set(pin, state);
+    }
+    return state;
+  }
+
+  /**
+   * Record one event; time never goes backwards (wall-clock → virtual handover)
+   */
+  private append(tUs: number, kind: number, pin: number, a: number, b: number): void {
+    if (this.closed) return;
+
+    const t = Math.max(this.lastUs, Math.round(tUs));
+    this.lastUs = t;
+    this.encodeEvent(t, kind, pin, a, b);
+    this.chunkEvents++;
+    this.totalEvents++;
+
+    if (this.chunkEvents - this.keyEvents >= CHUNK_MAX_EVENTS || this.bodyLen >= CHUNK_MAX_BYTES) {
+      this.sealChunk();
+      this.openChunk(t);
+    }
+  }
+
+  private encodeEvent(t: number, kind: number, pin: number, a: number, b: number): void {
+    this.bodyLen = writeVarint(this.body, this.bodyLen, t - this.chunkPrevUs);
+    this.chunkPrevUs = t;
+    this.body[this.bodyLen++] = kind;
+    this.body[this.bodyLen++] = pin;
+
+    switch (kind) {
+      case KIND_LEVEL:
+      case KIND_MODE:
+        this.body[this.bodyLen++] = a;
+        break;
+      case KIND_PWM:
+      case KIND_ACTIVITY:
+        this.body.writeUInt16LE(a, this.bodyLen);
+        this.bodyLen = writeVarint(this.body, this.bodyLen + 2, b);
+        break;
+    }
+  }
+
+  /**
+   * New chunk at t0, starting with the keyframe of every known pin
+   */
+  private openChunk(t0: number): void {
+    this.bodyLen = 0;
+    this.chunkEvents = 0;
+    this.chunkT0 = t0;
+    this.chunkPrevUs = t0;
+
+    for (const state of this.state.values()) {
+      this.encodeEvent(t0, KIND_MODE, state.pin, MODES.indexOf(state.mode), 0);
+      if (state.pwm) {
+        this.encodeEvent(t0, KIND_PWM, state.pin, Math.round(state.pwm.duty * 0xffff), Math.round(state.pwm.frequency));
+      } else {
+        this.encodeEvent(t0, KIND_LEVEL, state.pin, state.value ? 1 : 0, 0);
+      }
+    }
+    this.keyEvents = this.chunkEvents = this.state.size * 2;
+  }
+
+  private sealChunk(): void {
+    if (this.chunkEvents === this.keyEvents) return; // Keyframe only
+
+    const header = Buffer.alloc(CHUNK_HEADER_LEN);
+    header.writeUInt32LE(this.bodyLen, 0);
+    header.writeUInt32LE(this.keyEvents, 4);
+    header.writeUInt32LE(this.chunkEvents, 8);
+    header.writeDoubleLE(this.chunkT0, 16);
+    header.writeDoubleLE(this.lastUs, 24);
+
+    fs.writeSync(this.fd, header, 0, CHUNK_HEADER_LEN, this.fileBytes);
+    fs.writeSync(this.fd, this.body, 0, this.bodyLen, this.fileBytes + CHUNK_HEADER_LEN);
+
+    this.index.push({
+      offset: this.fileBytes,
+      length: CHUNK_HEADER_LEN + this.bodyLen,
+      t0: this.chunkT0,
+      t1: this.lastUs,
+      events: this.chunkEvents
+    });
+    this.fileBytes += CHUNK_HEADER_LEN + this.bodyLen;
+    this.bodyLen = 0;
+    this.chunkEvents = this.keyEvents = 0;
+  }
+
+  /**
+   * Sealed chunks ending at or after fromUs (binary search), then the open one
+   */
+  private *chunksFrom(fromUs: number): Generator<{ t0: number; data: Buffer; keyEvents: number }> {
+    let lo = 0;
+    let hi = this.index.length;
+    while (lo < hi) {
+      const mid = (lo + hi) >> 1;
+      if (this.index[mid].t1 < fromUs) lo = mid + 1;
+      else hi = mid;
+    }
+
+    for (let i = lo; i < this.index.length; i++) {
+      const entry = this.index[i];
+      const chunk = Buffer.alloc(entry.length);
+      fs.readSync(this.fd, chunk, 0, entry.length, entry.offset);
+      yield {
+        t0: entry.t0,
+        data: chunk.subarray(CHUNK_HEADER_LEN, CHUNK_HEADER_LEN + chunk.readUInt32LE(0)),
+        keyEvents: chunk.readUInt32LE(4)
+      };
+    }
+
+    if (this.chunkEvents > this.keyEvents) {
+      yield { t0: this.chunkT0, data: this.body.subarray(0, this.bodyLen), keyEvents: this.keyEvents };
+    }
+  }
+}
+
+/**
+ * Events of a chunk body; the first delta is relative to the chunk's t0
+ */
+function* decodeChunk(
+  data: Buffer,
+  t0: number,
+  keyEvents: number
+): Generator<{ event: TraceEvent; keyframe: boolean }> {
+  let p = 0;
+  let t = t0;
+  let n = 0;
+
+  while (p < data.length) {
+    const [delta, next] = readVarint(data, p);
+    t += delta;
+    p = next;
+
+    const kind = data[p++];
+    const pin = data[p++];
+    let event: TraceEvent;
+
+    switch (kind) {
+      case KIND_LEVEL:
+        event = [t, pin, 'level', data[p++]];
+        break;
+      case KIND_MODE:
+        event = [t, pin, 'mode', MODES[data[p++]] ?? 'UNKNOWN'];
+        break;
+      case KIND_PWM: {
+        const [frequency, q] = readVarint(data, p + 2);
+        event = [t, pin, 'pwm', data.readUInt16LE(p) / 0xffff, frequency];
+        p = q;
+        break;
+      }
+      default: {
+        const [edges, q] = readVarint(data, p + 2);
+        event = [t, pin, 'activity', edges, data.readUInt16LE(p) / 0xffff];
+        p = q;
+        break;
+      }
+    }
+
+    yield { event, keyframe: n++ < keyEvents };
+  }
+}
+
+function applyEvent(state: Map<number, TracePinState>, event: TraceEvent): void {
+  const pin = event[1];
+  let current = state.get(pin);
+  if (!current) {
+    current = { pin, mode: 'UNKNOWN', value: 0 };
+    state.set(pin, current);
+  }
+
+  switch (event[2]) {
+    case 'level':
+      current.value = event[3];
+      delete current.pwm;
+      break;
+    case 'mode':
+      current.mode = event[3];
+      break;
+    case 'pwm':
+      current.value = Math.round(event[3] * 255);
+      current.pwm = { duty: event[3], frequency: event[4] };
+      break;
+  }
+}
+
+function writeVarint(buf: Buffer, p: number, value: number): number {
+  while (value >= 0x80) {
+    buf[p++] = (value % 0x80) | 0x80;
+    value = Math.floor(value / 0x80);
+  }
+  buf[p++] = value;
+  return p;
+}
+
+function readVarint(buf: Buffer, p: number): [number, number] {
+  let value = 0;
+  let scale = 1;
+  let byte: number;
+  do {
+    byte = buf[p++];
+    value += (byte & 0x7f) * scale;
+    scale *= 0x80;
+  } while (byte & 0x80);
+  return [value, p];
+}
+
+/** VCD identifier: printable ASCII 33..126, base 94 */
+function vcdId(n: number): string {
+  let id = '';
+  do {
+    id += String.fromCharCode(33 + (n % 94));
+    n = Math.floor(n / 94);
+  } while (n > 0);
+  return id;
+}
@@ -0,0 +1,38 @@
+import * as net from 'net';
+
+/** Ports handed out and not yet released (one per QEMU serial/monitor socket) */
+const reserved = new Set<number>();
+
+/**
+ * Ask the OS for a free TCP port on 127.0.0.1 and reserve it
+ *
+ * For sockets QEMU listens on itself (ESP32 serial, Windows monitor):
+ * the port is free when returned, and never handed out twice by this
+ * process until releasePort().
+ */
+export async function allocatePort(): Promise<number> {
+  for (let attempt = 0; attempt < 10; attempt++) {
+    const port = await new Promise<number>((resolve, reject) => {
+      const server = net.createServer();
+      server.unref();
+      server.on('error', reject);
+      server.listen(0, '127.0.0.1', () => {
+        const { port } = server.address() as net.AddressInfo;
+        server.close(() => resolve(port));
+      });
+    });
+
+    if (!reserved.has(port)) {
+      reserved.add(port);
+      return port;
+    }
+  }
+
+  throw new Error('No free TCP port available');
+}
+
+export function releasePort(port: number | null | undefined): void {
+  if (port) {
+    reserved.delete(port);
+  }
+}
@@ -0,0 +1,141 @@
+import { QEMURunner } from './QEMURunner';
+import type { RunMode } from '../types/simulation.types';
+
+export interface QEMUPoolTarget {
+  board: 'arduino-uno';
+  runMode: RunMode;
+}
+
+export interface QEMUPoolStats {
+  size: number;              // Idle instances kept per profile
+  idle: Record<string, number>;
+  hits: number;
+  misses: number;
+}
+
+/**
+ * Pre-spawned, paused QEMU instances (AVR)
+ *
+ * Each idle instance already has its monitor and serial sockets connected
+ * and sits at reset under the gdbstub, so a run only has to write the
+ * firmware and continue. The icount flags are fixed at spawn time, hence
+ * one pool per board + clock profile ('max' vs shift=auto).
+ */
+export class QEMUInstancePool {
+  private size: number;
+  private idle = new Map<string, QEMURunner[]>();
+  private spawning = new Map<string, number>();
+  private targets = new Map<string, QEMUPoolTarget>();
+  private hits = 0;
+  private misses = 0;
+  private closed = false;
+
+  /**
+   * QEMU_POOL_SIZE idle instances per profile (0 disables the pool)
+   */
+  static defaultSize(): number {
+    const configured = parseInt(process.env.QEMU_POOL_SIZE ?? '', 10);
+    return Number.isNaN(configured) ? 2 : Math.max(0, configured);
+  }
+
+  constructor(size: number = QEMUInstancePool.defaultSize()) {
+    this.size = size;
+  }
+
+  static key(board: string, runMode: RunMode): string {
+    return `${board}:${runMode.mode === 'max' ? 'max' : 'auto'}`;
+  }
+
+  /**
+   * Keep `size` idle instances ready for each target
+   */
+  warmUp(targets: QEMUPoolTarget[]): void {
+    if (this.size === 0) return;
+
+    for (const target of targets) {
+      this.targets.set(QEMUInstancePool.key(target.board, target.runMode), target);
+    }
+    this.targets.forEach((_, key) => this.refill(key));
+  }
+
+  /**
+   * Take an idle instance for this profile, or null (caller cold-starts)
+   */
+  acquire(board: string, runMode: RunMode): QEMURunner | null {
+    const key = QEMUInstancePool.key(board, runMode);
+    const runner = this.idle.get(key)?.shift() ?? null;
+
+    if (runner) {
+      this.hits++;
+      runner.removeAllListeners('stopped');
+      runner.removeAllListeners('error');
+    } else {
+      this.misses++;
+    }
+
+    // Profiles asked for at runtime are kept warm from now on
+    if (this.size > 0 && board === 'arduino-uno' && !this.targets.has(key)) {
+      this.targets.set(key, { board, runMode });
+    }
+    this.refill(key);
+    return runner;
+  }
+
+  getStats(): QEMUPoolStats {
+    const idle: Record<string, number> = {};
+    this.idle.forEach((runners, key) => {
+      idle[key] = runners.length;
+    });
+    return { size: this.size, idle, hits: this.hits, misses: this.misses };
+  }
+
+  shutdown(): void {
+    this.closed = true;
+    this.idle.forEach(runners => runners.forEach(runner => {
+      runner.removeAllListeners('stopped');
+      runner.stop();
+    }));
+    this.idle.clear();
+  }
+
+  private refill(key: string): void {
+    const target = this.targets.get(key);
+    if (!target || this.closed) return;
+
+    const idle = this.idle.get(key) ?? [];
+    this.idle.set(key, idle);
+
+    while (idle.length + (this.spawning.get(key) ?? 0) < this.size) {
+      this.spawning.set(key, (this.spawning.get(key) ?? 0) + 1);
+      this.spawn(key, target, idle);
+    }
+  }
+
+  private spawn(key: string, target: QEMUPoolTarget, idle: QEMURunner[]): void {
+    const runner = new QEMURunner();
+    const done = () => this.spawning.set(key, (this.spawning.get(key) ?? 1) - 1);
+    runner.on('error', (error: Error) => console.warn(`⚠️ QEMU pool instance error (${key}):`, error.message));
+
+    runner.prespawn(target.board, target.runMode)
+      .then(() => {
+        done();
+        if (this.closed) {
+          runner.stop();
+          return;
+        }
+
+        // An idle instance that dies is simply dropped (and replaced)
+        runner.once('stopped', () => {
+          const index = idle.indexOf(runner);
+          if (index !== -1) idle.splice(index, 1);
+          setTimeout(() => this.refill(key), 1000).unref();
+        });
+        idle.push(runner);
+      })
+      .catch((error) => {
+        done();
+        // No retry loop: the next acquire() tries again
+        console.warn(`⚠️ QEMU pool pre-spawn failed (${key}):`, error.message);
+      });
+  }
+}
@@ -1,6 +1,7 @@
-import { Socket } from 'net';
-import * as net from 'net';
-import * as fs from 'fs';
+import { EventEmitter } from 'events';
+import { QMPClient } from './QMPClient';
+import type { QMPEvent } from './QMPClient';
+import { qemuMonitorConnectSeconds } from './Metrics';
 
 export interface PinState {
   pin: number;
@@ -9,222 +10,144 @@ export interface PinState {
   bit: number;
 }
 
+/** AVR data space as seen by QEMU's physical address space */
+const AVR_DATA_OFFSET = 0x800000;
+
+/** PINB, DDRB, PORTB, PINC, DDRC, PORTC, PIND, DDRD, PORTD (ATmega328P) */
+const AVR_GPIO_BASE = 0x23;
+const AVR_GPIO_SIZE = 9;
+
 /**
  * QEMU Monitor Service
- * Connects to QEMU HMP (Human Monitor Protocol) to read/write GPIO state
+ * Connects to QEMU QMP (JSON monitor) to control the VM and read GPIO state
+ *
+ * Commands are pipelined (QMPClient matches replies by id), so pause,
+ * resume, reset and memory reads never wait behind each other. HMP is
+ * only used, via human-monitor-command, for memory reads (xp).
+ *
+ * Events:
+ * - 'stop' / 'resume' / 'reset' (data): VM state changes, whoever caused them
+ * - 'event' (QMPEvent): every QMP event
  */
-export class QEMUMonitorService {
-  private socket: Socket | null = null;
-  private socketPath: string | null = null;
-  private responseBuffer: string = '';
-  private pendingCommand: {
-    resolve: (value: string) => void;
-    reject: (error: Error) => void;
-  } | null = null;
+export class QEMUMonitorService extends EventEmitter {
+  private qmp: QMPClient | null = null;
 
   /**
-   * Connect to QEMU monitor (auto-detect Unix socket or TCP)
+   * Connect to QEMU QMP (auto-detect Unix socket or TCP "host:port")
    */
   async connect(address: string): Promise<void> {
-    if (this.socket) {
+    if (this.qmp) {
       throw new Error('Already connected to QEMU monitor');
     }
 
-    // Detect connection type
-    if (address.includes(':')) {
-      // TCP format: "127.0.0.1:4444"
-      const [host, portStr] = address.split(':');
-      const port = parseInt(portStr, 10);
-      await this.connectTcp(host, port);
-    } else {
-      // Unix socket format: "/tmp/qemu-monitor-xxx.sock"
-      await this.connectUnix(address);
-    }
-  }
-
-  /**
-   * Connect to QEMU monitor via TCP
-   */
-  private async connectTcp(host: string, port: number): Promise<void> {
-    console.log(`🔌 Connecting to QEMU monitor via TCP: ${host}:${port}`);
-
-    // Wait for port to be listening
-    await this.waitForTcpPort(host, port, 5000);
-
-    return new Promise((resolve, reject) => {
-      this.socket = net.connect({ host, port });
-
-      this.socket.on('connect', () => {
-        console.log(`✅ Connected to QEMU monitor via TCP: ${host}:${port}`);
-        
-        // Setup data handler
-        this.socket!.on('data', (data) => this.handleData(data));
-        
-        resolve();
-      });
-
-      this.socket.on('error', (error) => {
-        console.error('QEMU monitor TCP connection error:', error);
-        reject(error);
-      });
-
-      this.socket.on('close', () => {
-        console.log('QEMU monitor TCP connection closed');
-        this.socket = null;
-      });
+    console.log(`🔌 Connecting to QEMU QMP: ${address}`);
+    const startedAt = performance.now();
+
+    const qmp = new QMPClient();
+    qmp.on('event', (event: QMPEvent) => this.emit('event', event));
+    qmp.on('STOP', (data) => this.emit('stop', data));
+    qmp.on('RESUME', (data) => this.emit('resume', data));
+    qmp.on('RESET', (data) => this.emit('reset', data));
+    qmp.on('close', () => {
+      if (this.qmp === qmp) {
+        console.log('QEMU QMP connection closed');
+        this.qmp = null;
+      }
     });
-  }
-
-  /**
-   * Connect to QEMU monitor via Unix socket
-   */
-  private async connectUnix(socketPath: string): Promise<void> {
-    console.log(`🔌 Connecting to QEMU monitor via Unix socket: ${socketPath}`);
-
-    this.socketPath = socketPath;
 
-    // Wait for socket file to exist
-    await this.waitForSocket(socketPath, 5000);
-
-    return new Promise((resolve, reject) => {
-      this.socket = net.createConnection(socketPath);
-
-      this.socket.on('connect', () => {
-        console.log('✅ Connected to QEMU monitor via Unix socket:', socketPath);
-        
-        // Setup data handler
-        this.socket!.on('data', (data) => this.handleData(data));
-        
-        resolve();
-      });
-
-      this.socket.on('error', (error) => {
-        console.error('QEMU monitor Unix socket connection error:', error);
-        reject(error);
-      });
+    this.qmp = qmp;
+    try {
+      await qmp.connect(address);
+    } catch (error) {
+      this.qmp = null;
+      qmp.disconnect();
+      throw error;
+    }
 
-      this.socket.on('close', () => {
-        console.log('QEMU monitor Unix socket connection closed');
-        this.socket = null;
-      });
-    });
+    qemuMonitorConnectSeconds.observeSince(startedAt);
+    console.log(`✅ Connected to QEMU QMP: ${address}`);
   }
 
   /**
-   * Wait for TCP port to be listening
+   * Disconnect from QEMU monitor
    */
-  private async waitForTcpPort(host: string, port: number, timeout: number): Promise<void> {
-    const startTime = Date.now();
-
-    while (Date.now() - startTime < timeout) {
-      try {
-        await new Promise<void>((resolve, reject) => {
-          const client = net.connect({ host, port }, () => {
-            client.end();
-            resolve();
-          });
-
-          client.on('error', reject);
-          client.setTimeout(200);
-        });
-
-        // Connection succeeded, port is ready
-        return;
-      } catch {
-        // Port not ready, wait and retry
-        await new Promise(resolve => setTimeout(resolve, 100));
-      }
+  disconnect(): void {
+    if (this.qmp) {
+      const qmp = this.qmp;
+      this.qmp = null;
+      qmp.disconnect();
     }
-
-    throw new Error(`Timeout waiting for QEMU monitor TCP port: ${host}:${port}`);
   }
 
   /**
-   * Wait for Unix socket file to exist
+   * Run a QMP command (any number may be in flight)
    */
-  private async waitForSocket(socketPath: string, timeout: number): Promise<void> {
-    const startTime = Date.now();
-    
-    while (!fs.existsSync(socketPath)) {
-      if (Date.now() - startTime > timeout) {
-        throw new Error(`Timeout waiting for QEMU monitor socket: ${socketPath}`);
-      }
-      
-      // Wait 100ms before checking again
-      await new Promise(resolve => setTimeout(resolve, 100));
+  execute<T = any>(command: string, args?: Record<string, any>): Promise<T> {
+    if (!this.qmp) {
+      return Promise.reject(new Error('Not connected to QEMU monitor'));
     }
+    return this.qmp.execute<T>(command, args);
   }
 
   /**
-   * Disconnect from QEMU monitor
+   * Send an HMP command (through QMP) and return its text output
    */
-  disconnect(): void {
-    if (this.socket) {
-      this.socket.end();
-      this.socket = null;
+  async sendCommand(command: string): Promise<string> {
+    if (!this.qmp) {
+      throw new Error('Not connected to QEMU monitor');
     }
+    return this.qmp.humanMonitorCommand(command);
   }
 
   /**
-   * Handle incoming data from QEMU monitor
+   * Stop the vCPU (the virtual clock stops with it)
    */
-  private handleData(data: Buffer): void {
-    this.responseBuffer += data.toString();
+  async pause(): Promise<void> {
+    await this.execute('stop');
+  }
 
-    // Check if we have a complete response (ends with QEMU prompt)
-    if (this.responseBuffer.includes('(qemu)')) {
-      const response = this.responseBuffer.replace('(qemu)', '').trim();
-      this.responseBuffer = '';
+  async resume(): Promise<void> {
+    await this.execute('cont');
+  }
 
-      if (this.pendingCommand) {
-        this.pendingCommand.resolve(response);
-        this.pendingCommand = null;
-      }
-    }
+  async reset(): Promise<void> {
+    await this.execute('system_reset');
   }
 
   /**
-   * Send command to QEMU monitor and wait for response
+   * Read guest physical memory (AVR data space starts at 0x800000)
    */
-  async sendCommand(command: string): Promise<string> {
-    if (!this.socket) {
-      throw new Error('Not connected to QEMU monitor');
+  async readMemory(address: number, length: number): Promise<Buffer> {
+    const output = await this.sendCommand(`xp /${length}xb 0x${address.toString(16)}`);
+    const bytes: number[] = [];
+
+    // "0000000000800023: 0x00 0x20 0x20 ..."
+    for (const line of output.split('\n')) {
+      const colon = line.indexOf(':');
+      if (colon === -1) continue;
+      for (const token of line.slice(colon + 1).trim().split(/\s+/)) {
+        if (token.startsWith('0x')) bytes.push(parseInt(token, 16));
+      }
     }
 
-    return new Promise((resolve, reject) => {
-      this.pendingCommand = { resolve, reject };
-
-      this.socket!.write(command + '\n', (error) => {
-        if (error) {
-          this.pendingCommand = null;
-          reject(error);
-        }
-      });
-
-      // Timeout after 2 seconds
-      setTimeout(() => {
-        if (this.pendingCommand) {
-          this.pendingCommand.reject(new Error('Command timeout'));
-          this.pendingCommand = null;
-        }
-      }, 2000);
-    });
+    if (bytes.length !== length) {
+      throw new Error(`Unexpected memory dump at 0x${address.toString(16)}: ${output.trim()}`);
+    }
+    return Buffer.from(bytes);
   }
 
   /**
    * Get GPIO state for all pins
    * Returns state of all 20 Arduino Uno pins (D0-D13, A0-A5)
-   * Note: QEMU AVR may not support this - returns empty array on failure
+   * Returns an empty array when the monitor is unavailable
    */
   async getGPIOState(): Promise<PinState[]> {
     try {
-      // Get register dump from QEMU
-      const output = await this.sendCommand('info registers');
-      
-      // Parse PORTB, PORTC, PORTD values
-      const portB = this.parseRegister(output, 'PORTB');
-      const portC = this.parseRegister(output, 'PORTC');
-      const portD = this.parseRegister(output, 'PORTD');
+      // One read covers PINx/DDRx/PORTx of ports B, C and D
+      const io = await this.readMemory(AVR_DATA_OFFSET + AVR_GPIO_BASE, AVR_GPIO_SIZE);
+      const portB = io[2];
+      const portC = io[5];
+      const portD = io[8];
 
       const pinStates: PinState[] = [];
 
@@ -260,77 +183,16 @@ export class QEMUMonitorService {
 
       return pinStates;
     } catch (error) {
-      // QEMU AVR may not support 'info registers' command
+      // Monitor not connected or VM gone
       // Silently return empty array
       return [];
     }
   }
 
-  /**
-   * Parse register value from QEMU output
-   */
-  private parseRegister(output: string, registerName: string): number {
-    // Look for pattern like "PORTB = 0x20" or "PORTB: 0x20"
-    const patterns = [
-      new RegExp(`${registerName}\\s*=\\s*0x([0-9a-fA-F]+)`, 'i'),
-      new RegExp(`${registerName}\\s*:\\s*0x([0-9a-fA-F]+)`, 'i'),
-      new RegExp(`${registerName}\\s+([0-9a-fA-F]+)h`, 'i')
-    ];
-
-    for (const pattern of patterns) {
-      const match = output.match(pattern);
-      if (match) {
-        return parseInt(match[1], 16);
-      }
-    }
-
-    // Default to 0 if not found
-    return 0;
-  }
-
-  /**
-   * Set GPIO pin state (write to QEMU)
-   * @param pin Arduino pin number (0-19)
-   * @param state 'HIGH' or 'LOW'
-   */
-  async setGPIOPin(pin: number, state: 'HIGH' | 'LOW'): Promise<void> {
-    // Map pin to port and bit
-    const { port, bit } = this.pinToPort(pin);
-    const value = state === 'HIGH' ? 1 : 0;
-
-    try {
-      // Use QEMU monitor to write to GPIO register
-      // This would require custom QEMU commands or using system_reset + memory write
-      // For now, log it (will implement in future commits)
-      console.log(`GPIO Write: ${port}.${bit} = ${value}`);
-      
-      // TODO: Implement actual GPIO write via QEMU monitor
-      // await this.sendCommand(`writemem ${portAddress} ${value}`);
-    } catch (error) {
-      console.error('Error setting GPIO pin:', error);
-      throw error;
-    }
-  }
-
-  /**
-   * Map Arduino pin number to AVR port and bit
-   */
-  private pinToPort(pin: number): { port: string; bit: number } {
-    if (pin >= 0 && pin <= 7) {
-      return { port: 'PORTD', bit: pin };
-    } else if (pin >= 8 && pin <= 13) {
-      return { port: 'PORTB', bit: pin - 8 };
-    } else if (pin >= 14 && pin <= 19) {
-      return { port: 'PORTC', bit: pin - 14 };
-    }
-    
-    throw new Error(`Invalid pin number: ${pin}`);
-  }
-
   /**
    * Check if connected
    */
   isConnected(): boolean {
-    return this.socket !== null && !this.socket.destroyed;
+    return this.qmp !== null && this.qmp.isConnected();
   }
 }
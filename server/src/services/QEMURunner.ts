@@ -4,6 +4,18 @@ import * as fs from 'fs';
 import * as path from 'path';
 import * as os from 'os';
 import * as net from 'net';
+import type { RunMode } from '../types/simulation.types';
+import { SerialFramer, SerialFrameDecoder } from './SerialFramer';
+import { allocatePort, releasePort } from './PortAllocator';
+import { GdbRemoteClient } from './GdbRemoteClient';
+import { loadAvrFlashImage } from './FirmwareImage';
+import { NF_HOST_OP, encodeFrame } from './NFWireProtocol';
+import { qemuSpawnSeconds, serialBytesTotal, serialLinesTotal, Tracer } from './Metrics';
+
+const spawnSeconds = qemuSpawnSeconds.labels('avr');
+const serialBytes = serialBytesTotal.labels('avr');
+const serialLines = serialLinesTotal.labels('avr');
+const serialTrace = new Tracer('serial');
 
 /**
  * Low-level QEMU process manager
@@ -14,20 +26,47 @@ export class QEMURunner extends EventEmitter {
   private firmwarePath: string | null = null;
   private monitorSocket: string | null = null;
   private monitorPort: number | null = null;
-  private serialPort: number = 5555;
+  private serialPort: number | null = null; // Assigned by the OS when the serial server listens
   private serialClient: net.Socket | null = null;
-  private serialBuffer: string = ''; // Buffer for fragmented TCP data
+  private serialFramer = new SerialFramer(); // Lines + binary frames from raw TCP data
   private healthCheckInterval: NodeJS.Timeout | null = null;
+  private gdb: GdbRemoteClient | null = null; // Only for pre-spawned (paused) instances
+  private gdbPort: number | null = null;
+  private prespawned = false; // Paused at reset, waiting for launch()
+
+  /**
+   * Fixed icount shift for 'max' run mode: 2^6 ns = 64 ns/instruction,
+   * close to the 16 MHz Uno and deterministic across hosts
+   */
+  private static readonly MAX_SPEED_ICOUNT_SHIFT = 6;
+
+  /** Distinguishes monitor sockets of runners started in the same ms */
+  private static instanceCount = 0;
 
   constructor() {
     super();
     this.qemuPath = process.platform === 'win32' ? 'qemu-system-avr.exe' : 'qemu-system-avr';
   }
 
+  /**
+   * Attach a decoder for binary frames mixed into the serial stream
+   */
+  setFrameDecoder(decoder: SerialFrameDecoder | null): void {
+    this.serialFramer.setDecoder(decoder);
+  }
+
   /**
    * Start QEMU with firmware
+   *
+   * With options.hold the VM is started halted at reset with the gdbstub
+   * connected (getGdb()); call run() once debug hooks are in place.
    */
-  async start(firmwarePath?: string, board: 'arduino-uno' | 'esp32' = 'arduino-uno'): Promise<void> {
+  async start(
+    firmwarePath?: string,
+    board: 'arduino-uno' | 'esp32' = 'arduino-uno',
+    runMode: RunMode = { mode: 'realtime' },
+    options: { hold?: boolean } = {}
+  ): Promise<void> {
     if (this.process) {
       throw new Error('QEMU is already running');
     }
@@ -42,29 +81,124 @@ export class QEMURunner extends EventEmitter {
     }
 
     this.firmwarePath = firmware;
-    this.serialBuffer = ''; // Reset buffer
+
+    if (!options.hold) {
+      await this.spawnQemu(board, runMode, firmware, false);
+      this.emit('started');
+      return;
+    }
+
+    this.gdbPort = await allocatePort();
+    try {
+      await this.spawnQemu(board, runMode, firmware, true);
+      this.gdb = new GdbRemoteClient();
+      await this.gdb.connect(this.gdbPort);
+    } catch (error) {
+      this.stop();
+      throw error;
+    }
+    this.emit('started');
+  }
+
+  /**
+   * Spawn QEMU paused at reset with no firmware, serial and monitor already
+   * connected (QEMUInstancePool). launch() then only has to program the flash.
+   */
+  async prespawn(
+    board: 'arduino-uno' = 'arduino-uno',
+    runMode: RunMode = { mode: 'realtime' }
+  ): Promise<void> {
+    if (this.process) {
+      throw new Error('QEMU is already running');
+    }
+
+    this.gdbPort = await allocatePort();
+    try {
+      await this.spawnQemu(board, runMode, null, true);
+      await this.waitForSerialClient();
+
+      this.gdb = new GdbRemoteClient();
+      await this.gdb.connect(this.gdbPort);
+      this.prespawned = true;
+    } catch (error) {
+      this.stop();
+      throw error;
+    }
+  }
+
+  /**
+   * Load firmware into a pre-spawned instance and let it run
+   * (options.hold: stay halted at reset until run())
+   */
+  async launch(firmwarePath: string, options: { hold?: boolean } = {}): Promise<void> {
+    if (!this.process || !this.gdb || !this.prespawned) {
+      throw new Error('QEMU instance was not pre-spawned');
+    }
+
+    if (!fs.existsSync(firmwarePath)) {
+      throw new Error(`Firmware not found: ${firmwarePath}`);
+    }
+
+    // Same bytes -bios would have loaded, written through the gdbstub (PC is still at reset)
+    for (const segment of loadAvrFlashImage(firmwarePath)) {
+      await this.gdb.writeMemory(segment.address, segment.data);
+    }
+
+    this.firmwarePath = firmwarePath;
+    this.prespawned = false;
+    if (!options.hold) {
+      this.gdb.continue();
+    }
+    this.emit('started');
+  }
+
+  /**
+   * Let a VM held at reset (start/launch with hold) run
+   */
+  run(): void {
+    if (!this.gdb) {
+      throw new Error('QEMU was not started halted');
+    }
+    this.gdb.continue();
+  }
+
+  /**
+   * gdbstub session of a held or pre-spawned VM (null for plain starts)
+   */
+  getGdb(): GdbRemoteClient | null {
+    return this.gdb;
+  }
+
+  /**
+   * Spawn the QEMU process (firmware null: empty flash; halted: stopped at reset with a gdbstub)
+   */
+  private async spawnQemu(board: string, runMode: RunMode, firmware: string | null, halted: boolean): Promise<void> {
+    this.serialFramer.reset();
 
     // Setup monitor socket
     // Windows doesn't support Unix sockets, use TCP instead
     if (process.platform === 'win32') {
-      this.monitorPort = 4444;
+      this.monitorPort = await allocatePort();
       this.monitorSocket = null;
     } else {
-      this.monitorSocket = path.join(os.tmpdir(), `qemu-monitor-${Date.now()}.sock`);
+      const id = `${process.pid}-${Date.now()}-${QEMURunner.instanceCount++}`;
+      this.monitorSocket = path.join(os.tmpdir(), `qemu-monitor-${id}.sock`);
       this.monitorPort = null;
     }
 
-    const args = this.buildQemuArgs(board);
-
-    console.log('🚀 Starting QEMU with args:', args.join(' '));
-
     // IMPORTANTE: Criar servidor TCP ANTES de iniciar o QEMU
-    // QEMU vai se conectar como cliente
+    // QEMU vai se conectar como cliente (na porta escolhida pelo SO)
     await this.setupSerialTCPServer();
 
-    this.process = spawn(this.qemuPath, args, {
+    const args = this.buildQemuArgs(board, runMode, firmware, halted);
+
+    console.log('🚀 Starting QEMU with args:', args.join(' '));
+    const spawnedAt = performance.now();
+
+    const child = spawn(this.qemuPath, args, {
       stdio: ['ignore', 'pipe', 'pipe']
     });
+    this.process = child;
 
     this.process.on('error', (error) => {
       console.error('QEMU process error:', error);
@@ -73,8 +207,11 @@ export class QEMURunner extends EventEmitter {
 
     this.process.on('exit', (code) => {
       console.log('QEMU process exited with code:', code);
+      // stop() + start(): the new process owns the sockets now
+      if (this.process !== null && this.process !== child) return;
       this.stopHealthCheck();
       this.disconnectSerial();
+      this.disconnectGdb();
       this.process = null;
       this.emit('stopped', code);
     });
@@ -92,8 +229,30 @@ export class QEMURunner extends EventEmitter {
 
     // Wait for monitor socket/port to be ready
     await this.waitForMonitor();
+    spawnSeconds.observeSince(spawnedAt);
+  }
 
-    this.emit('started');
+  /**
+   * Wait until QEMU has connected to the serial TCP server
+   */
+  private async waitForSerialClient(timeout: number = 5000): Promise<void> {
+    const startTime = Date.now();
+    while (!this.serialClient) {
+      if (!this.process || Date.now() - startTime > timeout) {
+        throw new Error('Timeout waiting for QEMU serial connection');
+      }
+      await new Promise(resolve => setTimeout(resolve, 10));
+    }
+  }
+
+  private disconnectGdb(): void {
+    if (this.gdb) {
+      this.gdb.disconnect();
+      this.gdb = null;
+    }
+    releasePort(this.gdbPort);
+    this.gdbPort = null;
+    this.prespawned = false;
   }
 
   /**
@@ -101,18 +260,20 @@ export class QEMURunner extends EventEmitter {
    * QEMU will connect as a client
    */
   private async setupSerialTCPServer(): Promise<void> {
-    console.log(`🏛️ [QEMURunner] Setting up serial TCP server on port ${this.serialPort}...`);
+    console.log('🏛️ [QEMURunner] Setting up serial TCP server...');
 
     return new Promise((resolve, reject) => {
       const server = net.createServer((socket) => {
         console.log(`✅ [QEMURunner] QEMU connected to serial TCP server`);
         this.serialClient = socket;
-
-        socket.setEncoding('utf8');
-
-        socket.on('data', (data: string) => {
-          // Don't log every byte - too verbose
-          // console.log(`📥 [QEMURunner] Serial TCP data (${data.length} bytes):`, data);
+        socket.setNoDelay(true); // Host -> firmware frames (WAKE, INPUT) go out immediately
+
+        // No encoding: SerialFramer works on raw Buffers
+        socket.on('data', (data: Buffer) => {
+          serialBytes.inc(data.length);
+          if (serialTrace.enabled) {
+            serialTrace.sample(() => `QEMU serial read: ${data.length} bytes ${data.subarray(0, 16).toString('hex')}`);
+          }
           this.handleSerialData(data);
         });
 
@@ -131,7 +292,9 @@ export class QEMURunner extends EventEmitter {
         reject(error);
       });
 
-      server.listen(this.serialPort, '127.0.0.1', () => {
+      // Port 0: one free port per runner, so many simulations can share the host
+      server.listen(0, '127.0.0.1', () => {
+        this.serialPort = (server.address() as net.AddressInfo).port;
         console.log(`✅ [QEMURunner] Serial TCP server listening on port ${this.serialPort}`);
         // Store server reference to close later
         (this as any).serialServer = server;
@@ -153,33 +316,30 @@ export class QEMURunner extends EventEmitter {
     if ((this as any).serialServer) {
       (this as any).serialServer.close();
       (this as any).serialServer = null;
+      this.serialPort = null;
       console.log('🔌 [QEMURunner] Serial TCP server closed');
     }
   }
 
   /**
    * Handle serial data from TCP
-   * Buffers fragments and emits complete lines
+   * Strips binary frames, buffers fragments and emits complete lines
    */
-  private handleSerialData(data: string): void {
-    // Append to buffer
-    this.serialBuffer += data;
-
-    // Process complete lines (split by \n or \r\n)
-    const lines = this.serialBuffer.split(/\r?\n/);
-    
-    // Keep incomplete line in buffer
-    this.serialBuffer = lines.pop() || '';
-
-    // Emit complete lines
-    for (const line of lines) {
-      if (line.trim()) {
-        console.log('📤 [QEMURunner] Emitting serial event:', line.trim());
-        this.emit('serial', line.trim());
+  private handleSerialData(data: Buffer): void {
+    const lines = this.serialFramer.push(data);
+    if (lines.length === 0) return;
+    serialLines.inc(lines.length);
+
+    // One event per TCP read instead of one per line
+    this.emit('serial-batch', lines);
+    if (this.listenerCount('serial') > 0) {
+      for (const line of lines) {
+        this.emit('serial', line);
       }
     }
   }
 
+
   /**
    * Start process health check
    */
@@ -284,23 +444,30 @@ export class QEMURunner extends EventEmitter {
   /**
    * Build QEMU command line arguments
    */
-  private buildQemuArgs(board: string): string[] {
+  private buildQemuArgs(board: string, runMode: RunMode, firmware: string | null, halted: boolean): string[] {
     const args = [
       '-machine', 'arduino-uno',
-      '-bios', this.firmwarePath!,
+      ...(firmware ? ['-bios', firmware] : []),
+      ...(halted ? ['-S', '-gdb', `tcp:127.0.0.1:${this.gdbPort}`] : []),
       '-nographic',
       // 🔧 NEUROFORGE FIX: QEMU connects as CLIENT to backend TCP server
       // No 'server' flag = QEMU is client, backend is server
       '-serial', `tcp:127.0.0.1:${this.serialPort}`,
-      // ⏱️ NEUROFORGE TIME: Enable real-time execution
-      '-icount', 'shift=auto',
     ];
 
-    // Add monitor (with nowait - monitor is optional)
+    if (runMode.mode === 'max') {
+      // ⏩ NEUROFORGE TIME: fixed shift + no idle sleep, QEMU never waits for the wall clock
+      args.push('-icount', `shift=${QEMURunner.MAX_SPEED_ICOUNT_SHIFT},sleep=off`);
+    } else {
+      // ⏱️ NEUROFORGE TIME: Enable real-time execution (scaled speed is paced by VirtualClock)
+      args.push('-icount', 'shift=auto');
+    }
+
+    // Add monitor as QMP (with nowait - monitor is optional)
     if (this.monitorPort) {
-      args.push('-monitor', `tcp:127.0.0.1:${this.monitorPort},server,nowait`);
+      args.push('-qmp', `tcp:127.0.0.1:${this.monitorPort},server,nowait`);
     } else if (this.monitorSocket) {
-      args.push('-monitor', `unix:${this.monitorSocket},server,nowait`);
+      args.push('-qmp', `unix:${this.monitorSocket},server,nowait`);
     }
 
     return args;
@@ -312,6 +479,7 @@ export class QEMURunner extends EventEmitter {
   stop(): void {
     this.stopHealthCheck();
     this.disconnectSerial();
+    this.disconnectGdb();
     
     if (this.process) {
       this.process.kill('SIGTERM');
@@ -329,30 +497,36 @@ export class QEMURunner extends EventEmitter {
       this.monitorSocket = null;
     }
 
+    releasePort(this.monitorPort);
     this.monitorPort = null;
   }
 
   /**
-   * Write GPIO pin via QEMU monitor
+   * Drive an input pin (digitalRead) through an NF_OP_INPUT frame on UART RX.
+   * The firmware decodes it in the RX interrupt (nf_input.cpp); value
+   * NF_INPUT_RELEASE hands the pin back to PINx.
+   * False only without a serial connection; a full socket buffer still
+   * queues the frame (write()'s return is backpressure, not delivery).
    */
-  async writeGPIO(port: string, pin: number, value: number): Promise<void> {
-    // TODO: Implement QEMU monitor communication
-    console.log(`GPIO Write: ${port}.${pin} = ${value}`);
+  writeGPIO(pin: number, value: number): boolean {
+    if (!this.serialClient) return false;
+    this.serialClient.write(encodeFrame(NF_HOST_OP.INPUT, [pin, value]));
+    return true;
   }
 
   /**
-   * Read GPIO pin via QEMU monitor
+   * Send data to serial input (UART RX)
    */
-  async readGPIO(port: string, pin: number): Promise<number> {
-    // TODO: Implement QEMU monitor communication
-    console.log(`GPIO Read: ${port}.${pin}`);
-    return 0;
+  sendSerialData(data: string): void {
+    if (this.serialClient) {
+      this.serialClient.write(data);
+    }
   }
 
   /**
-   * Send data to serial input (UART RX)
+   * Send raw bytes to serial input (binary host -> firmware frames)
    */
-  sendSerialData(data: string): void {
+  sendSerialBytes(data: Buffer): void {
     if (this.serialClient) {
       this.serialClient.write(data);
     }
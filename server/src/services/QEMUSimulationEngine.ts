@@ -1,14 +1,30 @@
 import { EventEmitter } from 'events';
 import { QEMURunner } from './QEMURunner';
+import type { QEMUInstancePool } from './QEMUInstancePool';
 import { QEMUMonitorService } from './QEMUMonitorService';
 import { Esp32Backend } from './Esp32Backend';
-import { SerialGPIOParser, PinStateUpdate } from './SerialGPIOParser';
+import { SerialGPIOParser } from './SerialGPIOParser';
+import type { PinStateUpdate, PwmConfig, PinActivitySummary } from './SerialGPIOParser';
+import { VirtualClock } from './VirtualClock';
+import { NF_HOST_OP, NF_HOST_FLAG, NF_PROTO_VERSION, NF_CAPTURE, encodeFrame, u48 } from './NFWireProtocol';
 import type { BoardType } from './CompilerService';
 import type { Esp32BackendConfig } from '../types/esp32.types';
+import { GdbGpioCapture } from './GdbGpioCapture';
+import { AnalogSamplePool, ANALOG_TARGETS, encodeAnalogSource } from './AnalogInput';
+import type { AnalogSource } from './AnalogInput';
+import { encodeGpioPolicy } from './GpioPolicy';
+import type { GpioPolicy } from './GpioPolicy';
+import { PinTraceRecorder } from './PinTraceRecorder';
+import { gpioPinEventsTotal } from './Metrics';
+import type { RunMode, GpioCaptureMode } from '../types/simulation.types';
+
+const pinEvents = gpioPinEventsTotal.labels();
 
 export interface PinState {
   mode: 'INPUT' | 'OUTPUT' | 'INPUT_PULLUP' | 'UNKNOWN';
-  value: number; // 0 or 1 for digital, 0-1023 for analog
+  value: number; // 0 or 1 for digital, 0-255 for PWM (duty), 0-1023 for analog
+  pwm?: PwmConfig; // Set while the pin outputs hardware PWM
+  activity?: PinActivitySummary; // Aggregated pin: last window's summary
 }
 
 /**
@@ -17,28 +33,44 @@ export interface PinState {
  */
 export class QEMUSimulationEngine extends EventEmitter {
   private runner: QEMURunner;
+  private pool: QEMUInstancePool | null;
   private monitor: QEMUMonitorService;
   private esp32Backend: Esp32Backend | null = null;
   private gpioParser: SerialGPIOParser;
+  private clock: VirtualClock;
   private backendType: 'avr' | 'esp32' | null = null;
   private pinStates: Map<number, PinState>;
   private serialBuffer: string[];
   private pollInterval: NodeJS.Timeout | null = null;
+  private pollOnResume = false; // Polling was active when pause() stopped it
   private _isRunning = false;
   private _isPaused = false;
   private _firmwarePath: string | null = null;
   private _board: BoardType = 'arduino-uno';
+  private _runMode: RunMode = { mode: 'realtime' };
+  private gpioCapture: GpioCaptureMode = 'serial';
+  private gdbCapture: GdbGpioCapture | null = null;
   private gpioErrorShown = false;
+  private gpioDropped = 0; // Reports coalesced by the firmware TX ring
+  private analogPool: AnalogSamplePool | null = null; // Regions of the firmware's ADC sample pool
+  private gpioPolicy: GpioPolicy | null = null; // Per-pin reporting policy pushed to nf_gpio (AVR)
+  private trace: PinTraceRecorder | null = null; // Pin events of the current/last run, on disk
+  private traceStartMs = 0; // Wall-clock origin for backends without virtual time
 
-  constructor() {
+  constructor(options: { pool?: QEMUInstancePool | null } = {}) {
     super();
+    this.pool = options.pool ?? null;
     this.runner = new QEMURunner();
     this.monitor = new QEMUMonitorService();
     this.gpioParser = new SerialGPIOParser();
+    this.clock = new VirtualClock();
     this.pinStates = new Map();
     this.serialBuffer = [];
+    this.runner.setFrameDecoder(this.gpioParser);
     this.setupRunnerEvents();
     this.setupGpioParserEvents();
+    this.setupClockEvents();
+    this.setupMonitorEvents();
   }
 
   /**
@@ -63,16 +95,67 @@ export class QEMUSimulationEngine extends EventEmitter {
     this.emit('firmware-loaded', firmwarePath, board);
   }
 
+  /**
+   * Firmware the next start() runs (kept after stop(), restartable)
+   */
+  getFirmwarePath(): string | null {
+    return this._firmwarePath;
+  }
+
   /**
    * Start QEMU simulation
+   *
+   * runMode only applies to AVR: the ESP32 shim has no virtual clock yet.
+   * options.gpioCapture: 'serial' (default, GPIO_CAPTURE env), 'gdb' (AVR) or
+   * 'sampled' (ESP32, GPIO.out read every options.gpioSampleUs, default 1000).
+   * options.gpioPolicy (AVR): per-pin off/edge/aggregate reporting, see GpioPolicy.
+   * options.trace: record every pin event to disk (default: PIN_TRACE=1), see getTrace().
    */
-  async start(esp32Config?: Esp32BackendConfig): Promise<void> {
+  async start(
+    esp32Config?: Esp32BackendConfig,
+    runMode: RunMode = { mode: 'realtime' },
+    options: { gpioCapture?: GpioCaptureMode; gpioSampleUs?: number; gpioPolicy?: GpioPolicy; trace?: boolean } = {}
+  ): Promise<void> {
     if (!this._firmwarePath) {
       throw new Error('No firmware loaded. Call loadFirmware() first.');
     }
 
+    if (this.backendType === 'esp32' && runMode.mode !== 'realtime') {
+      throw new Error(`Run mode '${runMode.mode}' is only supported on AVR boards`);
+    }
+
     try {
       this.gpioErrorShown = false;
+      this.gpioParser.reset();
+      this.gpioDropped = 0;
+      this.clock.reset();
+      this.clock.setSpeed(
+        runMode.mode === 'max' ? 'max' : runMode.mode === 'scaled' ? runMode.speed ?? 1 : 1
+      );
+      this._runMode = runMode;
+      this.analogPool = new AnalogSamplePool(ANALOG_TARGETS[this.backendType ?? 'avr'].poolSize);
+      this.gpioCapture = options.gpioCapture
+        ?? (process.env.GPIO_CAPTURE === 'gdb' || process.env.GPIO_CAPTURE === 'sampled' ? process.env.GPIO_CAPTURE : 'serial');
+
+      const supported: GpioCaptureMode[] = this.backendType === 'esp32' ? ['serial', 'sampled'] : ['serial', 'gdb'];
+      if (!supported.includes(this.gpioCapture)) {
+        if (options.gpioCapture) {
+          throw new Error(`GPIO capture '${options.gpioCapture}' is not supported on ${this.backendType} boards`);
+        }
+        this.gpioCapture = 'serial'; // GPIO_CAPTURE env meant for the other backend
+      }
+
+      if (options.gpioPolicy && this.backendType === 'esp32') {
+        throw new Error('GPIO reporting policies are only supported on AVR boards');
+      }
+      this.gpioPolicy = options.gpioPolicy ?? null;
+
+      this.discardTrace();
+      if (options.trace ?? process.env.PIN_TRACE === '1') {
+        this.trace = new PinTraceRecorder();
+        this.traceStartMs = performance.now();
+        console.log(`🎞️ [Trace] Recording pin events to ${this.trace.file}`);
+      }
 
       // Rotear para o backend correto
       if (this.backendType === 'esp32') {
@@ -80,8 +163,20 @@ export class QEMUSimulationEngine extends EventEmitter {
           throw new Error('ESP32 config required for ESP32 board');
         }
         await this.startEsp32Backend(esp32Config);
+
+        // The shim starts in hook mode; bytes wait on UART1 until setup()
+        if (this.gpioCapture === 'sampled') {
+          const period = Math.round(options.gpioSampleUs ?? 1000);
+          this.esp32Backend!.writeInputFrames(encodeFrame(NF_HOST_OP.CAPTURE, [
+            NF_CAPTURE.SAMPLED,
+            period & 0xff, (period >> 8) & 0xff, (period >> 16) & 0xff, (period >>> 24) & 0xff
+          ]));
+          console.log(`🔭 [GPIO] Sampling ESP32 output registers every ${period} µs`);
+        }
       } else {
         await this.startAvrBackend();
+        // Received by the RX interrupt from boot on; the first reports may predate it
+        this.sendGpioPolicy();
       }
 
       this._isRunning = true;
@@ -96,7 +191,28 @@ export class QEMUSimulationEngine extends EventEmitter {
    * Inicia backend AVR (original)
    */
   private async startAvrBackend(): Promise<void> {
-    await this.runner.start(this._firmwarePath!, this._board as any);
+    const pooled = this.pool?.acquire(this._board, this._runMode) ?? null;
+    // gdb capture: keep the VM halted at reset until the watchpoint is in place
+    const hold = this.gpioCapture === 'gdb';
+
+    if (pooled) {
+      this.useRunner(pooled);
+      try {
+        await pooled.launch(this._firmwarePath!, { hold });
+        console.log('⚡ Using pre-spawned QEMU instance');
+      } catch (error) {
+        console.warn('⚠️ Pre-spawned QEMU failed, cold-starting:', error);
+        this.useRunner(new QEMURunner());
+        pooled.stop();
+        await this.runner.start(this._firmwarePath!, this._board as any, this._runMode, { hold });
+      }
+    } else {
+      await this.runner.start(this._firmwarePath!, this._board as any, this._runMode, { hold });
+    }
+
+    if (hold) {
+      await this.startGdbCapture();
+    }
 
     const monitorInfo = this.runner.getMonitorInfo();
     if (monitorInfo) {
@@ -105,6 +221,7 @@ export class QEMUSimulationEngine extends EventEmitter {
         console.log(`✅ QEMU Monitor connected (${monitorInfo.type})`);
         // Desativado: Entra em conflito com o protocolo Serial customizado
         // this.startGPIOPolling(); 
+        this.verifyGdbCapture();
       } catch (error) {
         console.error('⚠️ Failed to connect QEMU monitor:', error);
         console.log('⚠️ Continuing without GPIO monitoring...');
@@ -114,11 +231,51 @@ export class QEMUSimulationEngine extends EventEmitter {
     }
   }
 
+  /**
+   * Watchpoint-based GPIO capture; falls back to polling the registers over QMP
+   */
+  private async startGdbCapture(): Promise<void> {
+    const gdb = this.runner.getGdb()!;
+    const capture = new GdbGpioCapture(gdb);
+    capture.on('pin-change', (update: PinStateUpdate) => this.applyPinUpdate(update));
+
+    try {
+      await capture.start();
+      this.gdbCapture = capture;
+      console.log('🔭 [GPIO] Capturing PORTx/DDRx/PINx writes via gdbstub watchpoint');
+    } catch (error) {
+      console.warn('⚠️ [GPIO] gdbstub watchpoints unavailable, polling registers instead:', error);
+      this.startGPIOPolling();
+    }
+
+    this.runner.run();
+  }
+
+  /**
+   * An accepted watchpoint may still never fire (see GdbGpioCapture.verify):
+   * switch to register polling once PORTx changes without a hit
+   */
+  private verifyGdbCapture(): void {
+    const capture = this.gdbCapture;
+    if (!capture) return;
+
+    capture.verify((address, length) => this.monitor.readMemory(address, length)).then(working => {
+      if (working || this.gdbCapture !== capture) return;
+
+      console.warn('⚠️ [GPIO] PORTx changed without watchpoint hits, polling registers instead');
+      // The inert watchpoint stays: removing it would mean halting the VM
+      capture.stop();
+      this.gdbCapture = null;
+      this.startGPIOPolling();
+    });
+  }
+
   /**
    * Inicia backend ESP32 (novo)
    */
   private async startEsp32Backend(config: Esp32BackendConfig): Promise<void> {
     this.esp32Backend = new Esp32Backend();
+    this.esp32Backend.setFrameDecoder(this.gpioParser);
 
     // Forward eventos de serial para o buffer
     this.esp32Backend.on('serial', (line: string) => {
@@ -149,28 +306,38 @@ export class QEMUSimulationEngine extends EventEmitter {
     await this.esp32Backend.start(config);
   }
 
+  /**
+   * Switch to another QEMURunner (one taken from the instance pool)
+   */
+  private useRunner(runner: QEMURunner): void {
+    this.runner.setFrameDecoder(null);
+    this.runner.removeAllListeners();
+    this.runner = runner;
+    this.runner.setFrameDecoder(this.gpioParser);
+    this.setupRunnerEvents();
+  }
+
   /**
    * Setup event forwarding from QEMURunner (AVR)
    */
   private setupRunnerEvents(): void {
-    // Forward serial output
-    this.runner.on('serial', (line: string) => {
-      // 🔍 DEBUG: Log every line received from QEMU
-      console.log('🔍 [QEMU Serial]:', line);
-      
-      // NeuroForge: Process line for GPIO first. 
-      // If it's a GPIO frame, it returns true and we DON'T echo it to serial monitor.
-      const isGPIO = this.gpioParser.processLine(line);
-
-      if (isGPIO) {
-        console.log('⚡ [GPIO Detected] Line matched GPIO protocol:', line);
+    // Forward serial output (one batch per TCP read, binary frames already decoded)
+    this.runner.on('serial-batch', (lines: string[]) => {
+      const text: string[] = [];
+
+      for (const line of lines) {
+        // NeuroForge: ASCII GPIO frames (v1.0) are not echoed to the serial monitor
+        if (!this.gpioParser.processLine(line)) {
+          text.push(line);
+        }
       }
 
-      if (!isGPIO) {
-        this.serialBuffer.push(line);
+      if (text.length === 0) return;
+
+      this.serialBuffer.push(...text);
+      this.emit('serial-batch', text);
+      for (const line of text) {
         this.emit('serial', line);
-      } else {
-        // console.log('🛡️ [QEMU] Filtered GPIO frame from serial:', line);
       }
     });
 
@@ -184,6 +351,8 @@ export class QEMUSimulationEngine extends EventEmitter {
     this.runner.on('stopped', () => {
       this._isRunning = false;
       this.stopGPIOPolling();
+      this.gdbCapture?.stop();
+      this.gdbCapture = null;
       this.emit('stopped');
     });
   }
@@ -192,22 +361,121 @@ export class QEMUSimulationEngine extends EventEmitter {
    * Listen for GPIO events from Serial protocol
    */
   private setupGpioParserEvents(): void {
+    this.gpioParser.on('protocol', (protocol: string, version: number) => {
+      console.log(`🔗 [GPIO] Firmware negotiated ${protocol} protocol (v${version})`);
+
+      // Answer the HELLO: from now on delay() waits for our wake-ups
+      if (this.backendType === 'avr') {
+        this.runner.sendSerialBytes(
+          encodeFrame(NF_HOST_OP.HELLO, [NF_PROTO_VERSION, NF_HOST_FLAG.CLOCK])
+        );
+      }
+    });
+
+    this.gpioParser.on('sleep', (deadlineUs: number) => {
+      this.clock.sleepUntil(deadlineUs);
+    });
+
+    this.gpioParser.on('dropped', (total: number) => {
+      if (total !== this.gpioDropped) {
+        console.warn(`⚠️ [GPIO] Firmware TX ring full: ${total} reports coalesced so far`);
+        this.gpioDropped = total;
+      }
+    });
+
     this.gpioParser.on('pin-change', (update: PinStateUpdate) => {
-      const { pin, value, mode } = update;
-      
-      // 🔍 DEBUG: Log pin-change event
-      console.log(`⚡ [GPIO pin-change] Pin ${pin} = ${value} (mode: ${mode || 'OUTPUT'})`);
-      
-      const state: PinState = {
-        mode: mode || 'OUTPUT',
-        value
-      };
-
-      this.pinStates.set(pin, state);
-      
-      // 🔍 DEBUG: About to emit pin-change
-      console.log(`📡 [Engine] Emitting pin-change event to WebSocket...`);
-      this.emit('pin-change', pin, state);
+      // With gdb capture the registers are the source of truth (PWM lives in the timers)
+      if (this.gpioCapture === 'gdb' && this.backendType === 'avr' && !update.pwm) return;
+      this.applyPinUpdate(update);
+    });
+  }
+
+  private applyPinUpdate(update: PinStateUpdate): void {
+    pinEvents.inc();
+    const { pin, value, mode, pwm, activity } = update;
+    const previous = this.pinStates.get(pin);
+
+    // Mode-only and value-only updates keep the other half of the state
+    const state: PinState = {
+      mode: mode || previous?.mode || 'OUTPUT',
+      value: value ?? previous?.value ?? 0
+    };
+
+    if (pwm) {
+      // One frame per analogWrite(): the duty cycle is the analog value
+      state.value = Math.round(pwm.duty * 255);
+      state.pwm = pwm;
+    } else if (value === undefined && previous?.pwm) {
+      state.pwm = previous.pwm; // Mode-only update; a digital level ends the PWM
+    }
+    if (activity) {
+      state.activity = activity;
+    }
+
+    this.pinStates.set(pin, state);
+    this.recordPinUpdate(update);
+    this.emit('pin-change', pin, state);
+  }
+
+  private recordPinUpdate(update: PinStateUpdate): void {
+    if (!this.trace) return;
+
+    const t = this.getTimeUs();
+    if (update.mode) {
+      this.trace.mode(t, update.pin, update.mode);
+    }
+    if (update.pwm) {
+      this.trace.pwm(t, update.pin, update.pwm);
+    } else if (update.value !== undefined) {
+      this.trace.level(t, update.pin, update.value ? 1 : 0);
+    }
+    if (update.activity) {
+      this.trace.activity(t, update.pin, update.activity);
+    }
+  }
+
+  /**
+   * Simulation time in µs, the pin trace's timebase: the firmware's nf_now_us()
+   * once the host drives its clock (AVR), wall time since start otherwise (ESP32, ASCII cores)
+   */
+  getTimeUs(): number {
+    if (this.backendType === 'avr' && this.gpioParser.getProtocol() === 'binary') {
+      return this.clock.nowMicros();
+    }
+    return Math.round((performance.now() - this.traceStartMs) * 1000);
+  }
+
+  /**
+   * Run fn at exactly timeUs of simulation time (VirtualClock.at; true from fn
+   * holds the clock there). False when the firmware is not on the virtual clock
+   * (ESP32, ASCII cores) and the caller has to time it itself.
+   */
+  atTimeUs(timeUs: number, fn: () => boolean | void): boolean {
+    if (this.backendType !== 'avr' || this.gpioParser.getProtocol() !== 'binary') return false;
+    this.clock.at(timeUs, fn);
+    return true;
+  }
+
+  /**
+   * Wake the firmware when the virtual clock reaches its sleep deadline
+   */
+  private setupClockEvents(): void {
+    this.clock.on('wake', (nowUs: number) => {
+      this.runner.sendSerialBytes(encodeFrame(NF_HOST_OP.WAKE, u48(nowUs)));
+    });
+  }
+
+  /**
+   * QMP events (AVR)
+   */
+  private setupMonitorEvents(): void {
+    // Watchdog/firmware reset: the firmware negotiates the protocol again
+    this.monitor.on('reset', () => {
+      console.log('🔁 [QEMU] System reset');
+      this.gpioParser.reset();
+      this.analogPool?.clear(); // Firmware RAM is gone with its waveforms
+      this.sendGpioPolicy(); // ...and with the policy masks
+      this.emit('reset');
     });
   }
 
@@ -221,10 +489,14 @@ export class QEMUSimulationEngine extends EventEmitter {
       this.esp32Backend.stop();
       this.esp32Backend = null;
     } else {
+      this.gdbCapture?.stop();
+      this.gdbCapture = null;
       this.monitor.disconnect();
       this.runner.stop();
     }
 
+    this.trace?.finish(); // Stays browsable until the next start
+    this.clock.reset();
     this._isRunning = false;
     this._isPaused = false;
     this.gpioErrorShown = false;
@@ -235,16 +507,30 @@ export class QEMUSimulationEngine extends EventEmitter {
    * Pause simulation
    */
   pause(): void {
+    this.pollOnResume = this.pollInterval !== null;
     this.stopGPIOPolling();
+    this.clock.pause();
     this._isPaused = true;
     this.emit('paused');
+
+    // Stop the vCPU too (QMP, does not wait behind other monitor commands)
+    if (this.backendType === 'avr' && this.monitor.isConnected()) {
+      this.monitor.pause().catch(error => console.warn('⚠️ QMP stop failed:', error.message));
+    }
   }
 
   /**
    * Resume simulation
    */
   resume(): void {
-    this.startGPIOPolling();
+    if (this.backendType === 'avr' && this.monitor.isConnected()) {
+      this.monitor.resume().catch(error => console.warn('⚠️ QMP cont failed:', error.message));
+    }
+
+    if (this.pollOnResume) {
+      this.startGPIOPolling();
+    }
+    this.clock.resume();
     this._isPaused = false;
     this.emit('resumed');
   }
@@ -261,18 +547,25 @@ export class QEMUSimulationEngine extends EventEmitter {
 
   /**
    * Set pin state (simulate input, e.g. button press)
+   *
+   * Sent as an NF_OP_INPUT frame: the firmware's RX interrupt updates its
+   * shadow input registers and the next digitalRead() returns the value.
    */
   async setPinState(pin: number, value: number): Promise<void> {
     try {
-      // Write to QEMU via monitor (AVR only for now)
-      if (this.backendType === 'avr') {
-        await this.monitor.setGPIOPin(pin, value === 1 ? 'HIGH' : 'LOW');
+      const level = value ? 1 : 0;
+      const sent = this.backendType === 'esp32'
+        ? this.esp32Backend?.writeInput(pin, level) ?? false
+        : this.runner.writeGPIO(pin, level);
+      if (!sent) {
+        console.warn(`⚠️ Pin ${pin} input not delivered (simulation not running)`);
       }
 
       // Update local cache
       const currentState = this.pinStates.get(pin) || { mode: 'INPUT', value: 0 };
-      currentState.value = value;
+      currentState.value = level;
       this.pinStates.set(pin, currentState);
+      this.trace?.level(this.getTimeUs(), pin, level);
 
       this.emit('pin-change', pin, currentState);
     } catch (error) {
@@ -281,6 +574,45 @@ export class QEMUSimulationEngine extends EventEmitter {
     }
   }
 
+  /**
+   * Change which pins the firmware reports, and how (AVR only).
+   * Kept for the session and re-sent when the firmware resets.
+   */
+  setGpioPolicy(policy: GpioPolicy): void {
+    if (!this._isRunning) {
+      throw new Error('Simulation not running');
+    }
+    if (this.backendType !== 'avr') {
+      throw new Error('GPIO reporting policies are only supported on AVR boards');
+    }
+
+    this.gpioPolicy = policy;
+    this.sendGpioPolicy();
+  }
+
+  private sendGpioPolicy(): void {
+    if (this.gpioPolicy && this.backendType === 'avr') {
+      this.runner.sendSerialBytes(encodeGpioPolicy(this.gpioPolicy));
+    }
+  }
+
+  /**
+   * Feed analogRead(pin) from the host: a constant, or a waveform table
+   * uploaded once and played back on the firmware's virtual clock
+   */
+  async setAnalogInput(pin: number, source: AnalogSource): Promise<void> {
+    if (!this._isRunning || !this.backendType || !this.analogPool) {
+      throw new Error('Simulation not running');
+    }
+
+    const frames = encodeAnalogSource(pin, source, this.analogPool, ANALOG_TARGETS[this.backendType]);
+    if (this.backendType === 'esp32') {
+      this.esp32Backend?.writeInputFrames(frames);
+    } else {
+      this.runner.sendSerialBytes(frames);
+    }
+  }
+
   /**
    * Start polling GPIO pins from QEMU (20 FPS)
    * Currently only supported for AVR backend
@@ -318,7 +650,7 @@ export class QEMUSimulationEngine extends EventEmitter {
           }
         }
       } catch (error) {
-        // QEMU AVR doesn't reliably support GPIO monitoring via 'info registers'
+        // Monitor may be gone (QEMU exiting)
         // This is expected - show warning once, then silently continue
         if (!this.gpioErrorShown) {
           console.log('⚠️ GPIO monitoring not available in this QEMU build (continuing with serial only)');
@@ -369,6 +701,47 @@ export class QEMUSimulationEngine extends EventEmitter {
     return this._isPaused;
   }
 
+  /**
+   * GPIO reporting stats (negotiated protocol, coalesced reports)
+   */
+  getGPIOStats(): { protocol: string; dropped: number; capture: GpioCaptureMode; watchHits: number } {
+    return {
+      protocol: this.gpioParser.getProtocol(),
+      dropped: this.gpioDropped,
+      capture: this.gpioCapture,
+      watchHits: this.gdbCapture?.getHits() ?? 0
+    };
+  }
+
+  /**
+   * Current run mode (realtime, scaled N×, max)
+   */
+  getRunMode(): RunMode {
+    return this._runMode;
+  }
+
+  /**
+   * Virtual time in ms (host-driven NeuroForge Time)
+   */
+  getVirtualTime(): number {
+    return this.clock.now();
+  }
+
+  /**
+   * Pin trace of the current run (or the last one, once stopped)
+   */
+  getTrace(): PinTraceRecorder | null {
+    return this.trace;
+  }
+
+  /**
+   * Delete the trace file (new run, session destroyed)
+   */
+  discardTrace(): void {
+    this.trace?.discard();
+    this.trace = null;
+  }
+
   /**
    * Get current backend type
    */
@@ -0,0 +1,207 @@
+import { EventEmitter } from 'events';
+import * as net from 'net';
+
+/**
+ * Asynchronous QMP event (STOP, RESUME, RESET, SHUTDOWN, ...)
+ */
+export interface QMPEvent {
+  event: string;
+  data: Record<string, any>;
+  timestamp: { seconds: number; microseconds: number };
+}
+
+export class QMPError extends Error {
+  errorClass: string;
+
+  constructor(errorClass: string, desc: string) {
+    super(desc);
+    this.name = 'QMPError';
+    this.errorClass = errorClass;
+  }
+}
+
+interface PendingRequest {
+  resolve: (value: any) => void;
+  reject: (error: Error) => void;
+  timer: NodeJS.Timeout;
+}
+
+/**
+ * QEMU Machine Protocol client (-qmp unix:...,server or tcp:...,server)
+ *
+ * Every command carries an id, so any number of them can be in flight and
+ * replies are matched by id instead of by order. Events are emitted as
+ * 'event' (QMPEvent) and under their own name (e.g. 'STOP').
+ *
+ * Events:
+ * - 'event' (QMPEvent)
+ * - '<EVENT NAME>' (data, timestamp)
+ * - 'close'
+ */
+export class QMPClient extends EventEmitter {
+  private socket: net.Socket | null = null;
+  private buffer = '';
+  private nextId = 1;
+  private pending = new Map<number, PendingRequest>();
+  private greeting: ((value: void) => void) | null = null;
+  private commandTimeout: number;
+
+  constructor(options: { commandTimeout?: number } = {}) {
+    super();
+    this.commandTimeout = options.commandTimeout ?? 2000;
+  }
+
+  /**
+   * Connect and leave capabilities negotiation mode
+   * @param address - Unix socket path or "host:port"
+   */
+  async connect(address: string, timeout: number = 5000): Promise<void> {
+    if (this.socket) {
+      throw new Error('Already connected to QMP');
+    }
+
+    const startTime = Date.now();
+    while (true) {
+      try {
+        await this.open(address, Math.max(100, timeout - (Date.now() - startTime)));
+        break;
+      } catch (error) {
+        if (Date.now() - startTime > timeout) {
+          throw new Error(`Timeout connecting to QMP at ${address}`);
+        }
+        await new Promise(resolve => setTimeout(resolve, 10));
+      }
+    }
+
+    await this.execute('qmp_capabilities');
+  }
+
+  disconnect(): void {
+    if (this.socket) {
+      this.socket.destroy();
+      this.socket = null;
+    }
+  }
+
+  isConnected(): boolean {
+    return this.socket !== null && !this.socket.destroyed;
+  }
+
+  /**
+   * Run a QMP command; resolves with its "return" value
+   */
+  execute<T = any>(command: string, args?: Record<string, any>, timeout: number = this.commandTimeout): Promise<T> {
+    return new Promise<T>((resolve, reject) => {
+      if (!this.socket) {
+        reject(new Error('Not connected to QMP'));
+        return;
+      }
+
+      const id = this.nextId++;
+      const timer = setTimeout(() => {
+        this.pending.delete(id);
+        reject(new Error(`QMP command timeout: ${command}`));
+      }, timeout);
+
+      this.pending.set(id, { resolve, reject, timer });
+      this.socket.write(JSON.stringify(args ? { execute: command, arguments: args, id } : { execute: command, id }) + '\n');
+    });
+  }
+
+  /**
+   * HMP command through QMP, for what has no QMP equivalent (e.g. xp)
+   */
+  humanMonitorCommand(commandLine: string): Promise<string> {
+    return this.execute<string>('human-monitor-command', { 'command-line': commandLine });
+  }
+
+  private open(address: string, timeout: number): Promise<void> {
+    return new Promise((resolve, reject) => {
+      const [host, port] = address.split(':');
+      const socket = port ? net.connect({ host, port: parseInt(port, 10) }) : net.createConnection(address);
+
+      const fail = (error: Error) => {
+        clearTimeout(timer);
+        this.greeting = null;
+        socket.destroy();
+        reject(error);
+      };
+      const timer = setTimeout(() => fail(new Error('QMP greeting timeout')), timeout);
+      socket.once('error', fail);
+
+      // Connected once the {"QMP": ...} greeting arrives
+      this.greeting = () => {
+        clearTimeout(timer);
+        socket.removeListener('error', fail);
+        socket.on('error', () => undefined); // 'close' follows
+        this.socket = socket;
+        resolve();
+      };
+
+      this.buffer = '';
+      socket.setNoDelay?.(true);
+      socket.on('data', (data: Buffer) => this.handleData(data));
+      socket.on('close', () => {
+        if (this.socket === socket) {
+          this.socket = null;
+          this.failPending(new Error('QMP connection closed'));
+          this.emit('close');
+        }
+      });
+    });
+  }
+
+  private handleData(data: Buffer): void {
+    this.buffer += data.toString('utf8');
+
+    let newline: number;
+    while ((newline = this.buffer.indexOf('\n')) !== -1) {
+      const line = this.buffer.slice(0, newline).trim();
+      this.buffer = this.buffer.slice(newline + 1);
+      if (!line) continue;
+
+      let message: any;
+      try {
+        message = JSON.parse(line);
+      } catch {
+        console.warn('⚠️ [QMP] Invalid message:', line);
+        continue;
+      }
+      this.dispatch(message);
+    }
+  }
+
+  private dispatch(message: any): void {
+    if (message.QMP) {
+      this.greeting?.();
+      this.greeting = null;
+      return;
+    }
+
+    if (message.event) {
+      const event: QMPEvent = { event: message.event, data: message.data ?? {}, timestamp: message.timestamp };
+      this.emit('event', event);
+      this.emit(event.event, event.data, event.timestamp);
+      return;
+    }
+
+    const pending = this.pending.get(message.id);
+    if (!pending) return;
+
+    this.pending.delete(message.id);
+    clearTimeout(pending.timer);
+    if (message.error) {
+      pending.reject(new QMPError(message.error.class, message.error.desc));
+    } else {
+      pending.resolve(message.return);
+    }
+  }
+
+  private failPending(error: Error): void {
+    this.pending.forEach(pending => {
+      clearTimeout(pending.timer);
+      pending.reject(error);
+    });
+    this.pending.clear();
+  }
+}
@@ -0,0 +1,125 @@
+import { NF_SYNC, NF_MAX_FRAME_LEN, frameLength } from './NFWireProtocol';
+
+/**
+ * Validates and dispatches one binary frame in place
+ * (implemented by SerialGPIOParser)
+ */
+export interface SerialFrameDecoder {
+  decodeFrame(buf: Buffer, offset: number, len: number): boolean;
+}
+
+const NEWLINE = 0x0a;
+const CARRIAGE_RETURN = 0x0d;
+
+/**
+ * Incremental framer for the raw serial byte stream
+ *
+ * Scans each chunk in place for '\n' and NF_SYNC: binary frames go
+ * straight to the decoder, text is kept as zero-copy slices of the
+ * chunk and only turned into a string once a line is complete.
+ * push() returns every line completed by the chunk, so callers can
+ * handle serial output in batches instead of one event per line.
+ */
+export class SerialFramer {
+  /** A line longer than this is flushed as-is (firmware never sent '\n') */
+  private static readonly MAX_LINE_BYTES = 4096;
+
+  private lineParts: Buffer[] = []; // Slices of the current incomplete line
+  private lineBytes = 0;
+  private pendingFrame: Buffer | null = null; // Frame split across chunks
+  private decoder: SerialFrameDecoder | null;
+
+  constructor(decoder: SerialFrameDecoder | null = null) {
+    this.decoder = decoder;
+  }
+
+  setDecoder(decoder: SerialFrameDecoder | null): void {
+    this.decoder = decoder;
+  }
+
+  reset(): void {
+    this.lineParts = [];
+    this.lineBytes = 0;
+    this.pendingFrame = null;
+  }
+
+  /**
+   * Feed one chunk from the socket; returns the completed lines (trimmed, non-empty)
+   */
+  push(chunk: Buffer): string[] {
+    const lines: string[] = [];
+
+    // Rare: only when a frame straddles two TCP reads (at most NF_MAX_FRAME_LEN bytes carried)
+    const data = this.pendingFrame ? Buffer.concat([this.pendingFrame, chunk]) : chunk;
+    this.pendingFrame = null;
+
+    let textStart = 0;
+    let nl = data.indexOf(NEWLINE);
+    let sync = this.decoder ? data.indexOf(NF_SYNC) : -1;
+
+    while (true) {
+      if (sync !== -1 && (nl === -1 || sync < nl)) {
+        // Need the opcode to know the frame length
+        const len = sync + 1 < data.length ? frameLength(data[sync + 1]) : NF_MAX_FRAME_LEN;
+        if (len === 0) {
+          // Unknown opcode: not a frame, the byte stays in the text
+          sync = data.indexOf(NF_SYNC, sync + 1);
+          continue;
+        }
+
+        if (sync + len > data.length) {
+          this.appendText(data, textStart, sync, lines);
+          this.pendingFrame = Buffer.from(data.subarray(sync));
+          return lines;
+        }
+
+        if (this.decoder!.decodeFrame(data, sync, len)) {
+          this.appendText(data, textStart, sync, lines);
+          textStart = sync + len;
+          if (nl !== -1 && nl < textStart) {
+            nl = data.indexOf(NEWLINE, textStart); // '\n' was a payload byte
+          }
+          sync = data.indexOf(NF_SYNC, textStart);
+        } else {
+          sync = data.indexOf(NF_SYNC, sync + 1);
+        }
+        continue;
+      }
+
+      if (nl === -1) break;
+
+      this.appendText(data, textStart, nl, lines);
+      this.endLine(lines);
+      textStart = nl + 1;
+      nl = data.indexOf(NEWLINE, textStart);
+    }
+
+    this.appendText(data, textStart, data.length, lines);
+    return lines;
+  }
+
+  private appendText(data: Buffer, start: number, end: number, lines: string[]): void {
+    if (end <= start) return;
+    this.lineParts.push(data.subarray(start, end));
+    this.lineBytes += end - start;
+    if (this.lineBytes >= SerialFramer.MAX_LINE_BYTES) {
+      this.endLine(lines);
+    }
+  }
+
+  private endLine(lines: string[]): void {
+    if (this.lineBytes === 0) return;
+
+    let line = this.lineParts.length === 1 ? this.lineParts[0] : Buffer.concat(this.lineParts, this.lineBytes);
+    if (line[line.length - 1] === CARRIAGE_RETURN) {
+      line = line.subarray(0, line.length - 1);
+    }
+    this.lineParts = [];
+    this.lineBytes = 0;
+
+    const text = line.toString('utf8').trim();
+    if (text) {
+      lines.push(text);
+    }
+  }
+}
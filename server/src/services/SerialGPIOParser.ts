@@ -1,24 +1,211 @@
 import { EventEmitter } from 'events';
+import { NF_SYNC, NF_OP, AVR_PORT_PINS, crc8, readU48 } from './NFWireProtocol';
+import type { SerialFrameDecoder } from './SerialFramer';
+import { gpioFramesTotal, Tracer } from './Metrics';
+import type { CounterChild } from './Metrics';
+
+/** Frame counters indexed by opcode, resolved once (unknown opcodes share 'other') */
+const FRAME_COUNTERS = (() => {
+    const other = gpioFramesTotal.labels('other');
+    const counters: CounterChild[] = new Array(256).fill(other);
+    for (const [name, op] of Object.entries(NF_OP)) {
+        counters[op] = gpioFramesTotal.labels(name.toLowerCase());
+    }
+    return counters;
+})();
+const ASCII_FRAMES = gpioFramesTotal.labels('ascii');
+const gpioTrace = new Tracer('gpio');
 
 export interface PinStateUpdate {
     pin: number;
     value: number;
     mode?: 'INPUT' | 'OUTPUT' | 'INPUT_PULLUP';
+    pwm?: PwmConfig;
+    activity?: PinActivitySummary;
+}
+
+/**
+ * One firmware aggregation window of a pin (NF_OP.AGG)
+ */
+export interface PinActivitySummary {
+    edges: number;
+    highRatio: number; // 0..1
+}
+
+/**
+ * Hardware PWM as configured by analogWrite()/ledcWrite()
+ */
+export interface PwmConfig {
+    duty: number;      // 0..1
+    frequency: number; // Hz (0 = timer stopped)
 }
 
+export type GPIOProtocol = 'ascii' | 'binary';
+
 /**
  * Parses Serial-encoded GPIO frames from QEMU output
- * Protocol v1.0: G:pin=13,v=1
+ * Protocol v1.0: G:pin=13,v=1 (ASCII, fallback)
+ * Protocol v2.0: [0xA5][op][pin][value][crc8] (binary, see NFWireProtocol)
+ *
+ * The parser starts in ASCII mode and switches to binary when the
+ * firmware announces itself with a HELLO frame at boot.
  */
-export class SerialGPIOParser extends EventEmitter {
+export class SerialGPIOParser extends EventEmitter implements SerialFrameDecoder {
     private static readonly GPIO_REGEX = /G:.*?pin=(\d+),v=([01])/;
     private static readonly MODE_REGEX = /M:.*?pin=(\d+),m=([0-2])/;
+    private static readonly DROPS_REGEX = /^D:n=(\d+)$/;
+    private static readonly PWM_REGEX = /P:.*?pin=(\d+),d=(\d+),f=(\d+)/;
+    private static readonly MODES: ('INPUT' | 'OUTPUT' | 'INPUT_PULLUP')[] = ['INPUT', 'OUTPUT', 'INPUT_PULLUP'];
+
+    private protocol: GPIOProtocol = 'ascii';
+
+    /**
+     * Current negotiated protocol
+     */
+    getProtocol(): GPIOProtocol {
+        return this.protocol;
+    }
+
+    /**
+     * Reset negotiation state (call when a new simulation starts)
+     */
+    reset(): void {
+        this.protocol = 'ascii';
+    }
+
+    /**
+     * Validates and dispatches one binary frame in place
+     * (called by SerialFramer, no intermediate strings or arrays)
+     */
+    decodeFrame(bytes: Buffer, offset: number, len: number): boolean {
+        if (bytes[offset] !== NF_SYNC || crc8(bytes, offset + 1, offset + len - 1) !== bytes[offset + len - 1]) {
+            return false;
+        }
+
+        // Payload starts at p
+        const p = offset + 2;
+        const op = bytes[offset + 1];
+        FRAME_COUNTERS[op].inc();
+        if (gpioTrace.enabled) {
+            gpioTrace.sample(() => `frame op=0x${op.toString(16)} ${bytes.subarray(offset, offset + len).toString('hex')}`);
+        }
+        switch (op) {
+            case NF_OP.HELLO:
+                if (this.protocol !== 'binary') {
+                    this.protocol = 'binary';
+                    this.emit('protocol', this.protocol, bytes[p]);
+                }
+                break;
+
+            case NF_OP.GPIO:
+                this.emit('pin-change', {
+                    pin: bytes[p],
+                    value: bytes[p + 1] ? 1 : 0,
+                } as PinStateUpdate);
+                break;
+
+            case NF_OP.MODE:
+                this.emit('pin-change', {
+                    pin: bytes[p],
+                    mode: SerialGPIOParser.MODES[bytes[p + 1]] || 'OUTPUT',
+                } as PinStateUpdate);
+                break;
+
+            case NF_OP.PORTS:
+                // Batched PORTB/C/D snapshot: expand dirty bits into per-pin updates
+                AVR_PORT_PINS.forEach(({ firstPin, bits }, i) => {
+                    const dirty = bytes[p + i * 2];
+                    const value = bytes[p + 1 + i * 2];
+                    for (let bit = 0; dirty && bit < bits; bit++) {
+                        if (dirty & (1 << bit)) {
+                            this.emit('pin-change', {
+                                pin: firstPin + bit,
+                                value: (value >> bit) & 1,
+                            } as PinStateUpdate);
+                        }
+                    }
+                });
+                break;
+
+            case NF_OP.GPIO_MASK: {
+                // Sampled output registers: one update per changed bit, pins 0-63
+                for (let word = 0; word < 2; word++) {
+                    let changed = bytes.readUInt32LE(p + word * 4);
+                    const levels = bytes.readUInt32LE(p + 8 + word * 4);
+                    while (changed) {
+                        const bit = 31 - Math.clz32(changed & -changed);
+                        changed &= changed - 1;
+                        this.emit('pin-change', {
+                            pin: word * 32 + bit,
+                            value: (levels >>> bit) & 1,
+                        } as PinStateUpdate);
+                    }
+                }
+                break;
+            }
+
+            case NF_OP.AGG:
+                // Aggregated pin: one summary per window instead of every edge
+                this.emit('pin-change', {
+                    pin: bytes[p],
+                    value: bytes[p + 5] ? 1 : 0,
+                    activity: {
+                        edges: bytes[p + 1] | (bytes[p + 2] << 8),
+                        highRatio: (bytes[p + 3] | (bytes[p + 4] << 8)) / 0xffff,
+                    },
+                } as PinStateUpdate);
+                break;
+
+            case NF_OP.PWM:
+                this.emit('pin-change', {
+                    pin: bytes[p],
+                    pwm: {
+                        duty: (bytes[p + 1] | (bytes[p + 2] << 8)) / 0xffff,
+                        frequency: bytes.readUInt32LE(p + 3),
+                    },
+                } as PinStateUpdate);
+                break;
+
+            case NF_OP.DROPS:
+                // Total reports the firmware coalesced because its TX ring was full
+                this.emit('dropped', bytes[p] | (bytes[p + 1] << 8));
+                break;
+
+            case NF_OP.SLEEP:
+                // Firmware halted until the host advances the virtual clock to this deadline (µs)
+                this.emit('sleep', readU48(bytes, p));
+                break;
+        }
+
+        return true;
+    }
 
     /**
      * Processes a line of serial output
      * If it matches a GPIO frame, emits 'pin-change'
      */
     processLine(line: string): boolean {
+        // Binary firmware never emits ASCII frames: plain serial text
+        if (this.protocol === 'binary') {
+            return false;
+        }
+
+        // Cheap pre-check: every ASCII frame has 'pin=' or starts with 'D:'
+        if (line.indexOf('pin=') === -1 && !line.startsWith('D:')) {
+            return false;
+        }
+
+        if (!this.matchAsciiFrame(line)) {
+            return false;
+        }
+        ASCII_FRAMES.inc();
+        if (gpioTrace.enabled) {
+            gpioTrace.sample(() => `ascii frame ${line}`);
+        }
+        return true;
+    }
+
+    private matchAsciiFrame(line: string): boolean {
         // 1. Detect Value Changes (G:pin=13,v=1)
         const gMatch = line.match(SerialGPIOParser.GPIO_REGEX);
         if (gMatch) {
@@ -41,8 +228,7 @@ export class SerialGPIOParser extends EventEmitter {
             const m = parseInt(mMatch[2], 10);
 
             // Mapping: 0=INPUT, 1=OUTPUT, 2=INPUT_PULLUP
-            const modes: ('INPUT' | 'OUTPUT' | 'INPUT_PULLUP')[] = ['INPUT', 'OUTPUT', 'INPUT_PULLUP'];
-            const mode = modes[m] || 'OUTPUT';
+            const mode = SerialGPIOParser.MODES[m] || 'OUTPUT';
 
             this.emit('pin-change', {
                 pin,
@@ -52,6 +238,27 @@ export class SerialGPIOParser extends EventEmitter {
             return true;
         }
 
+        // 3. Detect PWM configuration (P:pin=9,d=32896,f=490)
+        const pMatch = line.match(SerialGPIOParser.PWM_REGEX);
+        if (pMatch) {
+            this.emit('pin-change', {
+                pin: parseInt(pMatch[1], 10),
+                pwm: {
+                    duty: Math.min(parseInt(pMatch[2], 10), 0xffff) / 0xffff,
+                    frequency: parseInt(pMatch[3], 10),
+                },
+            } as PinStateUpdate);
+
+            return true;
+        }
+
+        // 4. Detect coalescing counter (D:n=12)
+        const dMatch = line.match(SerialGPIOParser.DROPS_REGEX);
+        if (dMatch) {
+            this.emit('dropped', parseInt(dMatch[1], 10));
+            return true;
+        }
+
         return false;
     }
 }
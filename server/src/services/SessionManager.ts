@@ -0,0 +1,218 @@
+import { EventEmitter } from 'events';
+import { randomUUID } from 'crypto';
+import * as os from 'os';
+import { QEMUSimulationEngine } from './QEMUSimulationEngine';
+import type { QEMUInstancePool } from './QEMUInstancePool';
+import { sessionsActive } from './Metrics';
+
+/**
+ * One user's simulation: its own engine, QEMU process and sockets
+ */
+export interface Session {
+  id: string;
+  engine: QEMUSimulationEngine;
+  createdAt: number;
+  lastActivity: number;
+  clients: number; // Connected websockets
+}
+
+export interface SessionInfo {
+  id: string;
+  running: boolean;
+  backend: 'avr' | 'esp32' | null;
+  clients: number;
+  createdAt: number;
+  idleMs: number;
+}
+
+export interface SessionManagerOptions {
+  maxSessions?: number;
+  idleTimeoutMs?: number; // Sessions without clients or API calls for this long are destroyed
+  minFreeMemoryMb?: number; // New simulations are refused below this
+  pool?: QEMUInstancePool; // Pre-spawned AVR instances shared by all sessions
+}
+
+/**
+ * Host capacity reached (sessions or memory); answered with HTTP 503
+ */
+export class SessionCapacityError extends Error {
+  constructor(message: string) {
+    super(message);
+    this.name = 'SessionCapacityError';
+  }
+}
+
+/**
+ * Registry of concurrent simulation sessions
+ *
+ * Every session owns a QEMUSimulationEngine; QEMU serial/monitor ports
+ * are allocated per process, so sessions never collide.
+ *
+ * Events:
+ * - 'created' (session)
+ * - 'destroyed' (sessionId)
+ */
+export class SessionManager extends EventEmitter {
+  private sessions = new Map<string, Session>();
+  private maxSessions: number;
+  private idleTimeoutMs: number;
+  private minFreeMemoryMb: number;
+  private pool: QEMUInstancePool | null;
+  private reaper: NodeJS.Timeout | null = null;
+
+  constructor(options: SessionManagerOptions = {}) {
+    super();
+    this.maxSessions = options.maxSessions
+      ?? (parseInt(process.env.MAX_SESSIONS || '', 10) || os.cpus().length * 2);
+    this.idleTimeoutMs = options.idleTimeoutMs
+      ?? (parseInt(process.env.SESSION_IDLE_TIMEOUT_MS || '', 10) || 30 * 60 * 1000);
+    this.minFreeMemoryMb = options.minFreeMemoryMb
+      ?? (parseInt(process.env.SESSION_MIN_FREE_MEMORY_MB || '', 10) || 256);
+    this.pool = options.pool ?? null;
+  }
+
+  /**
+   * Create a session (throws SessionCapacityError when the host is full)
+   */
+  create(id: string = randomUUID()): Session {
+    if (this.sessions.has(id)) {
+      throw new Error(`Session already exists: ${id}`);
+    }
+    if (this.sessions.size >= this.maxSessions) {
+      this.reapIdle();
+      if (this.sessions.size >= this.maxSessions) {
+        throw new SessionCapacityError(`Server full: ${this.maxSessions} sessions`);
+      }
+    }
+
+    const now = Date.now();
+    const session: Session = {
+      id,
+      engine: new QEMUSimulationEngine({ pool: this.pool }),
+      createdAt: now,
+      lastActivity: now,
+      clients: 0
+    };
+    // Every websocket of the session subscribes to the engine
+    session.engine.setMaxListeners(0);
+
+    this.sessions.set(id, session);
+    sessionsActive.set(this.sessions.size);
+    this.startReaper();
+    console.log(`🧩 Session created: ${id} (${this.sessions.size}/${this.maxSessions})`);
+    this.emit('created', session);
+    return session;
+  }
+
+  get(id: string): Session | undefined {
+    const session = this.sessions.get(id);
+    if (session) {
+      session.lastActivity = Date.now();
+    }
+    return session;
+  }
+
+  getOrCreate(id: string): Session {
+    return this.get(id) ?? this.create(id);
+  }
+
+  /**
+   * Stop the session's simulation and forget it
+   */
+  destroy(id: string): boolean {
+    const session = this.sessions.get(id);
+    if (!session) return false;
+
+    this.sessions.delete(id);
+    sessionsActive.set(this.sessions.size);
+    if (session.engine.isRunning()) {
+      session.engine.stop();
+    }
+    session.engine.discardTrace();
+    this.emit('destroyed', id);
+    session.engine.removeAllListeners();
+    console.log(`🧹 Session destroyed: ${id} (${this.sessions.size}/${this.maxSessions})`);
+    return true;
+  }
+
+  destroyAll(): void {
+    for (const id of Array.from(this.sessions.keys())) {
+      this.destroy(id);
+    }
+    if (this.reaper) {
+      clearInterval(this.reaper);
+      this.reaper = null;
+    }
+  }
+
+  /**
+   * Throws SessionCapacityError if one more QEMU process would starve the host
+   */
+  assertCanStart(): void {
+    const freeMb = os.freemem() / (1024 * 1024);
+    if (freeMb < this.minFreeMemoryMb) {
+      throw new SessionCapacityError(`Server low on memory (${Math.round(freeMb)} MB free)`);
+    }
+  }
+
+  attachClient(session: Session): void {
+    session.clients++;
+    session.lastActivity = Date.now();
+  }
+
+  detachClient(session: Session): void {
+    session.clients = Math.max(0, session.clients - 1);
+    session.lastActivity = Date.now();
+  }
+
+  list(): SessionInfo[] {
+    const now = Date.now();
+    return Array.from(this.sessions.values()).map(session => ({
+      id: session.id,
+      running: session.engine.isRunning(),
+      backend: session.engine.getBackendType(),
+      clients: session.clients,
+      createdAt: session.createdAt,
+      idleMs: now - session.lastActivity
+    }));
+  }
+
+  /**
+   * Firmware loaded by any session, running or not (see CompilerService.trackFirmwareUsers)
+   */
+  firmwarePaths(): string[] {
+    const paths: string[] = [];
+    this.sessions.forEach(session => {
+      const firmware = session.engine.getFirmwarePath();
+      if (firmware) paths.push(firmware);
+    });
+    return paths;
+  }
+
+  getStats(): { sessions: number; running: number; maxSessions: number } {
+    let running = 0;
+    this.sessions.forEach(session => {
+      if (session.engine.isRunning()) running++;
+    });
+    return { sessions: this.sessions.size, running, maxSessions: this.maxSessions };
+  }
+
+  private startReaper(): void {
+    if (this.reaper) return;
+    this.reaper = setInterval(() => this.reapIdle(), Math.min(60000, this.idleTimeoutMs));
+    this.reaper.unref();
+  }
+
+  /**
+   * Destroy sessions nobody is watching or calling anymore
+   */
+  private reapIdle(): void {
+    const now = Date.now();
+    this.sessions.forEach(session => {
+      if (session.clients === 0 && now - session.lastActivity > this.idleTimeoutMs) {
+        console.log(`⏰ Session idle for ${Math.round((now - session.lastActivity) / 1000)}s: ${session.id}`);
+        this.destroy(session.id);
+      }
+    });
+  }
+}
@@ -0,0 +1,572 @@
+import * as os from 'os';
+import * as path from 'path';
+import { randomUUID } from 'crypto';
+import type { CompilerService, BoardType, CompileResult } from './CompilerService';
+import { QEMUSimulationEngine } from './QEMUSimulationEngine';
+import type { QEMUInstancePool } from './QEMUInstancePool';
+import type { PinTraceRecorder } from './PinTraceRecorder';
+import type { Esp32BackendConfig } from '../types/esp32.types';
+import type { RunMode } from '../types/simulation.types';
+
+/**
+ * One check on a finished run. Times are ms of simulation time (virtual
+ * time on AVR, wall time since start on ESP32); windows default to the
+ * whole run.
+ * - serial: a line matching pattern (regex) at least `count` times, or never (absent)
+ * - level:  pin level at atMs
+ * - edges:  number of level changes on pin within [min, max]
+ * - period: mean time between rising edges (or the hardware PWM period), ± tolerance (fraction)
+ * - duty:   fraction of time HIGH (or hardware PWM duty), ± tolerance (absolute)
+ */
+export type SketchExpectation =
+  | { type: 'serial'; pattern: string; count?: number; absent?: boolean; fromMs?: number; toMs?: number }
+  | { type: 'level'; pin: number; value: 0 | 1; atMs: number }
+  | { type: 'edges'; pin: number; min?: number; max?: number; fromMs?: number; toMs?: number }
+  | { type: 'period'; pin: number; periodMs: number; tolerance?: number; fromMs?: number; toMs?: number }
+  | { type: 'duty'; pin: number; duty: number; tolerance?: number; fromMs?: number; toMs?: number };
+
+/** Input pin driven by the host once simulation time reaches atMs */
+export interface SketchStimulus {
+  atMs: number;
+  pin: number;
+  value: 0 | 1;
+}
+
+export interface SketchTestCase {
+  name: string;
+  code: string;
+  board: BoardType;
+  durationMs: number;   // Simulation time to run
+  timeoutMs: number;    // Wall-clock limit for the run (compile excluded)
+  runMode: RunMode;
+  inputs: SketchStimulus[];
+  expectations: SketchExpectation[];
+}
+
+export interface SketchExpectationResult {
+  expectation: SketchExpectation;
+  passed: boolean;
+  message: string;
+}
+
+export interface SketchTestResult {
+  index: number;
+  name: string;
+  board: BoardType;
+  status: 'passed' | 'failed' | 'error';
+  error?: string;
+  compileMs: number;
+  compileCached: boolean;
+  runMs: number;        // Wall time from QEMU start to stop
+  simulatedMs: number;  // Simulation time reached
+  expectations: SketchExpectationResult[];
+}
+
+export interface SketchTestRun {
+  id: string;
+  total: number;
+  completed: number;
+  passed: number;
+  failed: number;
+  finished: boolean;
+  startedAt: string;
+  durationMs: number;
+  results: SketchTestResult[]; // Completion order; `index` is the case position
+}
+
+const MAX_CASES = 500;
+const RUN_RETENTION_MS = 60 * 60 * 1000;
+const POLL_MS = 5;
+const DEFAULT_DURATION_MS = 2000;
+const TIMEOUT_MARGIN_MS = 20000;
+const HANDSHAKE_MS = 2000; // AVR: wait this long for the firmware to take the virtual clock
+
+function isEsp32(board: BoardType): boolean {
+  return board === 'esp32' || board.includes('esp32');
+}
+
+function sleep(ms: number): Promise<void> {
+  return new Promise(resolve => setTimeout(resolve, ms));
+}
+
+function optionalNumber(value: any, name: string, min = 0): number | undefined {
+  if (value === undefined) return undefined;
+  if (typeof value !== 'number' || !Number.isFinite(value) || value < min) {
+    throw new Error(`${name} must be a number >= ${min}`);
+  }
+  return value;
+}
+
+function requiredNumber(value: any, name: string, min = 0): number {
+  const number = optionalNumber(value, name, min);
+  if (number === undefined) throw new Error(`${name} is required`);
+  return number;
+}
+
+function parsePin(value: any, name: string): number {
+  if (!Number.isInteger(value) || value < 0 || value > 63) {
+    throw new Error(`${name} must be a pin number (0-63)`);
+  }
+  return value;
+}
+
+function parseExpectation(raw: any, name: string): SketchExpectation {
+  const window = { fromMs: optionalNumber(raw?.fromMs, `${name}.fromMs`), toMs: optionalNumber(raw?.toMs, `${name}.toMs`) };
+
+  switch (raw?.type) {
+    case 'serial':
+      if (typeof raw.pattern !== 'string' || !raw.pattern) {
+        throw new Error(`${name}.pattern must be a regular expression string`);
+      }
+      try {
+        new RegExp(raw.pattern);
+      } catch {
+        throw new Error(`${name}.pattern is not a valid regular expression`);
+      }
+      return { type: 'serial', pattern: raw.pattern, count: optionalNumber(raw.count, `${name}.count`, 1), absent: !!raw.absent, ...window };
+    case 'level':
+      if (raw.value !== 0 && raw.value !== 1) throw new Error(`${name}.value must be 0 or 1`);
+      return { type: 'level', pin: parsePin(raw.pin, `${name}.pin`), value: raw.value, atMs: requiredNumber(raw.atMs, `${name}.atMs`) };
+    case 'edges':
+      if (raw.min === undefined && raw.max === undefined) throw new Error(`${name} needs min and/or max`);
+      return { type: 'edges', pin: parsePin(raw.pin, `${name}.pin`), min: optionalNumber(raw.min, `${name}.min`), max: optionalNumber(raw.max, `${name}.max`), ...window };
+    case 'period':
+      return {
+        type: 'period', pin: parsePin(raw.pin, `${name}.pin`), periodMs: requiredNumber(raw.periodMs, `${name}.periodMs`),
+        tolerance: optionalNumber(raw.tolerance, `${name}.tolerance`), ...window
+      };
+    case 'duty':
+      return {
+        type: 'duty', pin: parsePin(raw.pin, `${name}.pin`), duty: requiredNumber(raw.duty, `${name}.duty`),
+        tolerance: optionalNumber(raw.tolerance, `${name}.tolerance`), ...window
+      };
+    default:
+      throw new Error(`${name}.type must be one of: serial, level, edges, period, duty`);
+  }
+}
+
+function parseRunMode(value: any, board: BoardType): RunMode {
+  // CI-style runs: AVR as fast as possible; the ESP32 has no virtual clock
+  if (value === undefined) return { mode: isEsp32(board) ? 'realtime' : 'max' };
+  if (value === 'realtime' || value === 'max') return { mode: value };
+  if (value?.mode === 'scaled' && typeof value.speed === 'number' && value.speed > 0) return { mode: 'scaled', speed: value.speed };
+  if (value?.mode === 'realtime' || value?.mode === 'max') return { mode: value.mode };
+  throw new Error('runMode must be realtime, max or { mode: "scaled", speed }');
+}
+
+/**
+ * Validate one test case (API body or CLI suite entry, defaults already merged)
+ */
+export function parseSketchTestCase(raw: any, index: number): SketchTestCase {
+  const name = typeof raw?.name === 'string' && raw.name ? raw.name : `case ${index + 1}`;
+  if (typeof raw?.code !== 'string' || !raw.code.trim()) {
+    throw new Error(`${name}: code is required`);
+  }
+  if (!Array.isArray(raw.expectations) || raw.expectations.length === 0) {
+    throw new Error(`${name}: expectations must be a non-empty array`);
+  }
+  if (raw.inputs !== undefined && !Array.isArray(raw.inputs)) {
+    throw new Error(`${name}: inputs must be an array`);
+  }
+
+  const board = (typeof raw.board === 'string' && raw.board ? raw.board : 'arduino-uno') as BoardType;
+  const durationMs = optionalNumber(raw.durationMs, `${name}: durationMs`, 1) ?? DEFAULT_DURATION_MS;
+  const runMode = parseRunMode(raw.runMode, board);
+
+  return {
+    name,
+    code: raw.code,
+    board,
+    durationMs,
+    timeoutMs: optionalNumber(raw.timeoutMs, `${name}: timeoutMs`, 1) ?? durationMs + TIMEOUT_MARGIN_MS,
+    runMode,
+    inputs: (raw.inputs ?? []).map((input: any, i: number) => {
+      if (input?.value !== 0 && input?.value !== 1) throw new Error(`${name}: inputs[${i}].value must be 0 or 1`);
+      return {
+        atMs: requiredNumber(input.atMs, `${name}: inputs[${i}].atMs`),
+        pin: parsePin(input.pin, `${name}: inputs[${i}].pin`),
+        value: input.value
+      };
+    }).sort((a: SketchStimulus, b: SketchStimulus) => a.atMs - b.atMs),
+    expectations: raw.expectations.map((expectation: any, i: number) => parseExpectation(expectation, `${name}: expectations[${i}]`))
+  };
+}
+
+/**
+ * Validate a batch ({ cases: [...] }); top-level fields other than cases are
+ * defaults for every case (board, durationMs, expectations, ...)
+ */
+export function parseSketchTestCases(body: any): SketchTestCase[] {
+  const { cases, ...defaults } = body ?? {};
+  if (!Array.isArray(cases) || cases.length === 0) {
+    throw new Error('cases must be a non-empty array');
+  }
+  if (cases.length > MAX_CASES) {
+    throw new Error(`At most ${MAX_CASES} cases per run`);
+  }
+  return cases.map((raw: any, index: number) => parseSketchTestCase({ ...defaults, ...raw }, index));
+}
+
+interface LevelSegment {
+  fromUs: number;
+  value: number; // 0/1, or the duty (0..1) of hardware PWM / aggregated windows
+  pwmFrequency?: number;
+}
+
+/**
+ * Pin waveform over [fromUs, toUs] as segments, rebuilt from the trace
+ */
+function pinSegments(trace: PinTraceRecorder, pin: number, fromUs: number, toUs: number): { segments: LevelSegment[]; rising: number[]; edges: number } {
+  const segments: LevelSegment[] = [];
+  const rising: number[] = [];
+  let edges = 0;
+  let level = 0;
+
+  for (const page of trace.pages(fromUs, toUs, [pin])) {
+    if (segments.length === 0) {
+      const initial = page.initial.find(state => state.pin === pin);
+      level = initial?.value ? 1 : 0;
+      segments.push(initial?.pwm
+        ? { fromUs, value: initial.pwm.frequency > 0 ? initial.pwm.duty : 0, pwmFrequency: initial.pwm.frequency }
+        : { fromUs, value: level });
+    }
+
+    for (const event of page.events) {
+      const t = event[0];
+      if (event[2] === 'level') {
+        if (event[3] !== level) {
+          edges++;
+          if (event[3]) rising.push(t);
+        }
+        level = event[3];
+        segments.push({ fromUs: t, value: level });
+      } else if (event[2] === 'pwm') {
+        segments.push({ fromUs: t, value: event[4] > 0 ? event[3] : 0, pwmFrequency: event[4] });
+      } else if (event[2] === 'activity') {
+        // Aggregated pin: each window summary is taken as the duty until the next report
+        edges += event[3];
+        segments.push({ fromUs: t, value: event[4] });
+      }
+    }
+  }
+
+  return { segments, rising, edges };
+}
+
+function formatMs(us: number): string {
+  return `${Math.round(us) / 1000} ms`;
+}
+
+/**
+ * Headless batch runner: compiles sketches through CompilerService, runs each
+ * one in its own QEMU instance (up to `concurrency` at once) with the pin trace
+ * on, and checks serial patterns and pin waveforms against expectations.
+ *
+ * Compiles share CompilerService's worker pool and cache, so a class of
+ * identical starter sketches compiles once.
+ */
+export class SketchTestRunner {
+  private readonly compiler: CompilerService;
+  private readonly pool: QEMUInstancePool | null;
+  private readonly concurrency: number;
+  private active = 0;
+  private waiting: (() => void)[] = [];
+  private runs = new Map<string, SketchTestRun>();
+  private engines = new Set<QEMUSimulationEngine>(); // Cases being simulated
+
+  /**
+   * TEST_RUNNER_CONCURRENCY, or one simulation per CPU core
+   */
+  static defaultConcurrency(): number {
+    const configured = parseInt(process.env.TEST_RUNNER_CONCURRENCY || '', 10);
+    return configured > 0 ? configured : Math.max(1, os.cpus().length);
+  }
+
+  constructor(compiler: CompilerService, options: { concurrency?: number; pool?: QEMUInstancePool | null } = {}) {
+    this.compiler = compiler;
+    this.pool = options.pool ?? null;
+    this.concurrency = options.concurrency ?? SketchTestRunner.defaultConcurrency();
+    compiler.trackFirmwareUsers(() =>
+      [...this.engines].map(engine => engine.getFirmwarePath()).filter((file): file is string => file !== null));
+  }
+
+  /**
+   * Run every case; results in case order. onResult sees each one as it finishes.
+   */
+  async run(cases: SketchTestCase[], onResult?: (result: SketchTestResult) => void): Promise<SketchTestResult[]> {
+    return Promise.all(cases.map((testCase, index) =>
+      this.slot(() => this.runCase(testCase, index)).then(result => {
+        onResult?.(result);
+        return result;
+      })
+    ));
+  }
+
+  /**
+   * Start a run in the background (API); poll it with getRun()
+   */
+  start(cases: SketchTestCase[]): SketchTestRun {
+    this.pruneRuns();
+    const startedAt = Date.now();
+    const run: SketchTestRun = {
+      id: randomUUID(), total: cases.length, completed: 0, passed: 0, failed: 0,
+      finished: false, startedAt: new Date(startedAt).toISOString(), durationMs: 0, results: []
+    };
+    this.runs.set(run.id, run);
+
+    this.run(cases, result => {
+      run.results.push(result);
+      run.completed++;
+      if (result.status === 'passed') run.passed++;
+      else run.failed++;
+      run.durationMs = Date.now() - startedAt;
+    }).finally(() => {
+      run.finished = true;
+      run.durationMs = Date.now() - startedAt;
+      console.log(`🧪 Test run ${run.id}: ${run.passed}/${run.total} passed in ${(run.durationMs / 1000).toFixed(1)}s`);
+    });
+
+    return run;
+  }
+
+  getRun(id: string): SketchTestRun | undefined {
+    this.pruneRuns();
+    return this.runs.get(id);
+  }
+
+  getStats(): { concurrency: number; active: number; queued: number } {
+    return { concurrency: this.concurrency, active: this.active, queued: this.waiting.length };
+  }
+
+  private pruneRuns(): void {
+    const cutoff = Date.now() - RUN_RETENTION_MS;
+    this.runs.forEach((run, id) => {
+      if (run.finished && Date.parse(run.startedAt) + run.durationMs < cutoff) {
+        this.runs.delete(id);
+      }
+    });
+  }
+
+  /**
+   * Run task when one of the `concurrency` slots is free (shared by every run)
+   */
+  private async slot<T>(task: () => Promise<T>): Promise<T> {
+    if (this.active >= this.concurrency) {
+      await new Promise<void>(resolve => this.waiting.push(resolve));
+    }
+    this.active++;
+    try {
+      return await task();
+    } finally {
+      this.active--;
+      this.waiting.shift()?.();
+    }
+  }
+
+  private async runCase(testCase: SketchTestCase, index: number): Promise<SketchTestResult> {
+    const result: SketchTestResult = {
+      index, name: testCase.name, board: testCase.board, status: 'error',
+      compileMs: 0, compileCached: false, runMs: 0, simulatedMs: 0, expectations: []
+    };
+
+    const compileStart = performance.now();
+    const compiled = await this.compiler.compile(testCase.code, testCase.board, 'qemu');
+    result.compileMs = Math.round(performance.now() - compileStart);
+    result.compileCached = compiled.cached ?? false;
+    if (!compiled.success) {
+      result.error = `Compile failed: ${compiled.error ?? 'unknown error'}`;
+      return result;
+    }
+
+    const engine = new QEMUSimulationEngine({ pool: this.pool });
+    this.engines.add(engine);
+    const serial: { tUs: number; line: string }[] = [];
+    engine.on('serial', (line: string) => serial.push({ tUs: engine.getTimeUs(), line }));
+
+    const runStart = performance.now();
+    try {
+      await engine.loadFirmware(compiled.firmwarePath!, testCase.board);
+      await engine.start(isEsp32(testCase.board) ? esp32Config(compiled) : undefined, testCase.runMode, { trace: true });
+
+      const timedOut = await this.drive(engine, testCase);
+      result.simulatedMs = Math.round(engine.getTimeUs() / 1000);
+      engine.stop(); // Seals the trace
+      result.runMs = Math.round(performance.now() - runStart);
+
+      const endUs = Math.min(testCase.durationMs * 1000, result.simulatedMs * 1000);
+      result.expectations = testCase.expectations.map(expectation =>
+        this.check(expectation, engine.getTrace()!, serial, endUs));
+
+      if (timedOut) {
+        result.error = `Timed out after ${testCase.timeoutMs} ms at ${result.simulatedMs} ms of ${testCase.durationMs} ms simulated`;
+      } else {
+        result.status = result.expectations.every(check => check.passed) ? 'passed' : 'failed';
+      }
+    } catch (error) {
+      result.error = error instanceof Error ? error.message : String(error);
+      result.runMs = Math.round(performance.now() - runStart);
+    } finally {
+      if (engine.isRunning()) engine.stop();
+      engine.discardTrace();
+      engine.removeAllListeners();
+      this.engines.delete(engine);
+    }
+
+    return result;
+  }
+
+  /**
+   * Apply the inputs at their atMs and stop at durationMs of simulation time; true on wall timeout.
+   * On the AVR virtual clock both are clock marks, so they are exact at any speed.
+   */
+  private async drive(engine: QEMUSimulationEngine, testCase: SketchTestCase): Promise<boolean> {
+    const deadline = performance.now() + testCase.timeoutMs;
+
+    // Until the firmware's HELLO, AVR simulation time is wall time since start (ASCII cores stay on it)
+    if (!isEsp32(testCase.board)) {
+      const handshake = performance.now() + HANDSHAKE_MS;
+      while (engine.getGPIOStats().protocol !== 'binary' && engine.isRunning() && performance.now() < handshake) {
+        await sleep(POLL_MS);
+      }
+    }
+
+    if (engine.getGPIOStats().protocol === 'binary' && !isEsp32(testCase.board)) {
+      return this.driveOnClock(engine, testCase, deadline);
+    }
+
+    // Wall-timed backends (ESP32, ASCII cores): inputs land up to POLL_MS late
+    let next = 0;
+    while (true) {
+      const nowMs = engine.getTimeUs() / 1000;
+      while (next < testCase.inputs.length && testCase.inputs[next].atMs <= nowMs) {
+        const { pin, value } = testCase.inputs[next++];
+        await engine.setPinState(pin, value);
+      }
+
+      if (nowMs >= testCase.durationMs) return false;
+      if (!engine.isRunning()) throw new Error(`Simulation stopped at ${Math.round(nowMs)} ms`);
+      if (performance.now() >= deadline) return true;
+      await sleep(POLL_MS);
+    }
+  }
+
+  /**
+   * drive() on the virtual clock: each input goes out when the clock reaches
+   * its atMs (before the firmware's next WAKE), and the clock is held at durationMs
+   */
+  private driveOnClock(engine: QEMUSimulationEngine, testCase: SketchTestCase, deadline: number): Promise<boolean> {
+    return new Promise((resolve, reject) => {
+      const watch = setInterval(() => {
+        if (!engine.isRunning()) {
+          finish();
+          reject(new Error(`Simulation stopped at ${Math.round(engine.getTimeUs() / 1000)} ms`));
+        } else if (performance.now() >= deadline) {
+          finish();
+          resolve(true);
+        }
+      }, POLL_MS);
+      const finish = () => clearInterval(watch);
+
+      for (const { atMs, pin, value } of testCase.inputs) {
+        engine.atTimeUs(atMs * 1000, () => {
+          engine.setPinState(pin, value).catch(() => { /* Logged by the engine */ });
+        });
+      }
+      engine.atTimeUs(testCase.durationMs * 1000, () => {
+        finish();
+        resolve(false);
+        return true; // Hold: nothing runs past durationMs
+      });
+    });
+  }
+
+  private check(
+    expectation: SketchExpectation,
+    trace: PinTraceRecorder,
+    serial: { tUs: number; line: string }[],
+    endUs: number
+  ): SketchExpectationResult {
+    const fromUs = 'fromMs' in expectation && expectation.fromMs !== undefined ? expectation.fromMs * 1000 : 0;
+    const toUs = 'toMs' in expectation && expectation.toMs !== undefined ? Math.min(expectation.toMs * 1000, endUs) : endUs;
+    const window = `[${formatMs(fromUs)}, ${formatMs(toUs)}]`;
+    const outcome = (passed: boolean, message: string) => ({ expectation, passed, message });
+
+    switch (expectation.type) {
+      case 'serial': {
+        const pattern = new RegExp(expectation.pattern);
+        const matches = serial.filter(({ tUs, line }) => tUs >= fromUs && tUs <= toUs && pattern.test(line)).length;
+        if (expectation.absent) {
+          return outcome(matches === 0, `/${expectation.pattern}/ matched ${matches} line(s) in ${window}, expected none`);
+        }
+        const count = expectation.count ?? 1;
+        return outcome(matches >= count, `/${expectation.pattern}/ matched ${matches} line(s) in ${window}, expected >= ${count}`);
+      }
+
+      case 'level': {
+        const atUs = expectation.atMs * 1000;
+        if (atUs > endUs) {
+          return outcome(false, `pin ${expectation.pin} at ${formatMs(atUs)}: simulation ended at ${formatMs(endUs)}`);
+        }
+        const { segments } = pinSegments(trace, expectation.pin, atUs, atUs);
+        const value = segments.length > 0 && segments[segments.length - 1].value > 0 ? 1 : 0;
+        return outcome(value === expectation.value, `pin ${expectation.pin} at ${formatMs(atUs)} was ${value}, expected ${expectation.value}`);
+      }
+
+      case 'edges': {
+        const { edges } = pinSegments(trace, expectation.pin, fromUs, toUs);
+        const min = expectation.min ?? 0;
+        const max = expectation.max ?? Infinity;
+        return outcome(edges >= min && edges <= max,
+          `pin ${expectation.pin} changed ${edges} time(s) in ${window}, expected ${min}..${max === Infinity ? '∞' : max}`);
+      }
+
+      case 'period': {
+        const { segments, rising } = pinSegments(trace, expectation.pin, fromUs, toUs);
+        const tolerance = expectation.tolerance ?? 0.05;
+        const pwm = segments.filter(segment => segment.pwmFrequency).pop();
+        let periodMs: number | null = null;
+        if (rising.length >= 2) {
+          periodMs = (rising[rising.length - 1] - rising[0]) / (rising.length - 1) / 1000;
+        } else if (pwm) {
+          periodMs = 1000 / pwm.pwmFrequency!;
+        }
+        if (periodMs === null) {
+          return outcome(false, `pin ${expectation.pin}: fewer than 2 rising edges in ${window}`);
+        }
+        const error = Math.abs(periodMs - expectation.periodMs) / expectation.periodMs;
+        return outcome(error <= tolerance,
+          `pin ${expectation.pin} period ${Math.round(periodMs * 1000) / 1000} ms in ${window}, expected ${expectation.periodMs} ms ±${tolerance * 100}%`);
+      }
+
+      case 'duty': {
+        const { segments } = pinSegments(trace, expectation.pin, fromUs, toUs);
+        const tolerance = expectation.tolerance ?? 0.05;
+        if (toUs <= fromUs) {
+          return outcome(false, `pin ${expectation.pin}: empty window ${window}`);
+        }
+        let highUs = 0;
+        segments.forEach((segment, i) => {
+          const end = i + 1 < segments.length ? segments[i + 1].fromUs : toUs;
+          highUs += Math.max(0, end - segment.fromUs) * segment.value;
+        });
+        const duty = highUs / (toUs - fromUs);
+        return outcome(Math.abs(duty - expectation.duty) <= tolerance,
+          `pin ${expectation.pin} duty ${Math.round(duty * 1000) / 1000} in ${window}, expected ${expectation.duty} ±${tolerance}`);
+      }
+    }
+  }
+}
+
+function esp32Config(compiled: CompileResult): Esp32BackendConfig {
+  return {
+    flash: {
+      flashImagePath: compiled.firmwarePath!,
+      efuseImagePath: compiled.efusePath ?? path.join(path.dirname(compiled.firmwarePath!), 'qemu_efuse.bin')
+    },
+    qemuOptions: {
+      memory: process.env.ESP32_DEFAULT_MEMORY || '4M',
+      networkMode: 'none',
+      wdtDisable: true
+    }
+  };
+}
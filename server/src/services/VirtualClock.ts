@@ -0,0 +1,235 @@
+import { EventEmitter } from 'events';
+
+/** Virtual ms per wall ms, or 'max' to wake the firmware immediately */
+export type ClockSpeed = number | 'max';
+
+/**
+ * Host-side virtual clock for NeuroForge Time v1
+ *
+ * The firmware asks to sleep (NF_OP_SLEEP) and halts until the host
+ * answers with NF_OP_WAKE carrying the new virtual time. This clock
+ * decides when that wake-up happens, so pause really freezes time and
+ * the speed can be scaled or unbounded ('max', for CI-style runs).
+ *
+ * Host actions can be pinned to a virtual time with at(): the clock
+ * stops there on the way to the firmware's deadline, so they land at
+ * exactly that time whatever the speed.
+ *
+ * Events:
+ * - 'wake' (nowUs): send NF_OP_WAKE to the firmware
+ */
+export class VirtualClock extends EventEmitter {
+  /**
+   * A sleep requested this soon after the previous wake-up is anchored
+   * to that wake-up's due time, so timer lateness does not accumulate.
+   */
+  private static readonly CATCH_UP_MS = 20;
+
+  private nowUs = 0;
+  private wakeAtUs: number | null = null; // Virtual time (µs) of the pending wake-up
+  private wakeDue = 0; // Wall time (Date.now) the pending wake-up is due
+  private lastDue: number | null = null; // Wall time of the last wake-up
+  private timer: NodeJS.Timeout | null = null;
+  private immediate: NodeJS.Immediate | null = null;
+  private pausedAt: number | null = null;
+  private speed: ClockSpeed = 1;
+  private sleepDeadlineUs: number | null = null; // Deadline the sleeping firmware asked for
+  private sleepFromUs = 0; // Virtual time the current sleep started at
+  private sleepAnchor = 0; // Wall time the current sleep is paced from
+  private marks: { atUs: number; fn: () => boolean | void }[] = []; // Sorted by atUs
+
+  /**
+   * Current virtual time in ms
+   */
+  now(): number {
+    return Math.floor(this.nowUs / 1000);
+  }
+
+  /**
+   * Current virtual time in µs
+   */
+  nowMicros(): number {
+    return this.nowUs;
+  }
+
+  /**
+   * Current speed (1 = real time)
+   */
+  getSpeed(): ClockSpeed {
+    return this.speed;
+  }
+
+  /**
+   * Change the speed; a pending wake-up keeps its virtual deadline
+   */
+  setSpeed(speed: ClockSpeed): void {
+    if (speed !== 'max' && !(speed > 0)) {
+      throw new Error(`Invalid clock speed: ${speed}`);
+    }
+
+    if (this.wakeAtUs !== null && speed !== 'max') {
+      // Remaining virtual time, re-timed at the new speed
+      const remainingMs = this.speed === 'max'
+        ? 0
+        : Math.max(0, this.wakeDue - Date.now()) * this.speed;
+      this.wakeDue = Date.now() + remainingMs / speed;
+      this.sleepAnchor = this.wakeDue - (this.wakeAtUs - this.sleepFromUs) / 1000 / speed;
+    }
+
+    this.speed = speed;
+    this.lastDue = null;
+    this.schedule();
+  }
+
+  /**
+   * True while the firmware is halted waiting for a wake-up
+   */
+  isSleeping(): boolean {
+    return this.wakeAtUs !== null;
+  }
+
+  /**
+   * Firmware requested to sleep until deadlineUs of virtual time.
+   * The deadline also covers time the firmware advanced on its own
+   * (short delayMicroseconds), which gets paced here.
+   */
+  sleepUntil(deadlineUs: number): void {
+    const wall = Date.now();
+    this.sleepDeadlineUs = Math.max(deadlineUs, this.nowUs);
+    this.sleepFromUs = this.nowUs;
+    this.sleepAnchor = this.lastDue !== null && wall - this.lastDue < VirtualClock.CATCH_UP_MS
+      ? this.lastDue
+      : wall;
+    this.arm();
+  }
+
+  /**
+   * Run fn once virtual time reaches atUs (right away if it already has).
+   * A sleeping firmware is not woken early: the clock stops at atUs, runs
+   * fn (e.g. an NF_OP_INPUT frame, which the RX interrupt takes while the
+   * CPU sleeps) and goes on to the firmware's deadline. Frames fn sends go
+   * out before the WAKE of that deadline. fn returning true holds the clock
+   * at atUs (paused, firmware asleep) until resume().
+   */
+  at(atUs: number, fn: () => boolean | void): void {
+    if (atUs <= this.nowUs) {
+      if (fn() === true) this.pause();
+      return;
+    }
+
+    let index = this.marks.length;
+    while (index > 0 && this.marks[index - 1].atUs > atUs) index--;
+    this.marks.splice(index, 0, { atUs, fn });
+
+    if (this.sleepDeadlineUs !== null) this.arm();
+  }
+
+  /**
+   * Freeze virtual time (the firmware stays asleep)
+   */
+  pause(): void {
+    if (this.pausedAt !== null) return;
+    this.pausedAt = Date.now();
+    this.clearTimer();
+  }
+
+  /**
+   * Continue from where pause() left off
+   */
+  resume(): void {
+    if (this.pausedAt === null) return;
+    const pausedFor = Date.now() - this.pausedAt;
+    this.pausedAt = null;
+    this.wakeDue += pausedFor;
+    this.sleepAnchor += pausedFor;
+    if (this.lastDue !== null) this.lastDue += pausedFor;
+    this.schedule();
+  }
+
+  /**
+   * Back to t=0 (new simulation)
+   */
+  reset(): void {
+    this.clearTimer();
+    this.nowUs = 0;
+    this.wakeAtUs = null;
+    this.lastDue = null;
+    this.pausedAt = null;
+    this.sleepDeadlineUs = null;
+    this.marks = [];
+  }
+
+  /**
+   * Next stop of the sleeping firmware's clock: its deadline, or the
+   * first at() mark before it
+   */
+  private arm(): void {
+    if (this.sleepDeadlineUs === null) return;
+
+    const mark = this.marks[0]?.atUs;
+    const target = mark !== undefined && mark < this.sleepDeadlineUs ? mark : this.sleepDeadlineUs;
+    this.wakeAtUs = target;
+    this.wakeDue = this.speed === 'max'
+      ? Date.now()
+      : this.sleepAnchor + (target - this.sleepFromUs) / 1000 / this.speed;
+    this.schedule();
+  }
+
+  private schedule(): void {
+    this.clearTimer();
+    if (this.wakeAtUs === null || this.pausedAt !== null) return;
+
+    if (this.speed === 'max') {
+      // setTimeout(0) costs ~1 ms per sleep; fine for real time, not here
+      this.immediate = setImmediate(() => this.wake());
+      return;
+    }
+
+    const delay = this.wakeDue - Date.now();
+    if (delay < 1) {
+      // Sub-ms sleep or behind schedule: catch up without the setTimeout floor
+      this.immediate = setImmediate(() => this.wake());
+      return;
+    }
+    this.timer = setTimeout(() => this.wake(), delay);
+  }
+
+  private wake(): void {
+    this.timer = null;
+    this.immediate = null;
+    if (this.wakeAtUs === null) return;
+
+    this.nowUs = this.wakeAtUs;
+    this.wakeAtUs = null;
+    this.lastDue = this.wakeDue;
+
+    let hold = false;
+    while (this.marks.length > 0 && this.marks[0].atUs <= this.nowUs) {
+      if (this.marks.shift()!.fn() === true) hold = true;
+    }
+    if (hold) {
+      this.pause();
+      this.arm(); // Armed but paused: resume() picks the sleep up from here
+      return;
+    }
+
+    if (this.sleepDeadlineUs !== null && this.nowUs < this.sleepDeadlineUs) {
+      this.arm(); // Stopped for a mark: the firmware sleeps on
+      return;
+    }
+
+    this.sleepDeadlineUs = null;
+    this.emit('wake', this.nowUs);
+  }
+
+  private clearTimer(): void {
+    if (this.timer) {
+      clearTimeout(this.timer);
+      this.timer = null;
+    }
+    if (this.immediate) {
+      clearImmediate(this.immediate);
+      this.immediate = null;
+    }
+  }
+}
@@ -1,24 +1,658 @@
 
 #include <Arduino.h>
+#include <driver/uart.h>
+#include <esp32-hal-ledc.h>
+#include <esp32-hal-periman.h>
+#include <esp_rom_sys.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <hal/gpio_hal.h>
+#include <hal/uart_ll.h>
+#if __has_include(<driver/uart_vfs.h>)
+#include <driver/uart_vfs.h> // IDF >= 5.3 (arduino-esp32 3.1+, pinned 3.3.6)
+#define nf_uart_vfs_use_driver uart_vfs_dev_use_driver
+#else
+#include <esp_vfs_dev.h>
+#define nf_uart_vfs_use_driver esp_vfs_dev_uart_use_driver
+#endif
+#include <soc/gpio_struct.h>
 
 // Forward declarations of the original weak functions in the core
 extern "C" void __digitalWrite(uint8_t pin, uint8_t val);
 extern "C" void __pinMode(uint8_t pin, uint8_t mode);
+extern "C" int __digitalRead(uint8_t pin);
+extern "C" uint16_t __analogRead(uint8_t pin);
 
-// We use ets_printf to write directly to UART0 (Serial)
-// avoiding direct dependency on Serial object initialization
-extern "C" int ets_printf(const char *fmt, ...);
+// Wire protocol shared with the AVR core (see nf_proto.h):
+// [0xA5][op][payload][crc8], CRC-8/CCITT over op + payload
+#define NF_SYNC 0xA5
+#define NF_PROTO_VERSION 2
+#define NF_OP_HELLO 0x00 // version, flags
+#define NF_OP_GPIO 0x01  // pin, value
+#define NF_OP_MODE 0x02  // pin, mode (0=INPUT, 1=OUTPUT, 2=INPUT_PULLUP)
+#define NF_OP_DROPS 0x03 // total coalesced reports u16
+#define NF_OP_PWM 0x06   // pin, duty u16 (65535 = 100%), frequency Hz u32
+#define NF_OP_GPIO_MASK 0x07 // changed u64, levels u64 (sampled capture)
+
+static uint8_t nf_crc8(uint8_t crc, uint8_t c) {
+  crc ^= c;
+  for (uint8_t i = 0; i < 8; i++)
+    crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+  return crc;
+}
+
+// UART0 has a single writer: every byte on it goes through nf_uart0_write()
+// under one portMUX spinlock, so no core can put bytes in the middle of a
+// GPIO frame. Masking interrupts alone only protects the local core. The
+// other writers are routed here too:
+// - Serial and stdout (VFS switched to the driver path) call
+//   uart_write_bytes(), linker-wrapped below
+// - ets_printf/esp_rom_printf and the Arduino log go through the ROM putc1,
+//   replaced by nf_uart0_putc (again after Serial.setDebugOutput())
+// Writes go straight into the TX FIFO (works even if Serial is not
+// begin()'d), a chunk at a time. Waiting for FIFO room happens outside the
+// lock with interrupts enabled; the locked section only copies bytes that
+// already fit, a few µs, so neither core stalls for the line's byte time.
+// Text may split between chunks, but a frame (<= 19 bytes) never does.
+#define NF_UART0_CHUNK 32
+
+static portMUX_TYPE nf_uart0_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void nf_uart0_write(const uint8_t *data, size_t len) {
+  uart_dev_t *hw = UART_LL_GET_HW(UART_NUM_0);
+  while (len > 0) {
+    uint32_t chunk = len < NF_UART0_CHUNK ? len : NF_UART0_CHUNK;
+    while (uart_ll_get_txfifo_len(hw) < chunk) {
+    }
+
+    portENTER_CRITICAL_SAFE(&nf_uart0_lock);
+    // The other core may have taken the room since the check above
+    bool room = uart_ll_get_txfifo_len(hw) >= chunk;
+    if (room)
+      uart_ll_write_txfifo(hw, data, chunk);
+    portEXIT_CRITICAL_SAFE(&nf_uart0_lock);
+
+    if (room) {
+      data += chunk;
+      len -= chunk;
+    }
+  }
+}
+
+static void nf_uart0_putc(char c) {
+  nf_uart0_write((const uint8_t *)&c, 1);
+}
+
+extern "C" int __real_uart_write_bytes(uart_port_t uart_num, const void *src, size_t size);
+
+extern "C" int __wrap_uart_write_bytes(uart_port_t uart_num, const void *src, size_t size) {
+  if (uart_num != UART_NUM_0)
+    return __real_uart_write_bytes(uart_num, src, size);
+  nf_uart0_write((const uint8_t *)src, size);
+  return (int)size;
+}
+
+// ROM/log output follows the Arduino debug port; only UART0 is ours to lock
+static void nf_uart0_claim_putc() {
+  if (uartGetDebug() == UART_NUM_0)
+    esp_rom_install_channel_putc(1, nf_uart0_putc);
+}
+
+extern "C" void __real_uartSetDebug(uart_t *uart);
+
+extern "C" void __wrap_uartSetDebug(uart_t *uart) {
+  __real_uartSetDebug(uart);
+  nf_uart0_claim_putc();
+}
+
+static void nf_uart0_claim() {
+  // tx via uart_write_bytes(), i.e. through the wrap above, driver or not
+  nf_uart_vfs_use_driver(UART_NUM_0);
+  nf_uart0_claim_putc();
+}
+
+// GPIO reports: digitalWrite()/pinMode()/ledcWrite() only push an event
+// into a lock-free ring owned by the calling core (SPSC: that core is the
+// only producer, the drain task the only consumer). Interrupts are masked
+// on the local core for the few stores of a push, so tasks and ISRs on the
+// same core cannot interleave; the other core is never blocked.
+// A global sequence number keeps the order across cores when draining.
+#define NF_RING_LEN 256 // Per core, power of 2: ~1 ms of back-to-back writes
+#define NF_PINS 64
+#define NF_DRAIN_STACK 2048
+
+struct nf_event {
+  uint32_t seq;
+  uint32_t value; // Level, mode or PWM frequency
+  uint16_t duty;
+  uint8_t op;
+  uint8_t pin;
+};
+
+struct nf_ring {
+  nf_event events[NF_RING_LEN];
+  uint32_t head; // Written by the producer core only
+  uint32_t tail; // Written by the drain task only
+};
+
+// Last reported state per pin, so repeated writes cost no event at all
+struct nf_pwm_state {
+  uint16_t duty;
+  uint32_t frequency;
+};
+
+static nf_ring nf_rings[portNUM_PROCESSORS];
+static uint8_t nf_pin_states[NF_PINS];
+static uint8_t nf_pin_modes[NF_PINS];
+static nf_pwm_state nf_pwm_states[NF_PINS];
+static uint32_t nf_seq = 0;
+static uint32_t nf_dropped = 0;
+static uint8_t nf_events_started = 0;
+
+// Pins whose event did not fit in a full ring: the drain task sends their
+// cached state instead (two 32-bit words per kind, atomics stay lock-free)
+#define NF_PENDING_GPIO 0
+#define NF_PENDING_MODE 1
+#define NF_PENDING_PWM 2
+static uint32_t nf_pending[3][NF_PINS / 32];
+
+// Sampled capture: instead of hooking every write, a periodic esp_timer
+// reads GPIO.out/out1 and queues what changed on the output pins. Sees
+// gpio_set_level() and GPIO.out_w1ts writes, misses pulses shorter than
+// the period; digitalWrite() then skips its per-call report.
+#define NF_CAPTURE_HOOKS 0
+#define NF_CAPTURE_SAMPLED 1
+#define NF_SAMPLE_RING_LEN 64
+#define NF_SAMPLE_MIN_US 50 // esp_timer periodic minimum
+
+struct nf_sample {
+  uint64_t changed;
+  uint64_t levels;
+};
+
+// SPSC: the esp_timer task produces, the drain task consumes
+static nf_sample nf_samples[NF_SAMPLE_RING_LEN];
+static uint32_t nf_sample_head = 0;
+static uint32_t nf_sample_tail = 0;
+static uint8_t nf_capture_mode = NF_CAPTURE_HOOKS;
+
+// Cache entries start unknown, so the first write of any pin is reported
+__attribute__((constructor)) static void nf_events_init() {
+  memset(nf_pin_states, 0xFF, sizeof(nf_pin_states));
+  memset(nf_pin_modes, 0xFF, sizeof(nf_pin_modes));
+}
+
+// Caller masks interrupts on the local core
+static void nf_push(uint8_t op, uint8_t pin, uint32_t value, uint16_t duty, uint8_t pending) {
+  nf_ring &ring = nf_rings[xPortGetCoreID()];
+  uint32_t head = ring.head;
+
+  if (head - __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE) >= NF_RING_LEN) {
+    // Full: the cache already holds the latest state, send it later
+    __atomic_fetch_or(&nf_pending[pending][pin / 32], 1UL << (pin % 32), __ATOMIC_RELAXED);
+    __atomic_fetch_add(&nf_dropped, 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  nf_event &event = ring.events[head % NF_RING_LEN];
+  event.seq = __atomic_fetch_add(&nf_seq, 1, __ATOMIC_RELAXED);
+  event.value = value;
+  event.duty = duty;
+  event.op = op;
+  event.pin = pin;
+  __atomic_store_n(&ring.head, head + 1, __ATOMIC_RELEASE);
+}
+
+// One frame, written in a single nf_uart0_write() chunk
+static void nf_write_frame(uint8_t op, const uint8_t *payload, uint8_t len) {
+  uint8_t frame[3 + 16];
+  if (len > sizeof(frame) - 3)
+    return;
+
+  uint8_t crc = nf_crc8(0, op);
+  frame[0] = NF_SYNC;
+  frame[1] = op;
+  for (uint8_t i = 0; i < len; i++) {
+    frame[2 + i] = payload[i];
+    crc = nf_crc8(crc, payload[i]);
+  }
+  frame[2 + len] = crc;
+  nf_uart0_write(frame, len + 3);
+}
+
+static void nf_send(uint8_t op, uint8_t pin, uint32_t value, uint16_t duty) {
+  if (op == NF_OP_PWM) {
+    uint8_t payload[7] = {pin,
+                          (uint8_t)duty,
+                          (uint8_t)(duty >> 8),
+                          (uint8_t)value,
+                          (uint8_t)(value >> 8),
+                          (uint8_t)(value >> 16),
+                          (uint8_t)(value >> 24)};
+    nf_write_frame(op, payload, sizeof(payload));
+  } else {
+    uint8_t payload[2] = {pin, (uint8_t)value};
+    nf_write_frame(op, payload, sizeof(payload));
+  }
+}
+
+// Drain both rings oldest-first, then the pins that overflowed
+static void nf_drain() {
+  for (;;) {
+    nf_ring *next = NULL;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+      nf_ring &ring = nf_rings[core];
+      if (ring.tail == __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE))
+        continue;
+      if (!next || (int32_t)(ring.events[ring.tail % NF_RING_LEN].seq - next->events[next->tail % NF_RING_LEN].seq) < 0)
+        next = &ring;
+    }
+    if (!next)
+      break;
+
+    nf_event event = next->events[next->tail % NF_RING_LEN];
+    __atomic_store_n(&next->tail, next->tail + 1, __ATOMIC_RELEASE);
+    nf_send(event.op, event.pin, event.value, event.duty);
+  }
+
+  for (uint8_t kind = 0; kind < 3; kind++) {
+    for (uint8_t word = 0; word < NF_PINS / 32; word++) {
+      uint32_t mask = __atomic_exchange_n(&nf_pending[kind][word], 0, __ATOMIC_ACQ_REL);
+      while (mask) {
+        uint8_t pin = word * 32 + __builtin_ctz(mask);
+        mask &= mask - 1;
+        if (kind == NF_PENDING_GPIO)
+          nf_send(NF_OP_GPIO, pin, nf_pin_states[pin], 0);
+        else if (kind == NF_PENDING_MODE)
+          nf_send(NF_OP_MODE, pin, nf_pin_modes[pin], 0);
+        else
+          nf_send(NF_OP_PWM, pin, nf_pwm_states[pin].frequency, nf_pwm_states[pin].duty);
+      }
+    }
+  }
+
+  // Sampled deltas after the mode changes that made those pins outputs
+  while (nf_sample_tail != __atomic_load_n(&nf_sample_head, __ATOMIC_ACQUIRE)) {
+    nf_sample sample = nf_samples[nf_sample_tail % NF_SAMPLE_RING_LEN];
+    __atomic_store_n(&nf_sample_tail, nf_sample_tail + 1, __ATOMIC_RELEASE);
+
+    uint8_t payload[16];
+    for (uint8_t i = 0; i < 8; i++) {
+      payload[i] = (uint8_t)(sample.changed >> (8 * i));
+      payload[8 + i] = (uint8_t)(sample.levels >> (8 * i));
+    }
+    nf_write_frame(NF_OP_GPIO_MASK, payload, sizeof(payload));
+  }
+
+  static uint32_t reported_drops = 0;
+  uint32_t dropped = __atomic_load_n(&nf_dropped, __ATOMIC_RELAXED);
+  if (dropped != reported_drops) {
+    reported_drops = dropped;
+    uint8_t payload[2] = {(uint8_t)dropped, (uint8_t)(dropped >> 8)};
+    nf_write_frame(NF_OP_DROPS, payload, sizeof(payload));
+  }
+}
+
+// Lowest priority above idle (same as loopTask, so they time-slice), on the
+// core that runs the sketch
+static void nf_drain_task(void *) {
+  uint8_t hello[2] = {NF_PROTO_VERSION, 0};
+  nf_write_frame(NF_OP_HELLO, hello, sizeof(hello));
+
+  for (;;) {
+    nf_drain();
+    vTaskDelay(1);
+  }
+}
+
+// Started before setup(), or by an earlier report outside an ISR; events
+// pushed before that (or from ISRs) simply wait in the rings
+static void nf_events_start() {
+  if (__atomic_exchange_n(&nf_events_started, 1, __ATOMIC_ACQ_REL))
+    return;
+  xTaskCreatePinnedToCore(nf_drain_task, "nf_drain", NF_DRAIN_STACK, NULL, tskIDLE_PRIORITY + 1, NULL, ARDUINO_RUNNING_CORE);
+}
+
+static void nf_report(uint8_t op, uint8_t pin, uint8_t value) {
+  if (pin >= NF_PINS)
+    return;
+
+  uint8_t *cache = op == NF_OP_GPIO ? nf_pin_states : nf_pin_modes;
+  UBaseType_t irq = portSET_INTERRUPT_MASK_FROM_ISR();
+  if (cache[pin] != value) {
+    cache[pin] = value;
+    nf_push(op, pin, value, 0, op == NF_OP_GPIO ? NF_PENDING_GPIO : NF_PENDING_MODE);
+  }
+  portCLEAR_INTERRUPT_MASK_FROM_ISR(irq);
+
+  if (!nf_events_started && !xPortInIsrContext())
+    nf_events_start();
+}
+
+static esp_timer_handle_t nf_sample_timer = NULL;
+static uint64_t nf_sample_out = 0;
+static uint64_t nf_sample_enable = 0;
+static uint64_t nf_sample_carry = 0; // Changes that found the ring full
+
+static void nf_sample_tick(void *) {
+  uint64_t enable = GPIO.enable | ((uint64_t)(GPIO.enable1.val & 0xFF) << 32);
+  uint64_t out = GPIO.out | ((uint64_t)(GPIO.out1.val & 0xFF) << 32);
+
+  // Output pins whose level changed, plus pins that just became outputs
+  uint64_t changed = ((out ^ nf_sample_out) & enable) | (enable & ~nf_sample_enable) | nf_sample_carry;
+  nf_sample_out = out;
+  nf_sample_enable = enable;
+  if (!changed)
+    return;
+
+  uint32_t head = nf_sample_head;
+  if (head - __atomic_load_n(&nf_sample_tail, __ATOMIC_ACQUIRE) >= NF_SAMPLE_RING_LEN) {
+    // Full: resend these pins with the next entry that fits, only intermediate levels are lost
+    nf_sample_carry = changed;
+    __atomic_fetch_add(&nf_dropped, 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  nf_samples[head % NF_SAMPLE_RING_LEN] = {changed, out};
+  nf_sample_carry = 0;
+  __atomic_store_n(&nf_sample_head, head + 1, __ATOMIC_RELEASE);
+}
+
+// NF_OP_CAPTURE from the host: mode, sampling period in us
+static void nf_capture_set(uint8_t mode, uint32_t period_us) {
+  if (nf_sample_timer) {
+    esp_timer_stop(nf_sample_timer);
+  } else {
+    esp_timer_create_args_t args = {};
+    args.callback = nf_sample_tick;
+    args.name = "nf_sample";
+    if (esp_timer_create(&args, &nf_sample_timer) != ESP_OK)
+      return;
+  }
+
+  nf_capture_mode = mode == NF_CAPTURE_SAMPLED ? NF_CAPTURE_SAMPLED : NF_CAPTURE_HOOKS;
+  if (nf_capture_mode == NF_CAPTURE_SAMPLED) {
+    nf_sample_out = 0;
+    nf_sample_enable = 0; // First tick reports every output pin
+    nf_sample_carry = 0;
+    esp_timer_start_periodic(nf_sample_timer, period_us < NF_SAMPLE_MIN_US ? NF_SAMPLE_MIN_US : period_us);
+  }
+}
 
 // Override digitalWrite
 void digitalWrite(uint8_t pin, uint8_t val) {
   // Call the original implementation in the core
   __digitalWrite(pin, val);
 
-  // Report to NeuroForge
-  // Format: G:pin=2,v=1
-  // We use ets_printf because it works even if Serial is not begin()'d
-  ets_printf("G:pin=%d,v=%d\n", pin, val);
+  // Report to NeuroForge: one ring push, or nothing if the level did not change.
+  // Sampled capture picks the level up from GPIO.out instead.
+  if (nf_capture_mode == NF_CAPTURE_HOOKS)
+    nf_report(NF_OP_GPIO, pin, val ? 1 : 0);
+}
+
+// PWM is reported as one configuration frame per change, never as edges.
+// ledcWrite/ledcWriteTone/analogWrite are not weak in the core: CompilerService
+// links with -Wl,--wrap=<symbol>, which routes the sketch's calls here.
+extern "C" bool __real_ledcWrite(uint8_t pin, uint32_t duty);
+extern "C" uint32_t __real_ledcWriteTone(uint8_t pin, uint32_t freq);
+extern "C" void __real_analogWrite(uint8_t pin, int value);
+
+static void nf_report_pwm(uint8_t pin) {
+  ledc_channel_handle_t *bus = (ledc_channel_handle_t *)perimanGetPinBus(pin, ESP32_BUS_TYPE_LEDC);
+  if (bus == NULL || pin >= NF_PINS)
+    return;
+
+  // Full on is duty == 1 << resolution
+  uint64_t duty16 = ((uint64_t)ledcRead(pin) << 16) >> bus->channel_resolution;
+  uint16_t duty = duty16 > 65535 ? 65535 : (uint16_t)duty16;
+  uint32_t frequency = ledcReadFreq(pin);
+
+  UBaseType_t irq = portSET_INTERRUPT_MASK_FROM_ISR();
+  nf_pwm_state &last = nf_pwm_states[pin];
+  if (last.duty != duty || last.frequency != frequency || nf_pin_states[pin] != 0xFF) {
+    last.duty = duty;
+    last.frequency = frequency;
+    nf_pin_states[pin] = 0xFF; // The next digitalWrite() ends the PWM, even at the same level
+    nf_push(NF_OP_PWM, pin, frequency, duty, NF_PENDING_PWM);
+  }
+  portCLEAR_INTERRUPT_MASK_FROM_ISR(irq);
+
+  if (!nf_events_started && !xPortInIsrContext())
+    nf_events_start();
+}
+
+extern "C" bool __wrap_ledcWrite(uint8_t pin, uint32_t duty) {
+  bool ok = __real_ledcWrite(pin, duty);
+  if (ok)
+    nf_report_pwm(pin);
+  return ok;
+}
+
+extern "C" uint32_t __wrap_ledcWriteTone(uint8_t pin, uint32_t freq) {
+  uint32_t actual = __real_ledcWriteTone(pin, freq);
+  nf_report_pwm(pin);
+  return actual;
+}
+
+extern "C" void __wrap_analogWrite(uint8_t pin, int value) {
+  __real_analogWrite(pin, value);
+  nf_report_pwm(pin);
+}
+
+// Host-driven inputs (same frames as the AVR core, see nf_proto.h):
+// [0xA5][op][payload][crc8]. They arrive on UART1 (second -serial of QEMU)
+// so Serial on UART0 stays untouched; a sketch that uses Serial1 itself
+// gets no host inputs.
+#define NF_OP_INPUT 0x82     // pin, value (NF_INPUT_RELEASE hands the pin back)
+#define NF_OP_ADC_CONST 0x83 // pin, value u16 (NF_ADC_RELEASE hands the ADC back)
+#define NF_OP_ADC_DATA 0x84  // pool index u16, 4 samples u16
+#define NF_OP_ADC_PLAY 0x85  // pin, start u16, length u16, period us u32
+#define NF_OP_CAPTURE 0x86   // mode (NF_CAPTURE_*), sampling period us u32
+#define NF_INPUT_RELEASE 0xFF
+#define NF_ADC_RELEASE 0xFFFF
+#define NF_MAX_PAYLOAD_LEN 10
+#define NF_INPUT_UART UART_NUM_1
+
+static volatile uint64_t nf_input_mask = 0;
+static volatile uint64_t nf_input_value = 0;
+static uint8_t nf_input_started = 0;
+
+static void nf_input_set(uint8_t pin, uint8_t value) {
+  if (pin >= 64)
+    return;
+
+  uint64_t bit = 1ULL << pin;
+  if (value == NF_INPUT_RELEASE) {
+    nf_input_mask &= ~bit;
+    return;
+  }
+
+  if (value)
+    nf_input_value |= bit;
+  else
+    nf_input_value &= ~bit;
+  nf_input_mask |= bit;
+}
+
+// Host-fed analog inputs: constant values, or waveforms uploaded once into
+// a sample pool and looped on virtual time (esp_timer, icount-driven in QEMU)
+#define NF_ADC_POOL_LEN 1024
+#define NF_ADC_PINS 40
+
+#define NF_ADC_OFF 0
+#define NF_ADC_CONST 1
+#define NF_ADC_TABLE 2
+
+struct nf_adc_channel {
+  uint8_t mode;
+  uint16_t value;
+  uint16_t start;
+  uint16_t len;
+  uint32_t period_us;
+  int64_t t0_us;
+};
+
+static uint16_t nf_adc_pool[NF_ADC_POOL_LEN];
+static nf_adc_channel nf_adc_channels[NF_ADC_PINS];
+static portMUX_TYPE nf_adc_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint16_t nf_u16(const uint8_t *p) { return p[0] | ((uint16_t)p[1] << 8); }
+
+static uint32_t nf_u32(const uint8_t *p) { return nf_u16(p) | ((uint32_t)nf_u16(p + 2) << 16); }
+
+static void nf_adc_command(uint8_t op, const uint8_t *p) {
+  portENTER_CRITICAL(&nf_adc_lock);
+  if (op == NF_OP_ADC_DATA) {
+    for (uint16_t i = 0, index = nf_u16(p); i < 4; i++, index++) {
+      if (index < NF_ADC_POOL_LEN)
+        nf_adc_pool[index] = nf_u16(p + 2 + 2 * i);
+    }
+  } else if (p[0] < NF_ADC_PINS) {
+    nf_adc_channel &c = nf_adc_channels[p[0]];
+    if (op == NF_OP_ADC_CONST) {
+      c.value = nf_u16(p + 1);
+      c.mode = c.value == NF_ADC_RELEASE ? NF_ADC_OFF : NF_ADC_CONST;
+    } else {
+      uint16_t start = nf_u16(p + 1), len = nf_u16(p + 3);
+      if (len > 0 && start < NF_ADC_POOL_LEN && len <= NF_ADC_POOL_LEN - start) {
+        c.start = start;
+        c.len = len;
+        c.period_us = nf_u32(p + 5) ? nf_u32(p + 5) : 1;
+        c.t0_us = esp_timer_get_time();
+        c.mode = NF_ADC_TABLE;
+      }
+    }
+  }
+  portEXIT_CRITICAL(&nf_adc_lock);
+}
+
+static int nf_adc_read(uint8_t pin) {
+  if (pin >= NF_ADC_PINS)
+    return -1;
+
+  portENTER_CRITICAL(&nf_adc_lock);
+  nf_adc_channel c = nf_adc_channels[pin];
+  portEXIT_CRITICAL(&nf_adc_lock);
+
+  if (c.mode == NF_ADC_CONST)
+    return c.value;
+  if (c.mode != NF_ADC_TABLE)
+    return -1;
+  return nf_adc_pool[c.start + ((esp_timer_get_time() - c.t0_us) / c.period_us) % c.len];
+}
+
+static uint8_t nf_payload_len(uint8_t op) {
+  switch (op) {
+  case NF_OP_INPUT:
+    return 2;
+  case NF_OP_ADC_CONST:
+    return 3;
+  case NF_OP_ADC_DATA:
+    return 10;
+  case NF_OP_ADC_PLAY:
+    return 9;
+  case NF_OP_CAPTURE:
+    return 5;
+  default:
+    return 0xFF;
+  }
+}
+
+static void nf_dispatch(uint8_t op, const uint8_t *payload) {
+  if (op == NF_OP_INPUT)
+    nf_input_set(payload[0], payload[1]);
+  else if (op == NF_OP_CAPTURE)
+    nf_capture_set(payload[0], nf_u32(payload + 1));
+  else
+    nf_adc_command(op, payload);
+}
+
+// Blocks on the UART driver queue, so it wakes as soon as the RX
+// interrupt fires - the sketch never has to poll anything
+static void nf_input_task(void *) {
+  uint8_t payload[NF_MAX_PAYLOAD_LEN];
+  uint8_t op = 0, len = 0, pos = 0, crc = 0;
+  enum { IDLE, OPCODE, PAYLOAD } state = IDLE;
+  uint8_t buf[64];
+
+  for (;;) {
+    int n = uart_read_bytes(NF_INPUT_UART, buf, sizeof(buf), portMAX_DELAY);
+    for (int i = 0; i < n; i++) {
+      uint8_t c = buf[i];
+      if (state == IDLE) {
+        if (c == NF_SYNC)
+          state = OPCODE;
+      } else if (state == OPCODE) {
+        len = nf_payload_len(c);
+        state = len == 0xFF ? IDLE : PAYLOAD; // Unknown op: resync on the next NF_SYNC
+        op = c;
+        crc = nf_crc8(0, c);
+        pos = 0;
+      } else if (pos < len) {
+        payload[pos++] = c;
+        crc = nf_crc8(crc, c);
+      } else {
+        state = IDLE;
+        if (c == crc)
+          nf_dispatch(op, payload);
+      }
+    }
+  }
+}
+
+// Started before setup() (or by the first input pinMode()/digitalRead()/
+// analogRead() of a global constructor); bytes sent before that wait in
+// QEMU's chardev
+static void nf_input_start() {
+  if (__atomic_exchange_n(&nf_input_started, 1, __ATOMIC_ACQ_REL))
+    return;
+
+  uart_config_t config = {};
+  config.baud_rate = 115200;
+  config.data_bits = UART_DATA_8_BITS;
+  config.parity = UART_PARITY_DISABLE;
+  config.stop_bits = UART_STOP_BITS_1;
+  config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+  config.source_clk = UART_SCLK_APB;
+
+  if (uart_driver_install(NF_INPUT_UART, 256, 0, 0, NULL, 0) != ESP_OK)
+    return;
+  uart_param_config(NF_INPUT_UART, &config);
+  xTaskCreate(nf_input_task, "nf_input", 2048, NULL, configMAX_PRIORITIES - 1, NULL);
+}
+
+// setup() runs from loopTask with the scheduler up: start the input and
+// drain tasks there, so host frames (NF_OP_CAPTURE included) are honoured
+// even by sketches that never touch the Arduino GPIO API
+extern "C" void __real__Z5setupv();
+
+extern "C" void __wrap__Z5setupv() {
+  nf_uart0_claim();
+  nf_input_start();
+  nf_events_start();
+  __real__Z5setupv();
+  // Serial.begin() inside setup() may have installed its own putc
+  nf_uart0_claim_putc();
+}
+
+// Override digitalRead: host-driven pins first, then the real GPIO
+int digitalRead(uint8_t pin) {
+  if (!nf_input_started && !xPortInIsrContext())
+    nf_input_start();
+
+  if (pin < 64 && ((nf_input_mask >> pin) & 1))
+    return (int)((nf_input_value >> pin) & 1);
+  return __digitalRead(pin);
+}
+
+// Override analogRead: host-fed channels first, then the real ADC
+uint16_t analogRead(uint8_t pin) {
+  if (!nf_input_started && !xPortInIsrContext())
+    nf_input_start();
+
+  int sample = nf_adc_read(pin);
+  return sample >= 0 ? (uint16_t)sample : __analogRead(pin);
 }
 
 // Override pinMode
@@ -26,8 +660,11 @@ void pinMode(uint8_t pin, uint8_t mode) {
   // Call the original implementation
   __pinMode(pin, mode);
 
+  // INPUT, INPUT_PULLUP, INPUT_PULLDOWN (OUTPUT is 0x03 on this core)
+  if ((mode & OUTPUT) == INPUT)
+    nf_input_start();
+
   // Report to NeuroForge
-  // Format: M:pin=2,m=1 (OUTPUT)
   // Mapping of modes might differ, but Arduino constants are usually:
   // INPUT=0x01, OUTPUT=0x02, PULLUP=0x04, etc.
   // We simplify reporting for the frontend parser
@@ -37,5 +674,5 @@ void pinMode(uint8_t pin, uint8_t mode) {
   else if (mode == INPUT_PULLUP)
     reportMode = 2;
 
-  ets_printf("M:pin=%d,m=%d\n", pin, reportMode);
+  nf_report(NF_OP_MODE, pin, reportMode);
 }
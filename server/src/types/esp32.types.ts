@@ -7,7 +7,7 @@ import { ChildProcess } from 'child_process';
 export interface Esp32FlashConfig {
   flashImagePath: string;      // qemu_flash.bin
   efuseImagePath: string;       // qemu_efuse.bin
-  serialPort?: number;          // Porta TCP (default: 5555)
+  serialPort?: number;          // Porta TCP (default: alocada dinamicamente)
 }
 
 export interface Esp32QemuOptions {
@@ -0,0 +1,24 @@
+/**
+ * Tipos de execução da simulação (AVR + NeuroForge Time v1)
+ */
+
+/**
+ * - realtime: tempo virtual acompanha o relógio de parede
+ * - scaled:   tempo virtual corre `speed` vezes mais rápido (ou mais lento, se < 1)
+ * - max:      tão rápido quanto possível, desacoplado do relógio de parede
+ */
+export type RunModeKind = 'realtime' | 'scaled' | 'max';
+
+export interface RunMode {
+  mode: RunModeKind;
+  speed?: number; // Só para 'scaled' (ex: 10 = 10×)
+}
+
+/**
+ * Origem dos eventos de GPIO:
+ * - serial:  o firmware reporta cada mudança pela UART (nf_gpio / hooks do shim ESP32)
+ * - gdb:     (AVR) watchpoints do gdbstub do QEMU em PORTx/DDRx/PINx, sem ajuda do firmware
+ * - sampled: (ESP32) o shim amostra GPIO.out/out1 periodicamente; vê gpio_set_level()
+ *            e escritas diretas, perde pulsos menores que o período
+ */
+export type GpioCaptureMode = 'serial' | 'gdb' | 'sampled';
@@ -0,0 +1,51 @@
+// Benchmark: mixed traffic
+// A blinking pin, a PWM sweep, periodic serial output and delay(1) per loop,
+// like a typical sketch. Exercises the sleep/wake path of the virtual clock.
+
+#if defined(ESP32)
+const uint8_t PROBE_IN = 4;
+const uint8_t PROBE_OUT = 5;
+const uint8_t BLINK_PIN = 2;
+const uint8_t PWM_PIN = 19;
+#else
+const uint8_t PROBE_IN = 2;
+const uint8_t PROBE_OUT = 12;
+const uint8_t BLINK_PIN = 13;
+const uint8_t PWM_PIN = 9;
+#endif
+
+// Latency probe: the bench driver flips PROBE_IN, we mirror it on PROBE_OUT
+void probe() {
+  static int last = -1;
+  int level = digitalRead(PROBE_IN);
+  if (level != last) {
+    digitalWrite(PROBE_OUT, level);
+    last = level;
+  }
+}
+
+uint16_t tick = 0;
+
+void setup() {
+  Serial.begin(115200);
+  pinMode(PROBE_IN, INPUT);
+  pinMode(PROBE_OUT, OUTPUT);
+  pinMode(BLINK_PIN, OUTPUT);
+  pinMode(PWM_PIN, OUTPUT);
+}
+
+void loop() {
+  digitalWrite(BLINK_PIN, tick & 1);
+
+  if ((tick & 15) == 0) {
+    analogWrite(PWM_PIN, (tick >> 4) & 0xFF);
+  }
+  if ((tick & 31) == 0) {
+    Serial.print("tick ");
+    Serial.println(tick);
+  }
+
+  tick++;
+  probe();
+  delay(1);
+}
@@ -0,0 +1,40 @@
+// Benchmark: mode churn
+// pinMode() flipping between INPUT, OUTPUT and INPUT_PULLUP on four pins.
+// Measures MODE frame throughput and how the batcher folds mode changes.
+
+#if defined(ESP32)
+const uint8_t PROBE_IN = 4;
+const uint8_t PROBE_OUT = 5;
+const uint8_t CHURN_PINS[] = { 12, 13, 14, 15 };
+#else
+const uint8_t PROBE_IN = 2;
+const uint8_t PROBE_OUT = 12;
+const uint8_t CHURN_PINS[] = { 4, 5, 6, 7 };
+#endif
+
+const uint8_t MODES[] = { OUTPUT, INPUT, INPUT_PULLUP };
+
+// Latency probe: the bench driver flips PROBE_IN, we mirror it on PROBE_OUT
+void probe() {
+  static int last = -1;
+  int level = digitalRead(PROBE_IN);
+  if (level != last) {
+    digitalWrite(PROBE_OUT, level);
+    last = level;
+  }
+}
+
+uint8_t step = 0;
+
+void setup() {
+  pinMode(PROBE_IN, INPUT);
+  pinMode(PROBE_OUT, OUTPUT);
+}
+
+void loop() {
+  for (uint8_t i = 0; i < sizeof(CHURN_PINS); i++) {
+    pinMode(CHURN_PINS[i], MODES[(step + i) % 3]);
+  }
+  step++;
+  probe();
+}
@@ -0,0 +1,35 @@
+// Benchmark: serial flood
+// Serial.println() back to back; GPIO frames share the UART with the text.
+// Measures serial throughput and probe latency behind a full TX path.
+
+#if defined(ESP32)
+const uint8_t PROBE_IN = 4;
+const uint8_t PROBE_OUT = 5;
+#else
+const uint8_t PROBE_IN = 2;
+const uint8_t PROBE_OUT = 12;
+#endif
+
+// Latency probe: the bench driver flips PROBE_IN, we mirror it on PROBE_OUT
+void probe() {
+  static int last = -1;
+  int level = digitalRead(PROBE_IN);
+  if (level != last) {
+    digitalWrite(PROBE_OUT, level);
+    last = level;
+  }
+}
+
+uint32_t line = 0;
+
+void setup() {
+  Serial.begin(115200);
+  pinMode(PROBE_IN, INPUT);
+  pinMode(PROBE_OUT, OUTPUT);
+}
+
+void loop() {
+  Serial.print("flood ");
+  Serial.println(line++);
+  probe();
+}
@@ -0,0 +1,42 @@
+// Benchmark: toggle storm
+// digitalWrite() as fast as the loop allows, on two pins.
+// Measures GPIO reporting throughput and firmware-side coalescing (DROPS).
+
+#if defined(ESP32)
+const uint8_t PROBE_IN = 4;
+const uint8_t PROBE_OUT = 5;
+const uint8_t STORM_A = 2;
+const uint8_t STORM_B = 18;
+#else
+const uint8_t PROBE_IN = 2;
+const uint8_t PROBE_OUT = 12;
+const uint8_t STORM_A = 13;
+const uint8_t STORM_B = 8;
+#endif
+
+// Latency probe: the bench driver flips PROBE_IN, we mirror it on PROBE_OUT
+void probe() {
+  static int last = -1;
+  int level = digitalRead(PROBE_IN);
+  if (level != last) {
+    digitalWrite(PROBE_OUT, level);
+    last = level;
+  }
+}
+
+void setup() {
+  pinMode(PROBE_IN, INPUT);
+  pinMode(PROBE_OUT, OUTPUT);
+  pinMode(STORM_A, OUTPUT);
+  pinMode(STORM_B, OUTPUT);
+}
+
+void loop() {
+  for (uint8_t i = 0; i < 100; i++) {
+    digitalWrite(STORM_A, HIGH);
+    digitalWrite(STORM_B, LOW);
+    digitalWrite(STORM_A, LOW);
+    digitalWrite(STORM_B, HIGH);
+  }
+  probe();
+}
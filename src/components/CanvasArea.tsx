@@ -21,8 +21,12 @@ import { useSimulationStore, boardConfigs, defaultCodeMap } from '@/stores/useSi
 import { useSerialStore } from '@/stores/useSerialStore';
 import { useConnectionStore } from '@/stores/useConnectionStore';
 import { useUIStore } from '@/stores/useUIStore';
-import { simulationEngine } from '@/engine/SimulationEngine';
-import { codeParser } from '@/engine/CodeParser';
+import {
+  startBrowserSimulation,
+  stopBrowserSimulation,
+  resetBrowserSimulation,
+  setBrowserSimulationSpeed
+} from '@/engine/BrowserRuntime';
 import { cn } from '@/lib/utils';
 import type { BoardType, Language } from '@/types';
 import {
@@ -51,7 +55,6 @@ const CanvasInner: React.FC = () => {
     addMCU,
     removeMCU,
     syncMCUsWithCanvas,
-    startSimulation,
     stopSimulation,
     resetSimulation,
   } = useSimulationStore();
@@ -314,7 +317,7 @@ const CanvasInner: React.FC = () => {
   const handleRun = useCallback(async () => {
     if (status === 'running') {
       stopSimulation();
-      simulationEngine.stop();
+      stopBrowserSimulation();
     } else {
       // Get first MCU for legacy fake mode support
       const allMCUs = getAllMCUs();
@@ -323,27 +326,18 @@ const CanvasInner: React.FC = () => {
         return;
       }
 
-      const activeMCU = allMCUs[0];
-      codeParser.setLanguage(activeMCU.language);
-      const parsed = codeParser.parse(activeMCU.code);
-
-      if (parsed) {
-        startSimulation();
-        simulationEngine.start(parsed.setup, parsed.loop, speed);
-      } else {
-        addTerminalLine('❌ Failed to parse code', 'error');
-      }
+      await startBrowserSimulation(allMCUs[0], speed);
     }
-  }, [status, speed, getAllMCUs, startSimulation, stopSimulation, addTerminalLine]);
+  }, [status, speed, getAllMCUs, stopSimulation, addTerminalLine]);
 
   const handleReset = useCallback(() => {
     resetSimulation();
-    simulationEngine.reset();
+    resetBrowserSimulation();
   }, [resetSimulation]);
 
   const handleSpeedChange = useCallback((newSpeed: number) => {
     setSpeed(newSpeed);
-    simulationEngine.setSpeed(newSpeed);
+    setBrowserSimulationSpeed(newSpeed);
   }, [setSpeed]);
 
   const mcuCount = getAllMCUs().length;
@@ -5,8 +5,7 @@ import { useNodes } from '@xyflow/react';
 import { useFileStore } from '@/stores/useFileStore';
 import { useSimulationStore } from '@/stores/useSimulationStore';
 import { useSerialStore } from '@/stores/useSerialStore';
-import { simulationEngine } from '@/engine/SimulationEngine';
-import { codeParser } from '@/engine/CodeParser';
+import { startBrowserSimulation, stopBrowserSimulation } from '@/engine/BrowserRuntime';
 import { transpiler } from '@/engine/Transpiler';
 import type { Language } from '@/types';
 import { cn } from '@/lib/utils';
@@ -66,7 +65,6 @@ export const CodeEditorWithTabs: React.FC = () => {
     status,
     mcus,
     updateMCUCode,
-    startSimulation,
     stopSimulation,
     resetSimulation,
   } = useSimulationStore();
@@ -203,10 +201,10 @@ export const CodeEditorWithTabs: React.FC = () => {
   }, [activeFileId, files, handleDeleteFile]);
 
   // Handle run button
-  const handleRun = useCallback(() => {
+  const handleRun = useCallback(async () => {
     if (status === 'running') {
       stopSimulation();
-      simulationEngine.stop();
+      stopBrowserSimulation();
     } else {
       // Get active MCU
       const allMCUs = getAllMCUs();
@@ -215,22 +213,10 @@ export const CodeEditorWithTabs: React.FC = () => {
         return;
       }
 
-      const activeMCU = allMCUs[0];
-      codeParser.setLanguage(activeMCU.language);
-
-      // Preprocess code to inject libraries
-      const processedCode = simulationEngine.preprocess(activeMCU.code, activeMCU.language);
-      const parsed = codeParser.parse(processedCode);
-
-      if (parsed) {
-        startSimulation();
-        addTerminalLine('▶️ Starting simulation...', 'success');
-        simulationEngine.start(parsed.setup, parsed.loop, useSimulationStore.getState().speed);
-      } else {
-        addTerminalLine('❌ Failed to parse code', 'error');
-      }
+      addTerminalLine('▶️ Starting simulation...', 'success');
+      await startBrowserSimulation(allMCUs[0], useSimulationStore.getState().speed);
     }
-  }, [status, getAllMCUs, startSimulation, stopSimulation, addTerminalLine]);
+  }, [status, getAllMCUs, stopSimulation, addTerminalLine]);
 
   // Handle reset button
   const handleReset = useCallback(() => {
@@ -1,5 +1,6 @@
 import React, { useRef, useEffect, useState } from 'react';
 import { useSerialStore } from '@/stores/useSerialStore';
+import { wasmRuntime } from '@/engine/WasmRuntime';
 import { cn } from '@/lib/utils';
 import { Button } from '@/components/ui/button';
 import {
@@ -26,7 +27,8 @@ export const SerialMonitor: React.FC = () => {
     setBaudRate,
     setAutoScroll,
     clearSerial,
-    exportSerial
+    exportSerial,
+    addSerialLine
   } = useSerialStore();
 
   const scrollRef = useRef<HTMLDivElement>(null);
@@ -53,10 +55,13 @@ export const SerialMonitor: React.FC = () => {
     URL.revokeObjectURL(url);
   };
 
-  // Handle send (simulated)
+  // Handle send: only the WebAssembly runtime has a Serial RX for now
   const handleSend = () => {
     if (inputText.trim()) {
-      // In a real implementation, this would send data to the simulation
+      if (wasmRuntime.isRunning()) {
+        wasmRuntime.sendSerial(`${inputText}\n`);
+        addSerialLine(inputText, 'input');
+      }
       setInputText('');
     }
   };
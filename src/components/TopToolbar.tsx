@@ -3,8 +3,12 @@ import { useSimulationStore } from '@/stores/useSimulationStore';
 import { useSerialStore } from '@/stores/useSerialStore';
 import { useQEMUStore } from '@/stores/useQEMUStore';
 import { useQEMUSimulation } from '@/hooks/useQEMUSimulation';
-import { simulationEngine } from '@/engine/SimulationEngine';
-import { codeParser } from '@/engine/CodeParser';
+import {
+  startBrowserSimulation,
+  stopBrowserSimulation,
+  resetBrowserSimulation,
+  setBrowserSimulationSpeed
+} from '@/engine/BrowserRuntime';
 import { cn } from '@/lib/utils';
 import { Button } from '@/components/ui/button';
 import { SimulationModeToggle } from '@/components/SimulationModeToggle';
@@ -42,6 +46,7 @@ export const TopToolbar: React.FC = () => {
   const {
     mode,
     isCompiling,
+    compileQueuePosition,
     isSimulationRunning,
     compilationError,
     setCompilationError
@@ -138,18 +143,8 @@ export const TopToolbar: React.FC = () => {
         return;
       }
 
-      codeParser.setLanguage(activeMCU.language);
-
-      // Preprocess code to inject libraries
-      const processedCode = simulationEngine.preprocess(activeMCU.code, activeMCU.language);
-      const parsed = codeParser.parse(processedCode);
-
-      if (parsed) {
-        startSimulation();
-        simulationEngine.start(parsed.setup, parsed.loop, speed);
+      if (await startBrowserSimulation(activeMCU, speed)) {
         addTerminalLine(`▶️ Simulation started on ${activeMCU.label}`, 'info');
-      } else {
-        addTerminalLine('❌ Failed to parse code', 'error');
       }
     }
   }, [mode, speed, isBackendConnected, getActiveMCU, startSimulation, compileAndStart, addTerminalLine]);
@@ -162,7 +157,7 @@ export const TopToolbar: React.FC = () => {
       await stopQEMU();
       addTerminalLine('⏹️ QEMU simulation stopped', 'info');
     } else {
-      simulationEngine.stop();
+      stopBrowserSimulation();
       addTerminalLine('⏹️ Simulation stopped', 'info');
     }
 
@@ -188,7 +183,7 @@ export const TopToolbar: React.FC = () => {
       stopQEMU();
     }
     resetSimulation();
-    simulationEngine.reset();
+    resetBrowserSimulation();
     clearSerial();
     clearTerminal();
     addTerminalLine('🔄 Simulation reset', 'info');
@@ -200,7 +195,7 @@ export const TopToolbar: React.FC = () => {
   const handleSpeedChange = useCallback((newSpeed: number) => {
     setSpeed(newSpeed);
     if (mode === 'fake') {
-      simulationEngine.setSpeed(newSpeed);
+      setBrowserSimulationSpeed(newSpeed);
     }
   }, [mode, setSpeed]);
 
@@ -314,7 +309,7 @@ export const TopToolbar: React.FC = () => {
           {isCompiling ? (
             <>
               <Loader2 className="w-4 h-4 mr-1 animate-spin" />
-              Compiling...
+              {compileQueuePosition > 0 ? `Queued (#${compileQueuePosition})` : 'Compiling...'}
             </>
           ) : isRunning ? (
             <>
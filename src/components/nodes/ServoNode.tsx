@@ -11,6 +11,11 @@ interface ServoNodeProps {
   selected?: boolean;
 }
 
+/** Hobby servo pulse range and the highest frame rate we treat as a servo signal */
+const SERVO_MIN_PULSE_US = 544;
+const SERVO_MAX_PULSE_US = 2400;
+const SERVO_MAX_FREQUENCY = 400;
+
 export const ServoNode: React.FC<ServoNodeProps> = ({ data, selected, id }) => {
   const [angle, setAngle] = useState((data.angle as number) ?? 90);
   const [targetAngle, setTargetAngle] = useState((data.angle as number) ?? 90);
@@ -53,10 +58,15 @@ export const ServoNode: React.FC<ServoNodeProps> = ({ data, selected, id }) => {
 
   useEffect(() => {
     const unsubscribe = simulationEngine.on('pinChange', (event) => {
-      const pinEvent = event as { pin: number; value: 'HIGH' | 'LOW' | number };
+      const pinEvent = event as { pin: number; value: 'HIGH' | 'LOW' | number; duty?: number; frequency?: number };
 
       if (connectedPin === pinEvent.pin) {
-        if (typeof pinEvent.value === 'number') {
+        if (pinEvent.duty !== undefined && pinEvent.frequency && pinEvent.frequency <= SERVO_MAX_FREQUENCY) {
+          // Servo-rate PWM: the pulse width sets the angle (544-2400 us, as in Servo.h)
+          const pulseUs = (pinEvent.duty / pinEvent.frequency) * 1e6;
+          const ratio = Math.min(1, Math.max(0, (pulseUs - SERVO_MIN_PULSE_US) / (SERVO_MAX_PULSE_US - SERVO_MIN_PULSE_US)));
+          setTargetAngle(Math.round(ratio * (maxAngle - minAngle) + minAngle));
+        } else if (typeof pinEvent.value === 'number') {
           const newAngle = Math.round((pinEvent.value / 255) * (maxAngle - minAngle) + minAngle);
           setTargetAngle(newAngle);
         }
@@ -0,0 +1,59 @@
+import { useSerialStore } from '@/stores/useSerialStore';
+import { useSimulationStore } from '@/stores/useSimulationStore';
+import { simulationEngine } from '@/engine/SimulationEngine';
+import { codeParser } from '@/engine/CodeParser';
+import { wasmRuntime } from '@/engine/WasmRuntime';
+import type { MCUConfig } from '@/types';
+
+/**
+ * Start/stop of the JS runtime ("fake" mode), shared by the toolbar, the
+ * canvas and the editor.
+ *
+ * C++ sketches run compiled (WasmRuntime). MicroPython/CircuitPython, and
+ * C++ while the backend is unreachable, fall back to the line interpreter
+ * (CodeParser + SimulationEngine).
+ */
+export async function startBrowserSimulation(mcu: MCUConfig, speed: number, code = mcu.code): Promise<boolean> {
+  const serialStore = useSerialStore.getState();
+
+  if (mcu.language === 'cpp') {
+    const result = await wasmRuntime.compileAndStart(code, mcu.type, speed);
+    if (result !== 'offline') {
+      return result === 'started';
+    }
+    serialStore.addTerminalLine('⚠️ Backend offline: running the sketch in the line interpreter', 'warning');
+  }
+
+  codeParser.setLanguage(mcu.language);
+
+  // Preprocess code to inject libraries
+  const processedCode = simulationEngine.preprocess(code, mcu.language);
+  const parsed = codeParser.parse(processedCode);
+
+  if (!parsed) {
+    serialStore.addTerminalLine('❌ Failed to parse code', 'error');
+    return false;
+  }
+
+  useSimulationStore.getState().startSimulation();
+  simulationEngine.start(parsed.setup, parsed.loop, speed);
+  return true;
+}
+
+export function stopBrowserSimulation(): void {
+  if (wasmRuntime.isRunning()) {
+    wasmRuntime.stop();
+  } else {
+    simulationEngine.stop();
+  }
+}
+
+export function resetBrowserSimulation(): void {
+  wasmRuntime.stop();
+  simulationEngine.reset();
+}
+
+export function setBrowserSimulationSpeed(speed: number): void {
+  wasmRuntime.setSpeed(speed);
+  simulationEngine.setSpeed(speed);
+}
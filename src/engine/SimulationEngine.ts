@@ -2,6 +2,7 @@ import { useSimulationStore } from '@/stores/useSimulationStore';
 import { useSerialStore } from '@/stores/useSerialStore';
 import { useLibraryStore } from '@/stores/useLibraryStore';
 import type { PinState, PinMode, Language } from '@/types';
+import type { PinBatchEvent } from '@/services/QEMUWebSocket';
 
 // Preprocessor to inject libraries
 const preprocessCode = (code: string, language: Language): string => {
@@ -334,6 +335,21 @@ export class SimulationEngine extends EventEmitter {
     this.emit('pinChange', { pin, value });
   }
 
+  /**
+   * Frame of pin activity from a compiled runtime (QEMU pinBatch or the
+   * WASM worker): one store update, then the per-pin events canvas nodes use
+   */
+  applyPinBatch(batch: PinBatchEvent): void {
+    useSimulationStore.getState().applyPinBatch(batch);
+
+    batch.pins.forEach(([pin, value]) => {
+      this.emit('pinChange', { pin, value: value ? 'HIGH' : 'LOW' });
+    });
+    batch.pwm?.forEach(([pin, duty, frequency]) => {
+      this.emit('pinChange', { pin, value: Math.round(duty * 255), duty, frequency });
+    });
+  }
+
   digitalRead(pin: number): 'HIGH' | 'LOW' {
     const simulationStore = useSimulationStore.getState();
     return simulationStore.digitalRead(pin);
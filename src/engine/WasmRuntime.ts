@@ -0,0 +1,199 @@
+import { useSimulationStore } from '@/stores/useSimulationStore';
+import { useSerialStore } from '@/stores/useSerialStore';
+import { useQEMUStore } from '@/stores/useQEMUStore';
+import { qemuApi } from '@/services/QEMUApiClient';
+import { simulationEngine } from '@/engine/SimulationEngine';
+import type { BoardType } from '@/types';
+import type { SketchWorkerMessage, SketchWorkerRequest } from './wasm/protocol';
+
+/** Arduino Uno: A0-A5 are digital pins 14-19 */
+const ANALOG_PIN_OFFSET = 14;
+
+export type WasmStartResult = 'started' | 'failed' | 'offline';
+
+/**
+ * JS runtime for C++ sketches: the backend compiles the sketch to
+ * WebAssembly (clang + the neuroforge_wasm HAL) and it runs in a Web Worker
+ * (wasm/sketch.worker.ts) with its own virtual clock. The worker posts one
+ * pin batch per frame, applied like the QEMU pinBatch events.
+ */
+export class WasmRuntime {
+  private worker: Worker | null = null;
+  private unsubscribers: (() => void)[] = [];
+  private serialLine = '';
+  private paused = false;
+
+  isRunning(): boolean {
+    return this.worker !== null;
+  }
+
+  /**
+   * Compile on the backend and start. 'offline': backend unreachable, the
+   * caller may fall back to the line interpreter.
+   */
+  async compileAndStart(code: string, board: BoardType, speed: number): Promise<WasmStartResult> {
+    const qemuStore = useQEMUStore.getState();
+    const serialStore = useSerialStore.getState();
+
+    if (!(await qemuApi.healthCheck())) {
+      return 'offline';
+    }
+
+    qemuStore.setCompiling(true);
+    qemuStore.setCompilationError(null);
+    serialStore.addTerminalLine('🔨 Compiling sketch to WebAssembly...', 'info');
+
+    try {
+      const result = await qemuApi.compile(code, board, 'wasm');
+      if (!result.success || !result.wasm) {
+        qemuStore.setCompilationError(result.stderr || result.error || 'Compilation failed');
+        return 'failed';
+      }
+
+      serialStore.addTerminalLine(`✅ Compiled${result.cached ? ' (cached)' : ''}`, 'success');
+      this.start(Uint8Array.from(atob(result.wasm), c => c.charCodeAt(0)), speed);
+      return 'started';
+    } finally {
+      qemuStore.setCompiling(false);
+    }
+  }
+
+  /**
+   * Run a compiled module (replaces the running one)
+   */
+  start(wasm: Uint8Array, speed = 1): void {
+    this.terminate();
+
+    const simulationStore = useSimulationStore.getState();
+    simulationStore.resetSimulation();
+    simulationStore.startSimulation();
+
+    this.worker = new Worker(new URL('./wasm/sketch.worker.ts', import.meta.url), { type: 'module' });
+    this.worker.onmessage = (event: MessageEvent<SketchWorkerMessage>) => this.handleMessage(event.data);
+    this.worker.onerror = (event) => {
+      event.preventDefault();
+      this.fail(event.message || 'Worker error');
+    };
+
+    this.unsubscribers = [
+      simulationEngine.on('buttonPress', (data) => {
+        const { pin, value } = data as { pin: number; value: 'HIGH' | 'LOW' };
+        this.post({ type: 'input', pin, value: value === 'HIGH' ? 1 : 0 });
+      }),
+      simulationEngine.on('analogChange', (data) => {
+        const { pin, value } = data as { pin: number; value: number };
+        this.post({ type: 'analog', channel: pin >= ANALOG_PIN_OFFSET ? pin - ANALOG_PIN_OFFSET : pin, value });
+      })
+    ];
+
+    this.paused = false;
+    this.post({ type: 'start', wasm: wasm.buffer as ArrayBuffer, speed }, [wasm.buffer as ArrayBuffer]);
+  }
+
+  stop(): void {
+    if (!this.terminate()) return;
+
+    useSimulationStore.getState().stopSimulation();
+    useSerialStore.getState().addTerminalLine('⏹️ Simulation stopped', 'info');
+    simulationEngine.emit('simulationStopped', {});
+  }
+
+  pause(): void {
+    if (!this.worker || this.paused) return;
+    this.paused = true;
+    this.post({ type: 'pause' });
+    useSimulationStore.getState().pauseSimulation();
+    useSerialStore.getState().addTerminalLine('⏸️ Simulation paused', 'warning');
+  }
+
+  resume(): void {
+    if (!this.worker || !this.paused) return;
+    this.paused = false;
+    this.post({ type: 'resume' });
+    useSimulationStore.getState().startSimulation();
+    useSerialStore.getState().addTerminalLine('▶️ Simulation resumed', 'success');
+  }
+
+  setSpeed(speed: number): void {
+    this.post({ type: 'speed', speed });
+  }
+
+  /**
+   * Serial Monitor -> sketch RX
+   */
+  sendSerial(data: string): void {
+    this.post({ type: 'serial', data });
+  }
+
+  private handleMessage(message: SketchWorkerMessage): void {
+    switch (message.type) {
+      case 'started':
+        useSerialStore.getState().addTerminalLine('▶️ Simulation started (WebAssembly)', 'success');
+        break;
+      case 'batch':
+        simulationEngine.applyPinBatch(message.batch);
+        break;
+      case 'serial':
+        this.receiveSerial(message.text);
+        break;
+      case 'tone':
+        if (message.frequency > 0) {
+          simulationEngine.emit('tone', { pin: message.pin, frequency: message.frequency, duration: message.duration || undefined });
+        } else {
+          simulationEngine.emit('noTone', { pin: message.pin });
+        }
+        break;
+      case 'exit':
+        useSerialStore.getState().addTerminalLine(`⏹️ Sketch exited with code ${message.code}`, 'info');
+        this.stop();
+        break;
+      case 'error':
+        this.fail(message.message);
+        break;
+    }
+  }
+
+  /**
+   * Serial Monitor shows whole lines, as in QEMU mode
+   */
+  private receiveSerial(text: string): void {
+    const lines = (this.serialLine + text).split('\n');
+    this.serialLine = lines.pop() ?? '';
+
+    for (const line of lines) {
+      const clean = line.replace(/\r$/, '');
+      useSerialStore.getState().addSerialLine(clean, 'output');
+      // TX LED on the MCU node
+      simulationEngine.emit('serialTransmit', { text: clean });
+    }
+  }
+
+  private fail(message: string): void {
+    useSerialStore.getState().addTerminalLine(`❌ Runtime error: ${message}`, 'error');
+    this.stop();
+  }
+
+  /**
+   * Kill the worker; false if nothing was running
+   */
+  private terminate(): boolean {
+    if (!this.worker) return false;
+
+    this.worker.terminate();
+    this.worker = null;
+    this.unsubscribers.forEach(unsubscribe => unsubscribe());
+    this.unsubscribers = [];
+
+    if (this.serialLine) {
+      useSerialStore.getState().addSerialLine(this.serialLine, 'output');
+      this.serialLine = '';
+    }
+    return true;
+  }
+
+  private post(request: SketchWorkerRequest, transfer: Transferable[] = []): void {
+    this.worker?.postMessage(request, transfer);
+  }
+}
+
+export const wasmRuntime = new WasmRuntime();
@@ -0,0 +1,24 @@
+import type { PinBatchEvent } from '@/services/QEMUWebSocket';
+
+/**
+ * Messages between WasmRuntime (main thread) and sketch.worker.ts
+ */
+
+/** Main thread -> worker */
+export type SketchWorkerRequest =
+  | { type: 'start'; wasm: ArrayBuffer; speed: number }
+  | { type: 'pause' }
+  | { type: 'resume' }
+  | { type: 'speed'; speed: number }
+  | { type: 'input'; pin: number; value: 0 | 1 | 2 } // 2 releases the pin
+  | { type: 'analog'; channel: number; value: number } // channel 0-5, value 0-1023
+  | { type: 'serial'; data: string };
+
+/** Worker -> main thread */
+export type SketchWorkerMessage =
+  | { type: 'started' }
+  | { type: 'batch'; batch: PinBatchEvent; timeUs: number } // Same shape as the backend's pinBatch
+  | { type: 'serial'; text: string } // Raw TX, not split into lines
+  | { type: 'tone'; pin: number; frequency: number; duration: number } // frequency 0 = noTone
+  | { type: 'exit'; code: number }
+  | { type: 'error'; message: string };
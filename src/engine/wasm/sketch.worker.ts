@@ -0,0 +1,468 @@
+import type { PinBatchEvent, PinChangeEvent } from '@/services/QEMUWebSocket';
+import type { SketchWorkerRequest, SketchWorkerMessage } from './protocol';
+
+/**
+ * Runs one clang-compiled sketch (server/cores/neuroforge_wasm) off the main thread
+ *
+ * Virtual time lives in the module; the worker hands it slices that follow
+ * the wall clock times the speed. When the sketch needs to go past the end of
+ * a slice (delay(), busy-wait) it calls nf.yield_until, which unwinds its
+ * stack (Asyncify); the worker resumes it with a rewind once wall time has
+ * caught up, or earlier when an input changed. Pin activity is coalesced and
+ * posted once per frame in the backend's pinBatch shape.
+ */
+
+/** Batch/serial flush interval (one frame at 60 Hz) */
+const FRAME_MS = 16;
+
+/** Most virtual time one slice may cover: a throttled tab slows down instead of replaying a burst */
+const MAX_CATCH_UP_US = 100_000;
+
+/** nf.mode values (NF_MODE_* in nf_wasm.h) */
+const MODE_NAMES: PinChangeEvent['mode'][] = ['INPUT', 'OUTPUT', 'INPUT_PULLUP'];
+
+/** analogWrite() frequency of the Uno timers */
+const pwmFrequency = (pin: number) => (pin === 5 || pin === 6 ? 980 : 490);
+
+/** asyncify_get_state() */
+const ASYNCIFY_UNWINDING = 1;
+
+const WASI_ERRNO_NOSYS = 52;
+
+interface SketchExports {
+  memory: WebAssembly.Memory;
+  _initialize?: () => void;
+  nf_main: () => void;
+  nf_now: () => number;
+  nf_set_slice_end: (us: number) => void;
+  nf_set_input: (pin: number, value: number) => void;
+  nf_set_analog: (channel: number, value: number) => void;
+  nf_serial_rx: (byte: number) => number;
+  nf_asyncify_data: () => number;
+  asyncify_start_unwind: (data: number) => void;
+  asyncify_stop_unwind: () => void;
+  asyncify_start_rewind: (data: number) => void;
+  asyncify_stop_rewind: () => void;
+  asyncify_get_state: () => number;
+}
+
+/** proc_exit() from the sketch */
+class SketchExit extends Error {
+  code: number;
+
+  constructor(code: number) {
+    super(`exit(${code})`);
+    this.code = code;
+  }
+}
+
+interface PinActivity {
+  value: number;
+  toggles: number;
+  highUs: number;
+  lastChange: number;
+  dirty: boolean;
+}
+
+/**
+ * Per-frame coalescing, same rules as the backend PinChangeBatcher but
+ * timed in virtual µs: pins toggling faster than the frame get a duty summary
+ */
+class PinBatcher {
+  private activity = new Map<number, PinActivity>();
+  private modes = new Map<number, PinChangeEvent['mode']>();
+  private knownModes = new Map<number, PinChangeEvent['mode']>();
+  private pwm = new Map<number, number>();
+  private frameStart = 0;
+  private seq = 0;
+
+  level(pin: number, value: number, nowUs: number): void {
+    this.pwm.delete(pin);
+
+    const entry = this.activity.get(pin);
+    if (!entry) {
+      this.activity.set(pin, { value, toggles: 0, highUs: 0, lastChange: nowUs, dirty: true });
+      return;
+    }
+    if (entry.value === value) return;
+
+    if (entry.value) {
+      entry.highUs += nowUs - Math.max(entry.lastChange, this.frameStart);
+    }
+    entry.toggles++;
+    entry.value = value;
+    entry.lastChange = nowUs;
+    entry.dirty = true;
+  }
+
+  mode(pin: number, mode: PinChangeEvent['mode']): void {
+    if (this.knownModes.get(pin) === mode) return;
+    this.knownModes.set(pin, mode);
+    this.modes.set(pin, mode);
+  }
+
+  duty(pin: number, duty: number): void {
+    // Hardware PWM replaces the pin's digital activity until the next level
+    this.pwm.set(pin, duty);
+    this.activity.delete(pin);
+  }
+
+  flush(nowUs: number): PinBatchEvent | null {
+    const frameLength = nowUs - this.frameStart;
+    const batch: PinBatchEvent = { seq: this.seq + 1, pins: [] };
+    const duty: [number, number, number][] = [];
+
+    this.activity.forEach((entry, pin) => {
+      if (!entry.dirty) return;
+
+      batch.pins.push([pin, entry.value]);
+      if (entry.toggles > 1 && frameLength > 0) {
+        const highUs = entry.highUs + (entry.value ? nowUs - Math.max(entry.lastChange, this.frameStart) : 0);
+        duty.push([pin, entry.toggles, Math.round((highUs / frameLength) * 1000) / 1000]);
+      }
+
+      entry.dirty = false;
+      entry.toggles = 0;
+      entry.highUs = 0;
+    });
+
+    if (this.modes.size > 0) {
+      batch.modes = Array.from(this.modes.entries());
+      this.modes.clear();
+    }
+    if (duty.length > 0) {
+      batch.duty = duty;
+    }
+    if (this.pwm.size > 0) {
+      batch.pwm = Array.from(this.pwm, ([pin, value]) => [pin, Math.round((value / 255) * 10000) / 10000, pwmFrequency(pin)]);
+      this.pwm.clear();
+    }
+
+    this.frameStart = nowUs;
+
+    if (batch.pins.length === 0 && !batch.modes && !batch.pwm) {
+      return null;
+    }
+    this.seq = batch.seq;
+    return batch;
+  }
+}
+
+class SketchRunner {
+  private exports: SketchExports | null = null;
+  private asyncData = 0;
+  private asyncStackStart = 0;
+
+  private suspended = false; // Stack unwound inside nf.yield_until
+  private rewinding = false;
+  private wakeAt = 0;        // Deadline the suspended sketch waits for (virtual µs)
+  private resumeAt = 0;      // Value nf.yield_until returns on the next rewind
+
+  private virtualBase = 0;   // Virtual µs at wallBase
+  private wallBase = 0;
+  private speed = 1;
+  private paused = false;
+  private stopped = false;
+
+  private stepTimer: ReturnType<typeof setTimeout> | null = null;
+  private flushTimer: ReturnType<typeof setInterval> | null = null;
+
+  private batcher = new PinBatcher();
+  private decoder = new TextDecoder();
+  private serialOut = '';
+  private serialIn: number[] = [];
+
+  async start(wasm: ArrayBuffer, speed: number): Promise<void> {
+    const module = await WebAssembly.compile(wasm);
+    const instance = await WebAssembly.instantiate(module, {
+      nf: this.hostImports(),
+      wasi_snapshot_preview1: this.wasiImports()
+    });
+
+    this.exports = instance.exports as unknown as SketchExports;
+    this.exports._initialize?.();
+    this.asyncData = this.exports.nf_asyncify_data();
+    this.asyncStackStart = this.view32()[this.asyncData >> 2];
+
+    this.speed = speed;
+    this.virtualBase = 0;
+    this.wallBase = performance.now();
+    this.flushTimer = setInterval(() => this.flush(), FRAME_MS);
+
+    post({ type: 'started' });
+    this.step();
+  }
+
+  pause(): void {
+    if (this.paused) return;
+    this.virtualBase = this.target();
+    this.paused = true;
+    this.cancelStep();
+  }
+
+  resume(): void {
+    if (!this.paused) return;
+    this.wallBase = performance.now();
+    this.paused = false;
+    this.step();
+  }
+
+  setSpeed(speed: number): void {
+    this.virtualBase = this.target();
+    this.wallBase = performance.now();
+    this.speed = speed;
+    this.schedule();
+  }
+
+  setInput(pin: number, value: number): void {
+    this.exports?.nf_set_input(pin, value);
+    this.wake();
+  }
+
+  setAnalog(channel: number, value: number): void {
+    this.exports?.nf_set_analog(channel, value);
+  }
+
+  receiveSerial(data: string): void {
+    this.serialIn.push(...new TextEncoder().encode(data));
+    this.drainSerialIn();
+    this.wake();
+  }
+
+  /**
+   * Virtual time the wall clock allows the sketch to reach
+   */
+  private target(): number {
+    if (this.paused) return this.virtualBase;
+    return this.virtualBase + (performance.now() - this.wallBase) * 1000 * this.speed;
+  }
+
+  /**
+   * Run the sketch up to the current target (one slice)
+   */
+  private step(): void {
+    this.stepTimer = null;
+    const exports = this.exports;
+    if (!exports || this.paused || this.stopped) return;
+
+    let target = this.target();
+    const progress = this.suspended ? this.wakeAt : exports.nf_now();
+    if (target - progress > MAX_CATCH_UP_US) {
+      this.virtualBase -= target - progress - MAX_CATCH_UP_US;
+      target = progress + MAX_CATCH_UP_US;
+    }
+
+    this.drainSerialIn();
+    exports.nf_set_slice_end(target);
+    this.resumeAt = Math.min(target, this.wakeAt);
+
+    try {
+      if (this.suspended) {
+        exports.asyncify_start_rewind(this.asyncData);
+        this.rewinding = true;
+      }
+      exports.nf_main();
+
+      if (exports.asyncify_get_state() !== ASYNCIFY_UNWINDING) {
+        throw new Error('Sketch returned from nf_main');
+      }
+      exports.asyncify_stop_unwind();
+      this.suspended = true;
+    } catch (error) {
+      this.fail(error);
+      return;
+    }
+
+    this.schedule();
+  }
+
+  /**
+   * Next step when wall time reaches the deadline the sketch sleeps on
+   */
+  private schedule(): void {
+    if (!this.suspended || this.paused || this.stopped) return;
+    this.cancelStep();
+    const delayMs = Math.max(0, (this.wakeAt - this.target()) / 1000 / this.speed);
+    this.stepTimer = setTimeout(() => this.step(), delayMs);
+  }
+
+  /**
+   * Input changed: resume now so attached interrupts run at this virtual time
+   */
+  private wake(): void {
+    if (!this.suspended || this.paused || this.stopped) return;
+    this.cancelStep();
+    this.step();
+  }
+
+  private cancelStep(): void {
+    if (this.stepTimer !== null) {
+      clearTimeout(this.stepTimer);
+      this.stepTimer = null;
+    }
+  }
+
+  private drainSerialIn(): void {
+    while (this.serialIn.length > 0 && this.exports?.nf_serial_rx(this.serialIn[0])) {
+      this.serialIn.shift();
+    }
+  }
+
+  private flush(): void {
+    if (!this.exports) return;
+    const timeUs = this.exports.nf_now();
+
+    const batch = this.batcher.flush(timeUs);
+    if (batch) {
+      post({ type: 'batch', batch, timeUs });
+    }
+    if (this.serialOut) {
+      post({ type: 'serial', text: this.serialOut });
+      this.serialOut = '';
+    }
+  }
+
+  private fail(error: unknown): void {
+    this.stop();
+    if (error instanceof SketchExit) {
+      post({ type: 'exit', code: error.code });
+    } else {
+      post({ type: 'error', message: error instanceof Error ? error.message : String(error) });
+    }
+  }
+
+  stop(): void {
+    if (this.stopped) return;
+    this.flush();
+    this.stopped = true;
+    this.cancelStep();
+    if (this.flushTimer !== null) {
+      clearInterval(this.flushTimer);
+      this.flushTimer = null;
+    }
+  }
+
+  private view32(): Int32Array {
+    // Views must be recreated after memory.grow() (malloc)
+    return new Int32Array(this.exports!.memory.buffer);
+  }
+
+  private bytes(ptr: number, length: number): Uint8Array {
+    return new Uint8Array(this.exports!.memory.buffer, ptr, length);
+  }
+
+  /**
+   * Module "nf": the board as seen by nf_wasm.cpp
+   */
+  private hostImports(): WebAssembly.ModuleImports {
+    const now = () => this.exports!.nf_now();
+
+    return {
+      gpio: (pin: number, value: number) => this.batcher.level(pin, value, now()),
+      mode: (pin: number, mode: number) => this.batcher.mode(pin, MODE_NAMES[mode] ?? 'UNKNOWN'),
+      pwm: (pin: number, duty: number) => this.batcher.duty(pin, duty),
+      tone: (pin: number, frequency: number, duration: number) => post({ type: 'tone', pin, frequency, duration }),
+      serial_write: (ptr: number, length: number) => {
+        this.serialOut += this.decoder.decode(this.bytes(ptr, length), { stream: true });
+      },
+      yield_until: (deadline: number) => {
+        const exports = this.exports!;
+        if (this.rewinding) {
+          // Resuming: the call returns and the sketch carries on
+          exports.asyncify_stop_rewind();
+          this.rewinding = false;
+          return this.resumeAt;
+        }
+
+        this.wakeAt = deadline;
+        this.view32()[this.asyncData >> 2] = this.asyncStackStart;
+        exports.asyncify_start_unwind(this.asyncData);
+        return 0;
+      }
+    };
+  }
+
+  /**
+   * WASI for what wasi-libc may pull in: stdout/stderr go to Serial,
+   * the clock is the virtual one, everything else is ENOSYS
+   */
+  private wasiImports(): WebAssembly.ModuleImports {
+    const implemented: Record<string, (...args: number[]) => number | bigint | void> = {
+      fd_write: (fd: number, iovs: number, iovsLength: number, writtenPtr: number) => {
+        const view = new DataView(this.exports!.memory.buffer);
+        let written = 0;
+        for (let i = 0; i < iovsLength; i++) {
+          const ptr = view.getUint32(iovs + i * 8, true);
+          const length = view.getUint32(iovs + i * 8 + 4, true);
+          if (fd === 1 || fd === 2) {
+            this.serialOut += this.decoder.decode(this.bytes(ptr, length), { stream: true });
+          }
+          written += length;
+        }
+        view.setUint32(writtenPtr, written, true);
+        return 0;
+      },
+      clock_time_get: (_clockId: number, _precision: bigint | number, timePtr: number) => {
+        const view = new DataView(this.exports!.memory.buffer);
+        view.setBigUint64(timePtr, BigInt(Math.floor(this.exports!.nf_now())) * 1000n, true);
+        return 0;
+      },
+      random_get: (ptr: number, length: number) => {
+        crypto.getRandomValues(this.bytes(ptr, length));
+        return 0;
+      },
+      proc_exit: (code: number) => {
+        throw new SketchExit(code);
+      }
+    };
+
+    return new Proxy(implemented, {
+      get: (target, name: string) => target[name] ?? (() => WASI_ERRNO_NOSYS)
+    }) as WebAssembly.ModuleImports;
+  }
+}
+
+/** Worker global scope (the app's tsconfig only has the DOM lib) */
+const scope = self as unknown as {
+  postMessage(message: SketchWorkerMessage): void;
+  onmessage: ((event: MessageEvent<SketchWorkerRequest>) => void) | null;
+};
+
+function post(message: SketchWorkerMessage): void {
+  scope.postMessage(message);
+}
+
+let runner: SketchRunner | null = null;
+
+scope.onmessage = (event) => {
+  const request = event.data;
+
+  switch (request.type) {
+    case 'start':
+      runner?.stop();
+      runner = new SketchRunner();
+      runner.start(request.wasm, request.speed).catch(error => {
+        runner?.stop();
+        post({ type: 'error', message: error instanceof Error ? error.message : String(error) });
+      });
+      break;
+    case 'pause':
+      runner?.pause();
+      break;
+    case 'resume':
+      runner?.resume();
+      break;
+    case 'speed':
+      runner?.setSpeed(request.speed);
+      break;
+    case 'input':
+      runner?.setInput(request.pin, request.value);
+      break;
+    case 'analog':
+      runner?.setAnalog(request.channel, request.value);
+      break;
+    case 'serial':
+      runner?.receiveSerial(request.data);
+      break;
+  }
+};
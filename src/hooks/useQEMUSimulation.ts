@@ -1,11 +1,40 @@
-import { useEffect, useCallback } from 'react';
+import { useEffect, useCallback, useRef } from 'react';
 import { useQEMUStore } from '@/stores/useQEMUStore';
 import { qemuApi } from '@/services/QEMUApiClient';
+import type { GpioPolicy, GpioPinPolicy } from '@/services/QEMUApiClient';
 import { qemuWebSocket } from '@/services/QEMUWebSocket';
+import type { PinBatchEvent, CompileQueueEvent } from '@/services/QEMUWebSocket';
 import { useSimulationStore } from '@/stores/useSimulationStore';
 import { useSerialStore } from '@/stores/useSerialStore';
+import { useConnectionStore } from '@/stores/useConnectionStore';
 import { simulationEngine } from '@/engine/SimulationEngine';
 
+/** Onboard LED drawn by MCUNode, reported even when nothing is wired to it */
+const BUILTIN_LED_PIN = 13;
+
+/** Arduino Uno: A0-A5 are digital pins 14-19 */
+const ANALOG_PIN_OFFSET = 14;
+
+/**
+ * GPIO policy for AVR boards: only pins the canvas shows (wired pins and
+ * the onboard LED) are reported, the firmware stays silent about the rest
+ */
+function canvasGpioPolicy(): GpioPolicy {
+  const pins: Record<number, GpioPinPolicy> = { [BUILTIN_LED_PIN]: 'edge' };
+
+  for (const { source, target } of useConnectionStore.getState().connections) {
+    for (const handle of [source, target]) {
+      const match = handle.match(/:([DA])(\d+)$/);
+      if (match) {
+        const pin = parseInt(match[2], 10);
+        pins[match[1] === 'A' ? pin + ANALOG_PIN_OFFSET : pin] = 'edge';
+      }
+    }
+  }
+
+  return { default: 'off', pins };
+}
+
 /**
  * Hook for managing QEMU simulation lifecycle
  */
@@ -16,14 +45,18 @@ export function useQEMUSimulation() {
     setBackendConnected,
     isWebSocketConnected,
     setWebSocketConnected,
+    isSimulationRunning,
     setSimulationRunning,
     setFirmwarePath,
     setCompiling,
-    setCompilationError
+    setCompilationError,
+    setCompileQueuePosition
   } = useQEMUStore();
 
   const { status } = useSimulationStore();
   const { addSerialLine } = useSerialStore();
+  const { connections } = useConnectionStore();
+  const runningBoardRef = useRef<string | null>(null);
 
   /**
    * Check backend health on mount
@@ -52,7 +85,21 @@ export function useQEMUSimulation() {
   useEffect(() => {
     if (mode !== 'qemu' || !isBackendConnected) return;
 
-    qemuWebSocket.connect();
+    let cancelled = false;
+
+    // Each browser tab gets its own backend session (own QEMU, own events)
+    const connectSession = async () => {
+      try {
+        const sessionId = await qemuApi.ensureSession();
+        if (!cancelled) {
+          qemuWebSocket.connect(sessionId);
+        }
+      } catch (error) {
+        console.warn('⚠️ Could not get a QEMU session:', error);
+      }
+    };
+
+    connectSession();
 
     // Subscribe to events
     const unsubscribers = [
@@ -84,13 +131,26 @@ export function useQEMUSimulation() {
         // 2. Update Value ONLY if provided (not during pure mode changes)
         if (value !== undefined) {
           const pinValue = (value === 1 || value === 'HIGH') ? 'HIGH' : 'LOW';
-          console.log(`📡 [QEMU-WS] Pin ${pinNum} -> ${pinValue} (Mode: ${mode || 'OUTPUT'})`);
 
           useSimulationStore.getState().digitalWrite(pinNum, pinValue);
           simulationEngine.emit('pinChange', { pin: pinNum, value: pinValue });
         }
       }),
 
+      // One frame of levels, modes, duty summaries and hardware PWM
+      qemuWebSocket.on('pinBatch', (batch: PinBatchEvent) => {
+        simulationEngine.applyPinBatch(batch);
+      }),
+
+      qemuWebSocket.on('sessionClosed', () => {
+        setSimulationRunning(false);
+        connectSession();
+      }),
+
+      qemuWebSocket.on('compileQueue', ({ position }: CompileQueueEvent) => {
+        setCompileQueuePosition(position);
+      }),
+
       qemuWebSocket.on('simulationStarted', () => {
         setSimulationRunning(true);
       }),
@@ -101,10 +161,25 @@ export function useQEMUSimulation() {
     ];
 
     return () => {
+      cancelled = true;
       unsubscribers.forEach(unsub => unsub());
       qemuWebSocket.disconnect();
     };
-  }, [mode, isBackendConnected, setWebSocketConnected, setSimulationRunning, addSerialLine]);
+  }, [mode, isBackendConnected, setWebSocketConnected, setSimulationRunning, setCompileQueuePosition, addSerialLine]);
+
+  /**
+   * Rewiring while running: tell the firmware which pins are now on the canvas
+   */
+  useEffect(() => {
+    if (mode !== 'qemu' || !isSimulationRunning) return;
+    if (runningBoardRef.current !== 'arduino-uno') return;
+
+    qemuApi.setGpioPolicy(canvasGpioPolicy()).then((result) => {
+      if (!result.success) {
+        console.warn('⚠️ Could not update GPIO policy:', result.error);
+      }
+    });
+  }, [mode, isSimulationRunning, connections]);
 
   /**
    * Compile and start QEMU simulation
@@ -116,8 +191,12 @@ export function useQEMUSimulation() {
     setCompilationError(null);
 
     try {
+      // Session may have been reaped while idle
+      const sessionId = await qemuApi.ensureSession();
+      qemuWebSocket.connect(sessionId);
+
       // Step 1: Compile
-      const compileResult = await qemuApi.compile(code, board as any);
+      const compileResult = await qemuApi.compile(code, board as any, 'qemu', qemuWebSocket.getId());
 
       if (!compileResult.success) {
         setCompilationError(compileResult.error || 'Compilation failed');
@@ -130,7 +209,8 @@ export function useQEMUSimulation() {
       const startResult = await qemuApi.startSimulation(
         compileResult.firmwarePath!,
         board as any,
-        compileResult.efusePath // Pass efusePath if available (ESP32)
+        compileResult.efusePath, // Pass efusePath if available (ESP32)
+        board === 'arduino-uno' ? canvasGpioPolicy() : undefined
       );
 
       if (!startResult.success) {
@@ -138,13 +218,15 @@ export function useQEMUSimulation() {
         return;
       }
 
+      runningBoardRef.current = board;
       setSimulationRunning(true);
     } catch (error) {
       setCompilationError(error instanceof Error ? error.message : 'Unknown error');
     } finally {
       setCompiling(false);
+      setCompileQueuePosition(0);
     }
-  }, [mode, setCompiling, setCompilationError, setFirmwarePath, setSimulationRunning]);
+  }, [mode, setCompiling, setCompilationError, setCompileQueuePosition, setFirmwarePath, setSimulationRunning]);
 
   /**
    * Stop QEMU simulation
@@ -1,6 +1,7 @@
 import type { BoardType } from '@/types';
 
-export type SimulationMode = 'interpreter' | 'qemu';
+/** wasm: WebAssembly module for the browser runtime (src/engine/WasmRuntime.ts) */
+export type SimulationMode = 'interpreter' | 'qemu' | 'wasm';
 
 export interface CompileResponse {
   success: boolean;
@@ -9,6 +10,8 @@ export interface CompileResponse {
   error?: string;
   stdout?: string;
   stderr?: string;
+  cached?: boolean; // Firmware reused from the backend compile cache
+  wasm?: string; // mode 'wasm': the module, base64
 }
 
 export interface SimulationStatus {
@@ -24,26 +27,76 @@ export interface PinState {
   value: number;
 }
 
+/** Per-pin GPIO reporting policy (AVR firmware only, see server GpioPolicy.ts) */
+export type GpioPinPolicy = 'off' | 'edge' | 'aggregate';
+
+export interface GpioPolicy {
+  default?: GpioPinPolicy;
+  pins?: Record<number, GpioPinPolicy>;
+  windowMs?: number;
+}
+
 /**
  * Client for NeuroForge Backend REST API
  */
 export class QEMUApiClient {
   private baseUrl: string;
+  private sessionId: string | null = null;
 
   constructor(baseUrl: string = 'http://localhost:3000') {
     this.baseUrl = baseUrl;
   }
 
+  /**
+   * Simulation routes of our session (unscoped default session until one exists)
+   */
+  private simulateUrl(path: string): string {
+    const scope = this.sessionId ? `/api/sessions/${this.sessionId}` : '/api';
+    return `${this.baseUrl}${scope}/simulate${path}`;
+  }
+
+  getSessionId(): string | null {
+    return this.sessionId;
+  }
+
+  /**
+   * Reuse our backend session if it still exists, otherwise create one.
+   * Sessions are reaped by the backend after a period without activity.
+   */
+  async ensureSession(): Promise<string> {
+    if (this.sessionId) {
+      try {
+        const response = await fetch(`${this.baseUrl}/api/sessions/${this.sessionId}`);
+        if (response.ok) {
+          return this.sessionId;
+        }
+      } catch {
+        // Backend unreachable: fall through and let the create call report it
+      }
+    }
+
+    const response = await fetch(`${this.baseUrl}/api/sessions`, { method: 'POST' });
+    const data = await response.json();
+    if (!data.success) {
+      throw new Error(data.error || 'Failed to create session');
+    }
+
+    this.sessionId = data.sessionId;
+    return data.sessionId;
+  }
+
   /**
    * Compile Arduino code to firmware
    * @param code - Arduino sketch code
    * @param board - Target board type
    * @param mode - Simulation mode (qemu uses NeuroForge Time board)
+   * @param clientId - WebSocket id that receives queue position updates
    */
   async compile(
     code: string,
     board: BoardType = 'arduino-uno',
-    mode: SimulationMode = 'qemu'
+    mode: SimulationMode = 'qemu',
+    clientId?: string
   ): Promise<CompileResponse> {
     try {
       const response = await fetch(`${this.baseUrl}/api/compile`, {
@@ -51,7 +104,7 @@ export class QEMUApiClient {
         headers: {
           'Content-Type': 'application/json'
         },
-        body: JSON.stringify({ code, board, mode })
+        body: JSON.stringify({ code, board, mode, clientId })
       });
 
       const data = await response.json();
@@ -69,14 +122,16 @@ export class QEMUApiClient {
    * @param firmwarePath - Path to firmware binary
    * @param board - Target board type
    * @param efusePath - Optional path to eFuse image (ESP32 only)
+   * @param gpioPolicy - Optional per-pin reporting policy (AVR only)
    */
   async startSimulation(
     firmwarePath: string,
     board: BoardType = 'arduino-uno',
-    efusePath?: string
+    efusePath?: string,
+    gpioPolicy?: GpioPolicy
   ): Promise<CompileResponse> {
     try {
-      const response = await fetch(`${this.baseUrl}/api/simulate/start`, {
+      const response = await fetch(this.simulateUrl('/start'), {
         method: 'POST',
         headers: {
           'Content-Type': 'application/json'
@@ -84,7 +139,8 @@ export class QEMUApiClient {
         body: JSON.stringify({
           firmwarePath,
           board,
-          ...(efusePath && { efusePath })
+          ...(efusePath && { efusePath }),
+          ...(gpioPolicy && { gpioPolicy })
         })
       });
 
@@ -98,12 +154,35 @@ export class QEMUApiClient {
     }
   }
 
+  /**
+   * Replace the GPIO reporting policy of the running simulation (AVR only)
+   */
+  async setGpioPolicy(gpioPolicy: GpioPolicy): Promise<CompileResponse> {
+    try {
+      const response = await fetch(this.simulateUrl('/gpio-policy'), {
+        method: 'POST',
+        headers: {
+          'Content-Type': 'application/json'
+        },
+        body: JSON.stringify(gpioPolicy)
+      });
+
+      const data = await response.json();
+      return data;
+    } catch (error) {
+      return {
+        success: false,
+        error: error instanceof Error ? error.message : 'Network error'
+      };
+    }
+  }
+
   /**
    * Stop QEMU simulation
    */
   async stopSimulation(): Promise<CompileResponse> {
     try {
-      const response = await fetch(`${this.baseUrl}/api/simulate/stop`, {
+      const response = await fetch(this.simulateUrl('/stop'), {
         method: 'POST'
       });
 
@@ -122,7 +201,7 @@ export class QEMUApiClient {
    */
   async getStatus(): Promise<SimulationStatus> {
     try {
-      const response = await fetch(`${this.baseUrl}/api/simulate/status`);
+      const response = await fetch(this.simulateUrl('/status'));
       const data = await response.json();
       return data;
     } catch (error) {
@@ -139,7 +218,7 @@ export class QEMUApiClient {
    */
   async readPin(pin: number): Promise<PinState> {
     try {
-      const response = await fetch(`${this.baseUrl}/api/simulate/pins/${pin}`);
+      const response = await fetch(this.simulateUrl(`/pins/${pin}`));
       const data = await response.json();
       return data;
     } catch (error) {
@@ -157,7 +236,7 @@ export class QEMUApiClient {
    */
   async writePin(pin: number, value: number): Promise<CompileResponse> {
     try {
-      const response = await fetch(`${this.baseUrl}/api/simulate/pins/${pin}`, {
+      const response = await fetch(this.simulateUrl(`/pins/${pin}`), {
         method: 'POST',
         headers: {
           'Content-Type': 'application/json'
@@ -175,12 +254,37 @@ export class QEMUApiClient {
     }
   }
 
+  /**
+   * Feed analogRead(pin) in QEMU: a constant ({ value }) or a waveform
+   * ({ waveform, min, max, frequencyHz } / { samples, sampleRateHz }),
+   * played back on the firmware's virtual clock
+   */
+  async writeAnalog(pin: number, source: Record<string, unknown>): Promise<CompileResponse> {
+    try {
+      const response = await fetch(this.simulateUrl(`/analog/${pin}`), {
+        method: 'POST',
+        headers: {
+          'Content-Type': 'application/json'
+        },
+        body: JSON.stringify(source)
+      });
+
+      const data = await response.json();
+      return data;
+    } catch (error) {
+      return {
+        success: false,
+        error: error instanceof Error ? error.message : 'Network error'
+      };
+    }
+  }
+
   /**
    * Get serial buffer
    */
   async getSerial(): Promise<{ success: boolean; lines: string[] }> {
     try {
-      const response = await fetch(`${this.baseUrl}/api/simulate/serial`);
+      const response = await fetch(this.simulateUrl('/serial'));
       const data = await response.json();
       return data;
     } catch (error) {
@@ -196,7 +300,7 @@ export class QEMUApiClient {
    */
   async clearSerial(): Promise<CompileResponse> {
     try {
-      const response = await fetch(`${this.baseUrl}/api/simulate/serial`, {
+      const response = await fetch(this.simulateUrl('/serial'), {
         method: 'DELETE'
       });
 
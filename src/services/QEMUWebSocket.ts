@@ -6,6 +6,22 @@ export interface PinChangeEvent {
   value: number;
 }
 
+/**
+ * Coalesced pin activity, once per frame (~60 Hz): sent by the backend,
+ * and posted in the same shape by the WASM sketch worker
+ */
+export interface PinBatchEvent {
+  seq: number;
+  pins: [number, number][]; // [pin, value]
+  modes?: [number, PinChangeEvent['mode']][]; // [pin, mode]
+  duty?: [number, number, number][]; // [pin, toggles, highRatio 0..1] - toggling faster than the frame
+  pwm?: [number, number, number][]; // [pin, duty 0..1, frequency Hz] - hardware PWM (analogWrite/ledcWrite), no edges
+}
+
+export interface CompileQueueEvent {
+  position: number; // Place in the compile queue (1 = next); 0 = building
+}
+
 export interface SimulationStatusEvent {
   running: boolean;
   paused: boolean;
@@ -19,19 +35,28 @@ export class QEMUWebSocket {
   private reconnectAttempts = 0;
   private maxReconnectAttempts = 5;
   private listeners: Map<string, Set<Function>> = new Map();
+  private sessionId: string | undefined;
 
   constructor(private url: string = 'http://localhost:3000') { }
 
   /**
    * Connect to WebSocket server
+   * @param sessionId - Backend session whose simulation events we receive
    */
-  connect(): void {
-    if (this.socket?.connected) {
+  connect(sessionId?: string): void {
+    if (this.socket && this.sessionId !== sessionId) {
+      // Events are scoped to the session chosen at handshake
+      this.disconnect();
+    }
+
+    if (this.socket?.connected || this.socket?.active) {
       console.log('Already connected to WebSocket');
       return;
     }
 
+    this.sessionId = sessionId;
     this.socket = io(this.url, {
+      auth: sessionId ? { sessionId } : undefined,
       transports: ['websocket'],
       reconnection: true,
       reconnectionDelay: 1000,
@@ -69,6 +94,27 @@ export class QEMUWebSocket {
       this.emit('pinChange', data);
     });
 
+    // Batched delivery: ack so the backend knows we keep up (backpressure).
+    // Applied as a whole (simulationEngine.applyPinBatch), like the WASM runtime's frames
+    this.socket.on('pinBatch', (batch: PinBatchEvent, ack?: () => void) => {
+      this.emit('pinBatch', batch);
+      ack?.();
+    });
+
+    // Session reaped or deleted by the backend: a new one must be created
+    this.socket.on('sessionClosed', () => {
+      this.emit('sessionClosed');
+    });
+
+    this.socket.on('sessionError', (data: { error: string }) => {
+      console.error('Session error:', data.error);
+      this.emit('sessionClosed');
+    });
+
+    this.socket.on('compileQueue', (data: CompileQueueEvent) => {
+      this.emit('compileQueue', data);
+    });
+
     this.socket.on('simulationStarted', () => {
       this.emit('simulationStarted');
     });
@@ -126,6 +172,13 @@ export class QEMUWebSocket {
     }
   }
 
+  /**
+   * Socket id, sent with /api/compile to receive 'compileQueue' events
+   */
+  getId(): string | undefined {
+    return this.socket?.id;
+  }
+
   /**
    * Check if connected
    */
@@ -29,6 +29,8 @@ interface QEMUState {
   setCompiling: (compiling: boolean) => void;
   compilationError: string | null;
   setCompilationError: (error: string | null) => void;
+  compileQueuePosition: number; // Place in the backend compile queue (1 = next, 0 = building)
+  setCompileQueuePosition: (position: number) => void;
 
   // Backend URL
   backendUrl: string;
@@ -60,6 +62,9 @@ export const useQEMUStore = create<QEMUState>()(
       compilationError: null,
       setCompilationError: (error) => set({ compilationError: error }),
 
+      compileQueuePosition: 0,
+      setCompileQueuePosition: (position) => set({ compileQueuePosition: position }),
+
       backendUrl: 'http://localhost:3000',
       setBackendUrl: (url) => set({ backendUrl: url })
     }),
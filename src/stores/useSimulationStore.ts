@@ -8,6 +8,7 @@ import type {
   PinState,
   MCUConfig
 } from '@/types';
+import type { PinBatchEvent } from '@/services/QEMUWebSocket';
 
 interface SimulationStore {
   // Simulation state
@@ -46,6 +47,7 @@ interface SimulationStore {
   setPinMode: (pin: number, mode: PinState['mode']) => void;
   digitalWrite: (pin: number, value: 'HIGH' | 'LOW') => void;
   analogWrite: (pin: number, value: number) => void;
+  applyPinBatch: (batch: PinBatchEvent) => void;
   digitalRead: (pin: number) => 'HIGH' | 'LOW';
   analogRead: (pin: number) => number;
   getPinState: (pin: number) => PinState | undefined;
@@ -384,6 +386,27 @@ export const useSimulationStore = create<SimulationStore>()(
         });
       },
 
+      // One store update per frame (QEMU pinBatch or WASM worker), not one per pin
+      applyPinBatch: (batch) => {
+        set((state) => {
+          const newPins = new Map(state.pins);
+          const write = (pin: number, value: PinState['value']) => {
+            newPins.set(pin, { pin, mode: newPins.get(pin)?.mode ?? 'OUTPUT', value });
+          };
+
+          batch.modes?.forEach(([pin, mode]) => {
+            if (mode === 'UNKNOWN') return;
+            newPins.set(pin, { pin, mode, value: newPins.get(pin)?.value ?? 'LOW' });
+          });
+          batch.pins.forEach(([pin, value]) => write(pin, value ? 'HIGH' : 'LOW'));
+          // PWM-like toggling / hardware PWM: render the average level
+          batch.duty?.forEach(([pin, , highRatio]) => write(pin, Math.round(highRatio * 255)));
+          batch.pwm?.forEach(([pin, duty]) => write(pin, Math.round(duty * 255)));
+
+          return { pins: newPins };
+        });
+      },
+
       digitalRead: (pin) => {
         const pinState = get().pins.get(pin);
         if (!pinState) return 'LOW';